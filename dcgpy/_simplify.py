@@ -11,7 +11,8 @@ def _sympy_simplify(self, in_sym, subs_weights = False, erc = []):
     Returns the simplified dCGP expression for each output
 
     Note:
-        This method requires ``sympy`` and ``pyaudi`` modules installed in your Python system
+        This method requires ``sympy`` and ``pyaudi`` modules installed in your Python system. For the double
+        expressions, :func:`~dcgpy.expression_double.simplify_graph` simplifies the graph natively and much faster.
 
     Args:
         in_sym (a ``List[str]``): input symbols (its length must match the number of inputs)
@@ -3,13 +3,20 @@
 #include <functional> //std::function
 #include <sstream>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <dcgp/expression.hpp>
 #include <dcgp/expression_ann.hpp>
 #include <dcgp/expression_weighted.hpp>
+#include <dcgp/frozen_ann.hpp>
 #include <dcgp/kernel.hpp>
 #include <dcgp/kernel_set.hpp>
+#include <dcgp/newton.hpp>
+#include <dcgp/quantized_ann.hpp>
+#include <dcgp/s11n.hpp>
+#include <dcgp/simplified_expression.hpp>
+#include <dcgp/symbolic_dag.hpp>
 
 // See: https://docs.scipy.org/doc/numpy/reference/c-api.array.html#importing-the-api
 // In every cpp file We need to make sure this is included before everything else,
@@ -98,11 +105,108 @@ void expose_kernel_set(std::string type)
         .def("__getitem__", &wrap_operator<T>);
 }
 
+// Pickle support for the expressions. The state is a compact binary blob produced by boost serialization
+// (weights and biases included). The kernels are reconstructed by name upon unpickling, hence only expressions
+// built using the kernels in kernel_set can be unpickled.
+template <typename Expr>
+struct expression_pickle_suite : bp::pickle_suite {
+    static bp::tuple getstate(const Expr &instance)
+    {
+        std::ostringstream oss;
+        {
+            boost::archive::binary_oarchive oarchive(oss);
+            oarchive << instance;
+        }
+        auto s = oss.str();
+        return bp::make_tuple(
+            bp::object(bp::handle<>(PyBytes_FromStringAndSize(s.data(), static_cast<Py_ssize_t>(s.size())))));
+    }
+    static void setstate(Expr &instance, const bp::tuple &state)
+    {
+        if (bp::len(state) != 1) {
+            dcgpy_throw(PyExc_ValueError, ("the state tuple passed for expression deserialization must have a "
+                                           "single element, but instead it has "
+                                           + std::to_string(bp::len(state)) + " elements")
+                                              .c_str());
+        }
+        auto ptr = PyBytes_AsString(bp::object(state[0]).ptr());
+        if (!ptr) {
+            dcgpy_throw(PyExc_TypeError, "a bytes object is needed to deserialize an expression");
+        }
+        const auto size = bp::len(state[0]);
+        std::istringstream iss(std::string(ptr, ptr + size));
+        boost::archive::binary_iarchive iarchive(iss);
+        iarchive >> instance;
+    }
+};
+
+// The reverse mode gradient and the simplification are only available for the double expressions
+template <typename T>
+void expose_expression_gradient(bp::class_<expression<T>> &)
+{
+}
+
+// Converts a contiguous row-major tensor into nested lists of the given shape
+bp::list tensor_to_l(const std::vector<double> &flat, const std::vector<std::size_t> &shape, unsigned dim = 0u,
+                     std::size_t offset = 0u)
+{
+    std::size_t stride = 1u;
+    for (auto d = dim + 1u; d < shape.size(); ++d) {
+        stride *= shape[d];
+    }
+    bp::list retval;
+    for (std::size_t i = 0u; i < shape[dim]; ++i) {
+        if (dim + 1u == shape.size()) {
+            retval.append(flat[offset + i]);
+        } else {
+            retval.append(tensor_to_l(flat, shape, dim + 1u, offset + i * stride));
+        }
+    }
+    return retval;
+}
+
+void expose_expression_gradient(bp::class_<expression<double>> &expression_class)
+{
+    expression_class.def("gradient",
+                         +[](const expression<double> &instance, const bp::object &point) {
+                             auto res = instance.gradient(to_v<double>(point));
+                             const auto &jacobian = std::get<1>(res);
+                             bp::list rows;
+                             for (auto i = 0u; i < instance.get_m(); ++i) {
+                                 rows.append(v_to_l(std::vector<double>(jacobian.begin() + i * instance.get_n(),
+                                                                        jacobian.begin() + (i + 1u) * instance.get_n())));
+                             }
+                             return bp::make_tuple(v_to_l(std::get<0>(res)), rows);
+                         },
+                         expression_gradient_doc().c_str(), bp::arg("point"));
+    expression_class.def("jacobian",
+                         +[](const expression<double> &instance, const bp::object &points, unsigned parallel) {
+                             auto points_v = to_vv<double>(points);
+                             return tensor_to_l(instance.jacobian(points_v, parallel),
+                                                {points_v.size(), instance.get_m(), instance.get_n()});
+                         },
+                         expression_jacobian_doc().c_str(), (bp::arg("points"), bp::arg("parallel") = 0u));
+    expression_class.def("hessian",
+                         +[](const expression<double> &instance, const bp::object &points, unsigned parallel) {
+                             auto points_v = to_vv<double>(points);
+                             auto n = instance.get_n();
+                             return tensor_to_l(instance.hessian(points_v, parallel),
+                                                {points_v.size(), instance.get_m(), n, n});
+                         },
+                         expression_hessian_doc().c_str(), (bp::arg("points"), bp::arg("parallel") = 0u));
+    expression_class.def("simplify_graph", &expression<double>::simplify, expression_simplify_graph_doc().c_str());
+}
+
 template <typename T>
 void expose_expression(std::string type)
 {
     std::string class_name = "expression_" + type;
-    bp::class_<expression<T>>(class_name.c_str(), "A CGP expression", bp::no_init)
+    bp::class_<expression<T>> expression_class(class_name.c_str(), "A CGP expression", bp::no_init);
+    expression_class
+        // Default constructor (needed for unpickling)
+        .def("__init__", bp::make_constructor(+[]() {
+                 return ::new expression<T>(1u, 1u, 1u, 1u, 1u, 1u, kernel_set<T>({"sum"})(), 0u);
+             }))
         // Constructor with seed
         .def("__init__",
              bp::make_constructor(
@@ -160,6 +264,11 @@ void expose_expression(std::string type)
                      return v_to_l(instance(v));
                  }
              })
+        .def("symbolic",
+             +[](const expression<T> &instance, const bp::object &in, const std::string &prefix) {
+                 return instance.symbolic(l_to_v<std::string>(in), prefix);
+             },
+             expression_symbolic_doc().c_str(), (bp::arg("in_sym"), bp::arg("prefix") = "u"))
         .def("set", +[](expression<T> &instance, const bp::object &in) { instance.set(l_to_v<unsigned>(in)); },
              expression_set_doc().c_str(), bp::arg("chromosome"))
         .def("set_f_gene", &expression<T>::set_f_gene, expression_set_f_gene_doc().c_str(),
@@ -210,14 +319,52 @@ void expose_expression(std::string type)
              +[](expression<T> &instance, const bp::object &points, const bp::object &labels, const std::string &loss,
                  unsigned parallel) { return instance.loss(to_vv<T>(points), to_vv<T>(labels), loss, parallel); },
              expression_loss_doc().c_str(),
-             (bp::arg("points"), bp::arg("labels"), bp::arg("loss"), bp::arg("parallel") = 0u));
+             (bp::arg("points"), bp::arg("labels"), bp::arg("loss"), bp::arg("parallel") = 0u))
+        .def_pickle(expression_pickle_suite<expression<T>>());
+    expose_expression_gradient(expression_class);
+}
+
+// The training of the weights is only available for the double expressions
+template <typename T>
+void expose_expression_weighted_training(bp::class_<expression_weighted<T>, bp::bases<expression<T>>> &)
+{
+}
+
+void expose_expression_weighted_training(
+    bp::class_<expression_weighted<double>, bp::bases<expression<double>>> &expression_class)
+{
+    expression_class
+        .def("d_loss",
+             +[](const expression_weighted<double> &instance, const bp::object &points, const bp::object &labels,
+                 const std::string &loss, unsigned parallel) {
+                 auto loss_e = dcgp::detail::decode_loss<double>(loss);
+                 auto res = instance.d_loss(to_vv<double>(points), to_vv<double>(labels), loss_e, parallel);
+                 return bp::make_tuple(std::get<0>(res), v_to_l(std::get<1>(res)));
+             },
+             expression_weighted_d_loss_doc().c_str(),
+             (bp::arg("points"), bp::arg("labels"), bp::arg("loss"), bp::arg("parallel") = 0u))
+        .def("sgd",
+             +[](expression_weighted<double> &instance, const bp::object &points, const bp::object &labels,
+                 double l_rate, unsigned batch_size, const std::string &loss, unsigned parallel, bool shuffle) {
+                 auto d = to_vv<double>(points);
+                 auto l = to_vv<double>(labels);
+                 return instance.sgd(d, l, l_rate, batch_size, loss, parallel, shuffle);
+             },
+             expression_weighted_sgd_doc().c_str(),
+             (bp::arg("points"), bp::arg("labels"), bp::arg("lr"), bp::arg("batch_size"), bp::arg("loss"),
+              bp::arg("parallel") = 0u, bp::arg("shuffle") = true));
 }
 
 template <typename T>
 void expose_expression_weighted(std::string type)
 {
     std::string class_name = "expression_weighted_" + type;
-    bp::class_<expression_weighted<T>, bp::bases<expression<T>>>(class_name.c_str(), bp::no_init)
+    bp::class_<expression_weighted<T>, bp::bases<expression<T>>> expression_class(class_name.c_str(), bp::no_init);
+    expression_class
+        // Default constructor (needed for unpickling)
+        .def("__init__", bp::make_constructor(+[]() {
+                 return ::new expression_weighted<T>(1u, 1u, 1u, 1u, 1u, 1u, kernel_set<T>({"sum"})(), 0u);
+             }))
         // Constructor with seed
         .def("__init__",
              bp::make_constructor(
@@ -285,7 +432,9 @@ void expose_expression_weighted(std::string type)
         .def("get_weight", &expression_weighted<T>::get_weight, expression_weighted_get_weight_doc().c_str(),
              (bp::arg("node_id"), bp::arg("input_id")))
         .def("get_weights", +[](expression_weighted<T> &instance) { return v_to_l(instance.get_weights()); },
-             "Gets all weights");
+             "Gets all weights")
+        .def_pickle(expression_pickle_suite<expression_weighted<T>>());
+    expose_expression_weighted_training(expression_class);
 }
 
 template <typename T>
@@ -293,6 +442,10 @@ void expose_expression_ann(std::string type)
 {
     std::string class_name = "expression_ann_" + type;
     bp::class_<expression_ann, bp::bases<expression<T>>>(class_name.c_str(), bp::no_init)
+        // Default constructor (needed for unpickling)
+        .def("__init__", bp::make_constructor(+[]() {
+                 return ::new expression_ann(1u, 1u, 1u, 1u, 1u, 1u, kernel_set<double>({"sum"})(), 0u);
+             }))
         // Constructor with seed
         .def("__init__",
              bp::make_constructor(
@@ -381,6 +534,9 @@ void expose_expression_ann(std::string type)
              "Gets all weights")
         .def("n_active_weights", &expression_ann::n_active_weights, expression_ann_n_active_weights_doc().c_str(),
              bp::arg("unique") = false)
+        .def("is_layered", &expression_ann::is_layered,
+             "is_layered()\nTrue if the network is made of dense layers, each connected only to the previous one. In "
+             "that case the loss gradient is computed on batches via matrix products")
         .def("randomise_weights",
              +[](expression_ann &instance, double mean, double std, unsigned seed) {
                  return instance.randomise_weights(mean, std, seed);
@@ -412,7 +568,170 @@ void expose_expression_ann(std::string type)
              },
              expression_ann_sgd_doc().c_str(),
              (bp::arg("points"), bp::arg("labels"), bp::arg("lr"), bp::arg("batch_size"), bp::arg("loss"),
-              bp::arg("parallel") = 0u, bp::arg("shuffle") = true));
+              bp::arg("parallel") = 0u, bp::arg("shuffle") = true))
+        .def("sgd_async",
+             +[](expression_ann &instance, const bp::object &points, const bp::object &labels, double l_rate,
+                 unsigned batch_size, const std::string &loss, unsigned n_shards, bool shuffle, unsigned seed) {
+                 auto d = to_vv<double>(points);
+                 auto l = to_vv<double>(labels);
+                 return instance.sgd_async(d, l, l_rate, batch_size, loss, n_shards, shuffle, seed);
+             },
+             expression_ann_sgd_async_doc().c_str(),
+             (bp::arg("points"), bp::arg("labels"), bp::arg("lr"), bp::arg("batch_size"), bp::arg("loss"),
+              bp::arg("n_shards"), bp::arg("shuffle"), bp::arg("seed")))
+        .def("sgd_async",
+             +[](expression_ann &instance, const bp::object &points, const bp::object &labels, double l_rate,
+                 unsigned batch_size, const std::string &loss, unsigned n_shards, bool shuffle) {
+                 auto d = to_vv<double>(points);
+                 auto l = to_vv<double>(labels);
+                 return instance.sgd_async(d, l, l_rate, batch_size, loss, n_shards, shuffle, std::random_device()());
+             },
+             (bp::arg("points"), bp::arg("labels"), bp::arg("lr"), bp::arg("batch_size"), bp::arg("loss"),
+              bp::arg("n_shards") = 0u, bp::arg("shuffle") = true))
+        .def("set_optimizer", &expression_ann::set_optimizer, expression_ann_set_optimizer_doc().c_str(),
+             (bp::arg("name"), bp::arg("beta1") = 0.9, bp::arg("beta2") = 0.999, bp::arg("eps") = 1e-8))
+        .def("get_optimizer", &expression_ann::get_optimizer,
+             "get_optimizer()\nGets the name of the optimizer used by sgd")
+        .def("reset_optimizer", &expression_ann::reset_optimizer,
+             "reset_optimizer()\nSets to zero all the moment estimates of the optimizer used by sgd")
+        .def("set_precision", &expression_ann::set_precision, expression_ann_set_precision_doc().c_str(),
+             (bp::arg("name")))
+        .def("get_precision", &expression_ann::get_precision,
+             "get_precision()\nGets the floating point precision of the batch computations (sgd, sgd_async)")
+        .def("freeze", &expression_ann::freeze, expression_ann_freeze_doc().c_str())
+        .def_pickle(expression_pickle_suite<expression_ann>());
+}
+
+void expose_frozen_ann()
+{
+    bp::class_<frozen_ann>("frozen_ann", frozen_ann_doc().c_str(), bp::init<>())
+        .def("__call__",
+             +[](const frozen_ann &instance, const bp::object &in) { return v_to_l(instance(to_v<double>(in))); })
+        .def("batch",
+             +[](const frozen_ann &instance, const bp::object &points) {
+                 bp::list retval;
+                 for (const auto &out : instance(to_vv<double>(points))) {
+                     retval.append(v_to_l(out));
+                 }
+                 return retval;
+             },
+             frozen_ann_batch_doc().c_str(), bp::arg("points"))
+        .def("get_n", &frozen_ann::get_n, "get_n()\nGets the number of inputs")
+        .def("get_m", &frozen_ann::get_m, "get_m()\nGets the number of outputs")
+        .def("get_n_nodes", &frozen_ann::get_n_nodes, "get_n_nodes()\nGets the number of nodes")
+        .def_pickle(expression_pickle_suite<frozen_ann>());
+}
+
+void expose_simplified_expression()
+{
+    bp::class_<simplified_expression>("simplified_expression", simplified_expression_doc().c_str(), bp::init<>())
+        .def("__call__",
+             +[](const simplified_expression &instance, const bp::object &in) {
+                 std::vector<double> v;
+                 try {
+                     v = to_v<double>(in);
+                 } catch (...) {
+                     PyErr_Clear();
+                     return v_to_l(instance(l_to_v<std::string>(in)));
+                 }
+                 return v_to_l(instance(v));
+             })
+        .def("batch",
+             +[](const simplified_expression &instance, const bp::object &points) {
+                 bp::list retval;
+                 for (const auto &out : instance(to_vv<double>(points))) {
+                     retval.append(v_to_l(out));
+                 }
+                 return retval;
+             },
+             simplified_expression_batch_doc().c_str(), bp::arg("points"))
+        .def("get_n", &simplified_expression::get_n, "get_n()\nGets the number of inputs")
+        .def("get_m", &simplified_expression::get_m, "get_m()\nGets the number of outputs")
+        .def("get_n_nodes", &simplified_expression::get_n_nodes,
+             "get_n_nodes()\nGets the number of nodes (constants included)")
+        .def_pickle(expression_pickle_suite<simplified_expression>());
+}
+
+void expose_symbolic_dag()
+{
+    bp::class_<symbolic_dag>("symbolic_dag", symbolic_dag_doc().c_str(), bp::init<>())
+        .def("__repr__", +[](const symbolic_dag &instance) { return instance.to_string(); })
+        .def("flatten", +[](const symbolic_dag &instance) { return v_to_l(instance.flatten()); },
+             symbolic_dag_flatten_doc().c_str())
+        .def("get_definitions",
+             +[](const symbolic_dag &instance) {
+                 bp::list retval;
+                 for (auto k = 0u; k < instance.get_n_nodes(); ++k) {
+                     retval.append(bp::make_tuple(instance.get_nodes()[k].name, instance.get_definition(k)));
+                 }
+                 return retval;
+             },
+             "get_definitions()\nGets the (name, definition) pairs of the nodes, in topological order")
+        .def("get_outputs",
+             +[](const symbolic_dag &instance) {
+                 bp::list retval;
+                 for (auto o : instance.get_outputs()) {
+                     retval.append(instance.get_name(o));
+                 }
+                 return retval;
+             },
+             "get_outputs()\nGets the names of the outputs (input symbols or node names)")
+        .def("get_n", &symbolic_dag::get_n, "get_n()\nGets the number of inputs")
+        .def("get_m", &symbolic_dag::get_m, "get_m()\nGets the number of outputs")
+        .def("get_n_nodes", &symbolic_dag::get_n_nodes, "get_n_nodes()\nGets the number of nodes");
+}
+
+void expose_quantized_ann()
+{
+    bp::class_<quantized_ann>("quantized_ann", quantized_ann_doc().c_str(), bp::init<>())
+        .def("__init__", bp::make_constructor(
+                             +[](const frozen_ann &f, const bp::object &points) {
+                                 return ::new quantized_ann(f, to_vv<double>(points));
+                             },
+                             bp::default_call_policies(), (bp::arg("f"), bp::arg("points"))))
+        .def("__call__",
+             +[](const quantized_ann &instance, const bp::object &in) { return v_to_l(instance(to_v<double>(in))); })
+        .def("batch",
+             +[](const quantized_ann &instance, const bp::object &points) {
+                 bp::list retval;
+                 for (const auto &out : instance(to_vv<double>(points))) {
+                     retval.append(v_to_l(out));
+                 }
+                 return retval;
+             },
+             frozen_ann_batch_doc().c_str(), bp::arg("points"))
+        .def("get_n", &quantized_ann::get_n, "get_n()\nGets the number of inputs")
+        .def("get_m", &quantized_ann::get_m, "get_m()\nGets the number of outputs")
+        .def("get_n_nodes", &quantized_ann::get_n_nodes, "get_n_nodes()\nGets the number of nodes")
+        .def("get_scales", +[](const quantized_ann &instance) { return v_to_l(instance.get_scales()); },
+             "get_scales()\nGets the scales of the registers (inputs first, then nodes)")
+        .def_pickle(expression_pickle_suite<quantized_ann>());
+}
+
+void expose_newton()
+{
+    bp::def("newton_constants",
+            +[](const expression<gdual_d> &ex, const bp::object &constants, const bp::object &constants_idx,
+                const bp::object &points, const bp::object &labels, const std::string &loss, unsigned max_iter,
+                double tol) {
+                auto c = to_v<double>(constants);
+                auto retval
+                    = newton_constants(ex, c, l_to_v<unsigned>(constants_idx), to_vv<double>(points),
+                                       to_vv<double>(labels), loss, max_iter, tol);
+                return bp::make_tuple(retval, v_to_l(c));
+            },
+            newton_constants_doc().c_str(),
+            (bp::arg("ex"), bp::arg("constants"), bp::arg("constants_idx"), bp::arg("points"), bp::arg("labels"),
+             bp::arg("loss") = "MSE", bp::arg("max_iter") = 50u, bp::arg("tol") = 1e-12));
+    bp::def("newton_weights",
+            +[](expression_weighted<gdual_d> &ex, const bp::object &weights_idx, const bp::object &points,
+                const bp::object &labels, const std::string &loss, unsigned max_iter, double tol) {
+                return newton_weights(ex, l_to_v<unsigned>(weights_idx), to_vv<double>(points),
+                                      to_vv<double>(labels), loss, max_iter, tol);
+            },
+            newton_weights_doc().c_str(),
+            (bp::arg("ex"), bp::arg("weights_idx"), bp::arg("points"), bp::arg("labels"), bp::arg("loss") = "MSE",
+             bp::arg("max_iter") = 50u, bp::arg("tol") = 1e-12));
 }
 
 BOOST_PYTHON_MODULE(core)
@@ -442,11 +761,16 @@ BOOST_PYTHON_MODULE(core)
     expose_expression<double>("double");
     expose_expression_weighted<double>("double");
     expose_expression_ann<double>("double");
+    expose_frozen_ann();
+    expose_quantized_ann();
+    expose_simplified_expression();
+    expose_symbolic_dag();
 
     expose_kernel<gdual_d>("gdual_double");
     expose_kernel_set<gdual_d>("gdual_double");
     expose_expression<gdual_d>("gdual_double");
     expose_expression_weighted<gdual_d>("gdual_double");
+    expose_newton();
 
     expose_kernel<gdual_v>("gdual_vdouble");
     expose_kernel_set<gdual_v>("gdual_vdouble");
@@ -120,6 +120,119 @@ Raises:
     )";
 }
 
+std::string expression_gradient_doc()
+{
+    return R"(gradient(point)
+
+Computes the value of the expression and its derivatives with respect to all inputs in one forward and one backward
+(reverse mode) sweep over the active nodes. All the kernels built by :class:`dcgpy.kernel_set_double` know their
+derivatives, hence this is much cheaper than evaluating the expression on first order gduals.
+
+Args:
+    point (a ``List[float]`` or a 1D NumPy float array): the input point
+
+Returns:
+    a ``tuple`` containing the value of the outputs (a ``List[float]``) and the Jacobian (a ``List[List[float]]`` where
+    the entry [i][j] is the derivative of the output i with respect to the input j)
+
+Raises:
+    ValueError: if *point* has the wrong size or if an active kernel does not provide its derivatives
+    )";
+}
+
+std::string expression_jacobian_doc()
+{
+    return R"(jacobian(points, parallel = 0)
+
+Computes, as :func:`~dcgpy.expression_double.gradient`, the Jacobian of the expression at each of the points.
+
+Args:
+    points (a ``List[List[float]]`` or a 2D NumPy float array): the points
+    parallel (``int``): sets the grain for parallelism. 0 -> no parallelism n -> divides the points into n parts and
+        computes them in parallel threads
+
+Returns:
+    a ``List[List[List[float]]]`` where the entry [k][i][j] is the derivative of the output i with respect to the
+    input j at the point k
+
+Raises:
+    ValueError: if a point has the wrong size or if an active kernel does not provide its derivatives
+    )";
+}
+
+std::string expression_hessian_doc()
+{
+    return R"(hessian(points, parallel = 0)
+
+Computes the Hessian of each output of the expression at each of the points, running the reverse mode sweeps of
+:func:`~dcgpy.expression_double.gradient` on dual numbers once per input (forward over reverse mode).
+
+Args:
+    points (a ``List[List[float]]`` or a 2D NumPy float array): the points
+    parallel (``int``): sets the grain for parallelism. 0 -> no parallelism n -> divides the points into n parts and
+        computes them in parallel threads
+
+Returns:
+    a ``List[List[List[List[float]]]]`` where the entry [k][i][j][l] is the second derivative of the output i with
+    respect to the inputs j and l at the point k
+
+Raises:
+    ValueError: if a point has the wrong size or if an active kernel is not one of :class:`dcgpy.kernel_set_double`
+    )";
+}
+
+std::string expression_simplify_graph_doc()
+{
+    return R"(simplify_graph()
+
+Simplifies the active graph of the expression, without the round trip through strings and sympy of
+:func:`~dcgpy.expression_double.simplify`. Weights and biases become constants, which are folded. The identities
+x * 1, x + 0, x - x, x / x and 0 / x are eliminated, the arguments of the commutative kernels sorted and the identical
+subexpressions merged. The identities hold where the expression is finite.
+
+Returns:
+    A :class:`dcgpy.simplified_expression` computing the same outputs as the expression.
+
+Raises:
+    ValueError: if an active kernel is not one of :class:`dcgpy.kernel_set_double`
+
+Examples:
+    >>> ex = dcgpy.expression_double(1,1,1,2,3,2,dcgpy.kernel_set_double(["sum","diff"])(),0)
+    >>> ex.set([1,0,0,0,1,0,1])
+    >>> print(ex.simplify_graph()(["x"]))
+    ['0']
+    )";
+}
+
+std::string expression_symbolic_doc()
+{
+    return R"(symbolic(in_sym, prefix = "u")
+
+Builds the symbolic representation of the active graph as a DAG, where each active node is written once in terms of
+the names of its arguments. Unlike the call on symbols, which repeats the text of a node for each of its uses, the
+time and memory needed are linear in the number of active nodes. Weights and biases appear with their symbols.
+
+Args:
+    in_sym (a ``List[str]``): the symbols of the inputs
+    prefix (a ``str``): the prefix of the names of the nodes, followed by their id
+
+Returns:
+    A :class:`dcgpy.symbolic_dag`, printed in a let-bound form.
+
+Raises:
+    ValueError: if the length of *in_sym* does not match the number of inputs or if a node name is also an input
+        symbol
+
+Examples:
+    >>> ex = dcgpy.expression_double(1,1,1,2,3,2,dcgpy.kernel_set_double(["sum","mul"])(),0)
+    >>> ex.set([1,0,0,0,1,1,2])
+    >>> print(ex.symbolic(["x"]))
+    u1 = (x*x)
+    u2 = (u1+u1)
+    o0 = u2
+    )";
+}
+
 std::string expression_set_doc()
 {
     return R"(set(chromosome)
@@ -218,6 +331,53 @@ Raises:
     )";
 }
 
+std::string expression_weighted_d_loss_doc()
+{
+    return R"(d_loss(points, labels, loss_type, parallel = 0)
+
+Computes the loss of the model on the data and its gradient with respect to all the weights, backpropagating
+through the active nodes. All the kernels built by :class:`dcgpy.kernel_set_double` provide the needed derivatives.
+
+Args:
+    points (2D NumPy float array or ``list of lists`` of ``float``): the input data
+    labels (2D NumPy float array or ``list of lists`` of ``float``): the output labels (supervised signal)
+    loss_type (a ``str``): the loss, one of "MSE" for Mean Square Error and "CE" for Cross-Entropy.
+    parallel (a ``int``): sets the grain for parallelism. 0 -> no parallelism n -> divides the data into n parts and processes them in parallel threads
+
+Returns:
+    a ``tuple`` containing the loss (a ``float``) and its gradient (a ``List[float]``, null for the inactive weights)
+
+Raises:
+    ValueError: if *points* or *labels* are malformed, if *loss_type* is not one of the available types or if an
+      active kernel does not provide its derivatives.
+    )";
+}
+
+std::string expression_weighted_sgd_doc()
+{
+    return R"(sgd(points, labels, lr, batch_size, loss_type, parallel = 0, shuffle = True)
+
+Performs one epoch of mini-batch (stochastic) gradient descent updating the weights using the
+*points* and *labels* to decrease the loss.
+
+Args:
+    points (2D NumPy float array or ``list of lists`` of ``float``): the input data
+    labels (2D NumPy float array or ``list of lists`` of ``float``): the output labels (supervised signal)
+    lr (a ``float``): the learning rate
+    batch_size (an ``int``): the batch size
+    loss_type (a ``str``): the loss, one of "MSE" for Mean Square Error and "CE" for Cross-Entropy.
+    parallel (a ``int``): sets the grain for parallelism. 0 -> no parallelism n -> divides the data into n parts and processes them in parallel threads
+    shuffle (a ``bool``): when True the points and labels are visited in a random order.
+
+Returns:
+    The average error across the batches a (``float``). Note: this is only a proxy for the real loss on the whole data set.
+
+Raises:
+    ValueError: if *points* or *labels* are malformed, if *loss_type* is not one of the available types or if an
+      active kernel does not provide its derivatives.
+    )";
+}
+
 std::string expression_ann_set_weight_doc()
 {
     return R"(set_weight(node_id, input_id, weight)
@@ -361,11 +521,199 @@ Args:
 Returns:
     The average error across the batches a (``float``). Note: this is only a proxy for the real loss on the whole data set.
 
+The weights and biases are updated with the optimizer selected by :func:`~dcgpy.expression_ann_double.set_optimizer()`
+(plain stochastic gradient descent by default).
+
 Raises:
     ValueError: if *points* or *labels* are malformed or if *loss_type* is not one of the available types.
     )";
 }
 
+std::string expression_ann_sgd_async_doc()
+{
+    return R"(sgd_async(points, labels, lr, batch_size, loss_type, n_shards = 0, shuffle = True, seed = random)
+
+Performs one epoch of asynchronous (Hogwild) stochastic gradient descent. The data is split into *n_shards* disjoint
+shards processed in parallel, in batches of *batch_size* points. Each batch update is applied to the shared weights and
+biases without any synchronization with the other shards: concurrent updates of the same weight can overwrite each other,
+which for sparse networks is rare and does not prevent convergence. The update rule is plain stochastic gradient
+descent, which must be the optimizer selected by :func:`~dcgpy.expression_ann_double.set_optimizer()`.
+
+With more than one shard the result depends on the scheduling and is not reproducible. With one shard it is reproducible
+for a given *seed*, and equal to that of :func:`~dcgpy.expression_ann_double.sgd()` when the points are visited in the
+same order (e.g. with *shuffle* False).
+
+Args:
+    points (2D NumPy float array or ``list of lists`` of ``float``): the input data
+    labels (2D NumPy float array or ``list of lists`` of ``float``): the output labels (supervised signal)
+    lr (a ``float``): the learning rate
+    batch_size (an ``int``): the batch size
+    loss_type (a ``str``): the loss, one of "MSE" for Mean Square Error and "CE" for Cross-Entropy.
+    n_shards (an ``int``): the number of data shards processed in parallel. 0 -> the number of available threads.
+    shuffle (a ``bool``): when True the points are randomly assigned to the shards.
+    seed (an ``int``): seed for the random number generator shuffling the points.
+
+Returns:
+    The average error across the batches a (``float``). Note: this is only a proxy for the real loss on the whole data set.
+
+Raises:
+    ValueError: if *points* or *labels* are malformed, if *batch_size* is zero, if *loss_type* is not one of the available types
+      or if the selected optimizer is not "SGD".
+    )";
+}
+
+std::string expression_ann_set_optimizer_doc()
+{
+    return R"(set_optimizer(name, beta1 = 0.9, beta2 = 0.999, eps = 1e-8)
+
+Selects the optimizer used by sgd to update the weights and biases, resetting its state. The optimizer state
+(moment estimates) is kept across calls to sgd and chromosome changes: when a connection gene changes only
+the state of its weight is reset (and that of the bias when the function gene changes).
+
+Args:
+    name (a ``str``): the optimizer, one of "SGD", "MOMENTUM", "NESTEROV", "RMSPROP" and "ADAM".
+    beta1 (a ``float``): the momentum coefficient (first moment decay rate for Adam).
+    beta2 (a ``float``): the second moment decay rate (RMSProp, Adam).
+    eps (a ``float``): the term added to the denominator for numerical stability (RMSProp, Adam).
+
+Raises:
+    ValueError: if *name* is not one of the available optimizers, if *beta1* or *beta2* are not in [0, 1) or if *eps* is not positive.
+    )";
+}
+
+std::string expression_ann_set_precision_doc()
+{
+    return R"(set_precision(name)
+
+Selects the floating point precision used to compute the loss and its gradient on a batch (sgd, sgd_async):
+
+* "double": all computations are made in double precision (default).
+* "single": node values, their derivatives and the gradient sums are computed in single precision.
+* "mixed": node values and their derivatives are computed in single precision, the loss and gradient sums
+  in double precision.
+
+The weights, biases and optimizer state are always kept and updated in double precision.
+
+Args:
+    name (a ``str``): the precision, one of "double", "single" and "mixed".
+
+Raises:
+    ValueError: if *name* is not one of the available precisions.
+    )";
+}
+
+std::string expression_ann_freeze_doc()
+{
+    return R"(freeze()
+
+Compiles the dCGPANN into an immutable inference-only object containing only the active nodes, in topological order,
+with their activation functions, biases and the gathered weights of their connections. Further training or mutations
+of the expression do not affect it.
+
+Returns:
+    A :class:`dcgpy.frozen_ann` computing the same outputs as the expression.
+    )";
+}
+
+std::string frozen_ann_doc()
+{
+    return R"(An inference-only dCGPANN, as returned by :func:`dcgpy.expression_ann_double.freeze()`.
+
+Calling it on a point (a ``list`` of ``float`` or a 1D NumPy array) returns the outputs. It can be pickled and used
+concurrently from many threads.
+    )";
+}
+
+std::string frozen_ann_batch_doc()
+{
+    return R"(batch(points)
+
+Evaluates the network on a batch of points, computing each node for many points at once.
+
+Args:
+    points (2D NumPy float array or ``list of lists`` of ``float``): the input data
+
+Returns:
+    A ``list of lists`` of ``float`` containing the outputs for each point.
+
+Raises:
+    ValueError: if *points* are malformed.
+    )";
+}
+
+std::string simplified_expression_doc()
+{
+    return R"(A simplified dCGP expression, as returned by :func:`dcgpy.expression_double.simplify_graph()`.
+
+Calling it on a point (a ``list`` of ``float`` or a 1D NumPy array) returns the outputs, calling it on a ``list`` of
+``str`` returns their symbolic representation. It can be pickled and used concurrently from many threads.
+    )";
+}
+
+std::string simplified_expression_batch_doc()
+{
+    return R"(batch(points)
+
+Evaluates the simplified expression on a batch of points, reusing the same buffers for all of them.
+
+Args:
+    points (2D NumPy float array or ``list of lists`` of ``float``): the input data
+
+Returns:
+    A ``list of lists`` of ``float`` containing the outputs for each point.
+
+Raises:
+    ValueError: if *points* are malformed.
+    )";
+}
+
+std::string symbolic_dag_doc()
+{
+    return R"(The symbolic representation of a dCGP expression as a DAG, as returned by
+:func:`dcgpy.expression_double.symbolic()`.
+
+Its representation is the let-bound form: one line per node, defining it in terms of the names of its arguments,
+followed by one line per output. Its size is linear in the number of active nodes.
+    )";
+}
+
+std::string symbolic_dag_flatten_doc()
+{
+    return R"(flatten()
+
+Builds the full symbolic expression of each output, substituting recursively the nodes definitions to their names.
+The result is that of the call on symbols of the expression, hence its size can grow exponentially with the depth
+of the graph.
+
+Returns:
+    A ``List[str]`` containing the symbolic expression of each output.
+    )";
+}
+
+std::string quantized_ann_doc()
+{
+    return R"(__init__(f, points)
+
+An int8 quantized inference-only dCGPANN.
+
+The values of the inputs and of the nodes, as well as the weights, are represented by 8 bits integers with scales
+calibrated evaluating *f* on *points*. Weighted sums are computed in integer arithmetic, SUM and ReLu nodes use
+integer arithmetic only, while the other activation functions are approximated by 256 entries lookup tables.
+Values outside the calibrated range saturate.
+
+Calling it on a point (a ``list`` of ``float`` or a 1D NumPy array) returns the outputs. It can be pickled and used
+concurrently from many threads.
+
+Args:
+    f (a :class:`dcgpy.frozen_ann`): the network to quantize.
+    points (2D NumPy float array or ``list of lists`` of ``float``): the calibration data, representative of the
+      data the network will be used on.
+
+Raises:
+    ValueError: if *points* are empty or malformed.
+    )";
+}
+
 std::string expression_ann_set_output_f_doc()
 {
     return R"(set_output_f(name)
@@ -395,4 +743,57 @@ Args:
     unique (a ``bool``): when True weights are counted only once if connecting the same two nodes.
     )";
 }
+
+std::string newton_constants_doc()
+{
+    return R"(newton_constants(ex, constants, constants_idx, points, labels, loss = "MSE", max_iter = 50, tol = 1e-12)
+
+Fits the constants of a gdual expression (i.e. the inputs listed in *constants_idx*, such as ephemeral random
+constants) to the data. The loss is expanded at second order in the constants, its gradient and Hessian are
+accumulated in parallel over the data and damped Newton steps are iterated until the loss stops decreasing, all in C++.
+
+Args:
+    ex (an :class:`dcgpy.expression_gdual_double` or :class:`dcgpy.expression_weighted_gdual_double`): the expression
+    constants (a ``list`` of ``float``): the initial values of the constants
+    constants_idx (a ``list`` of ``int``): the indexes of the inputs of *ex* that are constants
+    points (2D NumPy float array or ``list of lists`` of ``float``): the input data, containing only the values of the
+      remaining inputs (in their order)
+    labels (2D NumPy float array or ``list of lists`` of ``float``): the output labels (supervised signal)
+    loss (a ``str``): the loss, one of "MSE" for Mean Square Error and "CE" for Cross-Entropy.
+    max_iter (an ``int``): the maximum number of Newton iterations
+    tol (a ``float``): the tolerance on the relative loss decrease and on the gradient
+
+Returns:
+    A ``tuple`` containing the final loss (a ``float``) and the optimized constants (a ``list`` of ``float``).
+
+Raises:
+    ValueError: if *points* or *labels* are malformed, if *loss* is not one of the available types or if
+      *constants_idx* is invalid.
+    )";
+}
+
+std::string newton_weights_doc()
+{
+    return R"(newton_weights(ex, weights_idx, points, labels, loss = "MSE", max_iter = 50, tol = 1e-12)
+
+Fits the weights of a weighted gdual expression listed in *weights_idx* to the data, with damped Newton steps as
+in :func:`dcgpy.newton_constants()`. The optimized weights are set in *ex*.
+
+Args:
+    ex (an :class:`dcgpy.expression_weighted_gdual_double`): the expression
+    weights_idx (a ``list`` of ``int``): the indexes of the weights (in ``ex.get_weights()``) to optimize
+    points (2D NumPy float array or ``list of lists`` of ``float``): the input data
+    labels (2D NumPy float array or ``list of lists`` of ``float``): the output labels (supervised signal)
+    loss (a ``str``): the loss, one of "MSE" for Mean Square Error and "CE" for Cross-Entropy.
+    max_iter (an ``int``): the maximum number of Newton iterations
+    tol (a ``float``): the tolerance on the relative loss decrease and on the gradient
+
+Returns:
+    The final loss (a ``float``).
+
+Raises:
+    ValueError: if *points* or *labels* are malformed, if *loss* is not one of the available types or if
+      *weights_idx* is invalid.
+    )";
+}
 } // namespace dcgpy
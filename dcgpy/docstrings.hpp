@@ -17,11 +17,18 @@ std::string expression_set_doc();
 std::string expression_set_f_gene_doc();
 std::string expression_mutate_doc();
 std::string expression_loss_doc();
+std::string expression_gradient_doc();
+std::string expression_jacobian_doc();
+std::string expression_hessian_doc();
+std::string expression_simplify_graph_doc();
+std::string expression_symbolic_doc();
 
 // expression_weighted
 std::string expression_weighted_set_weight_doc();
 std::string expression_weighted_set_weights_doc();
 std::string expression_weighted_get_weight_doc();
+std::string expression_weighted_d_loss_doc();
+std::string expression_weighted_sgd_doc();
 
 // expression_ann
 std::string expression_ann_set_weight_doc();
@@ -34,6 +41,26 @@ std::string expression_ann_randomise_biases_doc();
 std::string expression_ann_set_output_f_doc();
 std::string expression_ann_n_active_weights_doc();
 std::string expression_ann_sgd_doc();
+std::string expression_ann_sgd_async_doc();
+std::string expression_ann_set_optimizer_doc();
+std::string expression_ann_set_precision_doc();
+std::string expression_ann_freeze_doc();
+
+// frozen_ann
+std::string frozen_ann_doc();
+std::string frozen_ann_batch_doc();
+// quantized_ann
+std::string quantized_ann_doc();
+// simplified_expression
+std::string simplified_expression_doc();
+std::string simplified_expression_batch_doc();
+// symbolic_dag
+std::string symbolic_dag_doc();
+std::string symbolic_dag_flatten_doc();
+
+// newton
+std::string newton_constants_doc();
+std::string newton_weights_doc();
 
 } // namespace dcgpy
 
@@ -176,6 +176,246 @@ class test_expression(_ut.TestCase):
         loss_array = ex.loss(np.array([[x]]), np.array([ex([x])]), "MSE")
         self.assertEqual(loss_list, loss_array)
 
+    def test_gradient_double(self):
+        from dcgpy import expression_double, expression_gdual_double
+        from dcgpy import kernel_set_double, kernel_set_gdual_double
+        from pyaudi import gdual_double as gdual
+        import numpy as np
+
+        names = ["sum", "diff", "mul", "div", "sig", "tanh", "sin", "cos", "exp"]
+        ex = expression_double(2, 2, 3, 10, 11, 2, kernel_set_double(names)(), 32)
+        ex_d = expression_gdual_double(
+            2, 2, 3, 10, 11, 2, kernel_set_gdual_double(names)(), 32)
+        point = [0.3, 1.2]
+        value, jacobian = ex.gradient(point)
+        jet = ex_d([gdual(point[0], "x", 1), gdual(point[1], "y", 1)])
+        self.assertEqual(len(jacobian), 2)
+        for i in range(2):
+            self.assertAlmostEqual(value[i], jet[i].constant_cf)
+            self.assertAlmostEqual(
+                jacobian[i][0], jet[i].get_derivative({"dx": 1}))
+            self.assertAlmostEqual(
+                jacobian[i][1], jet[i].get_derivative({"dy": 1}))
+        self.assertEqual(ex.gradient(np.array(point)), (value, jacobian))
+        self.assertRaises(ValueError, lambda: ex.gradient([1.]))
+
+    def test_jacobian_hessian_double(self):
+        from dcgpy import expression_double, expression_gdual_double
+        from dcgpy import kernel_set_double, kernel_set_gdual_double
+        from pyaudi import gdual_double as gdual
+
+        names = ["sum", "diff", "mul", "div", "sig", "tanh", "sin", "cos", "exp"]
+        ex = expression_double(2, 2, 3, 10, 11, 2, kernel_set_double(names)(), 32)
+        ex_d = expression_gdual_double(
+            2, 2, 3, 10, 11, 2, kernel_set_gdual_double(names)(), 32)
+        points = [[0.3, 1.2], [0.7, 0.4], [1.1, 0.9]]
+        jacobian = ex.jacobian(points)
+        hessian = ex.hessian(points, 3)
+        self.assertEqual(len(jacobian), 3)
+        self.assertEqual(len(hessian), 3)
+        for k, point in enumerate(points):
+            self.assertEqual(jacobian[k], ex.gradient(point)[1])
+            jet = ex_d([gdual(point[0], "x", 2), gdual(point[1], "y", 2)])
+            for i in range(2):
+                self.assertAlmostEqual(
+                    hessian[k][i][0][0], jet[i].get_derivative({"dx": 2}))
+                self.assertAlmostEqual(
+                    hessian[k][i][0][1], jet[i].get_derivative({"dx": 1, "dy": 1}))
+                self.assertAlmostEqual(
+                    hessian[k][i][1][0], jet[i].get_derivative({"dx": 1, "dy": 1}))
+                self.assertAlmostEqual(
+                    hessian[k][i][1][1], jet[i].get_derivative({"dy": 2}))
+        self.assertRaises(ValueError, lambda: ex.jacobian([[1.]]))
+        self.assertRaises(ValueError, lambda: ex.hessian([[1., 2., 3.]]))
+
+    def test_simplify_graph(self):
+        from dcgpy import expression_double, expression_weighted_double
+        from dcgpy import kernel_set_double
+        import pickle
+
+        names = ["sum", "diff", "mul", "div", "sig", "tanh", "sin", "cos"]
+        ex = expression_double(2, 2, 3, 10, 11, 2, kernel_set_double(names)(), 32)
+        ex_w = expression_weighted_double(
+            2, 2, 3, 10, 11, 2, kernel_set_double(names)(), 32)
+        ex_w.set_weights([0.5] * len(ex_w.get_weights()))
+        for e in [ex, ex_w]:
+            s = e.simplify_graph()
+            self.assertEqual(s.get_n(), 2)
+            self.assertEqual(s.get_m(), 2)
+            for a, b in zip(s([0.3, 1.2]), e([0.3, 1.2])):
+                self.assertAlmostEqual(a, b)
+            self.assertEqual(s.batch([[0.3, 1.2]]), [s([0.3, 1.2])])
+            self.assertEqual(len(s(["x", "y"])), 2)
+            s2 = pickle.loads(pickle.dumps(s))
+            self.assertEqual(s2([0.3, 1.2]), s([0.3, 1.2]))
+        # x - x
+        ex = expression_double(1, 1, 1, 2, 3, 2, kernel_set_double(["sum", "diff"])(), 0)
+        ex.set([1, 0, 0, 0, 1, 0, 1])
+        self.assertEqual(ex.simplify_graph()(["x"]), ["0"])
+        self.assertRaises(ValueError, lambda: ex.simplify_graph()([1., 2.]))
+
+    def test_symbolic(self):
+        from dcgpy import expression_double, expression_ann_double
+        from dcgpy import kernel_set_double
+
+        ex = expression_double(1, 1, 1, 2, 3, 2, kernel_set_double(["sum", "mul"])(), 0)
+        ex.set([1, 0, 0, 0, 1, 1, 2])
+        d = ex.symbolic(["x"])
+        self.assertEqual(repr(d), "u1 = (x*x)\nu2 = (u1+u1)\no0 = u2\n")
+        self.assertEqual(d.get_definitions(), [("u1", "(x*x)"), ("u2", "(u1+u1)")])
+        self.assertEqual(d.get_outputs(), ["u2"])
+        self.assertEqual(d.flatten(), ex(["x"]))
+        self.assertRaises(ValueError, lambda: ex.symbolic(["u1"]))
+        ex_a = expression_ann_double(2, 2, 3, 4, 5, 2, kernel_set_double(["sig", "tanh"])(), 32)
+        d = ex_a.symbolic(["x", "y"], "n")
+        self.assertEqual(d.flatten(), ex_a(["x", "y"]))
+        for name, definition in d.get_definitions():
+            self.assertTrue("b" + name[1:] + "+" in definition)
+
+    def test_pickle(self):
+        from dcgpy import expression_double as expression
+        from dcgpy import expression_weighted_double as expression_weighted
+        from dcgpy import expression_ann_double as expression_ann
+        from dcgpy import kernel_set_double as kernel_set
+        import pickle
+
+        ex = expression(2, 2, 3, 4, 5, 2, kernel_set(
+            ["sum", "mul", "div", "diff"])(), 32)
+        ex2 = pickle.loads(pickle.dumps(ex))
+        self.assertEqual(ex.get(), ex2.get())
+        self.assertEqual(ex([1., 2.]), ex2([1., 2.]))
+
+        ex = expression_weighted(2, 2, 3, 4, 5, 2, kernel_set(
+            ["sum", "mul", "div", "diff"])(), 32)
+        ex.set_weights([0.1 * i for i in range(len(ex.get_weights()))])
+        ex2 = pickle.loads(pickle.dumps(ex))
+        self.assertEqual(ex.get(), ex2.get())
+        self.assertEqual(ex.get_weights(), ex2.get_weights())
+        self.assertEqual(ex([1., 2.]), ex2([1., 2.]))
+
+        ex = expression_ann(2, 2, 3, 4, 5, 2, kernel_set(
+            ["sig", "tanh", "ReLu"])(), 32)
+        ex.randomise_weights(seed=23)
+        ex.randomise_biases(seed=23)
+        ex2 = pickle.loads(pickle.dumps(ex))
+        self.assertEqual(ex.get(), ex2.get())
+        self.assertEqual(ex.get_weights(), ex2.get_weights())
+        self.assertEqual(ex.get_biases(), ex2.get_biases())
+        self.assertEqual(ex([1., 2.]), ex2([1., 2.]))
+
+    def test_weighted_sgd(self):
+        from dcgpy import expression_weighted_double as expression_weighted
+        from dcgpy import kernel_set_double as kernel_set
+
+        ex = expression_weighted(2, 1, 3, 6, 7, 2, kernel_set(
+            ["sum", "diff", "mul", "sin"])(), 32)
+        points = [[0.1 * i, -0.05 * i] for i in range(20)]
+        labels = [[0.2 * i * 0.1] for i in range(20)]
+        loss0, grad = ex.d_loss(points, labels, "MSE")
+        self.assertAlmostEqual(loss0, ex.loss(points, labels, "MSE"))
+        self.assertEqual(len(grad), len(ex.get_weights()))
+        self.assertRaises(ValueError, ex.d_loss, points, labels, "MAE")
+        # One batch, i.e. gradient descent
+        for i in range(20):
+            ex.sgd(points, labels, 0.1, 20, "MSE")
+        self.assertTrue(ex.loss(points, labels, "MSE") < loss0)
+
+    def test_newton(self):
+        from dcgpy import expression_gdual_double as expression
+        from dcgpy import expression_weighted_gdual_double as expression_weighted
+        from dcgpy import kernel_set_gdual_double as kernel_set
+        from dcgpy import newton_constants, newton_weights
+
+        # y = c * x * x
+        ex = expression(2, 1, 1, 2, 3, 2, kernel_set(["mul"])(), 32)
+        ex.set([0, 0, 0, 0, 2, 1, 3])
+        points = [[0.1 * i] for i in range(10)]
+        labels = [[2.5 * p[0] * p[0]] for p in points]
+        loss, c = newton_constants(ex, [1.], [1], points, labels)
+        self.assertTrue(loss < 1e-20)
+        self.assertAlmostEqual(c[0], 2.5)
+        self.assertRaises(ValueError, newton_constants,
+                          ex, [1.], [2], points, labels)
+        self.assertRaises(ValueError, newton_constants,
+                          ex, [1.], [1], points, labels, "MAE")
+        # y = w0 * w1 * x * y
+        ex = expression_weighted(2, 1, 1, 1, 2, 2, kernel_set(["mul"])(), 32)
+        ex.set([0, 0, 1, 2])
+        points = [[0.1 * i, 0.2 - 0.1 * i] for i in range(10)]
+        labels = [[-1.5 * p[0] * p[1]] for p in points]
+        loss = newton_weights(ex, [0], points, labels)
+        self.assertTrue(loss < 1e-20)
+        self.assertRaises(ValueError, newton_weights,
+                          ex, [0, 0], points, labels)
+
+    def test_optimizer(self):
+        from dcgpy import expression_ann_double as expression_ann
+        from dcgpy import kernel_set_double as kernel_set
+
+        ex = expression_ann(2, 1, 5, 4, 2, 2, kernel_set(
+            ["sig", "tanh", "ReLu"])(), 32)
+        ex.randomise_weights(seed=23)
+        ex.randomise_biases(seed=23)
+        self.assertEqual(ex.get_optimizer(), "SGD")
+        self.assertRaises(ValueError, ex.set_optimizer, "ADAMW")
+        self.assertRaises(ValueError, ex.set_optimizer, "ADAM", beta1=1.)
+        points = [[0.1 * i, -0.05 * i] for i in range(20)]
+        labels = [[0.2 * i * 0.1] for i in range(20)]
+        loss0 = ex.loss(points, labels, "MSE")
+        for name in ["MOMENTUM", "NESTEROV", "RMSPROP", "ADAM"]:
+            ex2 = expression_ann(2, 1, 5, 4, 2, 2, kernel_set(
+                ["sig", "tanh", "ReLu"])(), 32)
+            ex2.set_weights(ex.get_weights())
+            ex2.set_biases(ex.get_biases())
+            ex2.set_optimizer(name, beta2=0.9)
+            self.assertEqual(ex2.get_optimizer(), name)
+            for i in range(20):
+                ex2.sgd(points, labels, 0.01, 4, "MSE", shuffle=False)
+            self.assertTrue(ex2.loss(points, labels, "MSE") < loss0)
+        # Single and mixed precision training
+        self.assertEqual(ex.get_precision(), "double")
+        self.assertRaises(ValueError, ex.set_precision, "half")
+        for precision in ["single", "mixed"]:
+            ex2 = expression_ann(2, 1, 5, 4, 2, 2, kernel_set(
+                ["sig", "tanh", "ReLu"])(), 32)
+            ex2.set_weights(ex.get_weights())
+            ex2.set_biases(ex.get_biases())
+            ex2.set_precision(precision)
+            self.assertEqual(ex2.get_precision(), precision)
+            for i in range(20):
+                ex2.sgd(points, labels, 0.01, 4, "MSE", shuffle=False)
+            self.assertTrue(ex2.loss(points, labels, "MSE") < loss0)
+        # Frozen network
+        import pickle
+        f = ex.freeze()
+        self.assertEqual(f.get_n(), 2)
+        self.assertEqual(f.get_m(), 1)
+        self.assertEqual(f([0.1, 0.2]), ex([0.1, 0.2]))
+        self.assertEqual(f.batch(points), [ex(p) for p in points])
+        f2 = pickle.loads(pickle.dumps(f))
+        self.assertEqual(f2.batch(points), f.batch(points))
+        # Quantized network
+        from dcgpy import quantized_ann
+        q = quantized_ann(f, points)
+        self.assertEqual(q.get_n(), 2)
+        self.assertEqual(q.get_m(), 1)
+        self.assertEqual(len(q.get_scales()), 2 + q.get_n_nodes())
+        self.assertEqual(q.batch(points), [q(p) for p in points])
+        for p in points:
+            self.assertTrue(abs(q(p)[0] - f(p)[0]) < 0.1)
+        q2 = pickle.loads(pickle.dumps(q))
+        self.assertEqual(q2.batch(points), q.batch(points))
+        self.assertRaises(ValueError, quantized_ann, f, [])
+        # Asynchronous sgd
+        loss_async = ex.sgd_async(points, labels, 0.01, 4, "MSE", n_shards=2)
+        self.assertTrue(loss_async >= 0.)
+        ex2 = pickle.loads(pickle.dumps(ex))
+        ex3 = pickle.loads(pickle.dumps(ex))
+        self.assertEqual(ex2.sgd_async(points, labels, 0.01, 4, "MSE", 1, True, 23),
+                         ex3.sgd_async(points, labels, 0.01, 4, "MSE", 1, True, 23))
+        ex2.set_optimizer("ADAM")
+        self.assertRaises(ValueError, ex2.sgd_async, points, labels, 0.01, 4, "MSE")
+
 
 def run_test_suite():
     """Run the full test suite.
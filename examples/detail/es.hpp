@@ -4,6 +4,7 @@
 #include <tbb/tbb.h>
 
 #include <dcgp/expression.hpp>
+#include <dcgp/racing.hpp>
 
 struct es_params {
     unsigned int m_childs;
@@ -42,7 +43,8 @@ void es(const std::vector<std::vector<double>> &in, const std::vector<std::vecto
                 }
                 exs[i].mutate(tbm);
             }
-            newfits[i] = exs[i].loss(in, out, "MSE", true);
+            // Offspring worse than the current best are discarded after a partial evaluation of the loss
+            newfits[i] = dcgp::racing_loss(exs[i], in, out, "MSE", best_fit);
             newchromosomes[i] = exs[i].get();
         });
 
@@ -1,25 +1,28 @@
 #include <iostream>
 
 #include <dcgp/expression.hpp>
+#include <dcgp/gdual_v_batch.hpp>
 #include <dcgp/kernel_set.hpp>
 
 // Here we search for first integrals of a mass spring sistem (one dimension) using Lipson method
 // The hamiltonian is H = p^2 + q^2 and is consistently found by the evolution
 
-double fitness(const dcgp::expression<gdual_d> &ex, const std::vector<std::vector<gdual_d>> &in)
+double fitness(const dcgp::expression<gdual_v> &ex, const std::vector<gdual_v> &in,
+               const std::vector<std::vector<double>> &grid)
 {
     double retval = 0;
-    for (auto i = 0u; i < in.size(); ++i) {
-        auto T = ex(in[i]); // We compute all the derivatives up to order one
-        double dFp = T[0].get_derivative({{"dp", 1}});
-        double dFq = T[0].get_derivative({{"dq", 1}});
-        double p = in[i][0].constant_cf();
-        double q = in[i][1].constant_cf();
-        double err = dFp / dFq - p / q; // Here we set (dp/dt) / (dq/dt) = dp/dq
+    auto N = static_cast<unsigned>(grid.size());
+    auto T = ex(in); // We compute all the derivatives up to order one on the whole grid at once
+    auto dFp = dcgp::batch_derivative(T[0], {{"dp", 1u}}, N);
+    auto dFq = dcgp::batch_derivative(T[0], {{"dq", 1u}}, N);
+    for (auto i = 0u; i < N; ++i) {
+        double p = grid[i][0];
+        double q = grid[i][1];
+        double err = dFp[i] / dFq[i] - p / q; // Here we set (dp/dt) / (dq/dt) = dp/dq
         retval += std::log(1 + std::abs(err));
     }
 
-    return retval / static_cast<double>(in.size());
+    return retval / static_cast<double>(N);
 }
 
 using namespace dcgp;
@@ -30,21 +33,22 @@ int main()
     std::random_device rd;
 
     // Function set
-    dcgp::kernel_set<gdual_d> basic_set({"sum", "diff", "mul", "div"});
+    dcgp::kernel_set<gdual_v> basic_set({"sum", "diff", "mul", "div"});
 
     // d-CGP expression
-    dcgp::expression<gdual_d> ex(2, 1, 1, 15, 16, 2, basic_set(), rd());
+    dcgp::expression<gdual_v> ex(2, 1, 1, 15, 16, 2, basic_set(), rd());
 
     // Symbols
     std::vector<std::string> in_sym({"p", "q"});
 
     // We create the grid over x
-    std::vector<std::vector<gdual_d>> in(10u);
-    for (auto i = 0u; i < in.size(); ++i) {
-        gdual_d p_var(0.12 + 0.9 / static_cast<double>((in.size() - 1)) * i, "p", 1u);
-        gdual_d q_var(1. - 0.143 / static_cast<double>((in.size() - 1)) * i, "q", 1u);
-        in[i] = std::vector<gdual_d>{p_var, q_var};
+    std::vector<std::vector<double>> grid(10u);
+    for (auto i = 0u; i < grid.size(); ++i) {
+        grid[i] = {0.12 + 0.9 / static_cast<double>((grid.size() - 1)) * i,
+                   1. - 0.143 / static_cast<double>((grid.size() - 1)) * i};
     }
+    // and the vectorized gduals holding all of its points
+    auto in = dcgp::batch_inputs(grid, in_sym, 1u);
     // We run the (1-4)-ES
     double best_fit = 1e32;
     std::vector<double> newfits(4, 0.);
@@ -56,7 +60,7 @@ int main()
         for (auto i = 0u; i < newfits.size(); ++i) {
             ex.set(best_chromosome);
             ex.mutate_active(6);
-            newfits[i] = fitness(ex, in); // Total fitness
+            newfits[i] = fitness(ex, in, grid); // Total fitness
             newchromosomes[i] = ex.get();
         }
         for (auto i = 0u; i < newfits.size(); ++i) {
@@ -76,6 +80,6 @@ int main()
     stream(std::cout, "Number of generations: ", gen, "\n");
     stream(std::cout, "Expression: ", ex, "\n");
     stream(std::cout, "Expression: ", ex(in_sym), "\n");
-    stream(std::cout, "Point: ", in[2], "\n");
-    stream(std::cout, "Taylor: ", ex(in[2]), "\n");
+    stream(std::cout, "Point: ", grid[2], "\n");
+    stream(std::cout, "Taylor: ", ex(dcgp::batch_inputs({grid[2]}, in_sym, 1u)), "\n");
 }
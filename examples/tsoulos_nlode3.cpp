@@ -2,21 +2,24 @@
 #include <iostream>
 
 #include <dcgp/expression.hpp>
+#include <dcgp/gdual_v_batch.hpp>
 #include <dcgp/kernel_set.hpp>
 
 // Here we solve the differential equation d^2y dy  = - 4 / x^3 (NLODE3) from Tsoulos paper
 // Tsoulos and Lagaris: "Solving Differential equations with genetic programming"
 
-double fitness(const dcgp::expression<gdual_d> &ex, const std::vector<std::vector<gdual_d>> &in)
+double fitness(const dcgp::expression<gdual_v> &ex, const std::vector<gdual_v> &in,
+               const std::vector<std::vector<double>> &grid)
 {
     double retval = 0;
-    for (auto i = 0u; i < in.size(); ++i) {
-        auto T = ex(in[i]); // We compute the expression and thus the derivatives
-        double dy = T[0].get_derivative({1});
-        double ddy = T[0].get_derivative({2});
-        double x = in[i][0].constant_cf();
+    auto N = static_cast<unsigned>(grid.size());
+    auto T = ex(in); // We compute the expression and thus the derivatives on the whole grid at once
+    auto dy = dcgp::batch_derivative(T[0], {{"dx", 1u}}, N);
+    auto ddy = dcgp::batch_derivative(T[0], {{"dx", 2u}}, N);
+    for (auto i = 0u; i < N; ++i) {
+        double x = grid[i][0];
         double ode1 = -4 / x / x / x;
-        retval += (ode1 - ddy * dy) * (ode1 - ddy * dy); // We compute the quadratic error
+        retval += (ode1 - ddy[i] * dy[i]) * (ode1 - ddy[i] * dy[i]); // We compute the quadratic error
     }
     return retval;
 }
@@ -27,19 +30,21 @@ int main()
     std::random_device rd;
 
     // Function set
-    dcgp::kernel_set<gdual_d> basic_set({"sum", "diff", "mul", "div", "log"});
+    dcgp::kernel_set<gdual_v> basic_set({"sum", "diff", "mul", "div", "log"});
 
     // d-CGP expression
-    dcgp::expression<gdual_d> ex(1, 1, 1, 15, 16, 2, basic_set(), rd());
+    dcgp::expression<gdual_v> ex(1, 1, 1, 15, 16, 2, basic_set(), rd());
 
     // Symbols for streaming out the hr expression
     std::vector<std::string> in_sym({"x"});
 
     // We create the grid over x
-    std::vector<std::vector<gdual_d>> in(10u);
-    for (auto i = 0u; i < in.size(); ++i) {
-        in[i].push_back(gdual_d(1. + 1. / static_cast<double>((in.size() - 1)) * i, "x", 2)); // 1, .., 2
+    std::vector<std::vector<double>> grid(10u);
+    for (auto i = 0u; i < grid.size(); ++i) {
+        grid[i].push_back(1. + 1. / static_cast<double>((grid.size() - 1)) * i); // 1, .., 2
     }
+    // and the vectorized gduals holding all of its points
+    auto in = dcgp::batch_inputs(grid, in_sym, 2u);
 
     // We run the (1-4)-ES
     double best_fit = 1e32;
@@ -53,9 +58,9 @@ int main()
         for (auto i = 0u; i < newfits.size(); ++i) {
             ex.set(best_chromosome);
             ex.mutate_active(2);
-            auto fitness_ic
-                = ex(std::vector<gdual_d>{gdual_d(1.)})[0]; // Penalty term to enforce the initial conditions
-            newfits[i] = fitness(ex, in) + fitness_ic.constant_cf() * fitness_ic.constant_cf(); // Total fitness
+            // Penalty term to enforce the initial conditions
+            auto fitness_ic = dcgp::batch_values(ex(std::vector<gdual_v>{gdual_v(1.)})[0], 1u)[0];
+            newfits[i] = fitness(ex, in, grid) + fitness_ic * fitness_ic; // Total fitness
             newchromosomes[i] = ex.get();
         }
 
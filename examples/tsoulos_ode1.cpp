@@ -1,21 +1,24 @@
 #include <iostream>
 
 #include <dcgp/expression.hpp>
+#include <dcgp/gdual_v_batch.hpp>
 #include <dcgp/kernel_set.hpp>
 
 // Here we solve the differential equation dy = (2x - y) / x from Tsoulos paper
 // Tsoulos and Lagaris: "Solving Differential equations with genetic programming"
 
-double fitness(const dcgp::expression<gdual_d> &ex, const std::vector<std::vector<gdual_d>> &in)
+double fitness(const dcgp::expression<gdual_v> &ex, const std::vector<gdual_v> &in,
+               const std::vector<std::vector<double>> &grid)
 {
     double retval = 0;
-    for (auto i = 0u; i < in.size(); ++i) {
-        auto T = ex(in[i]); // We compute the expression and thus the derivatives
-        double y = T[0].get_derivative({0});
-        double dy = T[0].get_derivative({1});
-        double x = in[i][0].constant_cf();
-        double ode1 = (2. * x - y) / x;
-        retval += (ode1 - dy) * (ode1 - dy); // We compute the quadratic error
+    auto N = static_cast<unsigned>(grid.size());
+    auto T = ex(in); // We compute the expression and thus the derivatives on the whole grid at once
+    auto y = dcgp::batch_values(T[0], N);
+    auto dy = dcgp::batch_derivative(T[0], {{"dx", 1u}}, N);
+    for (auto i = 0u; i < N; ++i) {
+        double x = grid[i][0];
+        double ode1 = (2. * x - y[i]) / x;
+        retval += (ode1 - dy[i]) * (ode1 - dy[i]); // We compute the quadratic error
     }
     return retval;
 }
@@ -26,20 +29,21 @@ int main()
     std::random_device rd;
 
     // Function set
-    dcgp::kernel_set<gdual_d> basic_set({"sum", "diff", "mul", "div", "exp", "log", "sin", "cos"});
+    dcgp::kernel_set<gdual_v> basic_set({"sum", "diff", "mul", "div", "exp", "log", "sin", "cos"});
 
     // d-CGP expression
-    dcgp::expression<gdual_d> ex(1, 1, 1, 15, 16, 2, basic_set(), rd());
+    dcgp::expression<gdual_v> ex(1, 1, 1, 15, 16, 2, basic_set(), rd());
 
     // Symbols
     std::vector<std::string> in_sym({"x"});
 
     // We create the grid over x
-    std::vector<std::vector<gdual_d>> in(10u);
-    for (auto i = 0u; i < in.size(); ++i) {
-        gdual_d point(0.1 + 0.9 / static_cast<double>((in.size() - 1)) * i, "x", 1);
-        in[i].push_back(point); // 1, .., 2
+    std::vector<std::vector<double>> grid(10u);
+    for (auto i = 0u; i < grid.size(); ++i) {
+        grid[i].push_back(0.1 + 0.9 / static_cast<double>((grid.size() - 1)) * i); // 0.1, .., 1
     }
+    // and the vectorized gduals holding all of its points
+    auto in = dcgp::batch_inputs(grid, in_sym, 1u);
 
     // We run the (1-4)-ES
     auto best_fit = 1e32;
@@ -53,8 +57,9 @@ int main()
         for (auto i = 0u; i < newfits.size(); ++i) {
             ex.set(best_chromosome);
             ex.mutate_active(2);
-            auto fitness_ic = ex({gdual_d(1.)})[0] - 3.; // Penalty term to enforce the initial conditions
-            newfits[i] = fitness(ex, in) + fitness_ic.constant_cf() * fitness_ic.constant_cf(); // Total fitness
+            // Penalty term to enforce the initial conditions
+            auto fitness_ic = dcgp::batch_values(ex({gdual_v(1.)})[0], 1u)[0] - 3.;
+            newfits[i] = fitness(ex, in, grid) + fitness_ic * fitness_ic; // Total fitness
             newchromosomes[i] = ex.get();
         }
 
@@ -1,9 +1,19 @@
 #ifndef DCGP_H
 #define DCGP_H
 
+#include <dcgp/dual.hpp>
 #include <dcgp/expression.hpp>
 #include <dcgp/expression_ann.hpp>
 #include <dcgp/expression_weighted.hpp>
+#include <dcgp/frozen_ann.hpp>
+#include <dcgp/gdual_v_batch.hpp>
 #include <dcgp/kernel_set.hpp>
+#include <dcgp/newton.hpp>
+#include <dcgp/nsga2.hpp>
+#include <dcgp/quantized_ann.hpp>
+#include <dcgp/racing.hpp>
+#include <dcgp/simplified_expression.hpp>
+#include <dcgp/steady_state.hpp>
+#include <dcgp/symbolic_dag.hpp>
 
 #endif // DCGP_H
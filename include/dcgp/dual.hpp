@@ -0,0 +1,234 @@
+#ifndef DCGP_DUAL_H
+#define DCGP_DUAL_H
+
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace dcgp
+{
+
+/// First order dual number
+/**
+ * A lightweight scalar type carrying a value and its N first order partial derivatives (with respect to N
+ * independent variables) in a fixed size array. When only first derivatives are needed, it can replace gduals in
+ * dcgp::expression, dcgp::expression_weighted and dcgp::kernel_set, avoiding the truncated polynomials machinery:
+ * each operation costs O(N) and its loops over the partials can be vectorized by the compiler.
+ *
+ * @code
+ * dcgp::expression<dcgp::dual<2>> ex(2, 1, 1, 15, 16, 2, dcgp::kernel_set<dcgp::dual<2>>({"sum", "mul"})(), 123);
+ * auto out = ex({dcgp::dual<2>(0.3, 0u), dcgp::dual<2>(1.2, 1u)});
+ * double dFdp = out[0].get_derivative(0u);
+ * @endcode
+ *
+ * @tparam N the number of partial derivatives.
+ */
+template <unsigned N>
+class dual
+{
+public:
+    /// Default constructor (zero)
+    dual() : m_value(0.), m_d() {}
+
+    /// Constructor from a constant
+    /**
+     * @param[value] the value (all partial derivatives are zero)
+     */
+    dual(double value) : m_value(value), m_d() {}
+
+    /// Constructor of an independent variable
+    /**
+     * @param[value] the value
+     * @param[idx] the index of the variable (its partial derivative with respect to itself is one)
+     *
+     * @throw std::invalid_argument if \p idx is not smaller than N
+     */
+    dual(double value, unsigned idx) : m_value(value), m_d()
+    {
+        if (idx >= N) {
+            throw std::invalid_argument("The variable index is " + std::to_string(idx)
+                                        + " while the number of partial derivatives is: " + std::to_string(N));
+        }
+        m_d[idx] = 1.;
+    }
+
+    /// Gets the value
+    double value() const
+    {
+        return m_value;
+    }
+
+    /// Gets a partial derivative
+    /**
+     * @param[idx] the index of the variable
+     *
+     * @return the partial derivative with respect to the variable \p idx
+     *
+     * @throw std::invalid_argument if \p idx is not smaller than N
+     */
+    double get_derivative(unsigned idx) const
+    {
+        if (idx >= N) {
+            throw std::invalid_argument("The variable index is " + std::to_string(idx)
+                                        + " while the number of partial derivatives is: " + std::to_string(N));
+        }
+        return m_d[idx];
+    }
+
+    /// Gets all partial derivatives
+    const std::array<double, N> &get_derivatives() const
+    {
+        return m_d;
+    }
+
+    dual &operator+=(const dual &b)
+    {
+        m_value += b.m_value;
+        for (auto i = 0u; i < N; ++i) {
+            m_d[i] += b.m_d[i];
+        }
+        return *this;
+    }
+    dual &operator-=(const dual &b)
+    {
+        m_value -= b.m_value;
+        for (auto i = 0u; i < N; ++i) {
+            m_d[i] -= b.m_d[i];
+        }
+        return *this;
+    }
+    // The values are cached so that self assignments (x *= x) are correct
+    dual &operator*=(const dual &b)
+    {
+        const double av = m_value, bv = b.m_value;
+        for (auto i = 0u; i < N; ++i) {
+            m_d[i] = m_d[i] * bv + b.m_d[i] * av;
+        }
+        m_value = av * bv;
+        return *this;
+    }
+    dual &operator/=(const dual &b)
+    {
+        const double bv = b.m_value, r = m_value / bv;
+        for (auto i = 0u; i < N; ++i) {
+            m_d[i] = (m_d[i] - r * b.m_d[i]) / bv;
+        }
+        m_value = r;
+        return *this;
+    }
+
+    // The operators and functions are hidden friends: found by argument dependent lookup (also when called
+    // unqualified from templates such as the kernels) and allowing the implicit conversion of doubles.
+    friend dual operator+(dual a, const dual &b)
+    {
+        return a += b;
+    }
+    friend dual operator-(dual a, const dual &b)
+    {
+        return a -= b;
+    }
+    friend dual operator*(dual a, const dual &b)
+    {
+        return a *= b;
+    }
+    friend dual operator/(dual a, const dual &b)
+    {
+        return a /= b;
+    }
+    friend dual operator-(const dual &a)
+    {
+        return a.chain(-a.m_value, -1.);
+    }
+
+    // Equality compares the value and the derivatives (a null adjoint in the reverse sweep is one with null
+    // derivatives), while the orderings compare the values only
+    friend bool operator==(const dual &a, const dual &b)
+    {
+        return a.m_value == b.m_value && a.m_d == b.m_d;
+    }
+    friend bool operator!=(const dual &a, const dual &b)
+    {
+        return !(a == b);
+    }
+    friend bool operator<(const dual &a, const dual &b)
+    {
+        return a.m_value < b.m_value;
+    }
+    friend bool operator>(const dual &a, const dual &b)
+    {
+        return a.m_value > b.m_value;
+    }
+
+    friend dual exp(const dual &a)
+    {
+        auto v = std::exp(a.m_value);
+        return a.chain(v, v);
+    }
+    friend dual log(const dual &a)
+    {
+        return a.chain(std::log(a.m_value), 1. / a.m_value);
+    }
+    friend dual sin(const dual &a)
+    {
+        return a.chain(std::sin(a.m_value), std::cos(a.m_value));
+    }
+    friend dual cos(const dual &a)
+    {
+        return a.chain(std::cos(a.m_value), -std::sin(a.m_value));
+    }
+    friend dual tanh(const dual &a)
+    {
+        auto v = std::tanh(a.m_value);
+        return a.chain(v, 1. - v * v);
+    }
+    friend dual sqrt(const dual &a)
+    {
+        auto v = std::sqrt(a.m_value);
+        return a.chain(v, 0.5 / v);
+    }
+    friend dual abs(const dual &a)
+    {
+        return (a.m_value < 0.) ? -a : a;
+    }
+
+    /// Overloaded stream operator
+    friend std::ostream &operator<<(std::ostream &os, const dual &a)
+    {
+        os << a.m_value << " [";
+        for (auto i = 0u; i < N; ++i) {
+            os << a.m_d[i] << (i + 1u < N ? ", " : "");
+        }
+        os << "]";
+        return os;
+    }
+
+    /// Serialization
+    template <typename Archive>
+    void serialize(Archive &ar, unsigned)
+    {
+        ar &m_value;
+        for (auto &d : m_d) {
+            ar &d;
+        }
+    }
+
+private:
+    // Applies the chain rule for a function with value v and derivative df at m_value
+    dual chain(double v, double df) const
+    {
+        dual retval(v);
+        for (auto i = 0u; i < N; ++i) {
+            retval.m_d[i] = df * m_d[i];
+        }
+        return retval;
+    }
+
+    double m_value;
+    std::array<double, N> m_d;
+};
+
+} // namespace dcgp
+
+#endif // DCGP_DUAL_H
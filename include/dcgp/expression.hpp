@@ -2,42 +2,173 @@
 #define DCGP_EXPRESSION_H
 
 #include <algorithm>
+#include <atomic>
 #include <audi/audi.hpp>
+#include <cstddef>
 #include <initializer_list>
 #include <iostream>
+#include <iterator>
 #include <random>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <tbb/spin_mutex.h>
 #include <tbb/tbb.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <dcgp/dual.hpp>
 #include <dcgp/kernel.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/s11n.hpp>
+#include <dcgp/simplified_expression.hpp>
+#include <dcgp/symbolic_dag.hpp>
 #include <dcgp/type_traits.hpp>
 
 namespace dcgp
 {
 
+template <typename T>
+class expression;
+
+namespace detail
+{
+// Checks that the data and the labels have the same, non null, size
+template <typename T>
+inline void data_checks(const std::vector<std::vector<T>> &points, const std::vector<std::vector<T>> &labels)
+{
+    if (points.size() != labels.size()) {
+        throw std::invalid_argument("Data and label size mismatch data size is: " + std::to_string(points.size())
+                                    + " while label size is: " + std::to_string(labels.size()));
+    }
+    if (points.size() == 0) {
+        throw std::invalid_argument("Data size cannot be zero");
+    }
+}
+
+// Decodes the loss type from its name
+template <typename T>
+inline typename expression<T>::loss_type decode_loss(const std::string &loss_s)
+{
+    if (loss_s == "MSE") { // Mean Squared Error
+        return expression<T>::loss_type::MSE;
+    } else if (loss_s == "CE") { // Cross Entropy
+        return expression<T>::loss_type::CE;
+    }
+    throw std::invalid_argument("The requested loss was: " + loss_s + " while only MSE and CE are allowed");
+}
+
+// The scalar value of a loss (its constant coefficient for gduals), used to compare it with thresholds and to
+// read the weights as constants in expression::simplify
+inline double loss_value(double x)
+{
+    return x;
+}
+template <typename T, typename std::enable_if<is_gdual<T>::value, int>::type = 0>
+inline double loss_value(const T &x)
+{
+    static_assert(std::is_arithmetic<typename T::cf_type>::value,
+                  "Only losses of gduals with scalar coefficients can be compared to a threshold");
+    return x.constant_cf();
+}
+template <typename T, typename std::enable_if<is_dual<T>::value, int>::type = 0>
+inline double loss_value(const T &x)
+{
+    return x.value();
+}
+
+// A random access iterator over the rows of a data set, visited in their order or in the order given by an index
+// permutation. The batch engines read the (shuffled) batches through it directly from the data, which is thus
+// neither moved nor copied row by row into a batch buffer.
+class row_iterator
+{
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::vector<double>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::vector<double> *;
+    using reference = const std::vector<double> &;
+
+    // The rows data[pos], data[pos + 1], ...
+    row_iterator(const std::vector<std::vector<double>> &data, difference_type pos)
+        : m_rows(data.data()), m_idx(nullptr), m_pos(pos)
+    {
+    }
+    // The rows data[perm[pos]], data[perm[pos + 1]], ...
+    row_iterator(const std::vector<std::vector<double>> &data, const std::vector<unsigned> &perm, difference_type pos)
+        : m_rows(data.data()), m_idx(perm.data()), m_pos(pos)
+    {
+    }
+
+    reference operator*() const
+    {
+        return m_idx ? m_rows[m_idx[m_pos]] : m_rows[m_pos];
+    }
+    pointer operator->() const
+    {
+        return &**this;
+    }
+    reference operator[](difference_type i) const
+    {
+        return *(*this + i);
+    }
+    row_iterator &operator++()
+    {
+        ++m_pos;
+        return *this;
+    }
+    row_iterator &operator+=(difference_type i)
+    {
+        m_pos += i;
+        return *this;
+    }
+    row_iterator operator+(difference_type i) const
+    {
+        auto retval = *this;
+        return retval += i;
+    }
+    difference_type operator-(const row_iterator &other) const
+    {
+        return m_pos - other.m_pos;
+    }
+    bool operator==(const row_iterator &other) const
+    {
+        return m_pos == other.m_pos;
+    }
+    bool operator!=(const row_iterator &other) const
+    {
+        return m_pos != other.m_pos;
+    }
+
+private:
+    const std::vector<double> *m_rows;
+    const unsigned *m_idx;
+    difference_type m_pos;
+};
+} // namespace detail
+
 /// A dCGP expression
 /**
  * This class represents a mathematical expression as encoded using CGP and
  * contains algorithms to compute its value (numerical and symbolical) and its
  * derivatives as well as to mutate the expression.
  *
- * @tparam T expression type. Can be double, or a gdual type.
+ * @tparam T expression type. Can be double, a gdual or a dcgp::dual type.
  */
 template <typename T>
 class expression
 {
 private:
     // Static checks.
-    static_assert(std::is_same<T, double>::value || is_gdual<T>::value,
-                  "A d-CGP expression can only be operating on doubles or gduals");
+    static_assert(std::is_same<T, double>::value || is_gdual<T>::value || is_dual<T>::value,
+                  "A d-CGP expression can only be operating on doubles, gduals or duals");
     // SFINAE dust
     template <typename U>
-    using functor_enabler = typename std::enable_if<
-        std::is_same<U, double>::value || is_gdual<T>::value || std::is_same<U, std::string>::value, int>::type;
+    using functor_enabler = typename std::enable_if<std::is_same<U, double>::value || is_gdual<T>::value
+                                                        || is_dual<T>::value || std::is_same<U, std::string>::value,
+                                                    int>::type;
 
 public:
     /// Loss types
@@ -47,6 +178,23 @@ public:
         // Cross-Entropy
         CE };
 
+    /// Evaluation workspace
+    /**
+     * Persistent storage used by dcgp::expression::evaluate(). The node values are kept across calls so that, for
+     * gduals, their polynomials are overwritten rather than constructed and destroyed at each evaluation. A workspace
+     * must not be shared between threads.
+     */
+    struct workspace {
+        /// Values of the nodes (the inputs excluded)
+        std::vector<T> node;
+        /// Kernel inputs, when they need to be stored (e.g. weighted)
+        std::vector<T> function_in;
+        /// Pointers to the kernel inputs
+        std::vector<const T *> in_ptr;
+        /// Values of the outputs
+        std::vector<T> retval;
+    };
+
     /// Constructor
     /** Constructs a dCGP expression with variable arity
      *
@@ -221,6 +369,264 @@ public:
         return (*this)(dummy);
     }
 
+    /// Evaluates the dCGP expression reusing a workspace
+    /**
+     * This evaluates the dCGP expression as the call operator does, but the node values are stored in the
+     * workspace \p ws and reused in the following calls. The kernels input values are not copied, and the kernels
+     * having an in-place variant (as sum, diff, mul and div in dcgp::kernel_set) write their value in the node with
+     * the +=, -=, *= and /= operators. For gduals, this avoids most of the polynomials allocations. The method can be
+     * overriden in the derived classes.
+     *
+     * @param[point] an std::vector containing the values where the dCGP expression has to be computed
+     * @param[ws] the workspace (resized as needed)
+     *
+     * @return a reference to the value of the function, stored in \p ws
+     *
+     * @throw std::invalid_argument if the input size is incompatible
+     */
+    virtual const std::vector<T> &evaluate(const std::vector<T> &point, workspace &ws) const
+    {
+        if (point.size() != m_n) {
+            throw std::invalid_argument("Input size is incompatible");
+        }
+        ws.node.resize(m_r * m_c);
+        ws.retval.resize(m_m);
+        for (auto node_id : m_active_nodes) {
+            if (node_id < m_n) {
+                continue;
+            }
+            unsigned arity = _get_arity(node_id);
+            unsigned idx = m_gene_idx[node_id]; // position in the chromosome of the current node
+            ws.in_ptr.resize(arity);
+            for (auto j = 0u; j < arity; ++j) {
+                ws.in_ptr[j] = &workspace_value(point, ws, m_x[idx + j + 1u]);
+            }
+            workspace_call(m_f[m_x[idx]], ws, ws.node[node_id - m_n]);
+        }
+        for (auto i = 0u; i < m_m; ++i) {
+            ws.retval[i] = workspace_value(point, ws, m_x[m_x.size() - m_m + i]);
+        }
+        return ws.retval;
+    }
+
+    /// Gradient of the dCGP expression (reverse mode)
+    /**
+     * Evaluates the dCGP expression and its derivatives with respect to all inputs using one forward
+     * sweep (storing the node values and the partial derivatives of each kernel) and one backward (adjoint) sweep
+     * per output over the active nodes. Differently from the use of gduals, the cost is only a small multiple of
+     * that of an evaluation. All active kernels must provide their partial derivatives, which is the case for the
+     * double kernels built by dcgp::kernel_set.
+     *
+     * @param[in] point an std::vector containing the values where the dCGP expression has to be computed
+     *
+     * @return an std::tuple containing the value of the outputs (an std::vector of size m) and the Jacobian (an
+     * std::vector of size m * n where the entry i * n + j is the derivative of the output i with respect to the input j)
+     *
+     * @throw std::invalid_argument if the input size is incompatible or if an active kernel does not provide
+     * its derivatives
+     */
+    std::tuple<std::vector<T>, std::vector<T>> gradient(const std::vector<T> &point) const
+    {
+        if (point.size() != m_n) {
+            throw std::invalid_argument("Input size is incompatible");
+        }
+        std::vector<T> retval(m_m), jacobian(m_m * m_n);
+        reverse_sweep(point, m_f, retval, jacobian);
+        return std::make_tuple(std::move(retval), std::move(jacobian));
+    }
+
+    /// Jacobians of the dCGP expression on a batch of points (reverse mode)
+    /**
+     * Computes, as dcgp::expression::gradient, the Jacobian of the dCGP expression at each of the points,
+     * storing them one after the other in a single contiguous std::vector.
+     *
+     * @param[in] points the points where the Jacobians are computed
+     * @param[parallel] sets the grain for parallelism. 0 -> no parallelism n -> divides the points into n parts and
+     * computes them in parallel threads
+     *
+     * @return an std::vector of size N * m * n (N being the number of points) where the entry (k * m + i) * n + j is
+     * the derivative of the output i with respect to the input j at the point k
+     *
+     * @throw std::invalid_argument if the size of a point is incompatible or if an active kernel does not provide
+     * its derivatives
+     */
+    std::vector<T> jacobian(const std::vector<std::vector<T>> &points, unsigned parallel = 0u) const
+    {
+        check_points(points);
+        std::vector<T> retval(points.size() * m_m * m_n);
+        for_each_point(points.size(), parallel, [&](std::size_t k) {
+            std::vector<T> outputs(m_m), jacobian(m_m * m_n);
+            reverse_sweep(points[k], m_f, outputs, jacobian);
+            std::copy(jacobian.begin(), jacobian.end(), retval.begin() + k * m_m * m_n);
+        });
+        return retval;
+    }
+
+    /// Hessians of the dCGP expression on a batch of points (forward over reverse mode)
+    /**
+     * Computes the Hessian of each output of the dCGP expression at each of the points, storing them one after the
+     * other in a single contiguous std::vector. The reverse mode sweeps of dcgp::expression::gradient are run on
+     * dcgp::dual numbers, once per input, each giving a column of the Hessians: the cost is thus n times that of
+     * a gradient. The kernels are matched by name to those of dcgp::kernel_set, whose partial derivatives are
+     * differentiated.
+     *
+     * @param[in] points the points where the Hessians are computed
+     * @param[parallel] sets the grain for parallelism. 0 -> no parallelism n -> divides the points into n parts and
+     * computes them in parallel threads
+     *
+     * @return an std::vector of size N * m * n * n (N being the number of points) where the entry
+     * ((k * m + i) * n + j) * n + l is the second derivative of the output i with respect to the inputs j and l at
+     * the point k
+     *
+     * @throw std::invalid_argument if the size of a point is incompatible or if an active kernel is not one of
+     * dcgp::kernel_set
+     */
+    template <typename U = T, typename std::enable_if<std::is_same<U, double>::value, int>::type = 0>
+    std::vector<double> hessian(const std::vector<std::vector<double>> &points, unsigned parallel = 0u) const
+    {
+        check_points(points);
+        // The kernels of the dual sweeps, at the same positions as those of the expression. Those not in the kernel
+        // set are replaced by placeholders without derivatives, an error only if they are active.
+        kernel_set<dual<1>> set;
+        for (const auto &k : m_f) {
+            try {
+                set.push_back(k.get_name());
+            } catch (const std::invalid_argument &) {
+                set.push_back(kernel<dual<1>>([](const std::vector<dual<1>> &in) { return in[0]; },
+                                              [](const std::vector<std::string> &in) { return in[0]; }, k.get_name()));
+            }
+        }
+        for (auto node_id : m_active_nodes) {
+            if (node_id >= m_n && !set[m_x[m_gene_idx[node_id]]].has_derivative()) {
+                throw std::invalid_argument("The Hessian cannot be computed as the kernel "
+                                            + m_f[m_x[m_gene_idx[node_id]]].get_name()
+                                            + " is not one of the kernel set");
+            }
+        }
+        const auto f = set();
+        std::vector<double> retval(points.size() * m_m * m_n * m_n);
+        for_each_point(points.size(), parallel, [&](std::size_t k) {
+            std::vector<dual<1>> point(points[k].begin(), points[k].end()), outputs(m_m), jacobian(m_m * m_n);
+            for (auto l = 0u; l < m_n; ++l) {
+                // The input l is the direction of the forward mode
+                point[l] = dual<1>(points[k][l], 0u);
+                reverse_sweep(point, f, outputs, jacobian);
+                point[l] = dual<1>(points[k][l]);
+                for (auto ij = 0u; ij < m_m * m_n; ++ij) {
+                    retval[(k * m_m * m_n + ij) * m_n + l] = jacobian[ij].get_derivative(0u);
+                }
+            }
+        });
+        return retval;
+    }
+
+    /// Simplifies the dCGP expression
+    /**
+     * Builds a dcgp::simplified_expression equivalent to the active graph, where the weights and biases of the
+     * derived classes (as formed by dcgp::expression::kernel_inputs) become constants. The constants are folded,
+     * the identities x * 1, x + 0, x - x, x / x and 0 / x eliminated, the arguments of the commutative kernels sorted
+     * and the identical subexpressions merged. The kernels are matched by name to those of dcgp::kernel_set.
+     *
+     * @return the simplified expression
+     *
+     * @throw std::invalid_argument if an active kernel is not one of dcgp::kernel_set
+     */
+    simplified_expression simplify() const
+    {
+        detail::simplifier s(m_n);
+        std::vector<unsigned> reg(m_n + m_r * m_c), args;
+        std::vector<T> function_in, d_in;
+        for (auto node_id : m_active_nodes) {
+            if (node_id < m_n) {
+                reg[node_id] = node_id;
+                continue;
+            }
+            unsigned arity = _get_arity(node_id);
+            unsigned idx = m_gene_idx[node_id];
+            auto o = simplified_expression::from_name(m_f[m_x[idx]].get_name());
+            // The kernel inputs are affine in the connections: at zero they give the biases, d_in the weights
+            function_in.assign(arity, T(0.));
+            kernel_inputs(node_id, function_in, d_in);
+            // Weights of a product and biases of a sum are passed to the node as further constant arguments
+            const bool is_mul = (o == simplified_expression::op::MUL);
+            const bool is_sum = simplified_expression::is_sum_of_inputs(o);
+            args.clear();
+            for (auto j = 0u; j < arity; ++j) {
+                auto a = reg[m_x[idx + j + 1u]];
+                const double w = detail::loss_value(d_in[j]), b = detail::loss_value(function_in[j]);
+                if (w != 1.) {
+                    if (is_mul) {
+                        args.push_back(s.constant(w));
+                    } else {
+                        a = s.node(simplified_expression::op::MUL, {a, s.constant(w)});
+                    }
+                }
+                if (b != 0.) {
+                    if (is_sum) {
+                        args.push_back(s.constant(b));
+                    } else {
+                        a = s.node(simplified_expression::op::SUM, {a, s.constant(b)});
+                    }
+                }
+                args.push_back(a);
+            }
+            reg[node_id] = s.node(o, args);
+        }
+        std::vector<unsigned> outputs(m_m);
+        for (auto i = 0u; i < m_m; ++i) {
+            outputs[i] = reg[m_x[m_x.size() - m_m + i]];
+        }
+        return s.finish(outputs);
+    }
+
+    /// Symbolic representation of the dCGP expression as a DAG
+    /**
+     * Builds the symbolic representation of the active graph as a dcgp::symbolic_dag, where each active node is
+     * written once, in terms of the names of its arguments (e.g. "u5 = sin(u3)"). Unlike the call operator on
+     * strings, which repeats the text of a node for each of its uses, the time and memory needed are linear in the
+     * number of active nodes. The weights and biases of the derived classes appear with their symbols. The full
+     * expressions of the outputs, identical to those of the call operator, are given by
+     * dcgp::symbolic_dag::flatten().
+     *
+     * @param[in] in the symbols of the inputs.
+     * @param[in] prefix the prefix of the names of the nodes, followed by their id.
+     *
+     * @return the symbolic DAG of the expression.
+     *
+     * @throw std::invalid_argument if the input size is incompatible or if a node name is also an input symbol.
+     */
+    symbolic_dag symbolic(const std::vector<std::string> &in, const std::string &prefix = "u") const
+    {
+        if (in.size() != m_n) {
+            throw std::invalid_argument("Input size is incompatible");
+        }
+        std::vector<symbolic_dag::node> nodes;
+        std::vector<unsigned> reg(m_n + m_r * m_c), args;
+        std::vector<std::string> function_in;
+        for (auto node_id : m_active_nodes) {
+            if (node_id < m_n) {
+                reg[node_id] = node_id;
+                continue;
+            }
+            unsigned arity = _get_arity(node_id);
+            unsigned idx = m_gene_idx[node_id];
+            function_in.resize(arity);
+            args.resize(arity);
+            for (auto j = 0u; j < arity; ++j) {
+                function_in[j] = symbolic_dag::placeholder(j);
+                args[j] = reg[m_x[idx + j + 1u]];
+            }
+            nodes.push_back(symbolic_dag::make_node(prefix + std::to_string(node_id),
+                                                    kernel_symbol(node_id, function_in), args));
+            reg[node_id] = m_n + static_cast<unsigned>(nodes.size()) - 1u;
+        }
+        std::vector<unsigned> outputs(m_m);
+        for (auto i = 0u; i < m_m; ++i) {
+            outputs[i] = reg[m_x[m_x.size() - m_m + i]];
+        }
+        return symbolic_dag(in, std::move(nodes), std::move(outputs));
+    }
+
     /// Evaluates the model loss (single data point)
     /**
      * Returns the model loss over a single point of data of the dCGP output.
@@ -261,12 +667,12 @@ public:
                 auto max = *std::max_element(outputs.begin(), outputs.end());
                 // exp(a_i - max)
                 std::transform(outputs.begin(), outputs.end(), outputs.begin(),
-                               [max](T a) { return audi::exp(a - max); });
+                               [max](T a) { return exp(a - max); });
                 // sum exp(a_i - max)
                 T cumsum = std::accumulate(outputs.begin(), outputs.end(), T(0.));
                 // log(p_i) * y_i
                 std::transform(outputs.begin(), outputs.end(), prediction.begin(), outputs.begin(),
-                               [cumsum](T a, T y) { return audi::log(a / cumsum) * y; });
+                               [cumsum](T a, T y) { return log(a / cumsum) * y; });
                 // - sum log(p_i) y_i
                 retval = -std::accumulate(outputs.begin(), outputs.end(), T(0.));
                 break;
@@ -289,24 +695,37 @@ public:
     T loss(const std::vector<std::vector<T>> &points, const std::vector<std::vector<T>> &labels,
            const std::string &loss_s, unsigned parallel = 0u) const
     {
-        if (points.size() != labels.size()) {
-            throw std::invalid_argument("Data and label size mismatch data size is: " + std::to_string(points.size())
-                                        + " while label size is: " + std::to_string(labels.size()));
-        }
-        if (points.size() == 0) {
-            throw std::invalid_argument("Data size cannot be zero");
-        }
-        loss_type loss_e;
-        if (loss_s == "MSE") { // Mean Squared Error
-            loss_e = loss_type::MSE;
-        } else if (loss_s == "CE") {
-            loss_e = loss_type::CE; // Cross Entropy
-        } else {
-            throw std::invalid_argument("The requested loss was: " + loss_s + " while only MSE and CE are allowed");
-        }
+        detail::data_checks(points, labels);
+        auto loss_e = detail::decode_loss<T>(loss_s);
         return loss(points.begin(), points.end(), labels.begin(), loss_e, parallel);
     }
 
+    /// Evaluates the model loss (on a batch) with early abort
+    /**
+     * Evaluates the model loss over a batch, stopping as soon as it is guaranteed to be larger than \p threshold
+     * (e.g. the current best fitness). The accumulated error is periodically compared with the threshold and, in the
+     * parallel case, all parts are stopped through a shared flag as soon as one detects the condition. Since the
+     * loss of each point is non-negative (for the CE loss this requires non-negative labels), the accumulated error
+     * divided by the batch size is a lower bound of the loss. A NaN accumulated error also stops the evaluation.
+     *
+     * @param[points] The input data (a batch).
+     * @param[labels] The predicted outputs (a batch).
+     * @param[loss_s] The loss type. Can be "MSE" for Mean Square Error (regression) or "CE" for Cross Entropy
+     * (classification)
+     * @param[threshold] The threshold.
+     * @param[parallel] sets the grain for parallelism. 0 -> no parallelism n -> divides the data into n parts and
+     * evaluates them in parallel threads
+     * @return the loss if lower or equal to \p threshold, otherwise a value larger than \p threshold (the loss or a
+     * lower bound of it) or NaN.
+     */
+    T bounded_loss(const std::vector<std::vector<T>> &points, const std::vector<std::vector<T>> &labels,
+                   const std::string &loss_s, const T &threshold, unsigned parallel = 0u) const
+    {
+        detail::data_checks(points, labels);
+        auto loss_e = detail::decode_loss<T>(loss_s);
+        return bounded_loss(points.begin(), points.end(), labels.begin(), loss_e, threshold, parallel);
+    }
+
     /// Sets the chromosome
     /** Sets a given chromosome as genotype for the expression and updates
      * the active nodes and active genes information accordingly
@@ -760,6 +1179,59 @@ protected:
         unsigned col = (node_id - m_n) / m_r;
         return m_arity[col];
     }
+
+    /// Value of a node during a workspace evaluation
+    const T &workspace_value(const std::vector<T> &point, const workspace &ws, unsigned node_id) const
+    {
+        return (node_id < m_n) ? point[node_id] : ws.node[node_id - m_n];
+    }
+
+    /// Calls a kernel on the inputs pointed to by ws.in_ptr during a workspace evaluation
+    void workspace_call(const kernel<T> &f, workspace &ws, T &out) const
+    {
+        if (f.has_in_place()) {
+            f.in_place(ws.in_ptr, out);
+        } else {
+            ws.function_in.resize(ws.in_ptr.size());
+            for (decltype(ws.in_ptr.size()) j = 0u; j < ws.in_ptr.size(); ++j) {
+                ws.function_in[j] = *ws.in_ptr[j];
+            }
+            out = f(ws.function_in);
+        }
+    }
+
+    /// Forms the kernel inputs of a node
+    /**
+     * Transforms in place the values of the connections of a node into the inputs of its kernel and writes the
+     * derivatives of each kernel input with respect to the corresponding connection value. In this class the
+     * connections are passed unchanged, while derived classes having weights (and biases) override this method
+     * consistently with their evaluation so that dcgp::expression::gradient accounts for them.
+     *
+     * @param[node_id] the id of the node
+     * @param[function_in] the values of the connections, transformed into the kernel inputs
+     * @param[d_in] the derivatives of the kernel inputs with respect to the connection values
+     */
+    virtual void kernel_inputs(unsigned, std::vector<T> &function_in, std::vector<T> &d_in) const
+    {
+        d_in.assign(function_in.size(), T(1.));
+    }
+
+    /// Forms the symbolic value of a node
+    /**
+     * Computes the symbolic value of a node from the symbols of its connections, as done by the call operator on
+     * strings. Derived classes having weights (and biases) override this method consistently with their symbolic
+     * evaluation so that dcgp::expression::symbolic accounts for them.
+     *
+     * @param[node_id] the id of the node
+     * @param[function_in] the symbols of the connections (can be modified)
+     *
+     * @return the symbolic value of the node
+     */
+    virtual std::string kernel_symbol(unsigned node_id, std::vector<std::string> &function_in) const
+    {
+        return m_f[m_x[m_gene_idx[node_id]]](function_in);
+    }
+
     /// Updates the class data that depend on the chromosome
     /**
      * Some of the expression data depend on the chromosome. This is the case, for example,
@@ -872,7 +1344,251 @@ protected:
         return retval;
     }
 
+    /// Evaluates the model loss (on a batch) with early abort
+    /**
+     * Evaluates the model loss over a batch, stopping as soon as it is guaranteed to be larger than \p threshold.
+     *
+     * @param[dfirst] Begin of data.
+     * @param[dlast] End of data.
+     * @param[lfirst] Begin of labels.
+     * @param[loss_e] The loss type.
+     * @param[threshold] The threshold.
+     * @param[parallel] sets the grain for parallelism. 0 -> no parallelism n -> divides the data into n parts and
+     * evaluates them in parallel threads
+     * @return the loss if lower or equal to \p threshold, otherwise a value larger than \p threshold (the loss or a
+     * lower bound of it) or NaN.
+     */
+    T bounded_loss(typename std::vector<std::vector<T>>::const_iterator dfirst,
+                   typename std::vector<std::vector<T>>::const_iterator dlast,
+                   typename std::vector<std::vector<T>>::const_iterator lfirst, loss_type loss_e, const T &threshold,
+                   unsigned parallel) const
+    {
+        // Number of points evaluated between two checks against the threshold
+        const unsigned period = 64u;
+        T retval(0.);
+        unsigned batch_size = static_cast<unsigned>(dlast - dfirst);
+        const double bound = detail::loss_value(threshold) * batch_size;
+        if (parallel > 0u) {
+            if (batch_size % parallel != 0) {
+                throw std::invalid_argument("The batch size is: " + std::to_string(batch_size)
+                                            + " and cannot be divided into " + std::to_string(parallel) + "parts.");
+            }
+            unsigned inner_batch_size = batch_size / parallel;
+            // The mutex that will protect read/write access to retval
+            tbb::spin_mutex mutex_retval;
+            // Raised by the first part detecting that the threshold is exceeded
+            std::atomic<bool> abort(false);
+            tbb::parallel_for(0u, batch_size, inner_batch_size, [&](unsigned i) {
+                for (auto j = 0u; j < inner_batch_size && !abort.load(std::memory_order_relaxed);) {
+                    T err(0.);
+                    auto end = std::min(j + period, inner_batch_size);
+                    for (; j < end; ++j) {
+                        err += loss(*(dfirst + i + j), *(lfirst + i + j), loss_e);
+                    }
+                    // We acquire the lock on the mutex, update the cumulative loss and check it
+                    tbb::spin_mutex::scoped_lock lock(mutex_retval);
+                    retval += err;
+                    if (!(detail::loss_value(retval) <= bound)) {
+                        abort.store(true, std::memory_order_relaxed);
+                    }
+                }
+            });
+        } else {
+            for (auto i = 0u; i < batch_size;) {
+                auto end = std::min(i + period, batch_size);
+                for (; i < end; ++i) {
+                    retval += loss(*(dfirst + i), *(lfirst + i), loss_e);
+                }
+                if (!(detail::loss_value(retval) <= bound)) {
+                    break;
+                }
+            }
+        }
+        retval /= batch_size;
+
+        return retval;
+    }
+
 private:
+    // Checks the sizes of a batch of points
+    template <typename U>
+    void check_points(const std::vector<std::vector<U>> &points) const
+    {
+        for (decltype(points.size()) k = 0u; k < points.size(); ++k) {
+            if (points[k].size() != m_n) {
+                throw std::invalid_argument("The point " + std::to_string(k) + " has dimension "
+                                            + std::to_string(points[k].size()) + " while the number of inputs is: "
+                                            + std::to_string(m_n));
+            }
+        }
+    }
+
+    // Calls f(k) for each of the N points, in parallel when requested
+    template <typename F>
+    void for_each_point(std::size_t N, unsigned parallel, const F &f) const
+    {
+        if (parallel > 0u && N > 0u) {
+            auto grain = (N + parallel - 1u) / parallel;
+            tbb::parallel_for(tbb::blocked_range<std::size_t>(0u, N, grain),
+                              [&f](const tbb::blocked_range<std::size_t> &range) {
+                                  for (auto k = range.begin(); k != range.end(); ++k) {
+                                      f(k);
+                                  }
+                              });
+        } else {
+            for (std::size_t k = 0u; k < N; ++k) {
+                f(k);
+            }
+        }
+    }
+
+    // Forms the kernel inputs in the sweeps on the expression type
+    void sweep_inputs(unsigned node_id, std::vector<T> &function_in, std::vector<T> &d_in) const
+    {
+        kernel_inputs(node_id, function_in, d_in);
+    }
+
+    // Forms the kernel inputs in the sweeps on duals (Hessians of the double expressions). Since the connections
+    // are transformed affinely (by weights and biases), the values go through kernel_inputs while their derivatives
+    // are scaled by d_in.
+    template <unsigned N, typename U = T, typename std::enable_if<std::is_same<U, double>::value, int>::type = 0>
+    void sweep_inputs(unsigned node_id, std::vector<dual<N>> &function_in, std::vector<dual<N>> &d_in) const
+    {
+        std::vector<double> values(function_in.size()), d_values;
+        for (decltype(values.size()) j = 0u; j < values.size(); ++j) {
+            values[j] = function_in[j].value();
+        }
+        kernel_inputs(node_id, values, d_values);
+        d_in.resize(d_values.size());
+        for (decltype(values.size()) j = 0u; j < values.size(); ++j) {
+            function_in[j] *= d_values[j];
+            function_in[j] += values[j] - function_in[j].value();
+            d_in[j] = d_values[j];
+        }
+    }
+
+    // The reverse mode sweeps, on values of type U (the expression type, or duals for the Hessians) using the
+    // kernels f, writing the outputs in retval and the (row-major, m x n) Jacobian in jacobian
+    template <typename U>
+    void reverse_sweep(const std::vector<U> &point, const std::vector<kernel<U>> &f, std::vector<U> &retval,
+                       std::vector<U> &jacobian) const
+    {
+        std::vector<U> node(m_n + m_r * m_c);
+        // Partial derivatives of each active node with respect to its connections, stored at the position in the
+        // chromosome of the connection gene
+        std::vector<U> d_node(m_x.size());
+        std::vector<U> function_in, d_in, grad;
+        // Forward sweep
+        for (auto node_id : m_active_nodes) {
+            if (node_id < m_n) {
+                node[node_id] = point[node_id];
+            } else {
+                unsigned arity = _get_arity(node_id);
+                function_in.resize(arity);
+                unsigned idx = m_gene_idx[node_id]; // position in the chromosome of the current node
+                for (auto j = 0u; j < arity; ++j) {
+                    function_in[j] = node[m_x[idx + j + 1u]];
+                }
+                sweep_inputs(node_id, function_in, d_in);
+                const auto &ker = f[m_x[idx]];
+                node[node_id] = ker(function_in);
+                ker.d(function_in, node[node_id], grad);
+                for (auto j = 0u; j < arity; ++j) {
+                    d_node[idx + j + 1u] = grad[j] * d_in[j];
+                }
+            }
+        }
+        std::fill(jacobian.begin(), jacobian.end(), U(0.));
+        std::vector<U> adjoint(node.size());
+        // Backward sweeps (m_active_nodes is sorted, hence reversing it follows the graph backwards)
+        for (auto i = 0u; i < m_m; ++i) {
+            auto out_id = m_x[m_x.size() - m_m + i];
+            retval[i] = node[out_id];
+            std::fill(adjoint.begin(), adjoint.end(), U(0.));
+            adjoint[out_id] = U(1.);
+            for (auto it = m_active_nodes.rbegin(); it != m_active_nodes.rend(); ++it) {
+                auto node_id = *it;
+                if (node_id < m_n) {
+                    jacobian[i * m_n + node_id] = adjoint[node_id];
+                } else if (adjoint[node_id] != U(0.)) {
+                    // nodes not reaching the output are skipped (their partial derivatives may not be finite)
+                    unsigned idx = m_gene_idx[node_id];
+                    for (auto j = 0u; j < _get_arity(node_id); ++j) {
+                        adjoint[m_x[idx + j + 1u]] += adjoint[node_id] * d_node[idx + j + 1u];
+                    }
+                }
+            }
+        }
+    }
+
+    friend class boost::serialization::access;
+    // Serialization. Kernels wrap generic callables and cannot be serialized, hence we only store their names
+    // and rebuild them upon deserialization using the kernel_set. As a consequence, only expressions that use the
+    // kernels provided by dcgp::kernel_set can be deserialized.
+    template <typename Archive>
+    void save(Archive &ar, const unsigned) const
+    {
+        ar << m_n;
+        ar << m_m;
+        ar << m_r;
+        ar << m_c;
+        ar << m_l;
+        ar << m_arity;
+        std::vector<std::string> f_names;
+        for (const auto &ker : m_f) {
+            f_names.push_back(ker.get_name());
+        }
+        ar << f_names;
+        ar << m_x;
+        // The random engine state is stored via its textual representation
+        std::ostringstream ss;
+        ss << m_e;
+        ar << ss.str();
+    }
+    template <typename Archive>
+    void load(Archive &ar, const unsigned)
+    {
+        unsigned n, m, r, c, l;
+        std::vector<unsigned> arity, x;
+        std::vector<std::string> f_names;
+        std::string e_state;
+        ar >> n;
+        ar >> m;
+        ar >> r;
+        ar >> c;
+        ar >> l;
+        ar >> arity;
+        ar >> f_names;
+        ar >> x;
+        ar >> e_state;
+        // We check the data before modifying the object. The kernels are reconstructed by name (will throw if a
+        // kernel is not in the kernel_set) and the constructor runs the sanity checks and computes the bounds.
+        expression<T> tmp(n, m, r, c, l, arity, kernel_set<T>(f_names)(), 0u);
+        if (!tmp.is_valid(x)) {
+            throw std::invalid_argument("The deserialized chromosome is incompatible with the expression");
+        }
+        std::default_random_engine e;
+        std::istringstream ss(e_state);
+        ss >> e;
+        if (ss.fail()) {
+            throw std::invalid_argument("The deserialized random engine state is invalid");
+        }
+        m_n = n;
+        m_m = m;
+        m_r = r;
+        m_c = c;
+        m_l = l;
+        m_arity = std::move(tmp.m_arity);
+        m_f = std::move(tmp.m_f);
+        m_lb = std::move(tmp.m_lb);
+        m_ub = std::move(tmp.m_ub);
+        m_gene_idx = std::move(tmp.m_gene_idx);
+        m_x = std::move(x);
+        m_e = e;
+        update_data_structures();
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
     void sanity_checks()
     {
         if (m_n == 0) throw std::invalid_argument("Number of inputs is 0");
@@ -972,6 +1688,25 @@ private:
     using type = T;
 };
 
+namespace detail
+{
+// Checks the arguments of the sgd methods (expression_ann, expression_weighted) and returns the loss type
+inline expression<double>::loss_type sgd_checks(const std::vector<std::vector<double>> &points,
+                                                const std::vector<std::vector<double>> &labels, double lr,
+                                                unsigned batch_size, const std::string &loss_s)
+{
+    data_checks(points, labels);
+    if (lr <= 0) {
+        throw std::invalid_argument("The learning rate must be a positive number, while: " + std::to_string(lr)
+                                    + " was detected.");
+    }
+    if (batch_size == 0u) {
+        throw std::invalid_argument("The batch size cannot be zero");
+    }
+    return decode_loss<double>(loss_s);
+}
+} // namespace detail
+
 } // end of namespace dcgp
 
 #endif // DCGP_EXPRESSION_H
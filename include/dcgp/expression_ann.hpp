@@ -1,8 +1,11 @@
 #ifndef DCGP_EXPRESSION_ANN_H
 #define DCGP_EXPRESSION_ANN_H
 
+#include <Eigen/Dense>
 #include <algorithm>
+#include <atomic>
 #include <audi/io.hpp>
+#include <cmath>
 #include <functional>
 #include <initializer_list>
 #include <iostream>
@@ -12,12 +15,15 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
-#include <tbb/spin_mutex.h>
+#include <tbb/enumerable_thread_specific.h>
 #include <tbb/tbb.h>
+#include <tuple>
 #include <vector>
 
 #include <dcgp/expression.hpp>
+#include <dcgp/frozen_ann.hpp>
 #include <dcgp/kernel.hpp>
+#include <dcgp/s11n.hpp>
 #include <dcgp/type_traits.hpp>
 
 namespace dcgp
@@ -40,6 +46,44 @@ private:
     template <typename U>
     using enable_double = typename std::enable_if<std::is_same<U, double>::value, int>::type;
 
+    // The state of the optimizer for a vector of parameters (see set_optimizer())
+    struct optimizer_state {
+        // Resizes the state to n parameters and sets it to zero
+        void reset(std::vector<double>::size_type n)
+        {
+            m_m1.assign(n, 0.);
+            m_m2.assign(n, 0.);
+            m_t.assign(n, 0u);
+        }
+        // Sets to zero the state of the i-th parameter
+        void reset_one(std::vector<double>::size_type i)
+        {
+            if (i < m_t.size()) {
+                m_m1[i] = 0.;
+                m_m2[i] = 0.;
+                m_t[i] = 0u;
+            }
+        }
+        // Checks the state is that of n parameters
+        bool has_size(std::vector<double>::size_type n) const
+        {
+            return m_m1.size() == n && m_m2.size() == n && m_t.size() == n;
+        }
+        template <typename Archive>
+        void serialize(Archive &ar, const unsigned)
+        {
+            ar &m_m1;
+            ar &m_m2;
+            ar &m_t;
+        }
+        // First moment estimates (velocities for momentum methods)
+        std::vector<double> m_m1;
+        // Second moment estimates
+        std::vector<double> m_m2;
+        // Number of updates (for Adam bias corrections)
+        std::vector<unsigned> m_t;
+    };
+
 public:
     /// Allowed kernels (for backpropagation to work)
     enum class kernel_type { 
@@ -55,6 +99,30 @@ public:
         ISRU, 
         /// Simple sum of inputs
         SUM };
+
+    /// Optimizers used to update the weights and biases in sgd
+    enum class optimizer_type {
+        /// Plain stochastic gradient descent
+        SGD,
+        /// Momentum (heavy ball)
+        MOMENTUM,
+        /// Nesterov accelerated gradient
+        NESTEROV,
+        /// RMSProp
+        RMSPROP,
+        /// Adam
+        ADAM
+    };
+
+    /// Floating point precisions of the batch computations
+    enum class precision_type {
+        /// Double precision
+        DOUBLE,
+        /// Single precision
+        SINGLE,
+        /// Single precision with double precision reductions
+        MIXED
+    };
     /// Constructor
     /** Constructs a dCGPANN expression
      *
@@ -76,46 +144,16 @@ public:
                    std::vector<kernel<double>> f,    // functions
                    unsigned seed                // seed for the pseudo-random numbers
                    )
-        : expression<double>(n, m, r, c, l, arity, f, seed), m_biases(r * c, 0.), m_kernel_map(f.size())
+        : expression<double>(n, m, r, c, l, arity, f, seed), m_biases(r * c, 0.)
 
     {
-        // Sanity checks
-        for (const auto &ker : f) {
-            if (ker.get_name() != "tanh" && ker.get_name() != "sig" && ker.get_name() != "ReLu"
-                && ker.get_name() != "ELU" && ker.get_name() != "ISRU" && ker.get_name() != "sum") {
-                throw std::invalid_argument(
-                    "Only tanh, sig, ReLu, ELU, ISRU and sum Kernels are valid for dCGP-ANN expressions");
-            }
-        }
-        // Initialize the kernel map
-        for (decltype(f.size()) i = 0u; i < f.size(); ++i) {
-            if (f[i].get_name() == "sig") {
-                m_kernel_map[i] = kernel_type::SIG;
-            } else if (f[i].get_name() == "tanh") {
-                m_kernel_map[i] = kernel_type::TANH;
-            } else if (f[i].get_name() == "ReLu") {
-                m_kernel_map[i] = kernel_type::RELU;
-            } else if (f[i].get_name() == "ELU") {
-                m_kernel_map[i] = kernel_type::ELU;
-            } else if (f[i].get_name() == "ISRU") {
-                m_kernel_map[i] = kernel_type::ISRU;
-            } else if (f[i].get_name() == "sum") {
-                m_kernel_map[i] = kernel_type::SUM;
-            }
-        }
+        // Sanity checks, kernel map and symbols for weights and biases
+        init_kernels_and_symbols();
         // Default initialization of weights to 1.
         unsigned n_connections = std::accumulate(this->get_arity().begin(), this->get_arity().end(), 0u) * r;
         m_weights = std::vector<double>(n_connections, 1.);
+        reset_optimizer();
 
-        // Filling in the symbols for the weights and biases
-        for (auto node_id = n; node_id < r * c + n; ++node_id) {
-            for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
-                m_weights_symbols.push_back("w" + std::to_string(node_id) + "_" + std::to_string(j));
-            }
-        }
-        for (auto node_id = n; node_id < r * c + n; ++node_id) {
-            m_biases_symbols.push_back("b" + std::to_string(node_id));
-        }
         // This will call the derived class method (not the base class) where the base class method is also called.
         // As a consequence data members of both classes will be updated.
         update_data_structures();
@@ -142,47 +180,16 @@ public:
                    std::vector<kernel<double>> f, // functions
                    unsigned seed             // seed for the pseudo-random numbers
                    )
-        : expression<double>(n, m, r, c, l, std::vector<unsigned>(c, arity), f, seed), m_biases(r * c, 0.),
-          m_kernel_map(f.size())
+        : expression<double>(n, m, r, c, l, std::vector<unsigned>(c, arity), f, seed), m_biases(r * c, 0.)
 
     {
-        // Sanity checks
-        for (const auto &ker : f) {
-            if (ker.get_name() != "tanh" && ker.get_name() != "sig" && ker.get_name() != "ReLu"
-                && ker.get_name() != "ELU" && ker.get_name() != "ISRU" && ker.get_name() != "sum") {
-                throw std::invalid_argument(
-                    "Only tanh, sig, ReLu, ELU, ISRU and sum Kernels are valid for dCGP-ANN expressions");
-            }
-        }
-        // Initialize the kernel map
-        for (decltype(f.size()) i = 0u; i < f.size(); ++i) {
-            if (f[i].get_name() == "sig") {
-                m_kernel_map[i] = kernel_type::SIG;
-            } else if (f[i].get_name() == "tanh") {
-                m_kernel_map[i] = kernel_type::TANH;
-            } else if (f[i].get_name() == "ReLu") {
-                m_kernel_map[i] = kernel_type::RELU;
-            } else if (f[i].get_name() == "ELU") {
-                m_kernel_map[i] = kernel_type::ELU;
-            } else if (f[i].get_name() == "ISRU") {
-                m_kernel_map[i] = kernel_type::ISRU;
-            } else if (f[i].get_name() == "sum") {
-                m_kernel_map[i] = kernel_type::SUM;
-            }
-        }
+        // Sanity checks, kernel map and symbols for weights and biases
+        init_kernels_and_symbols();
         // Default initialization of weights to 1.
         unsigned n_connections = std::accumulate(this->get_arity().begin(), this->get_arity().end(), 0u) * r;
         m_weights = std::vector<double>(n_connections, 1.);
+        reset_optimizer();
 
-        // Filling in the symbols for the weights and biases
-        for (auto node_id = n; node_id < r * c + n; ++node_id) {
-            for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
-                m_weights_symbols.push_back("w" + std::to_string(node_id) + "_" + std::to_string(j));
-            }
-        }
-        for (auto node_id = n; node_id < r * c + n; ++node_id) {
-            m_biases_symbols.push_back("b" + std::to_string(node_id));
-        }
         // This will call the derived class method (not the base class) where the base class method is also called.
         // As a consequence data members of both classes will be updated.
         update_data_structures();
@@ -245,6 +252,23 @@ public:
         return (*this)(dummy);
     }
 
+    /// Evaluates the dCGP-ANN expression reusing a workspace
+    /**
+     * This method overrides the base class method. As the dCGP-ANN only operates on doubles, no polynomial is
+     * allocated and the evaluation is the one of the call operator, the outputs being stored in \p ws.
+     *
+     * @param[point] an std::vector containing the values where the dCGP-ANN expression has to be computed
+     * @param[ws] the workspace
+     *
+     * @return a reference to the value of the output, stored in \p ws
+     */
+    const std::vector<double> &evaluate(const std::vector<double> &point,
+                                        typename expression<double>::workspace &ws) const
+    {
+        ws.retval = (*this)(point);
+        return ws.retval;
+    }
+
     /// Cumulates the loss and its gradient (of a single point)
     /**
      * Cumulates the loss and its gradient with respect to weights and biases. The values are cumulated into the inputs.
@@ -345,16 +369,14 @@ public:
             // index of the node in the weight vector
             auto w_idx = c_idx - (node_id - this->get_n());
 
-            // We update the d_node information
+            // We update the d_node information, first from the nodes then from the outputs (the m virtual nodes we
+            // added computing (x-x_i)^2)
             double cum = 0.;
-            for (auto i = 0u; i < m_connected[node_id].size(); ++i) {
-                // If the node is not "virtual", that is not one of the m virtual nodes we added computing (x-x_i)^2
-                if (m_connected[node_id][i].first < this->get_n() + this->get_r() * this->get_c()) {
-                    cum += m_weights[m_connected[node_id][i].second] * d_node[m_connected[node_id][i].first];
-                } else {
-                    auto n_out = m_connected[node_id][i].first - (this->get_n() + this->get_r() * this->get_c());
-                    cum += d_node[d_node.size() - this->get_m() + n_out];
-                }
+            for (auto k = m_con_offsets[node_id]; k < m_con_out_begin[node_id]; ++k) {
+                cum += m_weights[m_con_weights[k]] * d_node[m_con_targets[k]];
+            }
+            for (auto k = m_con_out_begin[node_id]; k < m_con_offsets[node_id + 1u]; ++k) {
+                cum += d_node[n_nodes + m_con_targets[k]];
             }
             d_node[node_id] *= cum;
 
@@ -384,90 +406,299 @@ public:
                                                                         expression<double>::loss_type loss_e,
                                                                         unsigned parallel)
     {
-        if (points.size() != labels.size()) {
-            throw std::invalid_argument("Data and label size mismatch data size is: " + std::to_string(points.size())
-                                        + " while label size is: " + std::to_string(labels.size()));
-        }
-        if (points.size() == 0) {
-            throw std::invalid_argument("Data size cannot be zero");
-        }
-        return d_loss(points.begin(), points.end(), labels.begin(), loss_e, parallel);
+        detail::data_checks(points, labels);
+        return d_loss(detail::row_iterator(points, 0), detail::row_iterator(points, points.size()),
+                      detail::row_iterator(labels, 0), loss_e, parallel);
     }
 
     /// Stochastic gradient descent
     /**
      * Performs one "epoch" of stochastic gradient descent using mean square error
      *
-     * @param[points] The input data (a batch). Will be randomly shuffled (with labels) after a call to sgd.
-     * @param[labels] The predicted outputs (a batch). Will be randomly shuffled (with points) after a call to sgd.
+     * @param[points] The input data.
+     * @param[labels] The predicted outputs.
      * @param[lr] The learning rate.
      * @param[batch_size] The batch size.
      * @param[loss_s] A string defining the loss type. Can be one of "MSE" (mean squared error) or "CE" (cross-entropy)
      * @param[parallel] sets the grain for parallelism. 0 -> no parallelism n -> divides the data into n parts and
      * processes them in parallel threads
-     * @param[shuffle] when true it shuffles the points and labels before performing one epoch of training.
+     * @param[shuffle] when true the points (and labels) are visited in a random order. The data is not modified,
+     * the batches being read through a permutation of the indexes, so that several expressions can be trained
+     * concurrently on the same data.
      *
      * @return The average error across the batches. Note: this will not be equal to the error on the whole data set
      * as weights get updated after each batch. It is an indicator, though, and its free to compute.
      *
-     * @throws std::invalid_argument if the *data* and *label* size do not match or is zero, or if *lr* is not
-     * positive.
+     * The weights are updated with the optimizer selected by set_optimizer() (plain stochastic gradient descent by
+     * default), its state being kept across calls.
+     *
+     * @throws std::invalid_argument if the *data* and *label* size do not match or is zero, if *lr* is not
+     * positive or if *batch_size* is zero.
      */
-    double sgd(std::vector<std::vector<double>> &points, std::vector<std::vector<double>> &labels, double lr,
-               unsigned batch_size, const std::string &loss_s, unsigned parallel = 0u, bool shuffle = true)
+    double sgd(const std::vector<std::vector<double>> &points, const std::vector<std::vector<double>> &labels,
+               double lr, unsigned batch_size, const std::string &loss_s, unsigned parallel = 0u, bool shuffle = true)
     {
-        // Sanity checks for the inputs
-        if (points.size() != labels.size()) {
-            throw std::invalid_argument("Data and label size mismatch data size is: " + std::to_string(points.size())
-                                        + " while label size is: " + std::to_string(labels.size()));
+        // Sanity checks for the inputs and decoding of the loss from string to the enum type (loss_s -> loss_e)
+        auto loss_e = detail::sgd_checks(points, labels, lr, batch_size, loss_s);
+
+        // The order in which the points are visited. We shuffle indexes rather than the data which is left untouched:
+        // the batch engines read the rows through the permutation when packing their own batch buffers.
+        const auto N = static_cast<unsigned>(points.size());
+        std::vector<unsigned> perm;
+        if (shuffle) {
+            perm.resize(N);
+            std::iota(perm.begin(), perm.end(), 0u);
+            std::mt19937 eng(std::random_device{}());
+            std::shuffle(perm.begin(), perm.end(), eng);
         }
-        if (points.size() == 0) {
-            throw std::invalid_argument("Data size cannot be zero");
+        auto dfirst = shuffle ? detail::row_iterator(points, perm, 0) : detail::row_iterator(points, 0);
+        auto lfirst = shuffle ? detail::row_iterator(labels, perm, 0) : detail::row_iterator(labels, 0);
+
+        // Starting the iteration
+        double retval = 0.;
+        double counter = 0.;
+        for (auto start = 0u; start < N; start += batch_size) {
+            auto end = std::min(start + batch_size, N);
+            retval += update_weights(dfirst + start, dfirst + end, lfirst + start, lr, loss_e, parallel);
+            counter++;
         }
-        if (lr <= 0) {
-            throw std::invalid_argument("The learning rate must be a positive number, while: " + std::to_string(lr)
-                                        + " was detected.");
+        return retval / counter;
+    }
+
+    /// Asynchronous stochastic gradient descent (Hogwild)
+    /**
+     * Performs one "epoch" of asynchronous stochastic gradient descent. The data is split into \p n_shards disjoint
+     * shards, each processed by a parallel task in batches of \p batch_size points. Each task computes the loss
+     * gradient of its batch with the weights and biases current at that time and applies the update to the shared
+     * weights and biases with relaxed atomic loads and stores, without any synchronization with the other tasks
+     * (Hogwild). Concurrent updates of the same weight can thus overwrite each other, which for sparse dCGP-ANNs is
+     * rare and does not prevent convergence, while removing all synchronization per batch.
+     *
+     * The update rule is plain stochastic gradient descent, which must thus be the optimizer selected by
+     * set_optimizer(). With more than one shard the result depends on the scheduling and is not reproducible. With
+     * one shard it is reproducible for a given \p seed, and equal to that of sgd without parallelism when the points
+     * are visited in the same order (e.g. with \p shuffle false).
+     *
+     * @param[points] The input data.
+     * @param[labels] The predicted outputs.
+     * @param[lr] The learning rate.
+     * @param[batch_size] The batch size.
+     * @param[loss_s] A string defining the loss type. Can be one of "MSE" (mean squared error) or "CE" (cross-entropy)
+     * @param[n_shards] The number of data shards processed in parallel. 0 -> the concurrency of the current task
+     * arena.
+     * @param[shuffle] when true the points are randomly assigned to the shards (and batches).
+     * @param[seed] seed for the random number generator shuffling the points.
+     *
+     * @return The average error across the batches.
+     *
+     * @throws std::invalid_argument if the *data* and *label* size do not match or is zero, if *lr* is not
+     * positive, if *batch_size* is zero or if the selected optimizer is not "SGD".
+     */
+    double sgd_async(const std::vector<std::vector<double>> &points, const std::vector<std::vector<double>> &labels,
+                     double lr, unsigned batch_size, const std::string &loss_s, unsigned n_shards = 0u,
+                     bool shuffle = true, std::random_device::result_type seed = std::random_device{}())
+    {
+        auto loss_e = detail::sgd_checks(points, labels, lr, batch_size, loss_s);
+        if (m_optimizer != optimizer_type::SGD) {
+            throw std::invalid_argument("The asynchronous sgd only supports the SGD optimizer, while "
+                                        + get_optimizer() + " is selected");
+        }
+        const auto N = static_cast<unsigned>(points.size());
+        if (n_shards == 0u) {
+            n_shards = static_cast<unsigned>(tbb::this_task_arena::max_concurrency());
+        }
+        n_shards = std::min(n_shards, N);
+        // The order in which the points are visited
+        std::vector<unsigned> perm(N);
+        std::iota(perm.begin(), perm.end(), 0u);
+        if (shuffle) {
+            std::mt19937 eng(seed);
+            std::shuffle(perm.begin(), perm.end(), eng);
+        }
+        // The shared weights and biases
+        std::vector<std::atomic<double>> weights(m_weights.size()), biases(m_biases.size());
+        for (decltype(m_weights.size()) i = 0u; i < m_weights.size(); ++i) {
+            weights[i].store(m_weights[i], std::memory_order_relaxed);
+        }
+        for (decltype(m_biases.size()) i = 0u; i < m_biases.size(); ++i) {
+            biases[i].store(m_biases[i], std::memory_order_relaxed);
         }
+        std::vector<double> shard_loss(n_shards, 0.);
+        std::vector<unsigned> shard_batches(n_shards, 0u);
+        const detail::row_iterator dfirst(points, perm, 0), lfirst(labels, perm, 0);
+        tbb::parallel_for(0u, n_shards, [&](unsigned k) {
+            // Each task works on its own copy of the expression, its batches are read through the permutation
+            auto ex = *this;
+            const unsigned first = static_cast<unsigned>(static_cast<unsigned long>(N) * k / n_shards);
+            const unsigned last = static_cast<unsigned>(static_cast<unsigned long>(N) * (k + 1u) / n_shards);
+            for (auto start = first; start < last; start += batch_size) {
+                const auto end = std::min(start + batch_size, last);
+                // We read the current weights and biases
+                for (auto idx : m_active_weights_idx) {
+                    ex.m_weights[idx] = weights[idx].load(std::memory_order_relaxed);
+                }
+                for (auto idx : m_active_biases_idx) {
+                    ex.m_biases[idx] = biases[idx].load(std::memory_order_relaxed);
+                }
+                auto err = ex.d_loss(dfirst + start, dfirst + end, lfirst + start, loss_e, 0u);
+                // And we update them, without synchronization
+                const auto &gweights = std::get<1>(err);
+                const auto &gbiases = std::get<2>(err);
+                for (auto idx : m_active_weights_idx) {
+                    weights[idx].store(weights[idx].load(std::memory_order_relaxed) - lr * gweights[idx],
+                                       std::memory_order_relaxed);
+                }
+                for (auto idx : m_active_biases_idx) {
+                    biases[idx].store(biases[idx].load(std::memory_order_relaxed) - lr * gbiases[idx],
+                                      std::memory_order_relaxed);
+                }
+                shard_loss[k] += std::get<0>(err);
+                ++shard_batches[k];
+            }
+        });
+        for (auto idx : m_active_weights_idx) {
+            m_weights[idx] = weights[idx].load(std::memory_order_relaxed);
+        }
+        for (auto idx : m_active_biases_idx) {
+            m_biases[idx] = biases[idx].load(std::memory_order_relaxed);
+        }
+        return std::accumulate(shard_loss.begin(), shard_loss.end(), 0.)
+               / std::accumulate(shard_batches.begin(), shard_batches.end(), 0u);
+    }
 
-        // Decoding the loss from string to the enum type (loss_s -> loss_e)
-        expression<double>::loss_type loss_e;
-        if (loss_s == "MSE") {
-            loss_e = expression<double>::loss_type::MSE;
-        } else if (loss_s == "CE") {
-            loss_e = expression<double>::loss_type::CE;
+    /// Selects the optimizer
+    /**
+     * Selects the optimizer used by sgd to update the weights and biases, resetting its state. The optimizer state
+     * (moment estimates) is stored alongside the weights and biases and kept across calls to sgd and chromosome
+     * changes: when a connection gene changes, only the state of its weight is reset (and that of the bias when the
+     * function gene changes).
+     *
+     * With learning rate lr and gradient g the updates are:
+     * - "SGD": w -= lr g
+     * - "MOMENTUM": v = beta1 v + g, w -= lr v
+     * - "NESTEROV": v = beta1 v + g, w -= lr (g + beta1 v)
+     * - "RMSPROP": s = beta2 s + (1 - beta2) g^2, w -= lr g / (sqrt(s) + eps)
+     * - "ADAM": m = beta1 m + (1 - beta1) g, s = beta2 s + (1 - beta2) g^2,
+     *   w -= lr m / (1 - beta1^t) / (sqrt(s / (1 - beta2^t)) + eps), t being the number of updates of w
+     *
+     * @param[name] The optimizer. One of "SGD", "MOMENTUM", "NESTEROV", "RMSPROP" or "ADAM".
+     * @param[beta1] The momentum coefficient (first moment decay rate for Adam).
+     * @param[beta2] The second moment decay rate (RMSProp, Adam).
+     * @param[eps] The term added to the denominator for numerical stability (RMSProp, Adam).
+     *
+     * @throws std::invalid_argument if the optimizer is unknown, if *beta1* or *beta2* are not in [0, 1) or if *eps*
+     * is not positive.
+     */
+    void set_optimizer(const std::string &name, double beta1 = 0.9, double beta2 = 0.999, double eps = 1e-8)
+    {
+        optimizer_type opt;
+        if (name == "SGD") {
+            opt = optimizer_type::SGD;
+        } else if (name == "MOMENTUM") {
+            opt = optimizer_type::MOMENTUM;
+        } else if (name == "NESTEROV") {
+            opt = optimizer_type::NESTEROV;
+        } else if (name == "RMSPROP") {
+            opt = optimizer_type::RMSPROP;
+        } else if (name == "ADAM") {
+            opt = optimizer_type::ADAM;
         } else {
-            throw std::invalid_argument("The requested loss was: " + loss_s + " while only MSE and CE are allowed");
+            throw std::invalid_argument("The requested optimizer was: " + name
+                                        + " while only SGD, MOMENTUM, NESTEROV, RMSPROP and ADAM are allowed");
+        }
+        if (!(beta1 >= 0. && beta1 < 1.) || !(beta2 >= 0. && beta2 < 1.)) {
+            throw std::invalid_argument("The decay rates must be in [0, 1), while beta1: " + std::to_string(beta1)
+                                        + " and beta2: " + std::to_string(beta2) + " were detected.");
         }
+        if (!(eps > 0.)) {
+            throw std::invalid_argument("The eps parameter must be a positive number, while: " + std::to_string(eps)
+                                        + " was detected.");
+        }
+        m_optimizer = opt;
+        m_beta1 = beta1;
+        m_beta2 = beta2;
+        m_eps = eps;
+        reset_optimizer();
+    }
 
-        if (shuffle) {
-            // Creating a shuffle
-            // Create two random engines with the same state
-            auto seed = std::random_device{}();
-            std::mt19937 eng1(seed);
-            auto eng2 = eng1;
-            std::shuffle(points.begin(), points.end(), eng1);
-            std::shuffle(labels.begin(), labels.end(), eng2);
+    /// Gets the optimizer
+    /**
+     * @return the name of the optimizer used by sgd (see set_optimizer()).
+     */
+    std::string get_optimizer() const
+    {
+        switch (m_optimizer) {
+            case optimizer_type::MOMENTUM:
+                return "MOMENTUM";
+            case optimizer_type::NESTEROV:
+                return "NESTEROV";
+            case optimizer_type::RMSPROP:
+                return "RMSPROP";
+            case optimizer_type::ADAM:
+                return "ADAM";
+            default:
+                return "SGD";
         }
+    }
 
-        // Starting the iteration
-        auto dfirst = points.begin();
-        auto dlast = points.end();
-        auto lfirst = labels.begin();
-        double retval = 0.;
-        double counter = 0.;
-        while (dfirst != dlast) {
-            if (dfirst + batch_size > dlast) {
-                retval += update_weights(dfirst, dlast, lfirst, lr, loss_e, parallel);
-                dfirst = dlast;
-                counter++;
-            } else {
-                retval += update_weights(dfirst, dfirst + batch_size, lfirst, lr, loss_e, parallel);
-                dfirst += batch_size;
-                lfirst += batch_size;
-                counter++;
-            }
+    /// Resets the optimizer state
+    /**
+     * Sets to zero all the moment estimates of the optimizer, as if no update had been made.
+     */
+    void reset_optimizer()
+    {
+        m_weights_state.reset(m_weights.size());
+        m_biases_state.reset(m_biases.size());
+    }
+
+    /// Sets the floating point precision of the training computations
+    /**
+     * Selects the precision used to compute the loss and its gradient on a batch (d_loss on a batch, sgd and
+     * sgd_async):
+     *
+     * - "double": all computations are made in double precision.
+     * - "single": node values, their derivatives and the loss gradient are computed, and summed over the batch,
+     *   in single precision.
+     * - "mixed": node values and their derivatives are computed in single precision while the loss and its gradient
+     *   are summed over the batch in double precision.
+     *
+     * Single precision halves the memory traffic and doubles the SIMD width of the forward and backward passes. In
+     * all cases the weights and biases, as well as the optimizer state, are kept and updated in double precision,
+     * so that small updates are not lost to rounding. Single point computations (d_loss on a point, evaluation,
+     * loss) are always made in double precision.
+     *
+     * @param[name] The precision. One of "double", "single" or "mixed".
+     *
+     * @throws std::invalid_argument if the precision is unknown.
+     */
+    void set_precision(const std::string &name)
+    {
+        if (name == "double") {
+            m_precision = precision_type::DOUBLE;
+        } else if (name == "single") {
+            m_precision = precision_type::SINGLE;
+        } else if (name == "mixed") {
+            m_precision = precision_type::MIXED;
+        } else {
+            throw std::invalid_argument("The requested precision was: " + name
+                                        + " while only double, single and mixed are allowed");
+        }
+    }
+
+    /// Gets the floating point precision of the training computations
+    /**
+     * @return the name of the precision used by the batch computations (see set_precision()).
+     */
+    std::string get_precision() const
+    {
+        switch (m_precision) {
+            case precision_type::SINGLE:
+                return "single";
+            case precision_type::MIXED:
+                return "mixed";
+            default:
+                return "double";
         }
-        return retval / counter;
     }
 
     /// Sets the output nonlinearities
@@ -517,23 +748,96 @@ public:
      */
     unsigned n_active_weights(bool unique = false) const
     {
+        if (!unique) {
+            return static_cast<unsigned>(m_active_weights_idx.size());
+        }
         unsigned retval = 0u;
         for (auto node_id : this->get_active_nodes()) {
             if (node_id < this->get_n()) continue;
-            if (!unique) {
-                retval += this->_get_arity(node_id);
-            } else {
-                auto g_idx = this->get_gene_idx()[node_id];
-                auto arity = this->_get_arity(node_id);
-                std::vector<unsigned> con_id(this->get().begin() + g_idx + 1u,
-                                             this->get().begin() + g_idx + 1u + arity);
-                std::sort(con_id.begin(), con_id.end());
-                retval += static_cast<unsigned>(std::unique(con_id.begin(), con_id.end()) - con_id.begin());
-            }
+            auto g_idx = this->get_gene_idx()[node_id];
+            auto arity = this->_get_arity(node_id);
+            std::vector<unsigned> con_id(this->get().begin() + g_idx + 1u, this->get().begin() + g_idx + 1u + arity);
+            std::sort(con_id.begin(), con_id.end());
+            retval += static_cast<unsigned>(std::unique(con_id.begin(), con_id.end()) - con_id.begin());
         }
         return retval;
     }
 
+    /// Freezes the dCGP-ANN for inference
+    /**
+     * Compiles the dCGP-ANN into an immutable inference-only object (see dcgp::frozen_ann) containing only the
+     * active nodes, in topological order, with their activation functions, biases and the gathered weights of their
+     * connections. The result does not depend on the expression anymore: further training or mutations of the
+     * expression do not affect it.
+     *
+     * @return the frozen dCGP-ANN.
+     */
+    frozen_ann freeze() const
+    {
+        const auto n = this->get_n();
+        const auto &x = this->get();
+        // The register of each active node: inputs first, then the other active nodes in order
+        std::vector<unsigned> reg(n + this->get_r() * this->get_c(), 0u);
+        std::vector<frozen_ann::activation> kernels;
+        std::vector<unsigned> offsets(1u, 0u), sources, outputs;
+        std::vector<double> weights, biases;
+        for (auto i = 0u; i < n; ++i) {
+            reg[i] = i;
+        }
+        for (auto node_id : this->get_active_nodes()) {
+            if (node_id < n) continue;
+            reg[node_id] = n + static_cast<unsigned>(kernels.size());
+            unsigned g_idx = this->get_gene_idx()[node_id];
+            unsigned w_idx = g_idx - (node_id - n);
+            switch (m_kernel_map[x[g_idx]]) {
+                case kernel_type::SIG:
+                    kernels.push_back(frozen_ann::activation::SIG);
+                    break;
+                case kernel_type::TANH:
+                    kernels.push_back(frozen_ann::activation::TANH);
+                    break;
+                case kernel_type::RELU:
+                    kernels.push_back(frozen_ann::activation::RELU);
+                    break;
+                case kernel_type::ELU:
+                    kernels.push_back(frozen_ann::activation::ELU);
+                    break;
+                case kernel_type::ISRU:
+                    kernels.push_back(frozen_ann::activation::ISRU);
+                    break;
+                case kernel_type::SUM:
+                    kernels.push_back(frozen_ann::activation::SUM);
+                    break;
+            }
+            for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
+                sources.push_back(reg[x[g_idx + 1u + j]]);
+                weights.push_back(m_weights[w_idx + j]);
+            }
+            offsets.push_back(static_cast<unsigned>(sources.size()));
+            biases.push_back(m_biases[node_id - n]);
+        }
+        for (auto i = 0u; i < this->get_m(); ++i) {
+            outputs.push_back(reg[x[x.size() - this->get_m() + i]]);
+        }
+        return frozen_ann(n, std::move(kernels), std::move(offsets), std::move(sources), std::move(weights),
+                          std::move(biases), std::move(outputs));
+    }
+
+    /// Checks if the dCGP-ANN is layered
+    /**
+     * A dCGP-ANN is layered when its active nodes, grouped by column, form layers that are only connected to the
+     * previous layer (the inputs for the first one), the outputs being connected to the last layer, as is the case
+     * for feed forward neural networks (or for any dCGP-ANN with levels-back equal to one). When this is the case,
+     * and the layers are dense enough, the loss gradient on a batch is computed via matrix products (a much faster
+     * path).
+     *
+     * @return true if the loss gradient on a batch is computed via matrix products.
+     */
+    bool is_layered() const
+    {
+        return m_layers.size() > 0u;
+    }
+
     /// Overloaded stream operator
     /**
      * Will return a formatted string containing a human readable representation
@@ -771,6 +1075,110 @@ public:
     /*@}*/
 
 private:
+    friend class boost::serialization::access;
+    // Serialization (kernel map and symbols are not stored as they only depend on the expression structure)
+    template <typename Archive>
+    void save(Archive &ar, const unsigned) const
+    {
+        ar << boost::serialization::base_object<expression<double>>(*this);
+        ar << m_weights;
+        ar << m_biases;
+        ar << static_cast<unsigned>(m_optimizer);
+        ar << m_beta1;
+        ar << m_beta2;
+        ar << m_eps;
+        ar << m_weights_state;
+        ar << m_biases_state;
+        ar << static_cast<unsigned>(m_precision);
+    }
+    template <typename Archive>
+    void load(Archive &ar, const unsigned)
+    {
+        ar >> boost::serialization::base_object<expression<double>>(*this);
+        std::vector<double> weights, biases;
+        ar >> weights;
+        ar >> biases;
+        unsigned n_connections
+            = std::accumulate(this->get_arity().begin(), this->get_arity().end(), 0u) * this->get_r();
+        if (weights.size() != n_connections || biases.size() != this->get_r() * this->get_c()) {
+            throw std::invalid_argument("The deserialized weights or biases have the wrong dimension");
+        }
+        unsigned optimizer;
+        double beta1, beta2, eps;
+        optimizer_state weights_state, biases_state;
+        ar >> optimizer;
+        ar >> beta1;
+        ar >> beta2;
+        ar >> eps;
+        ar >> weights_state;
+        ar >> biases_state;
+        if (optimizer > static_cast<unsigned>(optimizer_type::ADAM) || !weights_state.has_size(weights.size())
+            || !biases_state.has_size(biases.size())) {
+            throw std::invalid_argument("The deserialized optimizer is invalid");
+        }
+        unsigned precision;
+        ar >> precision;
+        if (precision > static_cast<unsigned>(precision_type::MIXED)) {
+            throw std::invalid_argument("The deserialized precision is invalid");
+        }
+        init_kernels_and_symbols();
+        m_weights = weights;
+        m_biases = biases;
+        m_optimizer = static_cast<optimizer_type>(optimizer);
+        m_beta1 = beta1;
+        m_beta2 = beta2;
+        m_eps = eps;
+        m_weights_state = weights_state;
+        m_biases_state = biases_state;
+        m_precision = static_cast<precision_type>(precision);
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    // Checks that the kernels are valid for a dCGP-ANN and initializes the kernel map as well as the symbols
+    // used for weights and biases. It is called upon construction and deserialization.
+    void init_kernels_and_symbols()
+    {
+        const auto &f = this->get_f();
+        // Sanity checks
+        for (const auto &ker : f) {
+            if (ker.get_name() != "tanh" && ker.get_name() != "sig" && ker.get_name() != "ReLu"
+                && ker.get_name() != "ELU" && ker.get_name() != "ISRU" && ker.get_name() != "sum") {
+                throw std::invalid_argument(
+                    "Only tanh, sig, ReLu, ELU, ISRU and sum Kernels are valid for dCGP-ANN expressions");
+            }
+        }
+        // Initialize the kernel map
+        m_kernel_map.resize(f.size());
+        for (decltype(f.size()) i = 0u; i < f.size(); ++i) {
+            if (f[i].get_name() == "sig") {
+                m_kernel_map[i] = kernel_type::SIG;
+            } else if (f[i].get_name() == "tanh") {
+                m_kernel_map[i] = kernel_type::TANH;
+            } else if (f[i].get_name() == "ReLu") {
+                m_kernel_map[i] = kernel_type::RELU;
+            } else if (f[i].get_name() == "ELU") {
+                m_kernel_map[i] = kernel_type::ELU;
+            } else if (f[i].get_name() == "ISRU") {
+                m_kernel_map[i] = kernel_type::ISRU;
+            } else if (f[i].get_name() == "sum") {
+                m_kernel_map[i] = kernel_type::SUM;
+            }
+        }
+        // Filling in the symbols for the weights and biases
+        m_weights_symbols.clear();
+        m_biases_symbols.clear();
+        auto n = this->get_n();
+        auto rc = this->get_r() * this->get_c();
+        for (auto node_id = n; node_id < rc + n; ++node_id) {
+            for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
+                m_weights_symbols.push_back("w" + std::to_string(node_id) + "_" + std::to_string(j));
+            }
+        }
+        for (auto node_id = n; node_id < rc + n; ++node_id) {
+            m_biases_symbols.push_back("b" + std::to_string(node_id));
+        }
+    }
+
     // For numeric computations
     double kernel_call(std::vector<double> &function_in, unsigned idx, unsigned arity, unsigned weight_idx,
                        unsigned bias_idx) const
@@ -786,6 +1194,26 @@ private:
         return this->get_f()[this->get()[idx]](function_in);
     }
 
+    // The kernel inputs are the weighted connections plus the bias on the first one (used by the base class
+    // gradient)
+    void kernel_inputs(unsigned node_id, std::vector<double> &function_in, std::vector<double> &d_in) const
+    {
+        unsigned w_idx = this->get_gene_idx()[node_id] - (node_id - this->get_n());
+        d_in.resize(function_in.size());
+        for (auto j = 0u; j < function_in.size(); ++j) {
+            function_in[j] = function_in[j] * m_weights[w_idx + j];
+            d_in[j] = m_weights[w_idx + j];
+        }
+        function_in[0] += m_biases[node_id - this->get_n()];
+    }
+
+    std::string kernel_symbol(unsigned node_id, std::vector<std::string> &function_in) const
+    {
+        unsigned g_idx = this->get_gene_idx()[node_id];
+        return kernel_call(function_in, g_idx, this->_get_arity(node_id), g_idx - (node_id - this->get_n()),
+                           node_id - this->get_n());
+    }
+
     // For the symbolic expression
     std::string kernel_call(std::vector<std::string> &function_in, unsigned idx, unsigned arity, unsigned weight_idx,
                             unsigned bias_idx) const
@@ -876,8 +1304,10 @@ private:
                         d_node[node_id] = (node[node_id] > 0.) ? 1. : node[node_id] + 1.;
                         break;
                     case kernel_type::ISRU: {
+                        // kernel_call left the weighted inputs and the bias in function_in
                         auto cumin = std::accumulate(function_in.begin(), function_in.end(), 0.);
-                        d_node[node_id] = node[node_id] * node[node_id] * node[node_id] / cumin / cumin / cumin;
+                        auto tmp = 1. + cumin * cumin;
+                        d_node[node_id] = 1. / (tmp * std::sqrt(tmp));
                         break;
                     }
                 }
@@ -885,33 +1315,514 @@ private:
         }
     }
 
-    // This overrides the base class update_data_structures and updates also the m_connected (as well as
-    // m_active_nodes and genes). It is called upon construction and each time active genes are changed.
+    // This overrides the base class update_data_structures and updates also the connectivity used in the backward
+    // pass (as well as m_active_nodes and genes). It is called upon construction and each time active genes are
+    // changed.
     void update_data_structures()
     {
         expression<double>::update_data_structures();
-        m_connected.clear();
-        m_connected.resize(this->get_n() + this->get_m() + this->get_r() * this->get_c());
+        update_connectivity();
+        // We store the indexes of the active weights and biases, the only ones with a non null gradient
+        m_active_weights_idx.clear();
+        m_active_biases_idx.clear();
         for (auto node_id : this->get_active_nodes()) {
-            if (node_id >= this->get_n()) { // not for input nodes
-                // start in the chromosome of the genes expressing the node_id connections
-                unsigned idx = this->get_gene_idx()[node_id] + 1u;
-                // start in the weight vector of the genes expressing the node_id connections
-                unsigned w_idx = (idx - 1u) - (node_id - this->get_n());
-                // loop over the genes representing connections
+            if (node_id < this->get_n()) continue;
+            unsigned w_idx = this->get_gene_idx()[node_id] - (node_id - this->get_n());
+            for (auto i = 0u; i < this->_get_arity(node_id); ++i) {
+                m_active_weights_idx.push_back(w_idx + i);
+            }
+            m_active_biases_idx.push_back(node_id - this->get_n());
+        }
+        // The optimizer state of reconnected weights (and of the biases of nodes with a new kernel) is reset
+        const auto &x = this->get();
+        if (m_last_x.size() == x.size()) {
+            auto n = this->get_n();
+            for (auto node_id = n; node_id < n + this->get_r() * this->get_c(); ++node_id) {
+                unsigned g_idx = this->get_gene_idx()[node_id];
+                unsigned w_idx = g_idx - (node_id - n);
+                if (x[g_idx] != m_last_x[g_idx]) {
+                    m_biases_state.reset_one(node_id - n);
+                }
                 for (auto i = 0u; i < this->_get_arity(node_id); ++i) {
-                    if (this->is_active(this->get()[idx + i])) {
-                        m_connected[this->get()[idx + i]].push_back({node_id, w_idx + i});
+                    if (x[g_idx + 1u + i] != m_last_x[g_idx + 1u + i]) {
+                        m_weights_state.reset_one(w_idx + i);
                     }
                 }
             }
         }
-        // We now add the output nodes with ids starting from n + r * c. In this case the weight is not
-        // relevant, hence we use the arbitrary value 0u as index in the weight vector.
+        m_last_x = x;
+        update_layers();
+    }
+
+    // Builds the compressed sparse row (CSR) connectivity: for each node the nodes (and weights) it feeds into,
+    // followed by the outputs it is connected to. Rows are filled in two passes (counting, then filling), so that
+    // edges appear in the order of the active nodes.
+    void update_connectivity()
+    {
+        auto n = this->get_n();
+        auto n_nodes = n + this->get_r() * this->get_c();
+        const auto &x = this->get();
+        // Counting the edges of each row: m_con_offsets[node_id + 1] will contain the number of edges to nodes
+        // and m_con_out_begin[node_id] the number of edges to outputs.
+        m_con_offsets.assign(n_nodes + 1u, 0u);
+        m_con_out_begin.assign(n_nodes, 0u);
+        for (auto node_id : this->get_active_nodes()) {
+            if (node_id < n) continue;
+            unsigned idx = this->get_gene_idx()[node_id] + 1u;
+            for (auto i = 0u; i < this->_get_arity(node_id); ++i) {
+                ++m_con_offsets[x[idx + i] + 1u];
+            }
+        }
+        for (auto i = 0u; i < this->get_m(); ++i) {
+            ++m_con_out_begin[x[x.size() - this->get_m() + i]];
+        }
+        // Prefix sums: the row of node_id spans [m_con_offsets[node_id], m_con_offsets[node_id + 1]) its edges to
+        // outputs starting at m_con_out_begin[node_id]
+        for (decltype(n_nodes) node_id = 0u; node_id < n_nodes; ++node_id) {
+            auto n_out = m_con_out_begin[node_id];
+            m_con_out_begin[node_id] = m_con_offsets[node_id] + m_con_offsets[node_id + 1u];
+            m_con_offsets[node_id + 1u] = m_con_out_begin[node_id] + n_out;
+        }
+        m_con_targets.resize(m_con_offsets[n_nodes]);
+        m_con_weights.resize(m_con_offsets[n_nodes]);
+        // Filling the rows (next[node_id] is the next free edge to a node in the row of node_id)
+        std::vector<unsigned> next(m_con_offsets.begin(), m_con_offsets.end() - 1);
+        for (auto node_id : this->get_active_nodes()) {
+            if (node_id < n) continue;
+            // start in the chromosome of the genes expressing the node_id connections
+            unsigned idx = this->get_gene_idx()[node_id] + 1u;
+            // start in the weight vector of the genes expressing the node_id connections
+            unsigned w_idx = (idx - 1u) - (node_id - n);
+            for (auto i = 0u; i < this->_get_arity(node_id); ++i) {
+                auto k = next[x[idx + i]]++;
+                m_con_targets[k] = node_id;
+                m_con_weights[k] = w_idx + i;
+            }
+        }
+        // The edges to outputs store the output index (the weight being irrelevant)
+        std::copy(m_con_out_begin.begin(), m_con_out_begin.end(), next.begin());
         for (auto i = 0u; i < this->get_m(); ++i) {
-            auto virtual_idx = this->get_n() + this->get_r() * this->get_c() + i;
-            auto node_idx = this->get()[this->get().size() - this->get_m() + i];
-            m_connected[node_idx].push_back({virtual_idx, 0u});
+            auto k = next[x[x.size() - this->get_m() + i]]++;
+            m_con_targets[k] = i;
+            m_con_weights[k] = 0u;
+        }
+    }
+
+    // Detects whether the active nodes are arranged in dense layers (see is_layered()) and, if so, fills m_layers and
+    // m_layer_pos. Otherwise m_layers is left empty.
+    void update_layers()
+    {
+        auto n = this->get_n();
+        auto n_nodes = n + this->get_r() * this->get_c();
+        m_layers.clear();
+        m_layer_pos.assign(n_nodes, 0u);
+        // layer_id is zero for the inputs and k + 1 for the nodes in m_layers[k]
+        std::vector<unsigned> layer_id(n_nodes, 0u);
+        for (auto i = 0u; i < n; ++i) {
+            m_layer_pos[i] = i;
+        }
+        unsigned last_col = 0u;
+        for (auto node_id : this->get_active_nodes()) {
+            if (node_id < n) continue;
+            auto col = (node_id - n) / this->get_r();
+            if (m_layers.size() == 0u || col != last_col) {
+                m_layers.emplace_back();
+                last_col = col;
+            }
+            m_layer_pos[node_id] = static_cast<unsigned>(m_layers.back().size());
+            layer_id[node_id] = static_cast<unsigned>(m_layers.size());
+            m_layers.back().push_back(node_id);
+        }
+        // Each layer must only be connected to the previous one
+        unsigned long n_connections = 0u, dense_size = 0u;
+        for (decltype(m_layers.size()) k = 0u; k < m_layers.size(); ++k) {
+            for (auto node_id : m_layers[k]) {
+                auto g_idx = this->get_gene_idx()[node_id];
+                for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
+                    if (layer_id[this->get()[g_idx + 1u + j]] != k) {
+                        m_layers.clear();
+                        return;
+                    }
+                }
+                n_connections += this->_get_arity(node_id);
+            }
+            dense_size += m_layers[k].size() * (k == 0u ? n : m_layers[k - 1u].size());
+        }
+        // And the outputs to the last layer
+        for (auto i = 0u; i < this->get_m(); ++i) {
+            if (layer_id[this->get()[this->get().size() - this->get_m() + i]] != m_layers.size()) {
+                m_layers.clear();
+                return;
+            }
+        }
+        // Too sparse layers would waste most of the matrix products on zeros
+        if (8u * n_connections < dense_size) {
+            m_layers.clear();
+        }
+    }
+
+    // Cumulates the loss and its gradient on a batch, with the precision selected by set_precision()
+    void d_loss_chunk(double &value, std::vector<double> &gweights, std::vector<double> &gbiases,
+                      detail::row_iterator dfirst, detail::row_iterator dlast, detail::row_iterator lfirst,
+                      const expression<double>::loss_type loss_e) const
+    {
+        switch (m_precision) {
+            case precision_type::SINGLE:
+                d_loss_chunk<float, float>(value, gweights, gbiases, dfirst, dlast, lfirst, loss_e);
+                break;
+            case precision_type::MIXED:
+                d_loss_chunk<float, double>(value, gweights, gbiases, dfirst, dlast, lfirst, loss_e);
+                break;
+            default:
+                d_loss_chunk<double, double>(value, gweights, gbiases, dfirst, dlast, lfirst, loss_e);
+                break;
+        }
+    }
+
+    // Cumulates the loss and its gradient on a batch computing node values and derivatives in the type F and the
+    // sums over the batch (loss and gradient) in the type A
+    template <typename F, typename A>
+    void d_loss_chunk(double &value, std::vector<double> &gweights, std::vector<double> &gbiases,
+                      detail::row_iterator dfirst, detail::row_iterator dlast, detail::row_iterator lfirst,
+                      const expression<double>::loss_type loss_e) const
+    {
+        if (is_layered()) {
+            // The loss and its gradient get computed via matrix products on the whole batch
+            d_loss_layered<F, A>(value, gweights, gbiases, dfirst, dlast, lfirst, loss_e);
+        } else {
+            d_loss_batch<F, A>(value, gweights, gbiases, dfirst, dlast, lfirst, loss_e);
+        }
+    }
+
+    // Cumulates the loss and its gradient on a batch. The active nodes are visited once per batch: node activations and
+    // derivatives are stored contiguously for all points of the batch (node major) and kernels are applied across the
+    // batch in tight loops. The floating point operations are the same, and in the same order, as in the single point
+    // d_loss, so that in double precision the results are identical. Node values and derivatives are of type F, the
+    // loss and gradient sums over the batch of type A.
+    template <typename F, typename A>
+    void d_loss_batch(double &value, std::vector<double> &gweights, std::vector<double> &gbiases,
+                      detail::row_iterator dfirst, detail::row_iterator dlast, detail::row_iterator lfirst,
+                      const expression<double>::loss_type loss_e) const
+    {
+        const auto n = this->get_n();
+        const auto m = this->get_m();
+        const auto n_nodes = n + this->get_r() * this->get_c();
+        const auto B = static_cast<unsigned>(dlast - dfirst);
+        const auto &x = this->get();
+        const auto &active = this->get_active_nodes();
+        // Position of each active node in the batch arrays
+        std::vector<unsigned> pos(n_nodes, 0u);
+        for (decltype(active.size()) i = 0u; i < active.size(); ++i) {
+            pos[active[i]] = static_cast<unsigned>(i);
+        }
+        // node[pos[node_id] * B + b] is the value of node_id for the point b of the batch, d_node its derivative
+        std::vector<F> node(active.size() * B), d_node(active.size() * B);
+        // ------------------------------------------ Forward pass ----------------------------------------------------
+        for (auto b = 0u; b < B; ++b) {
+            const auto &point = *(dfirst + b);
+            const auto &prediction = *(lfirst + b);
+            if (point.size() != n) {
+                throw std::invalid_argument("When computing the loss the point dimension (input) seemed wrong, it was: "
+                                            + std::to_string(point.size()) + " while I expected: " + std::to_string(n));
+            }
+            if (prediction.size() != m) {
+                throw std::invalid_argument(
+                    "When computing the loss the prediction dimension (output) seemed wrong, it was: "
+                    + std::to_string(prediction.size()) + " while I expected: " + std::to_string(m));
+            }
+        }
+        for (auto node_id : active) {
+            F *out = node.data() + pos[node_id] * B;
+            if (node_id < n) {
+                for (auto b = 0u; b < B; ++b) {
+                    out[b] = static_cast<F>((*(dfirst + b))[node_id]);
+                }
+                continue;
+            }
+            F *d_out = d_node.data() + pos[node_id] * B;
+            unsigned arity = this->_get_arity(node_id);
+            unsigned g_idx = this->get_gene_idx()[node_id];
+            unsigned w_idx = g_idx - (node_id - n);
+            // The weighted sum of the inputs plus the bias (stored in d_out, as in kernel_call)
+            const F *in = node.data() + pos[x[g_idx + 1u]] * B;
+            const F w0 = static_cast<F>(m_weights[w_idx]), bias = static_cast<F>(m_biases[node_id - n]);
+            for (auto b = 0u; b < B; ++b) {
+                d_out[b] = in[b] * w0 + bias;
+            }
+            for (auto j = 1u; j < arity; ++j) {
+                in = node.data() + pos[x[g_idx + 1u + j]] * B;
+                const F w = static_cast<F>(m_weights[w_idx + j]);
+                for (auto b = 0u; b < B; ++b) {
+                    d_out[b] += in[b] * w;
+                }
+            }
+            // The kernel and its derivative
+            switch (m_kernel_map[x[g_idx]]) {
+                case kernel_type::SIG:
+                    for (auto b = 0u; b < B; ++b) {
+                        out[b] = F(1) / (F(1) + std::exp(-d_out[b]));
+                        d_out[b] = out[b] * (F(1) - out[b]);
+                    }
+                    break;
+                case kernel_type::TANH:
+                    for (auto b = 0u; b < B; ++b) {
+                        out[b] = std::tanh(d_out[b]);
+                        d_out[b] = F(1) - out[b] * out[b];
+                    }
+                    break;
+                case kernel_type::SUM:
+                    for (auto b = 0u; b < B; ++b) {
+                        out[b] = d_out[b];
+                        d_out[b] = F(1);
+                    }
+                    break;
+                case kernel_type::RELU:
+                    for (auto b = 0u; b < B; ++b) {
+                        out[b] = (d_out[b] < F(0)) ? F(0) : d_out[b];
+                        d_out[b] = (out[b] > F(0)) ? F(1) : F(0);
+                    }
+                    break;
+                case kernel_type::ELU:
+                    for (auto b = 0u; b < B; ++b) {
+                        out[b] = (d_out[b] < F(0)) ? std::exp(d_out[b]) - F(1) : d_out[b];
+                        d_out[b] = (out[b] > F(0)) ? F(1) : out[b] + F(1);
+                    }
+                    break;
+                case kernel_type::ISRU:
+                    for (auto b = 0u; b < B; ++b) {
+                        auto tmp = F(1) + d_out[b] * d_out[b];
+                        out[b] = d_out[b] / std::sqrt(tmp);
+                        d_out[b] = F(1) / (tmp * std::sqrt(tmp));
+                    }
+                    break;
+            }
+        }
+        // We compute the loss and its derivatives w.r.t. the outputs (d_out[i * B + b])
+        std::vector<F> d_out(m * B);
+        std::vector<A> ps(m);
+        A loss = static_cast<A>(value);
+        for (auto b = 0u; b < B; ++b) {
+            const auto &prediction = *(lfirst + b);
+            switch (loss_e) {
+                // Mean Square Error
+                case expression<double>::loss_type::MSE: {
+                    auto sample_dim = static_cast<A>(m);
+                    for (auto i = 0u; i < m; ++i) {
+                        auto dummy = (static_cast<A>(node[pos[x[x.size() - m + i]] * B + b])
+                                      - static_cast<A>(prediction[i]));
+                        d_out[i * B + b] = static_cast<F>(A(2) * dummy / sample_dim);
+                        loss += dummy * dummy / sample_dim;
+                    }
+                    break;
+                }
+                // Cross Entropy
+                case expression<double>::loss_type::CE: {
+                    for (auto i = 0u; i < m; ++i) {
+                        ps[i] = static_cast<A>(node[pos[x[x.size() - m + i]] * B + b]);
+                    }
+                    auto max = *std::max_element(ps.begin(), ps.end());
+                    std::transform(ps.begin(), ps.end(), ps.begin(), [max](A a) { return std::exp(a - max); });
+                    A cumsum = std::accumulate(ps.begin(), ps.end(), A(0));
+                    std::transform(ps.begin(), ps.end(), ps.begin(), [cumsum](A a) { return a / cumsum; });
+                    for (auto i = 0u; i < m; ++i) {
+                        d_out[i * B + b] = static_cast<F>(ps[i] - static_cast<A>(prediction[i]));
+                    }
+                    std::transform(ps.begin(), ps.end(), prediction.begin(), ps.begin(),
+                                   [](A p, double y) { return std::log(p) * static_cast<A>(y); });
+                    loss += -std::accumulate(ps.begin(), ps.end(), A(0));
+                    break;
+                }
+            }
+        }
+        value = static_cast<double>(loss);
+        // ------------------------------------------ Backward pass ---------------------------------------------------
+        std::vector<F> cum(B);
+        for (auto it = active.rbegin(); it != active.rend(); ++it) {
+            auto node_id = *it;
+            if (node_id < n) continue;
+            F *delta = d_node.data() + pos[node_id] * B;
+            unsigned g_idx = this->get_gene_idx()[node_id];
+            unsigned w_idx = g_idx - (node_id - n);
+            std::fill(cum.begin(), cum.end(), F(0));
+            for (auto k = m_con_offsets[node_id]; k < m_con_out_begin[node_id]; ++k) {
+                const F w = static_cast<F>(m_weights[m_con_weights[k]]);
+                const F *d_next = d_node.data() + pos[m_con_targets[k]] * B;
+                for (auto b = 0u; b < B; ++b) {
+                    cum[b] += w * d_next[b];
+                }
+            }
+            for (auto k = m_con_out_begin[node_id]; k < m_con_offsets[node_id + 1u]; ++k) {
+                const F *d_next = d_out.data() + m_con_targets[k] * B;
+                for (auto b = 0u; b < B; ++b) {
+                    cum[b] += d_next[b];
+                }
+            }
+            for (auto b = 0u; b < B; ++b) {
+                delta[b] *= cum[b];
+            }
+            // Gradients for weights and biases (the products of two floats are exact in double precision)
+            for (auto i = 0u; i < this->_get_arity(node_id); ++i) {
+                const F *in = node.data() + pos[x[g_idx + 1u + i]] * B;
+                A gw = static_cast<A>(gweights[w_idx + i]);
+                for (auto b = 0u; b < B; ++b) {
+                    gw += static_cast<A>(delta[b]) * static_cast<A>(in[b]);
+                }
+                gweights[w_idx + i] = static_cast<double>(gw);
+            }
+            A gb = static_cast<A>(gbiases[node_id - n]);
+            for (auto b = 0u; b < B; ++b) {
+                gb += static_cast<A>(delta[b]);
+            }
+            gbiases[node_id - n] = static_cast<double>(gb);
+        }
+    }
+
+    // Cumulates the loss and its gradient on a batch, computing the forward and backward passes layer by layer as
+    // dense matrix products (rows are the nodes of a layer, columns the points of the batch). Assumes is_layered().
+    // Node values and derivatives are of type F, the loss and gradient sums over the batch of type A.
+    template <typename F, typename A>
+    void d_loss_layered(double &value, std::vector<double> &gweights, std::vector<double> &gbiases,
+                        detail::row_iterator dfirst, detail::row_iterator dlast, detail::row_iterator lfirst,
+                        const expression<double>::loss_type loss_e) const
+    {
+        const auto n = this->get_n();
+        const auto m = this->get_m();
+        const auto B = static_cast<Eigen::Index>(dlast - dfirst);
+        const auto L = m_layers.size();
+        const auto &x = this->get();
+        using matrix_f = Eigen::Matrix<F, Eigen::Dynamic, Eigen::Dynamic>;
+        using vector_f = Eigen::Matrix<F, Eigen::Dynamic, 1>;
+        // ------------------------------------------ Forward pass ----------------------------------------------------
+        // node[k] contains the layer k outputs (node[0] the inputs) and d_node[k] the activation function derivatives
+        std::vector<matrix_f> node(L + 1u), d_node(L), W(L);
+        node[0].resize(n, B);
+        for (Eigen::Index b = 0; b < B; ++b) {
+            const auto &point = *(dfirst + b);
+            const auto &prediction = *(lfirst + b);
+            if (point.size() != n) {
+                throw std::invalid_argument("When computing the loss the point dimension (input) seemed wrong, it was: "
+                                            + std::to_string(point.size()) + " while I expected: " + std::to_string(n));
+            }
+            if (prediction.size() != m) {
+                throw std::invalid_argument(
+                    "When computing the loss the prediction dimension (output) seemed wrong, it was: "
+                    + std::to_string(prediction.size()) + " while I expected: " + std::to_string(m));
+            }
+            for (auto i = 0u; i < n; ++i) {
+                node[0](i, b) = static_cast<F>(point[i]);
+            }
+        }
+        for (decltype(m_layers.size()) k = 0u; k < L; ++k) {
+            const auto &layer = m_layers[k];
+            const auto rows = static_cast<Eigen::Index>(layer.size());
+            // The dense weight matrix of the layer (repeated connections are summed) and the biases
+            W[k] = matrix_f::Zero(rows, node[k].rows());
+            vector_f bias(rows);
+            for (Eigen::Index i = 0; i < rows; ++i) {
+                auto node_id = layer[static_cast<unsigned>(i)];
+                auto g_idx = this->get_gene_idx()[node_id];
+                auto w_idx = g_idx - (node_id - n);
+                for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
+                    W[k](i, m_layer_pos[x[g_idx + 1u + j]]) += static_cast<F>(m_weights[w_idx + j]);
+                }
+                bias(i) = static_cast<F>(m_biases[node_id - n]);
+            }
+            matrix_f z = W[k] * node[k];
+            z.colwise() += bias;
+            node[k + 1u].resize(rows, B);
+            d_node[k].resize(rows, B);
+            for (Eigen::Index i = 0; i < rows; ++i) {
+                auto zi = z.row(i).array();
+                auto ni = node[k + 1u].row(i).array();
+                auto di = d_node[k].row(i).array();
+                switch (m_kernel_map[x[this->get_gene_idx()[layer[static_cast<unsigned>(i)]]]]) {
+                    case kernel_type::SIG:
+                        ni = F(1) / (F(1) + (-zi).exp());
+                        di = ni * (F(1) - ni);
+                        break;
+                    case kernel_type::TANH:
+                        ni = zi.tanh();
+                        di = F(1) - ni * ni;
+                        break;
+                    case kernel_type::SUM:
+                        ni = zi;
+                        di.setConstant(F(1));
+                        break;
+                    case kernel_type::RELU:
+                        ni = (zi < F(0)).select(F(0), zi);
+                        di = (ni > F(0)).template cast<F>();
+                        break;
+                    case kernel_type::ELU:
+                        ni = (zi < F(0)).select(zi.exp() - F(1), zi);
+                        di = (ni > F(0)).select(F(1), ni + F(1));
+                        break;
+                    case kernel_type::ISRU:
+                        ni = zi / (F(1) + zi * zi).sqrt();
+                        di = (F(1) + zi * zi).rsqrt().cube();
+                        break;
+                }
+            }
+        }
+        // We compute the loss and its derivative w.r.t. the last layer outputs
+        matrix_f G = matrix_f::Zero(node[L].rows(), B);
+        std::vector<unsigned> out_pos(m);
+        for (auto i = 0u; i < m; ++i) {
+            out_pos[i] = m_layer_pos[x[x.size() - m + i]];
+        }
+        std::vector<A> ps(m);
+        A loss = static_cast<A>(value);
+        for (Eigen::Index b = 0; b < B; ++b) {
+            const auto &prediction = *(lfirst + b);
+            switch (loss_e) {
+                // Mean Square Error
+                case expression<double>::loss_type::MSE: {
+                    auto sample_dim = static_cast<A>(m);
+                    for (auto i = 0u; i < m; ++i) {
+                        auto dummy = static_cast<A>(node[L](out_pos[i], b)) - static_cast<A>(prediction[i]);
+                        G(out_pos[i], b) += static_cast<F>(A(2) * dummy / sample_dim);
+                        loss += dummy * dummy / sample_dim;
+                    }
+                    break;
+                }
+                // Cross Entropy
+                case expression<double>::loss_type::CE: {
+                    for (auto i = 0u; i < m; ++i) {
+                        ps[i] = static_cast<A>(node[L](out_pos[i], b));
+                    }
+                    auto max = *std::max_element(ps.begin(), ps.end());
+                    std::transform(ps.begin(), ps.end(), ps.begin(), [max](A a) { return std::exp(a - max); });
+                    A cumsum = std::accumulate(ps.begin(), ps.end(), A(0));
+                    for (auto i = 0u; i < m; ++i) {
+                        ps[i] /= cumsum;
+                        G(out_pos[i], b) += static_cast<F>(ps[i] - static_cast<A>(prediction[i]));
+                        loss -= std::log(ps[i]) * static_cast<A>(prediction[i]);
+                    }
+                    break;
+                }
+            }
+        }
+        value = static_cast<double>(loss);
+        // ------------------------------------------ Backward pass ---------------------------------------------------
+        for (auto k = L; k-- > 0u;) {
+            const auto &layer = m_layers[k];
+            matrix_f delta = G.cwiseProduct(d_node[k]);
+            // The sums over the batch are made in the type A
+            Eigen::Matrix<A, Eigen::Dynamic, Eigen::Dynamic> gW
+                = delta.template cast<A>() * node[k].transpose().template cast<A>();
+            Eigen::Matrix<A, Eigen::Dynamic, 1> gb = delta.template cast<A>().rowwise().sum();
+            // We scatter back the dense gradients into the weights and biases gradients
+            for (decltype(layer.size()) i = 0u; i < layer.size(); ++i) {
+                auto node_id = layer[i];
+                auto g_idx = this->get_gene_idx()[node_id];
+                auto w_idx = g_idx - (node_id - n);
+                for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
+                    gweights[w_idx + j] += static_cast<double>(gW(static_cast<Eigen::Index>(i), m_layer_pos[x[g_idx + 1u + j]]));
+                }
+                gbiases[node_id - n] += static_cast<double>(gb(static_cast<Eigen::Index>(i)));
+            }
+            if (k > 0u) {
+                G = W[k].transpose() * delta;
+            }
         }
     }
 
@@ -930,26 +1841,64 @@ private:
      * @return the loss before the weight update
      *
      */
-    double update_weights(typename std::vector<std::vector<double>>::const_iterator dfirst,
-                          typename std::vector<std::vector<double>>::const_iterator dlast,
-                          typename std::vector<std::vector<double>>::const_iterator lfirst, double lr,
-                          expression<double>::loss_type loss_e, unsigned parallel)
+    double update_weights(detail::row_iterator dfirst, detail::row_iterator dlast, detail::row_iterator lfirst,
+                          double lr, expression<double>::loss_type loss_e, unsigned parallel)
     {
         auto err = d_loss(dfirst, dlast, lfirst, loss_e, parallel);
 
-        // We now update the weights with the stochastic gradient descent update rule
-        std::transform(m_weights.begin(), m_weights.end(), std::get<1>(err).begin(), m_weights.begin(),
-                       [&lr](double a, double b) { return a - lr * b; });
-        std::transform(m_biases.begin(), m_biases.end(), std::get<2>(err).begin(), m_biases.begin(),
-                       [&lr](double a, double b) { return a - lr * b; });
+        // We now update the active weights with the selected optimizer (the others have a null gradient)
+        optimizer_step(m_weights, std::get<1>(err), m_active_weights_idx, m_weights_state, lr);
+        optimizer_step(m_biases, std::get<2>(err), m_active_biases_idx, m_biases_state, lr);
         return std::get<0>(err);
     }
 
+    // Updates the parameters in idx with the selected optimizer, given their gradient
+    void optimizer_step(std::vector<double> &params, const std::vector<double> &grad, const std::vector<unsigned> &idx,
+                        optimizer_state &state, double lr)
+    {
+        const double b1 = m_beta1, b2 = m_beta2, eps = m_eps;
+        double *m1 = state.m_m1.data(), *m2 = state.m_m2.data();
+        unsigned *t = state.m_t.data();
+        switch (m_optimizer) {
+            case optimizer_type::SGD:
+                for (auto i : idx) {
+                    params[i] -= lr * grad[i];
+                }
+                break;
+            case optimizer_type::MOMENTUM:
+                for (auto i : idx) {
+                    m1[i] = b1 * m1[i] + grad[i];
+                    params[i] -= lr * m1[i];
+                }
+                break;
+            case optimizer_type::NESTEROV:
+                for (auto i : idx) {
+                    m1[i] = b1 * m1[i] + grad[i];
+                    params[i] -= lr * (grad[i] + b1 * m1[i]);
+                }
+                break;
+            case optimizer_type::RMSPROP:
+                for (auto i : idx) {
+                    m2[i] = b2 * m2[i] + (1. - b2) * grad[i] * grad[i];
+                    params[i] -= lr * grad[i] / (std::sqrt(m2[i]) + eps);
+                }
+                break;
+            case optimizer_type::ADAM:
+                for (auto i : idx) {
+                    ++t[i];
+                    m1[i] = b1 * m1[i] + (1. - b1) * grad[i];
+                    m2[i] = b2 * m2[i] + (1. - b2) * grad[i] * grad[i];
+                    const double m_hat = m1[i] / (1. - std::pow(b1, t[i]));
+                    const double v_hat = m2[i] / (1. - std::pow(b2, t[i]));
+                    params[i] -= lr * m_hat / (std::sqrt(v_hat) + eps);
+                }
+                break;
+        }
+    }
+
     std::tuple<double, std::vector<double>, std::vector<double>>
-    d_loss(typename std::vector<std::vector<double>>::const_iterator dfirst,
-           typename std::vector<std::vector<double>>::const_iterator dlast,
-           typename std::vector<std::vector<double>>::const_iterator lfirst, expression<double>::loss_type loss_e,
-           unsigned parallel) const
+    d_loss(detail::row_iterator dfirst, detail::row_iterator dlast, detail::row_iterator lfirst,
+           expression<double>::loss_type loss_e, unsigned parallel) const
     {
         // Batch dimension
         const unsigned batch_size = static_cast<unsigned>(dlast - dfirst);
@@ -964,36 +1913,57 @@ private:
                                             + " and cannot be divided into " + std::to_string(parallel) + "parts.");
             }
             unsigned inner_batch_size = batch_size / parallel;
-            // The mutex that will protect read write access to value, gweights, gbiases.
-            tbb::spin_mutex mutex_weights_updates;
+            // Each thread cumulates the loss and its gradient in its own buffers, allocated once and reused
+            // for all the chunks it processes.
+            using grad_buffer = std::tuple<double, std::vector<double>, std::vector<double>>;
+            tbb::enumerable_thread_specific<grad_buffer> buffers([this]() {
+                return grad_buffer(0., std::vector<double>(m_weights.size(), 0.),
+                                   std::vector<double>(m_biases.size(), 0.));
+            });
             // This loops over all points, predictions in the mini-batch
             tbb::parallel_for(0u, batch_size, inner_batch_size, [&](unsigned i) {
-                double value2 = 0.;
-                std::vector<double> gweights2(m_weights.size(), 0.);
-                std::vector<double> gbiases2(m_biases.size(), 0.);
-                // The loss and its gradient get computed
-                for (auto j = 0u; j < inner_batch_size; ++j) {
-                    d_loss(value2, gweights2, gbiases2, *(dfirst + i + j), *(lfirst + i + j), loss_e);
-                }
-                // We acquire the lock on the mutex
-                tbb::spin_mutex::scoped_lock lock(mutex_weights_updates);
-                // We update the cumulative loss and gradient
-                value += value2;
-                std::transform(gweights.begin(), gweights.end(), gweights2.begin(), gweights.begin(),
-                               [](double a, double b) { return a + b; });
-                std::transform(gbiases.begin(), gbiases.end(), gbiases2.begin(), gbiases.begin(),
-                               [](double a, double b) { return a + b; });
+                auto &buffer = buffers.local();
+                // The loss and its gradient get computed and cumulated in the thread buffers
+                d_loss_chunk(std::get<0>(buffer), std::get<1>(buffer), std::get<2>(buffer), dfirst + i,
+                             dfirst + i + inner_batch_size, lfirst + i, loss_e);
             });
-        } else {
-            for (unsigned i = 0u; i < batch_size; ++i) {
-                // The loss and its gradient get computed and cumulated in value, gweights, gbiases
-                d_loss(value, gweights, gbiases, *(dfirst + i), *(lfirst + i), loss_e);
+            // The thread buffers are summed pairwise in a parallel tree reduction. Only the active weights and
+            // biases are touched, the others having a null gradient.
+            std::vector<grad_buffer *> parts;
+            for (auto &buffer : buffers) {
+                parts.push_back(&buffer);
+            }
+            for (decltype(parts.size()) stride = 1u; stride < parts.size(); stride *= 2u) {
+                auto n_pairs = (parts.size() + 2u * stride - 1u) / (2u * stride);
+                tbb::parallel_for(decltype(n_pairs)(0u), n_pairs, [&](decltype(n_pairs) k) {
+                    auto j = 2u * stride * k + stride;
+                    if (j >= parts.size()) return;
+                    auto &to = *parts[j - stride];
+                    const auto &from = *parts[j];
+                    std::get<0>(to) += std::get<0>(from);
+                    for (auto idx : m_active_weights_idx) {
+                        std::get<1>(to)[idx] += std::get<1>(from)[idx];
+                    }
+                    for (auto idx : m_active_biases_idx) {
+                        std::get<2>(to)[idx] += std::get<2>(from)[idx];
+                    }
+                });
             }
+            if (parts.size() > 0u) {
+                value = std::get<0>(*parts[0]);
+                gweights = std::move(std::get<1>(*parts[0]));
+                gbiases = std::move(std::get<2>(*parts[0]));
+            }
+        } else {
+            // The loss and its gradient get computed on the whole batch and cumulated in value, gweights, gbiases
+            d_loss_chunk(value, gweights, gbiases, dfirst, dlast, lfirst, loss_e);
+        }
+        for (auto idx : m_active_weights_idx) {
+            gweights[idx] /= batch_size;
+        }
+        for (auto idx : m_active_biases_idx) {
+            gbiases[idx] /= batch_size;
         }
-        std::transform(gweights.begin(), gweights.end(), gweights.begin(),
-                       [&batch_size](double a) { return a / batch_size; });
-        std::transform(gbiases.begin(), gbiases.end(), gbiases.begin(),
-                       [&batch_size](double a) { return a / batch_size; });
         value /= batch_size;
         return std::make_tuple(std::move(value), std::move(gweights), std::move(gbiases));
     }
@@ -1005,11 +1975,35 @@ private:
     std::vector<double> m_biases;
     std::vector<std::string> m_biases_symbols;
 
+    // The optimizer used by sgd, its parameters and its state
+    optimizer_type m_optimizer = optimizer_type::SGD;
+    double m_beta1 = 0.9;
+    double m_beta2 = 0.999;
+    double m_eps = 1e-8;
+    optimizer_state m_weights_state;
+    optimizer_state m_biases_state;
+    // The precision of the batch computations
+    precision_type m_precision = precision_type::DOUBLE;
+    // The chromosome at the last update_data_structures() call, to detect reconnections
+    std::vector<unsigned> m_last_x;
+
     // In order to be able to perform backpropagation on the dCGPANN program, we need to add
     // to the usual CGP data structures one that contains for each node the list of nodes
-    // (and weights) it feeds into. We also need to add some virtual nodes (to keep track of output nodes dependencies)
-    // The assigned virtual ids starting from n + r * c
-    std::vector<std::vector<std::pair<unsigned, unsigned>>> m_connected;
+    // (and weights) it feeds into, and the list of outputs it is connected to. These are stored in compressed
+    // sparse row format: the edges of node_id are in [m_con_offsets[node_id], m_con_offsets[node_id + 1]), those
+    // to outputs starting at m_con_out_begin[node_id]. For edges to nodes m_con_targets contains the node id and
+    // m_con_weights the weight index, for edges to outputs m_con_targets contains the output index.
+    std::vector<unsigned> m_con_offsets;
+    std::vector<unsigned> m_con_out_begin;
+    std::vector<unsigned> m_con_targets;
+    std::vector<unsigned> m_con_weights;
+    // The indexes of the active weights and biases (i.e. those of the active nodes)
+    std::vector<unsigned> m_active_weights_idx;
+    std::vector<unsigned> m_active_biases_idx;
+    // When the network is layered (see is_layered()), the node ids of each layer, empty otherwise
+    std::vector<std::vector<unsigned>> m_layers;
+    // The position of each node in its layer (the inputs form the layer preceding the first one)
+    std::vector<unsigned> m_layer_pos;
     // Kernel map (this is here to avoid string comparisons)
     std::vector<kernel_type> m_kernel_map;
 }; // namespace dcgp
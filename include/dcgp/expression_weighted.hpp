@@ -1,17 +1,23 @@
 #ifndef DCGP_EXPRESSION_WEIGHTED_H
 #define DCGP_EXPRESSION_WEIGHTED_H
 
+#include <algorithm>
 #include <audi/audi.hpp>
+#include <cmath>
 #include <initializer_list>
 #include <iostream>
+#include <numeric>
 #include <random>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tbb/tbb.h>
+#include <tuple>
 #include <vector>
 
 #include <dcgp/expression.hpp>
 #include <dcgp/kernel.hpp>
+#include <dcgp/s11n.hpp>
 #include <dcgp/type_traits.hpp>
 
 namespace dcgp
@@ -24,7 +30,7 @@ namespace dcgp
  * value (numerical and symbolical) of the expression and its derivatives, as well
  * as to mutate the expression.
  *
- * @tparam T expression type. Can be double, or a gdual type.
+ * @tparam T expression type. Can be double, a gdual or a dcgp::dual type.
  */
 template <typename T>
 class expression_weighted : public expression<T>
@@ -33,8 +39,12 @@ class expression_weighted : public expression<T>
 private:
     // SFINAE dust
     template <typename U>
-    using functor_enabler = typename std::enable_if<
-        std::is_same<U, double>::value || is_gdual<T>::value || std::is_same<U, std::string>::value, int>::type;
+    using functor_enabler = typename std::enable_if<std::is_same<U, double>::value || is_gdual<T>::value
+                                                        || is_dual<T>::value || std::is_same<U, std::string>::value,
+                                                    int>::type;
+    // Enables the training methods, only available to double expressions
+    template <typename U>
+    using enable_double = typename std::enable_if<std::is_same<U, double>::value, int>::type;
 
 public:
     /// Constructor
@@ -147,6 +157,55 @@ public:
         return retval;
     }
 
+    /// Evaluates the dCGP-weighted expression reusing a workspace
+    /**
+     * This method overrides the base class method. The weighted kernel inputs are formed in place in the workspace
+     * \p ws, which, as the node values, is reused in the following calls.
+     *
+     * @param[in] in std::vector containing the values where the dCGP-weighted expression has to be computed
+     * @param[ws] the workspace (resized as needed)
+     *
+     * @return a reference to the value of the output, stored in \p ws
+     *
+     * @throw std::invalid_argument if the input size is incompatible
+     */
+    const std::vector<T> &evaluate(const std::vector<T> &in, typename expression<T>::workspace &ws) const
+    {
+        if (in.size() != this->get_n()) {
+            throw std::invalid_argument("Input size is incompatible");
+        }
+        ws.node.resize(this->get_r() * this->get_c());
+        ws.retval.resize(this->get_m());
+        for (auto node_id : this->get_active_nodes()) {
+            if (node_id < this->get_n()) {
+                continue;
+            }
+            unsigned arity = this->_get_arity(node_id);
+            // position in the chromosome of the current node
+            unsigned g_idx = this->get_gene_idx()[node_id];
+            // starting position in m_weights of the weights relative to the node
+            unsigned w_idx = g_idx - (node_id - this->get_n());
+            // The weighted inputs are stored before taking their addresses
+            ws.function_in.resize(arity);
+            ws.in_ptr.resize(arity);
+            for (auto j = 0u; j < arity; ++j) {
+                ws.function_in[j] = this->workspace_value(in, ws, this->get()[g_idx + j + 1]);
+                ws.function_in[j] *= m_weights[w_idx + j];
+                ws.in_ptr[j] = &ws.function_in[j];
+            }
+            const auto &f = this->get_f()[this->get()[g_idx]];
+            if (f.has_in_place()) {
+                f.in_place(ws.in_ptr, ws.node[node_id - this->get_n()]);
+            } else {
+                ws.node[node_id - this->get_n()] = f(ws.function_in);
+            }
+        }
+        for (auto i = 0u; i < this->get_m(); ++i) {
+            ws.retval[i] = this->workspace_value(in, ws, this->get()[this->get().size() - this->get_m() + i]);
+        }
+        return ws.retval;
+    }
+
     /// Evaluates the dCGP-weighted expression
     /**
      * This evaluates the dCGP-weighted expression. This method overrides the base class
@@ -310,9 +369,324 @@ public:
         return m_weights;
     }
 
+    /// Cumulates the loss and its gradient (of a single point)
+    /**
+     * Cumulates the loss and its gradient with respect to the weights. The values are cumulated into the inputs.
+     * If called in a loop with many data points will cumulate the total batch values. The gradient is computed
+     * backpropagating the loss derivatives through the active nodes, which requires all active kernels to provide
+     * their partial derivatives (as is the case for the double kernels built by dcgp::kernel_set).
+     *
+     * @param[value] The initial loss
+     * @param[gweights] The initial loss gradient w.r.t. weights
+     * @param[point] The input data (single point)
+     * @param[prediction] The predicted output (single point)
+     * @param[loss_e] The loss type. Must be loss_type::MSE for Mean Square Error (regression) or loss_type::CE for
+     * Cross Entropy (classification)
+     *
+     * @throws std::invalid_argument if the sizes of the inputs are not consistent or if an active kernel does not
+     * provide its derivatives
+     */
+    template <typename U = T, enable_double<U> = 0>
+    void d_loss(double &value, std::vector<double> &gweights, const std::vector<double> &point,
+                const std::vector<double> &prediction, typename expression<double>::loss_type loss_e) const
+    {
+        if (point.size() != this->get_n()) {
+            throw std::invalid_argument("When computing the loss the point dimension (input) seemed wrong, it was: "
+                                        + std::to_string(point.size())
+                                        + " while I expected: " + std::to_string(this->get_n()));
+        }
+        if (prediction.size() != this->get_m()) {
+            throw std::invalid_argument(
+                "When computing the loss the prediction dimension (output) seemed wrong, it was: "
+                + std::to_string(prediction.size()) + " while I expected: " + std::to_string(this->get_m()));
+        }
+        if (gweights.size() != m_weights.size()) {
+            throw std::invalid_argument("The size of the return value gweights is: " + std::to_string(gweights.size())
+                                        + " while I expected: " + std::to_string(m_weights.size()));
+        }
+        backprop_buffers buffers;
+        d_loss_point(value, gweights, point, prediction, loss_e, buffers);
+    }
+
+    /// Evaluates the loss and its gradient (on a batch)
+    /**
+     * Returns the loss and its gradient with respect to the weights.
+     *
+     * @param[points] The input data (a batch).
+     * @param[labels] The predicted outputs (a batch).
+     * @param[loss_e] The loss type. Must be loss_type::MSE for Mean Square Error (regression) or loss_type::CE for
+     * Cross Entropy (classification)
+     * @param[parallel] sets the grain for parallelism. 0 -> no parallelism n -> divides the data into n parts and
+     * processes them in parallel threads
+     *
+     * @return the loss and the gradient of the loss w.r.t. all weights (also inactive).
+     *
+     * @throws std::invalid_argument if the *data* and *label* size do not match or is zero, if the data cannot be
+     * divided in *parallel* parts or if an active kernel does not provide its derivatives
+     */
+    template <typename U = T, enable_double<U> = 0>
+    std::tuple<double, std::vector<double>> d_loss(const std::vector<std::vector<double>> &points,
+                                                   const std::vector<std::vector<double>> &labels,
+                                                   typename expression<double>::loss_type loss_e,
+                                                   unsigned parallel = 0u) const
+    {
+        detail::data_checks(points, labels);
+        return d_loss(detail::row_iterator(points, 0), detail::row_iterator(points, points.size()),
+                      detail::row_iterator(labels, 0), loss_e, parallel, active_weights_idx());
+    }
+
+    /// Stochastic gradient descent
+    /**
+     * Performs one "epoch" of stochastic gradient descent on the weights. This allows to fit the weights of
+     * many candidate expressions (e.g. in each generation of an evolutionary symbolic regression) at the cost of a few
+     * evaluations, rather than using gduals having one symbol per weight.
+     *
+     * @param[points] The input data.
+     * @param[labels] The predicted outputs.
+     * @param[lr] The learning rate.
+     * @param[batch_size] The batch size.
+     * @param[loss_s] A string defining the loss type. Can be one of "MSE" (mean squared error) or "CE" (cross-entropy)
+     * @param[parallel] sets the grain for parallelism. 0 -> no parallelism n -> divides the data into n parts and
+     * processes them in parallel threads
+     * @param[shuffle] when true the points (and labels) are visited in a random order. The data is not modified.
+     *
+     * @return The average error across the batches. Note: this will not be equal to the error on the whole data set
+     * as weights get updated after each batch. It is an indicator, though, and its free to compute.
+     *
+     * @throws std::invalid_argument if the *data* and *label* size do not match or is zero, if *lr* is not
+     * positive, if *batch_size* is zero or if an active kernel does not provide its derivatives.
+     */
+    template <typename U = T, enable_double<U> = 0>
+    double sgd(const std::vector<std::vector<double>> &points, const std::vector<std::vector<double>> &labels,
+               double lr, unsigned batch_size, const std::string &loss_s, unsigned parallel = 0u, bool shuffle = true)
+    {
+        auto loss_e = detail::sgd_checks(points, labels, lr, batch_size, loss_s);
+
+        // The order in which the points are visited. We shuffle indexes rather than the data which is left untouched
+        const auto N = static_cast<unsigned>(points.size());
+        std::vector<unsigned> perm;
+        if (shuffle) {
+            perm.resize(N);
+            std::iota(perm.begin(), perm.end(), 0u);
+            std::mt19937 eng(std::random_device{}());
+            std::shuffle(perm.begin(), perm.end(), eng);
+        }
+        auto dfirst = shuffle ? detail::row_iterator(points, perm, 0) : detail::row_iterator(points, 0);
+        auto lfirst = shuffle ? detail::row_iterator(labels, perm, 0) : detail::row_iterator(labels, 0);
+        // Only the active weights have a non null gradient
+        const auto active_idx = active_weights_idx();
+
+        double retval = 0.;
+        double counter = 0.;
+        for (auto start = 0u; start < N; start += batch_size) {
+            auto end = std::min(start + batch_size, N);
+            auto err = d_loss(dfirst + start, dfirst + end, lfirst + start, loss_e, parallel, active_idx);
+            for (auto i : active_idx) {
+                m_weights[i] -= lr * std::get<1>(err)[i];
+            }
+            retval += std::get<0>(err);
+            counter++;
+        }
+        return retval / counter;
+    }
+
 private:
+    friend class boost::serialization::access;
+    // Serialization (the weights symbols are not stored as they only depend on the expression structure)
+    template <typename Archive>
+    void save(Archive &ar, const unsigned) const
+    {
+        ar << boost::serialization::base_object<expression<T>>(*this);
+        ar << m_weights;
+    }
+    template <typename Archive>
+    void load(Archive &ar, const unsigned)
+    {
+        ar >> boost::serialization::base_object<expression<T>>(*this);
+        std::vector<T> weights;
+        ar >> weights;
+        unsigned n_connections = std::accumulate(this->get_arity().begin(), this->get_arity().end(), 0u) * this->get_r();
+        if (weights.size() != n_connections) {
+            throw std::invalid_argument("The deserialized weights have the wrong dimension");
+        }
+        m_weights = weights;
+        m_weights_symbols.clear();
+        for (auto node_id = this->get_n(); node_id < this->get_r() * this->get_c() + this->get_n(); ++node_id) {
+            for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
+                m_weights_symbols.push_back("w" + std::to_string(node_id) + "_" + std::to_string(j));
+            }
+        }
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    // Work buffers of the backpropagation, reused across the points of a batch
+    struct backprop_buffers {
+        std::vector<double> node, d_node, adjoint, function_in, grad;
+    };
+
+    // The indexes in m_weights of the weights of the active nodes
+    std::vector<unsigned> active_weights_idx() const
+    {
+        std::vector<unsigned> retval;
+        for (auto node_id : this->get_active_nodes()) {
+            if (node_id < this->get_n()) continue;
+            unsigned w_idx = this->get_gene_idx()[node_id] - (node_id - this->get_n());
+            for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
+                retval.push_back(w_idx + j);
+            }
+        }
+        return retval;
+    }
+
+    // Cumulates the loss of one point and its gradient w.r.t. the weights (no checks on the sizes)
+    void d_loss_point(double &value, std::vector<double> &gweights, const std::vector<double> &point,
+                      const std::vector<double> &prediction, typename expression<double>::loss_type loss_e,
+                      backprop_buffers &b) const
+    {
+        const auto &x = this->get();
+        auto n = this->get_n();
+        auto m = this->get_m();
+        // Forward pass: the node values and the partial derivatives of each node kernel with respect to its
+        // (weighted) inputs, stored at the position in the chromosome of the connection gene
+        b.node.resize(n + this->get_r() * this->get_c());
+        b.d_node.resize(x.size());
+        for (auto node_id : this->get_active_nodes()) {
+            if (node_id < n) {
+                b.node[node_id] = point[node_id];
+            } else {
+                unsigned arity = this->_get_arity(node_id);
+                unsigned g_idx = this->get_gene_idx()[node_id];
+                unsigned w_idx = g_idx - (node_id - n);
+                b.function_in.resize(arity);
+                for (auto j = 0u; j < arity; ++j) {
+                    b.function_in[j] = b.node[x[g_idx + j + 1u]] * m_weights[w_idx + j];
+                }
+                const auto &f = this->get_f()[x[g_idx]];
+                b.node[node_id] = f(b.function_in);
+                f.d(b.function_in, b.node[node_id], b.grad);
+                std::copy(b.grad.begin(), b.grad.end(), b.d_node.begin() + g_idx + 1u);
+            }
+        }
+        // The derivatives of the loss with respect to the outputs seed the adjoints
+        b.adjoint.assign(b.node.size(), 0.);
+        switch (loss_e) {
+            // Mean Square Error
+            case expression<double>::loss_type::MSE: {
+                for (auto i = 0u; i < m; ++i) {
+                    auto node_idx = x[x.size() - m + i];
+                    auto dummy = b.node[node_idx] - prediction[i];
+                    b.adjoint[node_idx] += 2. * dummy / m;
+                    value += dummy * dummy / m;
+                }
+                break;
+            }
+            // Cross Entropy
+            case expression<double>::loss_type::CE: {
+                std::vector<double> ps(m);
+                for (auto i = 0u; i < m; ++i) {
+                    ps[i] = b.node[x[x.size() - m + i]];
+                }
+                // We guard from numerical instabilities subtracting the max
+                auto max = *std::max_element(ps.begin(), ps.end());
+                std::transform(ps.begin(), ps.end(), ps.begin(), [max](double a) { return std::exp(a - max); });
+                double cumsum = std::accumulate(ps.begin(), ps.end(), 0.);
+                for (auto i = 0u; i < m; ++i) {
+                    ps[i] /= cumsum;
+                    b.adjoint[x[x.size() - m + i]] += ps[i] - prediction[i];
+                    value -= std::log(ps[i]) * prediction[i];
+                }
+                break;
+            }
+        }
+        // Backward pass: the adjoints flow from each node to its connections, the weight gradients being the
+        // adjoint of the weighted input times the connection value
+        for (auto it = this->get_active_nodes().rbegin(); it != this->get_active_nodes().rend(); ++it) {
+            auto node_id = *it;
+            if (node_id < n || b.adjoint[node_id] == 0.) continue;
+            unsigned g_idx = this->get_gene_idx()[node_id];
+            unsigned w_idx = g_idx - (node_id - n);
+            for (auto j = 0u; j < this->_get_arity(node_id); ++j) {
+                auto src = x[g_idx + j + 1u];
+                auto g = b.adjoint[node_id] * b.d_node[g_idx + j + 1u];
+                // inputs discarded by the kernel (e.g. the second one of sin) may have non finite values
+                if (g == 0.) continue;
+                gweights[w_idx + j] += g * b.node[src];
+                b.adjoint[src] += g * m_weights[w_idx + j];
+            }
+        }
+    }
+
+    // Loss and gradient on a batch, averaged over its points
+    std::tuple<double, std::vector<double>> d_loss(detail::row_iterator dfirst, detail::row_iterator dlast,
+                                                   detail::row_iterator lfirst,
+                                                   typename expression<double>::loss_type loss_e, unsigned parallel,
+                                                   const std::vector<unsigned> &active_idx) const
+    {
+        const unsigned batch_size = static_cast<unsigned>(dlast - dfirst);
+        for (auto it = dfirst; it != dlast; ++it) {
+            auto lit = lfirst + (it - dfirst);
+            if (it->size() != this->get_n() || lit->size() != this->get_m()) {
+                throw std::invalid_argument("Data and labels must have the dimension of the inputs and the outputs");
+            }
+        }
+        double value = 0.;
+        std::vector<double> gweights(m_weights.size(), 0.);
+        if (parallel > 0u) {
+            if (batch_size % parallel != 0) {
+                throw std::invalid_argument("The batch size is: " + std::to_string(batch_size)
+                                            + " and cannot be divided into " + std::to_string(parallel) + "parts.");
+            }
+            unsigned inner_batch_size = batch_size / parallel;
+            // Each thread cumulates the loss and its gradient in its own buffers
+            using grad_buffer = std::tuple<double, std::vector<double>, backprop_buffers>;
+            tbb::enumerable_thread_specific<grad_buffer> buffers(
+                [this]() { return grad_buffer(0., std::vector<double>(m_weights.size(), 0.), backprop_buffers{}); });
+            tbb::parallel_for(0u, batch_size, inner_batch_size, [&](unsigned i) {
+                auto &buffer = buffers.local();
+                for (auto j = i; j < i + inner_batch_size; ++j) {
+                    d_loss_point(std::get<0>(buffer), std::get<1>(buffer), *(dfirst + j), *(lfirst + j), loss_e,
+                                 std::get<2>(buffer));
+                }
+            });
+            for (const auto &buffer : buffers) {
+                value += std::get<0>(buffer);
+                for (auto idx : active_idx) {
+                    gweights[idx] += std::get<1>(buffer)[idx];
+                }
+            }
+        } else {
+            backprop_buffers b;
+            for (auto j = 0u; j < batch_size; ++j) {
+                d_loss_point(value, gweights, *(dfirst + j), *(lfirst + j), loss_e, b);
+            }
+        }
+        for (auto idx : active_idx) {
+            gweights[idx] /= batch_size;
+        }
+        value /= batch_size;
+        return std::make_tuple(value, std::move(gweights));
+    }
+
+    // The kernel inputs are the weighted connections (used by the base class gradient)
+    void kernel_inputs(unsigned node_id, std::vector<T> &function_in, std::vector<T> &d_in) const
+    {
+        unsigned w_idx = this->get_gene_idx()[node_id] - (node_id - this->get_n());
+        d_in.resize(function_in.size());
+        for (auto j = 0u; j < function_in.size(); ++j) {
+            function_in[j] = function_in[j] * m_weights[w_idx + j];
+            d_in[j] = m_weights[w_idx + j];
+        }
+    }
+
+    std::string kernel_symbol(unsigned node_id, std::vector<std::string> &function_in) const
+    {
+        unsigned g_idx = this->get_gene_idx()[node_id];
+        return kernel_call(function_in, g_idx, node_id, g_idx - (node_id - this->get_n()));
+    }
+
     // For numeric computations
-    template <typename U, typename std::enable_if<std::is_same<U, double>::value || is_gdual<U>::value, int>::type = 0>
+    template <typename U, typename std::enable_if<
+                              std::is_same<U, double>::value || is_gdual<U>::value || is_dual<U>::value, int>::type = 0>
     U kernel_call(std::vector<U> &function_in, unsigned idx, unsigned node_id, unsigned weight_idx) const
     {
         // Weights (we transform the inputs a,b,c,d,e in w_1 a, w_2 b, w_3 c, etc...)
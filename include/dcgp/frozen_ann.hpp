@@ -0,0 +1,336 @@
+#ifndef DCGP_FROZEN_ANN_H
+#define DCGP_FROZEN_ANN_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dcgp/s11n.hpp>
+
+namespace dcgp
+{
+
+/// An inference-only dCGP-ANN
+/**
+ * This class represents a trained dCGP-ANN compiled for inference (see dcgp::expression_ann::freeze()). Only the
+ * active nodes are kept, in topological order, each with its activation function, its bias and the gathered
+ * weights and sources of its connections. Values are stored in a compact register file: the first registers
+ * contain the inputs, the following ones the nodes.
+ *
+ * The object is immutable and all its methods are const and only use local buffers, hence it can be used
+ * concurrently from many threads.
+ */
+class frozen_ann
+{
+public:
+    /// Activation functions
+    enum class activation : std::uint8_t {
+        /// sigmoid
+        SIG,
+        /// Hyperbolic tangent
+        TANH,
+        /// Rectified linear unit
+        RELU,
+        /// Exponential linear unit
+        ELU,
+        /// ISRU
+        ISRU,
+        /// Simple sum of inputs
+        SUM
+    };
+
+    /// Default constructor
+    /**
+     * Constructs an empty network with no inputs and no outputs (e.g. to deserialize into).
+     */
+    frozen_ann() : m_n(0u), m_offsets(1u, 0u) {}
+
+    /// Constructor
+    /**
+     * Constructs the network from its compiled representation. Registers [0, n) contain the inputs, register
+     * n + k the value of the k-th node.
+     *
+     * @param[in] n number of inputs.
+     * @param[in] kernels activation function of each node.
+     * @param[in] offsets the connections of the k-th node are in [offsets[k], offsets[k + 1]).
+     * @param[in] sources the register feeding each connection.
+     * @param[in] weights the weight of each connection.
+     * @param[in] biases the bias of each node.
+     * @param[in] outputs the register of each output.
+     *
+     * @throw std::invalid_argument if the data are inconsistent, or a node is not fed by previous registers only.
+     */
+    frozen_ann(unsigned n, std::vector<activation> kernels, std::vector<unsigned> offsets,
+               std::vector<unsigned> sources, std::vector<double> weights, std::vector<double> biases,
+               std::vector<unsigned> outputs)
+        : m_n(n), m_kernels(std::move(kernels)), m_offsets(std::move(offsets)), m_sources(std::move(sources)),
+          m_weights(std::move(weights)), m_biases(std::move(biases)), m_outputs(std::move(outputs))
+    {
+        check();
+    }
+
+    /// Evaluates the network
+    /**
+     * @param[in] point the input values.
+     *
+     * @return the output values.
+     *
+     * @throw std::invalid_argument if the point dimension is wrong.
+     */
+    std::vector<double> operator()(const std::vector<double> &point) const
+    {
+        std::vector<std::vector<double>> out;
+        eval(&point, &point + 1, out);
+        return out[0];
+    }
+
+    /// Evaluates the network on a batch
+    /**
+     * Evaluates the network on a batch of points. The points are processed in chunks, each node being computed
+     * for all the points of a chunk in tight loops.
+     *
+     * @param[in] points the input values.
+     *
+     * @return the output values for each point.
+     *
+     * @throw std::invalid_argument if a point dimension is wrong.
+     */
+    std::vector<std::vector<double>> operator()(const std::vector<std::vector<double>> &points) const
+    {
+        std::vector<std::vector<double>> out;
+        eval(points.data(), points.data() + points.size(), out);
+        return out;
+    }
+
+    /// Gets the number of inputs
+    unsigned get_n() const
+    {
+        return m_n;
+    }
+
+    /// Gets the number of outputs
+    unsigned get_m() const
+    {
+        return static_cast<unsigned>(m_outputs.size());
+    }
+
+    /// Gets the number of nodes
+    unsigned get_n_nodes() const
+    {
+        return static_cast<unsigned>(m_kernels.size());
+    }
+
+    /// Gets the activation functions of the nodes
+    const std::vector<activation> &get_kernels() const
+    {
+        return m_kernels;
+    }
+
+    /// Gets the connection offsets of the nodes
+    const std::vector<unsigned> &get_offsets() const
+    {
+        return m_offsets;
+    }
+
+    /// Gets the source registers of the connections
+    const std::vector<unsigned> &get_sources() const
+    {
+        return m_sources;
+    }
+
+    /// Gets the weights of the connections
+    const std::vector<double> &get_weights() const
+    {
+        return m_weights;
+    }
+
+    /// Gets the biases of the nodes
+    const std::vector<double> &get_biases() const
+    {
+        return m_biases;
+    }
+
+    /// Gets the output registers
+    const std::vector<unsigned> &get_outputs() const
+    {
+        return m_outputs;
+    }
+
+    /// Applies an activation function
+    /**
+     * Applies an activation function in place to an array of values.
+     *
+     * @param[in] kernel the activation function.
+     * @param[in,out] z the values.
+     * @param[in] B the number of values.
+     */
+    static void activate(activation kernel, double *z, unsigned B)
+    {
+        switch (kernel) {
+            case activation::SIG:
+                for (auto b = 0u; b < B; ++b) {
+                    z[b] = 1. / (1. + std::exp(-z[b]));
+                }
+                break;
+            case activation::TANH:
+                for (auto b = 0u; b < B; ++b) {
+                    z[b] = std::tanh(z[b]);
+                }
+                break;
+            case activation::RELU:
+                for (auto b = 0u; b < B; ++b) {
+                    z[b] = (z[b] < 0.) ? 0. : z[b];
+                }
+                break;
+            case activation::ELU:
+                for (auto b = 0u; b < B; ++b) {
+                    z[b] = (z[b] < 0.) ? std::exp(z[b]) - 1. : z[b];
+                }
+                break;
+            case activation::ISRU:
+                for (auto b = 0u; b < B; ++b) {
+                    z[b] = z[b] / (std::sqrt(1. + z[b] * z[b]));
+                }
+                break;
+            case activation::SUM:
+                break;
+        }
+    }
+
+private:
+    // Evaluates the points in [first, last) chunk by chunk
+    void eval(const std::vector<double> *first, const std::vector<double> *last,
+              std::vector<std::vector<double>> &out) const
+    {
+        const unsigned chunk_size = 64u;
+        const auto N = static_cast<unsigned>(last - first);
+        const auto n_regs = m_n + get_n_nodes();
+        out.resize(N);
+        // regs[r * B + b] is the value of register r for the point b of the chunk
+        std::vector<double> regs(n_regs * std::min(chunk_size, N));
+        for (auto start = 0u; start < N; start += chunk_size) {
+            const auto B = std::min(chunk_size, N - start);
+            for (auto b = 0u; b < B; ++b) {
+                const auto &point = first[start + b];
+                if (point.size() != m_n) {
+                    throw std::invalid_argument("Input size is incompatible, it was: " + std::to_string(point.size())
+                                                + " while I expected: " + std::to_string(m_n));
+                }
+                for (auto i = 0u; i < m_n; ++i) {
+                    regs[i * B + b] = point[i];
+                }
+            }
+            for (auto k = 0u; k < get_n_nodes(); ++k) {
+                double *z = regs.data() + (m_n + k) * B;
+                // The weighted sum of the inputs plus the bias
+                auto c = m_offsets[k];
+                const double *in = regs.data() + m_sources[c] * B;
+                const double w0 = m_weights[c], bias = m_biases[k];
+                for (auto b = 0u; b < B; ++b) {
+                    z[b] = in[b] * w0 + bias;
+                }
+                for (++c; c < m_offsets[k + 1u]; ++c) {
+                    in = regs.data() + m_sources[c] * B;
+                    const double w = m_weights[c];
+                    for (auto b = 0u; b < B; ++b) {
+                        z[b] += in[b] * w;
+                    }
+                }
+                activate(m_kernels[k], z, B);
+            }
+            for (auto b = 0u; b < B; ++b) {
+                auto &o = out[start + b];
+                o.resize(m_outputs.size());
+                for (decltype(m_outputs.size()) i = 0u; i < m_outputs.size(); ++i) {
+                    o[i] = regs[m_outputs[i] * B + b];
+                }
+            }
+        }
+    }
+
+    // Checks the consistency of the data
+    void check() const
+    {
+        const auto K = m_kernels.size();
+        if (m_offsets.size() != K + 1u || m_offsets[0] != 0u || m_offsets.back() != m_sources.size()
+            || m_weights.size() != m_sources.size() || m_biases.size() != K) {
+            throw std::invalid_argument("The sizes of the frozen dCGP-ANN data are inconsistent");
+        }
+        for (decltype(m_kernels.size()) k = 0u; k < K; ++k) {
+            if (static_cast<unsigned>(m_kernels[k]) > static_cast<unsigned>(activation::SUM)) {
+                throw std::invalid_argument("Unknown activation function for node " + std::to_string(k));
+            }
+            if (m_offsets[k + 1u] <= m_offsets[k]) {
+                throw std::invalid_argument("Node " + std::to_string(k) + " has no connections");
+            }
+            for (auto c = m_offsets[k]; c < m_offsets[k + 1u]; ++c) {
+                if (m_sources[c] >= m_n + k) {
+                    throw std::invalid_argument("Node " + std::to_string(k) + " is fed by register "
+                                                + std::to_string(m_sources[c])
+                                                + ", which is not an input nor a previous node");
+                }
+            }
+        }
+        for (auto o : m_outputs) {
+            if (o >= m_n + K) {
+                throw std::invalid_argument("The output register " + std::to_string(o) + " does not exist");
+            }
+        }
+    }
+
+    friend class boost::serialization::access;
+    template <typename Archive>
+    void save(Archive &ar, const unsigned) const
+    {
+        std::vector<unsigned> kernels(m_kernels.size());
+        std::transform(m_kernels.begin(), m_kernels.end(), kernels.begin(),
+                       [](activation a) { return static_cast<unsigned>(a); });
+        ar << m_n;
+        ar << kernels;
+        ar << m_offsets;
+        ar << m_sources;
+        ar << m_weights;
+        ar << m_biases;
+        ar << m_outputs;
+    }
+    template <typename Archive>
+    void load(Archive &ar, const unsigned)
+    {
+        unsigned n;
+        std::vector<unsigned> kernels, offsets, sources, outputs;
+        std::vector<double> weights, biases;
+        ar >> n;
+        ar >> kernels;
+        ar >> offsets;
+        ar >> sources;
+        ar >> weights;
+        ar >> biases;
+        ar >> outputs;
+        std::vector<activation> acts(kernels.size());
+        std::transform(kernels.begin(), kernels.end(), acts.begin(), [](unsigned a) {
+            if (a > static_cast<unsigned>(activation::SUM)) {
+                throw std::invalid_argument("Unknown activation function: " + std::to_string(a));
+            }
+            return static_cast<activation>(a);
+        });
+        // We check the data before modifying the object
+        *this = frozen_ann(n, std::move(acts), std::move(offsets), std::move(sources), std::move(weights),
+                           std::move(biases), std::move(outputs));
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    unsigned m_n;
+    std::vector<activation> m_kernels;
+    std::vector<unsigned> m_offsets;
+    std::vector<unsigned> m_sources;
+    std::vector<double> m_weights;
+    std::vector<double> m_biases;
+    std::vector<unsigned> m_outputs;
+};
+
+} // end of namespace dcgp
+
+#endif // DCGP_FROZEN_ANN_H
@@ -0,0 +1,118 @@
+#ifndef DCGP_GDUAL_V_BATCH_H
+#define DCGP_GDUAL_V_BATCH_H
+
+#include <audi/audi.hpp>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dcgp
+{
+
+namespace detail
+{
+// Broadcasts a vectorized coefficient to the N points of the batch
+inline std::vector<double> batch_broadcast(const audi::vectorized<double> &cf, unsigned N)
+{
+    if (cf.size() == 1u) {
+        return std::vector<double>(N, cf[0]);
+    }
+    if (cf.size() != N) {
+        throw std::invalid_argument("The vectorized coefficient has size " + std::to_string(cf.size())
+                                    + " while the batch has " + std::to_string(N) + " points");
+    }
+    std::vector<double> retval(N);
+    for (auto i = 0u; i < N; ++i) {
+        retval[i] = cf[i];
+    }
+    return retval;
+}
+} // namespace detail
+
+/// Grid to vectorized gdual inputs
+/**
+ * Converts a grid of points into the inputs of a dcgp::expression<gdual_v>, so that a single evaluation of the
+ * expression computes its Taylor expansion (up to \p order) at all the points. The j-th input is the gdual_v whose
+ * coefficients are the j-th coordinates of all points, and has the symbol \p symbols[j] (derivatives are then
+ * requested as "d" + symbol). An empty symbol makes the input a constant, i.e. no derivative is taken with
+ * respect to it.
+ *
+ * @code
+ * auto in = dcgp::batch_inputs(grid, {"x"}, 1u);
+ * auto out = ex(in);
+ * auto dy = dcgp::batch_derivative(out[0], {{"dx", 1u}}, grid.size());
+ * @endcode
+ *
+ * @param[points] The grid, each point containing the values of all the inputs.
+ * @param[symbols] The symbols of the inputs.
+ * @param[order] The truncation order of the gduals.
+ *
+ * @return the vectorized gdual inputs.
+ *
+ * @throw std::invalid_argument if the grid is empty or the points and \p symbols sizes are inconsistent.
+ */
+inline std::vector<audi::gdual_v> batch_inputs(const std::vector<std::vector<double>> &points,
+                                               const std::vector<std::string> &symbols, unsigned order)
+{
+    if (points.size() == 0u) {
+        throw std::invalid_argument("The grid cannot be empty");
+    }
+    for (decltype(points.size()) i = 0u; i < points.size(); ++i) {
+        if (points[i].size() != symbols.size()) {
+            throw std::invalid_argument("The point " + std::to_string(i) + " has dimension "
+                                        + std::to_string(points[i].size()) + " while the number of symbols is: "
+                                        + std::to_string(symbols.size()));
+        }
+    }
+    std::vector<audi::gdual_v> retval;
+    std::vector<double> column(points.size());
+    for (decltype(symbols.size()) j = 0u; j < symbols.size(); ++j) {
+        for (decltype(points.size()) i = 0u; i < points.size(); ++i) {
+            column[i] = points[i][j];
+        }
+        if (symbols[j].empty()) {
+            retval.emplace_back(audi::vectorized<double>(column));
+        } else {
+            retval.emplace_back(audi::vectorized<double>(column), symbols[j], order);
+        }
+    }
+    return retval;
+}
+
+/// Per point values of a vectorized gdual
+/**
+ * @param[out] An output of the expression evaluated on dcgp::batch_inputs().
+ * @param[N] The number of points of the batch.
+ *
+ * @return the value of \p out at each of the \p N points (outputs not depending on the points, e.g. constants, are
+ * broadcasted).
+ *
+ * @throw std::invalid_argument if \p out does not have \p N points.
+ */
+inline std::vector<double> batch_values(const audi::gdual_v &out, unsigned N)
+{
+    return detail::batch_broadcast(out.constant_cf(), N);
+}
+
+/// Per point derivatives of a vectorized gdual
+/**
+ * @param[out] An output of the expression evaluated on dcgp::batch_inputs().
+ * @param[d] The derivative requested, e.g. {{"dx", 1u}, {"dy", 2u}}. Symbols \p out does not depend on give a zero
+ * derivative.
+ * @param[N] The number of points of the batch.
+ *
+ * @return the derivative of \p out at each of the \p N points.
+ *
+ * @throw std::invalid_argument if \p out does not have \p N points or the derivative order exceeds the one of
+ * \p out.
+ */
+inline std::vector<double> batch_derivative(const audi::gdual_v &out,
+                                            const std::unordered_map<std::string, unsigned> &d, unsigned N)
+{
+    return detail::batch_broadcast(out.get_derivative(d), N);
+}
+
+} // namespace dcgp
+
+#endif // DCGP_GDUAL_V_BATCH_H
@@ -4,6 +4,7 @@
 #include <audi/gdual.hpp>
 #include <functional> // std::function
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <utility> // std::forward
 #include <vector>
@@ -38,6 +39,10 @@ public:
     using my_fun_type = std::function<T(const std::vector<T> &)>;
     /// Basic prototype of a kernel function returning its symbolic representation
     using my_print_fun_type = std::function<std::string(const std::vector<std::string> &)>;
+    /// Basic prototype of a kernel function writing its partial derivatives (given the inputs and the output)
+    using my_d_fun_type = std::function<void(const std::vector<T> &, const T &, std::vector<T> &)>;
+    /// Basic prototype of a kernel function writing its evaluation in an existing object
+    using my_in_place_fun_type = std::function<void(const std::vector<const T *> &, T &)>;
 #endif
     /// Constructor
     /**
@@ -49,7 +54,48 @@ public:
      *
      */
     template <typename U, typename V>
-    kernel(U &&f, V &&pf, std::string name) : m_f(std::forward<U>(f)), m_pf(std::forward<V>(pf)), m_name(name)
+    kernel(U &&f, V &&pf, std::string name)
+        : m_f(std::forward<U>(f)), m_pf(std::forward<V>(pf)), m_df(), m_ipf(), m_name(name)
+    {
+    }
+
+    /// Constructor
+    /**
+     * Constructs a kernel that also knows its own partial derivatives, as needed by the
+     * reverse mode differentiation of a dCGP expression (see dcgp::expression::gradient)
+     *
+     * @param[in] f any callable with prototype T(const std::vector<T>&)
+     * @param[in] pf any callable with prototype std::string(const std::vector<std::string>&)
+     * @param[in] df any callable with prototype void(const std::vector<T>& in, const T& out, std::vector<T>& grad)
+     * writing in \p grad the partial derivatives of the kernel with respect to each of its inputs \p in, given the
+     * kernel output \p out
+     * @param[in] name string containing the function name (ex. "sum")
+     *
+     */
+    template <typename U, typename V, typename W>
+    kernel(U &&f, V &&pf, W &&df, std::string name)
+        : m_f(std::forward<U>(f)), m_pf(std::forward<V>(pf)), m_df(std::forward<W>(df)), m_ipf(), m_name(name)
+    {
+    }
+
+    /// Constructor
+    /**
+     * Constructs a kernel that also has an in-place variant, writing its value in an existing object (e.g. with
+     * the += and *= operators) rather than returning a temporary, as used by dcgp::expression::evaluate
+     *
+     * @param[in] f any callable with prototype T(const std::vector<T>&)
+     * @param[in] pf any callable with prototype std::string(const std::vector<std::string>&)
+     * @param[in] df any callable with prototype void(const std::vector<T>& in, const T& out, std::vector<T>& grad),
+     * or an empty std::function if the kernel does not provide its derivatives
+     * @param[in] ipf any callable with prototype void(const std::vector<const T*>& in, T& out) writing in \p out the
+     * kernel value in the point pointed to by \p in (\p out is never one of the inputs)
+     * @param[in] name string containing the function name (ex. "sum")
+     *
+     */
+    template <typename U, typename V, typename W, typename Z>
+    kernel(U &&f, V &&pf, W &&df, Z &&ipf, std::string name)
+        : m_f(std::forward<U>(f)), m_pf(std::forward<V>(pf)), m_df(std::forward<W>(df)), m_ipf(std::forward<Z>(ipf)),
+          m_name(name)
     {
     }
 
@@ -90,6 +136,64 @@ public:
         return m_pf(in);
     }
 
+    /// Partial derivatives
+    /**
+     * Computes the partial derivatives of the kernel with respect to each of its inputs
+     *
+     * @param[in] in the evaluation point as an std::vector<T>
+     * @param[in] out the kernel value in \p in
+     * @param[out] grad the partial derivatives (resized to the size of \p in)
+     *
+     * @throw std::invalid_argument if the kernel does not provide its derivatives
+     */
+    void d(const std::vector<T> &in, const T &out, std::vector<T> &grad) const
+    {
+        if (!m_df) {
+            throw std::invalid_argument("The kernel " + m_name + " does not provide its derivatives");
+        }
+        grad.resize(in.size());
+        m_df(in, out, grad);
+    }
+
+    /// Checks for the partial derivatives
+    /**
+     * @return true if the kernel was constructed with the rule computing its partial derivatives
+     */
+    bool has_derivative() const
+    {
+        return static_cast<bool>(m_df);
+    }
+
+    /// In-place evaluation
+    /**
+     * Evaluates the kernel in the point pointed to by \p in, writing the result in \p out. Kernels constructed
+     * without an in-place variant assign to \p out their value.
+     *
+     * @param[in] in pointers to the values of the evaluation point (none of them being \p out)
+     * @param[out] out the function value
+     */
+    void in_place(const std::vector<const T *> &in, T &out) const
+    {
+        if (m_ipf) {
+            m_ipf(in, out);
+        } else {
+            std::vector<T> tmp;
+            for (auto ptr : in) {
+                tmp.push_back(*ptr);
+            }
+            out = m_f(tmp);
+        }
+    }
+
+    /// Checks for the in-place variant
+    /**
+     * @return true if the kernel was constructed with an in-place variant
+     */
+    bool has_in_place() const
+    {
+        return static_cast<bool>(m_ipf);
+    }
+
     /// Kernel name
     /**
      * Returns the Kernel name
@@ -122,6 +226,10 @@ private:
     my_fun_type m_f;
     /// Its symbolic representation
     my_print_fun_type m_pf;
+    /// Its partial derivatives (may be empty)
+    my_d_fun_type m_df;
+    /// Its in-place variant (may be empty)
+    my_in_place_fun_type m_ipf;
     /// Its name
     std::string m_name;
 };
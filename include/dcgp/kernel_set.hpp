@@ -2,6 +2,7 @@
 #define DCGP_kernel_set_H
 
 #include <audi/gdual.hpp>
+#include <type_traits>
 #include <vector>
 
 #include <dcgp/kernel.hpp>
@@ -53,33 +54,37 @@ public:
     void push_back(std::string kernel_name)
     {
         if (kernel_name == "sum")
-            m_kernels.emplace_back(my_sum<T>, print_my_sum, kernel_name);
+            m_kernels.emplace_back(my_sum<T>, print_my_sum, derivative(d_my_sum<d_type>), my_sum_in_place<T>,
+                                   kernel_name);
         else if (kernel_name == "diff")
-            m_kernels.emplace_back(my_diff<T>, print_my_diff, kernel_name);
+            m_kernels.emplace_back(my_diff<T>, print_my_diff, derivative(d_my_diff<d_type>), my_diff_in_place<T>,
+                                   kernel_name);
         else if (kernel_name == "mul")
-            m_kernels.emplace_back(my_mul<T>, print_my_mul, kernel_name);
+            m_kernels.emplace_back(my_mul<T>, print_my_mul, derivative(d_my_mul<d_type>), my_mul_in_place<T>,
+                                   kernel_name);
         else if (kernel_name == "div")
-            m_kernels.emplace_back(my_div<T>, print_my_div, kernel_name);
+            m_kernels.emplace_back(my_div<T>, print_my_div, derivative(d_my_div<d_type>), my_div_in_place<T>,
+                                   kernel_name);
         else if (kernel_name == "pdiv")
-            m_kernels.emplace_back(my_pdiv<T>, print_my_pdiv, kernel_name);
+            m_kernels.emplace_back(my_pdiv<T>, print_my_pdiv, derivative(d_my_pdiv<d_type>), kernel_name);
         else if (kernel_name == "sig")
-            m_kernels.emplace_back(my_sig<T>, print_my_sig, kernel_name);
+            m_kernels.emplace_back(my_sig<T>, print_my_sig, derivative(d_my_sig<d_type>), kernel_name);
         else if (kernel_name == "tanh")
-            m_kernels.emplace_back(my_tanh<T>, print_my_tanh, kernel_name);
+            m_kernels.emplace_back(my_tanh<T>, print_my_tanh, derivative(d_my_tanh<d_type>), kernel_name);
         else if (kernel_name == "ReLu")
-            m_kernels.emplace_back(my_relu<T>, print_my_relu, kernel_name);
+            m_kernels.emplace_back(my_relu<T>, print_my_relu, derivative(d_my_relu<d_type>), kernel_name);
         else if (kernel_name == "ELU")
-            m_kernels.emplace_back(my_elu<T>, print_my_elu, kernel_name);
+            m_kernels.emplace_back(my_elu<T>, print_my_elu, derivative(d_my_elu<d_type>), kernel_name);
         else if (kernel_name == "ISRU")
-            m_kernels.emplace_back(my_isru<T>, print_my_isru, kernel_name);
+            m_kernels.emplace_back(my_isru<T>, print_my_isru, derivative(d_my_isru<d_type>), kernel_name);
         else if (kernel_name == "sin")
-            m_kernels.emplace_back(my_sin<T>, print_my_sin, kernel_name);
+            m_kernels.emplace_back(my_sin<T>, print_my_sin, derivative(d_my_sin<d_type>), kernel_name);
         else if (kernel_name == "cos")
-            m_kernels.emplace_back(my_cos<T>, print_my_cos, kernel_name);
+            m_kernels.emplace_back(my_cos<T>, print_my_cos, derivative(d_my_cos<d_type>), kernel_name);
         else if (kernel_name == "log")
-            m_kernels.emplace_back(my_log<T>, print_my_log, kernel_name);
+            m_kernels.emplace_back(my_log<T>, print_my_log, derivative(d_my_log<d_type>), kernel_name);
         else if (kernel_name == "exp")
-            m_kernels.emplace_back(my_exp<T>, print_my_exp, kernel_name);
+            m_kernels.emplace_back(my_exp<T>, print_my_exp, derivative(d_my_exp<d_type>), kernel_name);
         else
             throw std::invalid_argument("Unimplemented function " + kernel_name);
     }
@@ -142,6 +147,21 @@ public:
     }
 
 private:
+    // Only the double and dual kernels are given their partial derivatives (the other types take, and discard, the
+    // double rules)
+    using d_type = typename std::conditional<std::is_same<T, double>::value || is_dual<T>::value, T, double>::type;
+    using d_rule_type = void (*)(const std::vector<d_type> &, const d_type &, std::vector<d_type> &);
+    template <typename U = T, typename std::enable_if<std::is_same<U, d_type>::value, int>::type = 0>
+    static typename kernel<T>::my_d_fun_type derivative(d_rule_type df)
+    {
+        return df;
+    }
+    template <typename U = T, typename std::enable_if<!std::is_same<U, d_type>::value, int>::type = 0>
+    static typename kernel<T>::my_d_fun_type derivative(d_rule_type)
+    {
+        return {};
+    }
+
     // vector of functions
     std::vector<dcgp::kernel<T>> m_kernels;
 };
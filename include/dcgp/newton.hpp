@@ -0,0 +1,307 @@
+#ifndef DCGP_NEWTON_H
+#define DCGP_NEWTON_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <audi/audi.hpp>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/tbb.h>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dcgp/expression.hpp>
+#include <dcgp/expression_weighted.hpp>
+
+namespace dcgp
+{
+
+namespace detail
+{
+// Checks the data and returns the loss type
+inline expression<gdual_d>::loss_type newton_checks(const std::vector<std::vector<double>> &points,
+                                                    const std::vector<std::vector<double>> &labels,
+                                                    const std::string &loss_s, unsigned n, unsigned m)
+{
+    data_checks(points, labels);
+    for (decltype(points.size()) i = 0u; i < points.size(); ++i) {
+        if (points[i].size() != n || labels[i].size() != m) {
+            throw std::invalid_argument("The data point " + std::to_string(i) + " has dimension "
+                                        + std::to_string(points[i].size()) + " (label "
+                                        + std::to_string(labels[i].size()) + ") while I expected: "
+                                        + std::to_string(n) + " (label " + std::to_string(m) + ")");
+        }
+    }
+    return decode_loss<gdual_d>(loss_s);
+}
+
+// Checks that the indexes are unique and smaller than size
+inline void newton_check_idx(const std::vector<unsigned> &idx, unsigned size, const std::string &what)
+{
+    if (idx.size() == 0u) {
+        throw std::invalid_argument("At least one " + what + " must be optimized");
+    }
+    auto sorted = idx;
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+        throw std::invalid_argument("The indexes of the " + what + "s must be unique");
+    }
+    if (sorted.back() >= size) {
+        throw std::invalid_argument("The " + what + " index " + std::to_string(sorted.back())
+                                    + " is out of range, the maximum being: " + std::to_string(size - 1u));
+    }
+}
+
+// Symbol of the k-th parameter in the order 2 gduals
+inline std::string newton_symbol(unsigned k)
+{
+    return "p" + std::to_string(k);
+}
+
+// Sums the loss (and, if hessian is true, its gradient and Hessian w.r.t. the parameters) over the data.
+// set_params(pg) is called once, before the blocks, with the parameters as the gduals pg and
+// loss_block(first, last, pg) returns the gdual loss summed over the points first, ..., last - 1. The blocks are
+// processed in parallel and their results summed in order, so that the result does not depend on the scheduling.
+template <typename S, typename F>
+inline std::tuple<double, Eigen::VectorXd, Eigen::MatrixXd> newton_sum(const S &set_params, const F &loss_block,
+                                                                       unsigned N, const std::vector<double> &p,
+                                                                       bool hessian)
+{
+    const auto K = static_cast<unsigned>(p.size());
+    const auto KD = static_cast<Eigen::Index>(hessian ? K : 0u);
+    const unsigned block = 64u;
+    const unsigned n_blocks = (N + block - 1u) / block;
+    // The parameters as gduals (order 2 to get the Hessian)
+    std::vector<gdual_d> pg;
+    for (auto k = 0u; k < K; ++k) {
+        pg.push_back(hessian ? gdual_d(p[k], newton_symbol(k), 2u) : gdual_d(p[k]));
+    }
+    set_params(pg);
+    std::vector<std::tuple<double, Eigen::VectorXd, Eigen::MatrixXd>> parts(n_blocks);
+    tbb::parallel_for(0u, n_blocks, [&](unsigned b) {
+        auto l = loss_block(b * block, std::min(N, (b + 1u) * block), pg);
+        auto &part = parts[b];
+        std::get<0>(part) = l.constant_cf();
+        std::get<1>(part) = Eigen::VectorXd::Zero(KD);
+        std::get<2>(part) = Eigen::MatrixXd::Zero(KD, KD);
+        if (!hessian) return;
+        for (auto j = 0u; j < K; ++j) {
+            const auto sj = "d" + newton_symbol(j);
+            std::get<1>(part)(j) = l.get_derivative(std::unordered_map<std::string, unsigned>{{sj, 1u}});
+            std::get<2>(part)(j, j) = l.get_derivative(std::unordered_map<std::string, unsigned>{{sj, 2u}});
+            for (auto k = j + 1u; k < K; ++k) {
+                std::get<2>(part)(j, k) = std::get<2>(part)(k, j) = l.get_derivative(
+                    std::unordered_map<std::string, unsigned>{{sj, 1u}, {"d" + newton_symbol(k), 1u}});
+            }
+        }
+    });
+    auto retval = std::make_tuple(0., Eigen::VectorXd::Zero(KD).eval(), Eigen::MatrixXd::Zero(KD, KD).eval());
+    for (const auto &part : parts) {
+        std::get<0>(retval) += std::get<0>(part);
+        std::get<1>(retval) += std::get<1>(part);
+        std::get<2>(retval) += std::get<2>(part);
+    }
+    std::get<0>(retval) /= N;
+    std::get<1>(retval) /= N;
+    std::get<2>(retval) /= N;
+    return retval;
+}
+
+// Damped Newton iterations on the parameters p (updated in place). The Hessian is shifted by a multiple of the
+// identity (Levenberg-Marquardt damping) until it is positive definite and the step decreases the loss. Returns
+// the final loss.
+template <typename S, typename F>
+inline double newton_solve(const S &set_params, const F &loss_block, unsigned N, std::vector<double> &p,
+                           unsigned max_iter, double tol)
+{
+    const auto K = static_cast<Eigen::Index>(p.size());
+    auto current = newton_sum(set_params, loss_block, N, p, true);
+    double loss = std::get<0>(current);
+    if (!std::isfinite(loss)) {
+        return loss;
+    }
+    double lambda = 0.;
+    std::vector<double> trial(p.size());
+    for (auto it = 0u; it < max_iter; ++it) {
+        const auto &g = std::get<1>(current);
+        const auto &H = std::get<2>(current);
+        if (!g.allFinite() || !H.allFinite() || g.cwiseAbs().maxCoeff() <= tol) {
+            break;
+        }
+        // The smallest damping tried is relative to the Hessian scale
+        const double lambda_min = 1e-10 * (1. + H.diagonal().cwiseAbs().maxCoeff());
+        bool accepted = false;
+        double new_loss = loss;
+        for (auto attempt = 0u; attempt < 40u; ++attempt) {
+            Eigen::LDLT<Eigen::MatrixXd> ldlt(H + lambda * Eigen::MatrixXd::Identity(K, K));
+            if (ldlt.info() == Eigen::Success && ldlt.isPositive() && (ldlt.vectorD().array() > 0.).all()) {
+                Eigen::VectorXd d = ldlt.solve(-g);
+                for (Eigen::Index k = 0; k < K; ++k) {
+                    trial[static_cast<unsigned>(k)] = p[static_cast<unsigned>(k)] + d(k);
+                }
+                new_loss = std::get<0>(newton_sum(set_params, loss_block, N, trial, false));
+                if (std::isfinite(new_loss) && new_loss <= loss) {
+                    accepted = true;
+                    break;
+                }
+            }
+            lambda = std::max(lambda_min, 10. * lambda);
+        }
+        if (!accepted) {
+            break;
+        }
+        // Successful steps reduce the damping, down to a pure Newton step
+        lambda = (lambda <= lambda_min) ? 0. : lambda / 10.;
+        p = trial;
+        bool converged = (loss - new_loss) <= tol * (1. + loss);
+        loss = new_loss;
+        if (converged) {
+            break;
+        }
+        current = newton_sum(set_params, loss_block, N, p, true);
+        loss = std::get<0>(current);
+    }
+    return loss;
+}
+} // namespace detail
+
+/// Newton optimization of the constants of an expression
+/**
+ * Some inputs of the expression are designated as constants (e.g. ephemeral random constants) and are fitted to
+ * the data, the remaining inputs being fed by the data points. The loss is expanded at second order in the constants
+ * using gduals, its gradient and Hessian being summed in parallel over the data, and damped Newton steps are
+ * iterated until the loss stops decreasing (by more than \p tol relative to it), the gradient vanishes (below
+ * \p tol) or \p max_iter iterations are made. The damping (a multiple of the identity added to the Hessian) makes
+ * each step a descent one.
+ *
+ * Since it works on the dCGP expression evaluation, this also applies to the derived classes (e.g.
+ * dcgp::expression_weighted<gdual_d>).
+ *
+ * @param[ex] The expression.
+ * @param[constants] The initial values of the constants, updated with the optimized ones.
+ * @param[constants_idx] The indexes of the expression inputs that are constants (same size as \p constants).
+ * @param[points] The input data, each point containing the values of the remaining inputs (in their order).
+ * @param[labels] The predicted outputs.
+ * @param[loss_s] The loss type. Can be "MSE" for Mean Square Error (regression) or "CE" for Cross Entropy
+ * (classification)
+ * @param[max_iter] The maximum number of Newton iterations.
+ * @param[tol] The tolerance on the relative loss decrease and on the gradient.
+ *
+ * @return the loss with the optimized constants.
+ *
+ * @throw std::invalid_argument if the data are inconsistent, the loss is unknown or the constants indexes are
+ * invalid.
+ */
+inline double newton_constants(const expression<gdual_d> &ex, std::vector<double> &constants,
+                               const std::vector<unsigned> &constants_idx,
+                               const std::vector<std::vector<double>> &points,
+                               const std::vector<std::vector<double>> &labels, const std::string &loss_s = "MSE",
+                               unsigned max_iter = 50u, double tol = 1e-12)
+{
+    detail::newton_check_idx(constants_idx, ex.get_n(), "constant");
+    if (constants.size() != constants_idx.size()) {
+        throw std::invalid_argument("The number of constants is: " + std::to_string(constants.size())
+                                    + " while the number of their indexes is: "
+                                    + std::to_string(constants_idx.size()));
+    }
+    auto loss_e = detail::newton_checks(points, labels, loss_s,
+                                        ex.get_n() - static_cast<unsigned>(constants_idx.size()), ex.get_m());
+    // For each expression input, the index of the constant it is (or -1 if it is fed by the data)
+    std::vector<int> which(ex.get_n(), -1);
+    for (decltype(constants_idx.size()) k = 0u; k < constants_idx.size(); ++k) {
+        which[constants_idx[k]] = static_cast<int>(k);
+    }
+    auto loss_block = [&](unsigned first, unsigned last, const std::vector<gdual_d> &pg) {
+        gdual_d retval(0.);
+        std::vector<gdual_d> in(ex.get_n()), label;
+        for (auto i = first; i < last; ++i) {
+            auto it = points[i].begin();
+            for (auto j = 0u; j < ex.get_n(); ++j) {
+                in[j] = (which[j] >= 0) ? pg[static_cast<unsigned>(which[j])] : gdual_d(*(it++));
+            }
+            label.assign(labels[i].begin(), labels[i].end());
+            retval += ex.loss(in, label, loss_e);
+        }
+        return retval;
+    };
+    return detail::newton_solve([](const std::vector<gdual_d> &) {}, loss_block, static_cast<unsigned>(points.size()),
+                                constants, max_iter, tol);
+}
+
+/// Newton optimization of the weights of a weighted expression
+/**
+ * The designated weights of the expression are fitted to the data: the loss is expanded at second order in the
+ * weights using gduals, its gradient and Hessian being summed in parallel over the data, and damped Newton steps
+ * are iterated as in dcgp::newton_constants(). The optimized weights are set in the expression.
+ *
+ * @param[ex] The weighted expression.
+ * @param[weights_idx] The indexes (in dcgp::expression_weighted::get_weights()) of the weights to optimize.
+ * @param[points] The input data.
+ * @param[labels] The predicted outputs.
+ * @param[loss_s] The loss type. Can be "MSE" for Mean Square Error (regression) or "CE" for Cross Entropy
+ * (classification)
+ * @param[max_iter] The maximum number of Newton iterations.
+ * @param[tol] The tolerance on the relative loss decrease and on the gradient.
+ *
+ * @return the loss with the optimized weights.
+ *
+ * @throw std::invalid_argument if the data are inconsistent, the loss is unknown or the weights indexes are
+ * invalid.
+ */
+inline double newton_weights(expression_weighted<gdual_d> &ex, const std::vector<unsigned> &weights_idx,
+                             const std::vector<std::vector<double>> &points,
+                             const std::vector<std::vector<double>> &labels, const std::string &loss_s = "MSE",
+                             unsigned max_iter = 50u, double tol = 1e-12)
+{
+    detail::newton_check_idx(weights_idx, static_cast<unsigned>(ex.get_weights().size()), "weight");
+    auto loss_e = detail::newton_checks(points, labels, loss_s, ex.get_n(), ex.get_m());
+    std::vector<double> w;
+    for (auto idx : weights_idx) {
+        w.push_back(ex.get_weights()[idx].constant_cf());
+    }
+    // The data as gduals
+    std::vector<std::vector<gdual_d>> gpoints, glabels;
+    for (decltype(points.size()) i = 0u; i < points.size(); ++i) {
+        gpoints.emplace_back(points[i].begin(), points[i].end());
+        glabels.emplace_back(labels[i].begin(), labels[i].end());
+    }
+    // The weights of the current evaluation (the parameters) and its number
+    auto ws = ex.get_weights();
+    unsigned n_set = 0u;
+    auto set_params = [&](const std::vector<gdual_d> &pg) {
+        for (decltype(weights_idx.size()) k = 0u; k < weights_idx.size(); ++k) {
+            ws[weights_idx[k]] = pg[k];
+        }
+        ++n_set;
+    };
+    // Each worker thread reuses its own copy of the expression, whose weights are set once per evaluation
+    tbb::enumerable_thread_specific<std::pair<expression_weighted<gdual_d>, unsigned>> exs(std::make_pair(ex, 0u));
+    auto loss_block = [&](unsigned first, unsigned last, const std::vector<gdual_d> &) {
+        auto &ex_w = exs.local();
+        if (ex_w.second != n_set) {
+            ex_w.first.set_weights(ws);
+            ex_w.second = n_set;
+        }
+        gdual_d retval(0.);
+        for (auto i = first; i < last; ++i) {
+            retval += ex_w.first.loss(gpoints[i], glabels[i], loss_e);
+        }
+        return retval;
+    };
+    auto retval
+        = detail::newton_solve(set_params, loss_block, static_cast<unsigned>(points.size()), w, max_iter, tol);
+    ws = ex.get_weights();
+    for (decltype(weights_idx.size()) k = 0u; k < weights_idx.size(); ++k) {
+        ws[weights_idx[k]] = gdual_d(w[k]);
+    }
+    ex.set_weights(ws);
+    return retval;
+}
+
+} // namespace dcgp
+
+#endif // DCGP_NEWTON_H
@@ -0,0 +1,358 @@
+#ifndef DCGP_NSGA2_H
+#define DCGP_NSGA2_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tbb/tbb.h>
+#include <tuple>
+#include <vector>
+
+namespace dcgp
+{
+
+/// Pareto dominance
+/**
+ * Checks whether the fitness vector \p a Pareto-dominates \p b (minimization), that is if all of its
+ * objectives are not worse and at least one is strictly better.
+ *
+ * @param[in] a first fitness vector.
+ * @param[in] b second fitness vector.
+ *
+ * @return true if \p a dominates \p b.
+ */
+inline bool pareto_dominance(const std::vector<double> &a, const std::vector<double> &b)
+{
+    bool strictly_better = false;
+    for (decltype(a.size()) i = 0u; i < a.size(); ++i) {
+        if (a[i] > b[i]) {
+            return false;
+        } else if (a[i] < b[i]) {
+            strictly_better = true;
+        }
+    }
+    return strictly_better;
+}
+
+/// Non-dominated sorting
+/**
+ * Sorts the fitness vectors \p fits into non-dominated fronts. The implementation follows the
+ * efficient non-dominated sort with binary search (ENS-BS): points are visited in lexicographic order, so that a point
+ * can only be dominated by points already assigned, and the front of each point is located by a binary search
+ * over the fronts built so far. For two objectives the dominance test against a front only needs its last
+ * member and the whole sort is O(N log N). With more objectives the dominance test scans the members of a front,
+ * so the cost is O(M N log N) only when fronts are few and small, and O(M N^2) in the worst case (e.g. all points
+ * on one front). The divide-and-conquer sort of Jensen and Fortin, O(N log^(M-1) N), is not used: for the
+ * population sizes of NSGA-II it rarely pays off its much larger constant.
+ *
+ * @param[in] fits the fitness vectors (all of the same dimension, without NaNs).
+ *
+ * @return the fronts, each containing the indexes of its points in \p fits. The first is the Pareto front.
+ *
+ * @throw std::invalid_argument if the fitness vectors are empty or have different dimensions.
+ */
+inline std::vector<std::vector<unsigned>> non_dominated_sort(const std::vector<std::vector<double>> &fits)
+{
+    std::vector<std::vector<unsigned>> fronts;
+    if (fits.size() == 0u) {
+        return fronts;
+    }
+    const auto n_obj = fits[0].size();
+    if (n_obj == 0u) {
+        throw std::invalid_argument("Cannot sort fitness vectors with zero dimension");
+    }
+    if (std::any_of(fits.begin(), fits.end(), [n_obj](const std::vector<double> &f) { return f.size() != n_obj; })) {
+        throw std::invalid_argument("All fitness vectors must have the same dimension, i.e. "
+                                    + std::to_string(n_obj));
+    }
+    // Lexicographic ordering: no point can be dominated by one that follows it
+    std::vector<unsigned> idx(fits.size());
+    std::iota(idx.begin(), idx.end(), 0u);
+    std::stable_sort(idx.begin(), idx.end(), [&fits](unsigned a, unsigned b) { return fits[a] < fits[b]; });
+
+    // Returns true if the point p is dominated by some member of the front
+    auto dominated_by = [&fits, n_obj](const std::vector<unsigned> &front, unsigned p) {
+        // With one or two objectives the last member of a front has the best (smallest) last objective among the
+        // members, so it dominates p if any member does.
+        if (n_obj <= 2u) {
+            return pareto_dominance(fits[front.back()], fits[p]);
+        }
+        // Otherwise the most recently added members are the likeliest dominators
+        for (auto it = front.rbegin(); it != front.rend(); ++it) {
+            if (pareto_dominance(fits[*it], fits[p])) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (auto p : idx) {
+        // If p is dominated by some member of front k, it is also dominated by some member of each front before k,
+        // hence we can bisect.
+        decltype(fronts.size()) lo = 0u, hi = fronts.size();
+        while (lo < hi) {
+            auto mid = lo + (hi - lo) / 2u;
+            if (dominated_by(fronts[mid], p)) {
+                lo = mid + 1u;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == fronts.size()) {
+            fronts.emplace_back();
+        }
+        fronts[lo].push_back(p);
+    }
+    return fronts;
+}
+
+/// Crowding distance
+/**
+ * Computes the crowding distance of the points of a front, as defined in NSGA-II. Boundary points
+ * get an infinite distance. Objectives whose range on the front is null or not finite are skipped.
+ *
+ * @param[in] fits the fitness vectors.
+ * @param[in] front the indexes (in \p fits) of the points belonging to the front.
+ *
+ * @return the crowding distances, in the same order as \p front.
+ */
+inline std::vector<double> crowding_distance(const std::vector<std::vector<double>> &fits,
+                                             const std::vector<unsigned> &front)
+{
+    std::vector<double> retval(front.size(), 0.);
+    if (front.size() <= 2u) {
+        std::fill(retval.begin(), retval.end(), std::numeric_limits<double>::infinity());
+        return retval;
+    }
+    std::vector<unsigned> order(front.size());
+    for (decltype(fits[0].size()) obj = 0u; obj < fits[front[0]].size(); ++obj) {
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(),
+                  [&](unsigned a, unsigned b) { return fits[front[a]][obj] < fits[front[b]][obj]; });
+        const double f_min = fits[front[order.front()]][obj];
+        const double f_max = fits[front[order.back()]][obj];
+        retval[order.front()] = std::numeric_limits<double>::infinity();
+        retval[order.back()] = std::numeric_limits<double>::infinity();
+        // Objectives with a null or non finite range (e.g. infinite losses) do not contribute
+        if (!(std::isfinite(f_max - f_min) && f_max - f_min > 0.)) {
+            continue;
+        }
+        for (decltype(order.size()) i = 1u; i < order.size() - 1u; ++i) {
+            retval[order[i]] += (fits[front[order[i + 1u]]][obj] - fits[front[order[i - 1u]]][obj]) / (f_max - f_min);
+        }
+    }
+    return retval;
+}
+
+/// Multi-objective evolution of dCGP expressions (NSGA-II)
+/**
+ * Evolves a population of dCGP expressions trading off several objectives at once (e.g. the loss and
+ * the expression complexity, measured by the number of active nodes or, for dcgp::expression_ann, of active
+ * weights) using the NSGA-II selection scheme. Offspring are created by tournament selection on
+ * the crowded-comparison operator and by mutating active genes; their objectives are evaluated in parallel.
+ */
+class nsga2
+{
+public:
+    /// The outcome of an evolution: the chromosomes on the Pareto front and their objectives
+    struct pareto_front {
+        /// Chromosomes (unique) on the Pareto front, sorted by their first objective
+        std::vector<std::vector<unsigned>> m_chromosomes;
+        /// The corresponding objectives
+        std::vector<std::vector<double>> m_fitness;
+    };
+
+    /// Constructor
+    /**
+     * Constructs the NSGA-II algorithm.
+     *
+     * @param[in] gen number of generations.
+     * @param[in] pop_size population size.
+     * @param[in] n_mutations number of active genes mutated to create an offspring.
+     * @param[in] seed seed for the random number generator.
+     *
+     * @throw std::invalid_argument if \p pop_size is smaller than 2 or \p n_mutations is zero.
+     */
+    nsga2(unsigned gen, unsigned pop_size, unsigned n_mutations = 1u,
+          std::random_device::result_type seed = std::random_device{}())
+        : m_gen(gen), m_pop_size(pop_size), m_n_mutations(n_mutations), m_e(seed)
+    {
+        if (pop_size < 2u) {
+            throw std::invalid_argument("The population size must be at least 2, while " + std::to_string(pop_size)
+                                        + " was detected");
+        }
+        if (n_mutations == 0u) {
+            throw std::invalid_argument("The number of mutations must be at least 1");
+        }
+    }
+
+    /// Evolves the expression
+    /**
+     * Runs NSGA-II starting from a population made of \p ex and of random chromosomes.
+     *
+     * @param[in] ex the initial expression, its chromosome is part of the initial population.
+     * @param[in] objectives a callable returning the vector of objectives (to be minimized) of an expression
+     * of type \p Expr. It is called concurrently on distinct expressions and must thus be thread-safe. NaNs are
+     * considered as the worst possible objective (i.e. infinite).
+     *
+     * @return the final Pareto front.
+     *
+     * @throw std::invalid_argument if the objectives have inconsistent dimension.
+     */
+    template <typename Expr, typename F>
+    pareto_front evolve(const Expr &ex, const F &objectives)
+    {
+        // NaNs would break the orderings used by the sorts, they are considered as the worst possible objective
+        auto safe_objectives = [&objectives](const Expr &e) {
+            auto f = objectives(e);
+            for (auto &v : f) {
+                if (std::isnan(v)) {
+                    v = std::numeric_limits<double>::infinity();
+                }
+            }
+            return f;
+        };
+        const auto N = m_pop_size;
+        std::vector<Expr> pop(N, ex);
+        std::vector<std::vector<unsigned>> chromosomes(N, ex.get());
+        std::vector<std::vector<double>> fits(N);
+        // The initial population: ex and random chromosomes within the bounds
+        const auto &lb = ex.get_lb();
+        const auto &ub = ex.get_ub();
+        for (auto i = 1u; i < N; ++i) {
+            for (decltype(lb.size()) j = 0u; j < lb.size(); ++j) {
+                chromosomes[i][j] = std::uniform_int_distribution<unsigned>(lb[j], ub[j])(m_e);
+            }
+        }
+        tbb::parallel_for(0u, N, [&](unsigned i) {
+            pop[i].set(chromosomes[i]);
+            fits[i] = safe_objectives(pop[i]);
+        });
+        std::vector<unsigned> rank(N);
+        std::vector<double> crowding(N);
+        rank_and_crowding(fits, rank, crowding);
+
+        std::vector<Expr> offspring(N, ex);
+        std::vector<std::vector<double>> offspring_fits(N);
+        std::vector<unsigned> parents(N);
+        std::vector<std::random_device::result_type> seeds(N);
+        for (auto g = 0u; g < m_gen; ++g) {
+            // Selection and seeds are drawn sequentially so that results do not depend on the scheduling
+            for (auto i = 0u; i < N; ++i) {
+                parents[i] = tournament(rank, crowding);
+                seeds[i] = m_e();
+            }
+            tbb::parallel_for(0u, N, [&](unsigned i) {
+                offspring[i].set(chromosomes[parents[i]]);
+                offspring[i].seed(seeds[i]);
+                offspring[i].mutate_active(m_n_mutations);
+                offspring_fits[i] = safe_objectives(offspring[i]);
+            });
+            // Parents and offspring compete for survival
+            std::vector<std::vector<double>> all_fits(fits);
+            all_fits.insert(all_fits.end(), offspring_fits.begin(), offspring_fits.end());
+            auto fronts = non_dominated_sort(all_fits);
+            std::vector<unsigned> survivors, survivors_rank;
+            std::vector<double> survivors_crowding;
+            for (decltype(fronts.size()) k = 0u; k < fronts.size() && survivors.size() < N; ++k) {
+                auto cd = crowding_distance(all_fits, fronts[k]);
+                std::vector<unsigned> order(fronts[k].size());
+                std::iota(order.begin(), order.end(), 0u);
+                // The last front admitted is truncated keeping the less crowded points
+                if (survivors.size() + fronts[k].size() > N) {
+                    std::stable_sort(order.begin(), order.end(),
+                                     [&cd](unsigned a, unsigned b) { return cd[a] > cd[b]; });
+                    order.resize(N - survivors.size());
+                }
+                for (auto j : order) {
+                    survivors.push_back(fronts[k][j]);
+                    survivors_rank.push_back(static_cast<unsigned>(k));
+                    survivors_crowding.push_back(cd[j]);
+                }
+            }
+            std::vector<std::vector<unsigned>> new_chromosomes(N);
+            std::vector<std::vector<double>> new_fits(N);
+            for (auto i = 0u; i < N; ++i) {
+                auto s = survivors[i];
+                new_chromosomes[i] = (s < N) ? chromosomes[s] : offspring[s - N].get();
+                new_fits[i] = all_fits[s];
+            }
+            chromosomes.swap(new_chromosomes);
+            fits.swap(new_fits);
+            rank.swap(survivors_rank);
+            crowding.swap(survivors_crowding);
+        }
+
+        // We extract the (unique) Pareto front
+        pareto_front retval;
+        auto front = non_dominated_sort(fits)[0];
+        std::sort(front.begin(), front.end(), [&](unsigned a, unsigned b) {
+            return std::tie(fits[a], chromosomes[a]) < std::tie(fits[b], chromosomes[b]);
+        });
+        for (auto i : front) {
+            if (retval.m_chromosomes.size() == 0u || retval.m_chromosomes.back() != chromosomes[i]) {
+                retval.m_chromosomes.push_back(chromosomes[i]);
+                retval.m_fitness.push_back(fits[i]);
+            }
+        }
+        return retval;
+    }
+
+    /// Gets the number of generations
+    unsigned get_gen() const
+    {
+        return m_gen;
+    }
+
+    /// Gets the population size
+    unsigned get_pop_size() const
+    {
+        return m_pop_size;
+    }
+
+    /// Gets the number of mutations
+    unsigned get_n_mutations() const
+    {
+        return m_n_mutations;
+    }
+
+private:
+    // Computes the front rank and the crowding distance of each individual
+    static void rank_and_crowding(const std::vector<std::vector<double>> &fits, std::vector<unsigned> &rank,
+                                  std::vector<double> &crowding)
+    {
+        auto fronts = non_dominated_sort(fits);
+        for (decltype(fronts.size()) k = 0u; k < fronts.size(); ++k) {
+            auto cd = crowding_distance(fits, fronts[k]);
+            for (decltype(cd.size()) j = 0u; j < cd.size(); ++j) {
+                rank[fronts[k][j]] = static_cast<unsigned>(k);
+                crowding[fronts[k][j]] = cd[j];
+            }
+        }
+    }
+    // Binary tournament using the crowded-comparison operator
+    unsigned tournament(const std::vector<unsigned> &rank, const std::vector<double> &crowding)
+    {
+        auto N = static_cast<unsigned>(rank.size());
+        auto a = std::uniform_int_distribution<unsigned>(0u, N - 1u)(m_e);
+        auto b = std::uniform_int_distribution<unsigned>(0u, N - 2u)(m_e);
+        if (b >= a) ++b;
+        if (rank[a] != rank[b]) {
+            return rank[a] < rank[b] ? a : b;
+        }
+        return crowding[a] >= crowding[b] ? a : b;
+    }
+
+    unsigned m_gen;
+    unsigned m_pop_size;
+    unsigned m_n_mutations;
+    std::mt19937 m_e;
+};
+
+} // end of namespace dcgp
+
+#endif // DCGP_NSGA2_H
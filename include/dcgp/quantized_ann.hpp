@@ -0,0 +1,398 @@
+#ifndef DCGP_QUANTIZED_ANN_H
+#define DCGP_QUANTIZED_ANN_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dcgp/frozen_ann.hpp>
+#include <dcgp/s11n.hpp>
+
+namespace dcgp
+{
+
+/// An int8 quantized inference-only dCGP-ANN
+/**
+ * This class represents a dcgp::frozen_ann after post-training quantization. The value of each register (inputs
+ * and nodes) is represented by an 8 bits integer q, the real value being q * s, where the scale s of the register
+ * is calibrated on a sample dataset so that the largest observed value maps to 127.
+ *
+ * For each node, the weights of its connections, multiplied by the scale of their source register, are quantized to
+ * 8 bits integers with a per-node scale, and its bias to a 32 bits integer with the same scale. The weighted sum
+ * of the inputs is then computed in integer arithmetic (32 bits accumulation) and requantized to the scale of the
+ * node with a fixed point multiplier:
+ *
+ * - SUM and RELU nodes only use integer arithmetic.
+ * - SIG, TANH, ISRU and ELU nodes requantize the weighted sum to 8 bits (with a scale calibrated on the sample
+ *   dataset) and look up their output in a 256 entries table.
+ *
+ * Only the quantization of the inputs and the dequantization of the outputs use floating point arithmetic. Values
+ * outside the calibrated range saturate. As for dcgp::frozen_ann, the object is immutable and can be used
+ * concurrently from many threads.
+ */
+class quantized_ann
+{
+public:
+    /// The activation functions (same as dcgp::frozen_ann)
+    using activation = frozen_ann::activation;
+
+    /// Default constructor
+    /**
+     * Constructs an empty network with no inputs and no outputs (e.g. to deserialize into).
+     */
+    quantized_ann() : m_n(0u), m_offsets(1u, 0u) {}
+
+    /// Constructor (calibration)
+    /**
+     * Quantizes a frozen dCGP-ANN. The network is evaluated in double precision on the calibration points to
+     * determine the range of the values of each register and of the weighted sum of each node. The calibration
+     * points should thus be representative of the data the network will be used on.
+     *
+     * @param[in] f the network to quantize.
+     * @param[in] points the calibration points.
+     *
+     * @throw std::invalid_argument if there are no calibration points or if a point dimension is wrong.
+     */
+    quantized_ann(const frozen_ann &f, const std::vector<std::vector<double>> &points)
+        : m_n(f.get_n()), m_kernels(f.get_kernels()), m_offsets(f.get_offsets()), m_sources(f.get_sources()),
+          m_outputs(f.get_outputs())
+    {
+        if (points.size() == 0u) {
+            throw std::invalid_argument("At least one calibration point is needed to quantize a dCGP-ANN");
+        }
+        const auto K = get_n_nodes();
+        const auto &weights = f.get_weights();
+        const auto &biases = f.get_biases();
+        // Calibration: the largest absolute value of each register and of the weighted sum of each node
+        std::vector<double> max_reg(m_n + K, 0.), max_z(K, 0.), regs(m_n + K);
+        for (const auto &point : points) {
+            if (point.size() != m_n) {
+                throw std::invalid_argument("Input size is incompatible, it was: " + std::to_string(point.size())
+                                            + " while I expected: " + std::to_string(m_n));
+            }
+            std::copy(point.begin(), point.end(), regs.begin());
+            for (auto k = 0u; k < K; ++k) {
+                double z = biases[k];
+                for (auto c = m_offsets[k]; c < m_offsets[k + 1u]; ++c) {
+                    z += regs[m_sources[c]] * weights[c];
+                }
+                max_z[k] = std::max(max_z[k], std::abs(z));
+                frozen_ann::activate(m_kernels[k], &z, 1u);
+                regs[m_n + k] = z;
+            }
+            for (decltype(regs.size()) r = 0u; r < regs.size(); ++r) {
+                max_reg[r] = std::max(max_reg[r], std::abs(regs[r]));
+            }
+        }
+        m_scales.resize(m_n + K);
+        std::transform(max_reg.begin(), max_reg.end(), m_scales.begin(), scale_of);
+        // Quantization of the weights and biases, multipliers and lookup tables
+        m_qweights.resize(m_sources.size());
+        m_qbiases.resize(K);
+        m_mult.resize(K);
+        m_shift.resize(K);
+        m_luts.assign(256u * K, 0);
+        for (auto k = 0u; k < K; ++k) {
+            // The scale of the weighted sum, s.t. the largest (weight x source scale) maps to 127
+            double max_w = 0.;
+            for (auto c = m_offsets[k]; c < m_offsets[k + 1u]; ++c) {
+                max_w = std::max(max_w, std::abs(weights[c] * m_scales[m_sources[c]]));
+            }
+            const double s_acc = scale_of(max_w);
+            for (auto c = m_offsets[k]; c < m_offsets[k + 1u]; ++c) {
+                m_qweights[c] = saturate(std::llround(weights[c] * m_scales[m_sources[c]] / s_acc));
+            }
+            // The quantized bias is bounded by 2^30, so that the 32 bits sums cannot overflow
+            const double qb = std::round(biases[k] / s_acc), bias_max = 1073741824.;
+            m_qbiases[k] = static_cast<std::int32_t>(std::max(-bias_max, std::min(bias_max, qb)));
+            const double s_out = m_scales[m_n + k];
+            switch (m_kernels[k]) {
+                case activation::SUM:
+                case activation::RELU:
+                    // Integer arithmetic only: the sum is requantized to the node scale
+                    fixed_point(s_acc / s_out, m_mult[k], m_shift[k]);
+                    break;
+                default: {
+                    // The sum is requantized to 8 bits and the output is looked up. The input range of the tables
+                    // of saturating functions is limited, so as not to waste resolution on constant outputs.
+                    double range = max_z[k];
+                    if (m_kernels[k] == activation::SIG) {
+                        range = std::min(range, 8.);
+                    } else if (m_kernels[k] == activation::TANH) {
+                        range = std::min(range, 4.);
+                    }
+                    const double s_z = scale_of(range);
+                    fixed_point(s_acc / s_z, m_mult[k], m_shift[k]);
+                    for (auto q = -128; q < 128; ++q) {
+                        double z = q * s_z;
+                        frozen_ann::activate(m_kernels[k], &z, 1u);
+                        m_luts[256u * k + static_cast<unsigned>(q + 128)] = saturate(std::llround(z / s_out));
+                    }
+                }
+            }
+        }
+    }
+
+    /// Evaluates the network
+    /**
+     * @param[in] point the input values.
+     *
+     * @return the output values.
+     *
+     * @throw std::invalid_argument if the point dimension is wrong.
+     */
+    std::vector<double> operator()(const std::vector<double> &point) const
+    {
+        std::vector<std::vector<double>> out;
+        eval(&point, &point + 1, out);
+        return out[0];
+    }
+
+    /// Evaluates the network on a batch
+    /**
+     * Evaluates the network on a batch of points. The points are processed in chunks, each node being computed
+     * for all the points of a chunk in tight integer loops.
+     *
+     * @param[in] points the input values.
+     *
+     * @return the output values for each point.
+     *
+     * @throw std::invalid_argument if a point dimension is wrong.
+     */
+    std::vector<std::vector<double>> operator()(const std::vector<std::vector<double>> &points) const
+    {
+        std::vector<std::vector<double>> out;
+        eval(points.data(), points.data() + points.size(), out);
+        return out;
+    }
+
+    /// Gets the number of inputs
+    unsigned get_n() const
+    {
+        return m_n;
+    }
+
+    /// Gets the number of outputs
+    unsigned get_m() const
+    {
+        return static_cast<unsigned>(m_outputs.size());
+    }
+
+    /// Gets the number of nodes
+    unsigned get_n_nodes() const
+    {
+        return static_cast<unsigned>(m_kernels.size());
+    }
+
+    /// Gets the quantized weights of the connections
+    const std::vector<std::int8_t> &get_weights() const
+    {
+        return m_qweights;
+    }
+
+    /// Gets the scales of the registers (inputs first, then nodes)
+    const std::vector<double> &get_scales() const
+    {
+        return m_scales;
+    }
+
+private:
+    // Evaluates the points in [first, last) chunk by chunk
+    void eval(const std::vector<double> *first, const std::vector<double> *last,
+              std::vector<std::vector<double>> &out) const
+    {
+        const unsigned chunk_size = 256u;
+        const auto N = static_cast<unsigned>(last - first);
+        const auto n_regs = m_n + get_n_nodes();
+        out.resize(N);
+        // regs[r * B + b] is the quantized value of register r for the point b of the chunk
+        std::vector<std::int8_t> regs(n_regs * std::min(chunk_size, N));
+        std::vector<std::int32_t> acc(std::min(chunk_size, N));
+        for (auto start = 0u; start < N; start += chunk_size) {
+            const auto B = std::min(chunk_size, N - start);
+            for (auto b = 0u; b < B; ++b) {
+                const auto &point = first[start + b];
+                if (point.size() != m_n) {
+                    throw std::invalid_argument("Input size is incompatible, it was: " + std::to_string(point.size())
+                                                + " while I expected: " + std::to_string(m_n));
+                }
+                for (auto i = 0u; i < m_n; ++i) {
+                    regs[i * B + b] = saturate(std::llround(point[i] / m_scales[i]));
+                }
+            }
+            for (auto k = 0u; k < get_n_nodes(); ++k) {
+                std::int8_t *q = regs.data() + (m_n + k) * B;
+                // The weighted sum of the inputs plus the bias, in 32 bits integers
+                std::fill(acc.begin(), acc.begin() + B, m_qbiases[k]);
+                for (auto c = m_offsets[k]; c < m_offsets[k + 1u]; ++c) {
+                    const std::int8_t *in = regs.data() + m_sources[c] * B;
+                    const std::int32_t w = m_qweights[c];
+                    for (auto b = 0u; b < B; ++b) {
+                        acc[b] += w * in[b];
+                    }
+                }
+                const std::int64_t mult = m_mult[k];
+                const int shift = m_shift[k];
+                switch (m_kernels[k]) {
+                    case activation::SUM:
+                        for (auto b = 0u; b < B; ++b) {
+                            q[b] = requantize(acc[b], mult, shift);
+                        }
+                        break;
+                    case activation::RELU:
+                        for (auto b = 0u; b < B; ++b) {
+                            q[b] = std::max(std::int8_t(0), requantize(acc[b], mult, shift));
+                        }
+                        break;
+                    default: {
+                        const std::int8_t *lut = m_luts.data() + 256u * k + 128u;
+                        for (auto b = 0u; b < B; ++b) {
+                            q[b] = lut[requantize(acc[b], mult, shift)];
+                        }
+                    }
+                }
+            }
+            for (auto b = 0u; b < B; ++b) {
+                auto &o = out[start + b];
+                o.resize(m_outputs.size());
+                for (decltype(m_outputs.size()) i = 0u; i < m_outputs.size(); ++i) {
+                    o[i] = regs[m_outputs[i] * B + b] * m_scales[m_outputs[i]];
+                }
+            }
+        }
+    }
+
+    // Computes acc * mult / 2^shift rounded to the nearest integer and saturated to 8 bits
+    static std::int8_t requantize(std::int32_t acc, std::int64_t mult, int shift)
+    {
+        const std::int64_t r = (acc * mult + (std::int64_t(1) << (shift - 1))) >> shift;
+        return static_cast<std::int8_t>(std::max(std::int64_t(-128), std::min(std::int64_t(127), r)));
+    }
+
+    // Saturates to 8 bits
+    static std::int8_t saturate(long long q)
+    {
+        return static_cast<std::int8_t>(std::max(-128ll, std::min(127ll, q)));
+    }
+
+    // The scale mapping the largest absolute value max to 127 (one if max is null)
+    static double scale_of(double max)
+    {
+        return (max > 0. && std::isfinite(max)) ? max / 127. : 1.;
+    }
+
+    // Represents the positive real multiplier M as mult / 2^shift with mult in [2^30, 2^31) and shift in [1, 62]
+    static void fixed_point(double M, std::int32_t &mult, std::int32_t &shift)
+    {
+        int exp;
+        const double frac = std::frexp(M, &exp);
+        auto m = std::llround(std::ldexp(frac, 31));
+        if (m == (1ll << 31)) {
+            m /= 2;
+            ++exp;
+        }
+        shift = 31 - exp;
+        if (shift > 62) {
+            // Any sum is requantized to zero
+            mult = 0;
+            shift = 1;
+        } else if (shift < 1) {
+            // Any non null sum saturates
+            mult = std::numeric_limits<std::int32_t>::max();
+            shift = 1;
+        } else {
+            mult = static_cast<std::int32_t>(m);
+        }
+    }
+
+    // Checks the consistency of the data
+    void check() const
+    {
+        // A frozen dCGP-ANN with the same structure checks the connections and outputs
+        const auto K = m_kernels.size();
+        if (m_qweights.size() != m_sources.size() || m_qbiases.size() != K || m_mult.size() != K
+            || m_shift.size() != K || m_luts.size() != 256u * K || m_scales.size() != m_n + K) {
+            throw std::invalid_argument("The sizes of the quantized dCGP-ANN data are inconsistent");
+        }
+        frozen_ann(m_n, m_kernels, m_offsets, m_sources, std::vector<double>(m_sources.size()), std::vector<double>(K),
+                   m_outputs);
+        for (decltype(m_kernels.size()) k = 0u; k < K; ++k) {
+            if (m_shift[k] < 1 || m_shift[k] > 62 || m_mult[k] < 0) {
+                throw std::invalid_argument("Invalid fixed point multiplier for node " + std::to_string(k));
+            }
+        }
+        if (!std::all_of(m_scales.begin(), m_scales.end(), [](double s) { return s > 0. && std::isfinite(s); })) {
+            throw std::invalid_argument("The scales of a quantized dCGP-ANN must be positive");
+        }
+    }
+
+    friend class boost::serialization::access;
+    template <typename Archive>
+    void save(Archive &ar, const unsigned) const
+    {
+        std::vector<unsigned> kernels(m_kernels.size());
+        std::transform(m_kernels.begin(), m_kernels.end(), kernels.begin(),
+                       [](activation a) { return static_cast<unsigned>(a); });
+        ar << m_n;
+        ar << kernels;
+        ar << m_offsets;
+        ar << m_sources;
+        ar << m_qweights;
+        ar << m_qbiases;
+        ar << m_mult;
+        ar << m_shift;
+        ar << m_luts;
+        ar << m_scales;
+        ar << m_outputs;
+    }
+    template <typename Archive>
+    void load(Archive &ar, const unsigned)
+    {
+        quantized_ann tmp;
+        std::vector<unsigned> kernels;
+        ar >> tmp.m_n;
+        ar >> kernels;
+        ar >> tmp.m_offsets;
+        ar >> tmp.m_sources;
+        ar >> tmp.m_qweights;
+        ar >> tmp.m_qbiases;
+        ar >> tmp.m_mult;
+        ar >> tmp.m_shift;
+        ar >> tmp.m_luts;
+        ar >> tmp.m_scales;
+        ar >> tmp.m_outputs;
+        tmp.m_kernels.resize(kernels.size());
+        std::transform(kernels.begin(), kernels.end(), tmp.m_kernels.begin(), [](unsigned a) {
+            if (a > static_cast<unsigned>(activation::SUM)) {
+                throw std::invalid_argument("Unknown activation function: " + std::to_string(a));
+            }
+            return static_cast<activation>(a);
+        });
+        // We check the data before modifying the object
+        tmp.check();
+        *this = std::move(tmp);
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    unsigned m_n;
+    std::vector<activation> m_kernels;
+    std::vector<unsigned> m_offsets;
+    std::vector<unsigned> m_sources;
+    std::vector<std::int8_t> m_qweights;
+    std::vector<std::int32_t> m_qbiases;
+    // Fixed point multipliers requantizing the weighted sum of each node (m_mult[k] / 2^m_shift[k])
+    std::vector<std::int32_t> m_mult;
+    std::vector<std::int32_t> m_shift;
+    // 256 entries lookup table of each node, indexed by the requantized weighted sum + 128 (unused for SUM, RELU)
+    std::vector<std::int8_t> m_luts;
+    std::vector<double> m_scales;
+    std::vector<unsigned> m_outputs;
+};
+
+} // end of namespace dcgp
+
+#endif // DCGP_QUANTIZED_ANN_H
@@ -0,0 +1,174 @@
+#ifndef DCGP_RACING_H
+#define DCGP_RACING_H
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <tbb/tbb.h>
+#include <type_traits>
+#include <vector>
+
+#include <dcgp/expression.hpp>
+
+namespace dcgp
+{
+
+namespace detail
+{
+// Checks the racing arguments and returns the loss type
+template <typename T>
+inline typename expression<T>::loss_type racing_checks(const std::vector<std::vector<T>> &points,
+                                                       const std::vector<std::vector<T>> &labels,
+                                                       const std::string &loss_s, unsigned first_subset)
+{
+    data_checks(points, labels);
+    if (first_subset == 0) {
+        throw std::invalid_argument("The size of the first data subset cannot be zero");
+    }
+    return decode_loss<T>(loss_s);
+}
+} // namespace detail
+
+/// Racing evaluation of the loss
+/**
+ * Evaluates the model loss on growing subsets of the data (the first \p first_subset points, then twice as many
+ * and so on) and stops as soon as the loss cannot be lower than \p incumbent. Since the loss of each point is
+ * non-negative (for the CE loss this requires non-negative labels), the partial sum of the losses divided by the
+ * whole data size is a lower bound of the loss and the race is stopped once it exceeds the incumbent.
+ *
+ * The bound is valid for any data ordering, but its effectiveness is not: sorted data (e.g. along one
+ * input) should be shuffled once before racing. A NaN partial loss also stops the race.
+ *
+ * @param[ex] The expression to evaluate.
+ * @param[points] The input data.
+ * @param[labels] The predicted outputs.
+ * @param[loss_s] The loss type. Can be "MSE" for Mean Square Error (regression) or "CE" for Cross Entropy
+ * (classification)
+ * @param[incumbent] The loss to beat (e.g. that of the parent).
+ * @param[first_subset] The size of the first data subset.
+ *
+ * @return the loss if lower or equal to \p incumbent, otherwise a value greater than \p incumbent (either the
+ * loss or a lower bound of it) or NaN.
+ *
+ * @throw std::invalid_argument if the data are inconsistent or the loss is unknown.
+ */
+template <typename T>
+T racing_loss(const expression<T> &ex, const std::vector<std::vector<T>> &points,
+              const std::vector<std::vector<T>> &labels, const std::string &loss_s, const T &incumbent,
+              unsigned first_subset = 64u)
+{
+    auto loss_e = detail::racing_checks(points, labels, loss_s, first_subset);
+    const auto N = points.size();
+    const double bound = detail::loss_value(incumbent) * static_cast<double>(N);
+    T retval(0.);
+    decltype(points.size()) i = 0u, checkpoint = std::min<decltype(points.size())>(first_subset, N);
+    while (true) {
+        for (; i < checkpoint; ++i) {
+            retval += ex.loss(points[i], labels[i], loss_e);
+        }
+        if (checkpoint == N || !(detail::loss_value(retval) <= bound)) {
+            break;
+        }
+        checkpoint = std::min(2u * checkpoint, N);
+    }
+    retval /= static_cast<double>(N);
+    return retval;
+}
+
+/// Racing evaluation of the loss of a population
+/**
+ * Evaluates the model loss of a population of expressions racing them on growing subsets of the data (see
+ * dcgp::racing_loss()). All surviving expressions are evaluated, in parallel, on the same subset, then the ones
+ * that cannot beat \p incumbent anymore are dropped. When \p eta is larger than one, each round also performs
+ * successive halving, keeping only the best 1 / \p eta (at least one) of the surviving expressions on the
+ * partial loss: this trades exactness (an expression dropped this way could have beaten the incumbent) for a
+ * further cut in the number of evaluations. As its partial loss could still be lower than \p incumbent, an
+ * expression dropped by the successive halving gets an infinite loss.
+ *
+ * @param[exs] The expressions to evaluate.
+ * @param[points] The input data.
+ * @param[labels] The predicted outputs.
+ * @param[loss_s] The loss type. Can be "MSE" for Mean Square Error (regression) or "CE" for Cross Entropy
+ * (classification)
+ * @param[incumbent] The loss to beat (e.g. that of the parent).
+ * @param[first_subset] The size of the first data subset.
+ * @param[eta] The successive halving rate. 1 -> no halving.
+ * @param[n_evaluated] If not null, it will contain the number of data points each expression was evaluated on.
+ *
+ * @return for each expression, the loss if it has been evaluated on the whole data, an infinite loss if it has
+ * been dropped by the successive halving, otherwise (dropped by the race) a lower bound of the loss, greater
+ * than \p incumbent, or NaN.
+ *
+ * @throw std::invalid_argument if the data are inconsistent, the loss is unknown or \p eta is zero.
+ */
+template <typename Expr, typename T>
+std::vector<T> racing_loss(const std::vector<Expr> &exs, const std::vector<std::vector<T>> &points,
+                           const std::vector<std::vector<T>> &labels, const std::string &loss_s, const T &incumbent,
+                           unsigned first_subset = 64u, unsigned eta = 1u,
+                           std::vector<unsigned> *n_evaluated = nullptr)
+{
+    static_assert(std::is_base_of<expression<T>, Expr>::value, "Only dCGP expressions can be raced");
+    auto loss_e = detail::racing_checks(points, labels, loss_s, first_subset);
+    if (eta == 0) {
+        throw std::invalid_argument("The successive halving rate cannot be zero");
+    }
+    const auto N = points.size();
+    const double bound = detail::loss_value(incumbent) * static_cast<double>(N);
+    std::vector<T> retval(exs.size(), T(0.));
+    std::vector<unsigned> n_eval(exs.size(), 0u);
+    // The expressions dropped by the successive halving
+    std::vector<bool> halved(exs.size(), false);
+    // The expressions still in the race
+    std::vector<unsigned> alive(exs.size());
+    std::iota(alive.begin(), alive.end(), 0u);
+    decltype(points.size()) start = 0u, checkpoint = std::min<decltype(points.size())>(first_subset, N);
+    while (alive.size() > 0u) {
+        tbb::parallel_for(0u, static_cast<unsigned>(alive.size()), [&](unsigned k) {
+            auto j = alive[k];
+            for (auto i = start; i < checkpoint; ++i) {
+                retval[j] += exs[j].loss(points[i], labels[i], loss_e);
+            }
+            n_eval[j] = static_cast<unsigned>(checkpoint);
+        });
+        if (checkpoint == N) {
+            break;
+        }
+        // Racing
+        alive.erase(std::remove_if(alive.begin(), alive.end(),
+                                   [&](unsigned j) { return !(detail::loss_value(retval[j]) <= bound); }),
+                    alive.end());
+        // Successive halving
+        if (eta > 1u) {
+            auto keep = std::max<decltype(alive.size())>(1u, alive.size() / eta);
+            if (keep < alive.size()) {
+                std::stable_sort(alive.begin(), alive.end(), [&retval](unsigned a, unsigned b) {
+                    return detail::loss_value(retval[a]) < detail::loss_value(retval[b]);
+                });
+                // Their partial loss could be lower than the incumbent, they get an infinite loss instead
+                for (auto k = keep; k < alive.size(); ++k) {
+                    halved[alive[k]] = true;
+                }
+                alive.resize(keep);
+            }
+        }
+        start = checkpoint;
+        checkpoint = std::min(2u * checkpoint, N);
+    }
+    for (decltype(retval.size()) j = 0u; j < retval.size(); ++j) {
+        if (halved[j]) {
+            retval[j] = T(std::numeric_limits<double>::infinity());
+        } else {
+            retval[j] /= static_cast<double>(N);
+        }
+    }
+    if (n_evaluated) {
+        *n_evaluated = n_eval;
+    }
+    return retval;
+}
+
+} // end of namespace dcgp
+
+#endif // DCGP_RACING_H
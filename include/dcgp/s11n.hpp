@@ -0,0 +1,18 @@
+#ifndef DCGP_S11N_H
+#define DCGP_S11N_H
+
+// Serialization of dCGP objects is based on Boost.Serialization. This header collects all
+// the includes that are needed to (de)serialize the dCGP classes, and the archives that are
+// commonly used with them (e.g. in dcgpy to support pickling).
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/base_object.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#endif // DCGP_S11N_H
@@ -0,0 +1,672 @@
+#ifndef DCGP_SIMPLIFIED_EXPRESSION_H
+#define DCGP_SIMPLIFIED_EXPRESSION_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <dcgp/s11n.hpp>
+#include <dcgp/wrapped_functions.hpp>
+
+namespace dcgp
+{
+
+/// A simplified dCGP expression
+/**
+ * This class represents the active graph of a dCGP expression after its algebraic simplification (see
+ * dcgp::expression::simplify()). Weights and biases become constants, which are then folded. Identities such as
+ * x * 1, x - x and x / x are eliminated, and the arguments of the commutative kernels are sorted. Identical
+ * subexpressions are then merged, so that each distinct one is computed only once. Values are stored in a register
+ * file: the first registers contain the inputs, the following ones the nodes in topological order.
+ *
+ * The identities hold for finite values: where the original expression is not finite (e.g. x / x at x = 0) the
+ * simplified one may differ. The object is immutable and all its methods are const and only use local buffers,
+ * hence it can be used concurrently from many threads.
+ */
+class simplified_expression
+{
+public:
+    /// Node operations (the kernels of dcgp::kernel_set and the constants)
+    enum class op : std::uint8_t {
+        /// A constant
+        CONST,
+        /// Sum
+        SUM,
+        /// Difference
+        DIFF,
+        /// Product
+        MUL,
+        /// Division
+        DIV,
+        /// Protected division
+        PDIV,
+        /// Sigmoid of the sum
+        SIG,
+        /// Hyperbolic tangent of the sum
+        TANH,
+        /// Rectified linear unit of the sum
+        RELU,
+        /// Exponential linear unit of the sum
+        ELU,
+        /// ISRU of the sum
+        ISRU,
+        /// Sine
+        SIN,
+        /// Cosine
+        COS,
+        /// Natural logarithm
+        LOG,
+        /// Exponential
+        EXP
+    };
+
+    /// Default constructor
+    /**
+     * Constructs an empty expression with no inputs and no outputs (e.g. to deserialize into).
+     */
+    simplified_expression() : m_n(0u), m_offsets(1u, 0u) {}
+
+    /// Constructor
+    /**
+     * Constructs the expression from its compiled representation. Registers [0, n) contain the inputs, register
+     * n + k the value of the k-th node.
+     *
+     * @param[in] n number of inputs.
+     * @param[in] ops the operation of each node.
+     * @param[in] constants the value of each node of type op::CONST (ignored for the other nodes).
+     * @param[in] offsets the arguments of the k-th node are in [offsets[k], offsets[k + 1]).
+     * @param[in] sources the register of each argument.
+     * @param[in] outputs the register of each output.
+     *
+     * @throw std::invalid_argument if the data are inconsistent, a node has the wrong number of arguments or is
+     * not fed by previous registers only.
+     */
+    simplified_expression(unsigned n, std::vector<op> ops, std::vector<double> constants, std::vector<unsigned> offsets,
+                          std::vector<unsigned> sources, std::vector<unsigned> outputs)
+        : m_n(n), m_ops(std::move(ops)), m_constants(std::move(constants)), m_offsets(std::move(offsets)),
+          m_sources(std::move(sources)), m_outputs(std::move(outputs))
+    {
+        check();
+    }
+
+    /// Evaluates the expression
+    /**
+     * @param[in] point the input values.
+     *
+     * @return the output values.
+     *
+     * @throw std::invalid_argument if the point dimension is wrong.
+     */
+    std::vector<double> operator()(const std::vector<double> &point) const
+    {
+        std::vector<double> regs, in, retval;
+        eval(point, regs, in, retval);
+        return retval;
+    }
+
+    /// Evaluates the expression on a batch
+    /**
+     * @param[in] points the input values.
+     *
+     * @return the output values for each point.
+     *
+     * @throw std::invalid_argument if a point dimension is wrong.
+     */
+    std::vector<std::vector<double>> operator()(const std::vector<std::vector<double>> &points) const
+    {
+        std::vector<std::vector<double>> retval(points.size());
+        std::vector<double> regs, in;
+        for (decltype(points.size()) i = 0u; i < points.size(); ++i) {
+            eval(points[i], regs, in, retval[i]);
+        }
+        return retval;
+    }
+
+    /// Symbolic representation
+    /**
+     * Builds the symbolic expression of each output with the same printing conventions as dcgp::expression. The
+     * constants are printed with all their significant digits.
+     *
+     * @param[in] in the symbols of the inputs.
+     *
+     * @return the symbolic expression of each output.
+     *
+     * @throw std::invalid_argument if the number of symbols is wrong.
+     */
+    std::vector<std::string> operator()(const std::vector<std::string> &in) const
+    {
+        if (in.size() != m_n) {
+            throw std::invalid_argument("Input size is incompatible, it was: " + std::to_string(in.size())
+                                        + " while I expected: " + std::to_string(m_n));
+        }
+        std::vector<std::string> regs(in), args;
+        for (auto k = 0u; k < get_n_nodes(); ++k) {
+            if (m_ops[k] == op::CONST) {
+                std::ostringstream ss;
+                ss.precision(std::numeric_limits<double>::max_digits10);
+                ss << m_constants[k];
+                regs.push_back(ss.str());
+                continue;
+            }
+            args.clear();
+            for (auto c = m_offsets[k]; c < m_offsets[k + 1u]; ++c) {
+                args.push_back(regs[m_sources[c]]);
+            }
+            regs.push_back(print(m_ops[k], args));
+        }
+        std::vector<std::string> retval;
+        for (auto o : m_outputs) {
+            retval.push_back(regs[o]);
+        }
+        return retval;
+    }
+
+    /// Gets the number of inputs
+    unsigned get_n() const
+    {
+        return m_n;
+    }
+
+    /// Gets the number of outputs
+    unsigned get_m() const
+    {
+        return static_cast<unsigned>(m_outputs.size());
+    }
+
+    /// Gets the number of nodes (constants included)
+    unsigned get_n_nodes() const
+    {
+        return static_cast<unsigned>(m_ops.size());
+    }
+
+    /// Gets the operations of the nodes
+    const std::vector<op> &get_ops() const
+    {
+        return m_ops;
+    }
+
+    /// Gets the values of the constant nodes
+    const std::vector<double> &get_constants() const
+    {
+        return m_constants;
+    }
+
+    /// Gets the argument offsets of the nodes
+    const std::vector<unsigned> &get_offsets() const
+    {
+        return m_offsets;
+    }
+
+    /// Gets the source registers of the arguments
+    const std::vector<unsigned> &get_sources() const
+    {
+        return m_sources;
+    }
+
+    /// Gets the output registers
+    const std::vector<unsigned> &get_outputs() const
+    {
+        return m_outputs;
+    }
+
+    /// Operation of a kernel
+    /**
+     * @param[in] kernel_name the name of a kernel of dcgp::kernel_set (e.g. "sum").
+     *
+     * @return the corresponding operation.
+     *
+     * @throw std::invalid_argument if the kernel is not one of dcgp::kernel_set.
+     */
+    static op from_name(const std::string &kernel_name)
+    {
+        static const std::map<std::string, op> ops{
+            {"sum", op::SUM},   {"diff", op::DIFF}, {"mul", op::MUL},   {"div", op::DIV},   {"pdiv", op::PDIV},
+            {"sig", op::SIG},   {"tanh", op::TANH}, {"ReLu", op::RELU}, {"ELU", op::ELU},   {"ISRU", op::ISRU},
+            {"sin", op::SIN},   {"cos", op::COS},   {"log", op::LOG},   {"exp", op::EXP}};
+        auto it = ops.find(kernel_name);
+        if (it == ops.end()) {
+            throw std::invalid_argument("The kernel " + kernel_name
+                                        + " is not one of the kernel set and cannot be simplified");
+        }
+        return it->second;
+    }
+
+    /// Checks if an operation is a function of the sum of its arguments
+    /**
+     * @param[in] o the operation.
+     *
+     * @return true for op::SUM and the activation functions (op::SIG, op::TANH, op::RELU, op::ELU and op::ISRU).
+     */
+    static bool is_sum_of_inputs(op o)
+    {
+        return o == op::SUM || o == op::SIG || o == op::TANH || o == op::RELU || o == op::ELU || o == op::ISRU;
+    }
+
+    /// Applies an operation
+    /**
+     * @param[in] o the operation (not op::CONST).
+     * @param[in] in the values of the arguments.
+     *
+     * @return the value of the kernel of \p o in \p in.
+     */
+    static double apply(op o, const std::vector<double> &in)
+    {
+        switch (o) {
+            case op::SUM:
+                return my_sum(in);
+            case op::DIFF:
+                return my_diff(in);
+            case op::MUL:
+                return my_mul(in);
+            case op::DIV:
+                return my_div(in);
+            case op::PDIV:
+                return my_pdiv(in);
+            case op::SIG:
+                return my_sig(in);
+            case op::TANH:
+                return my_tanh(in);
+            case op::RELU:
+                return my_relu(in);
+            case op::ELU:
+                return my_elu(in);
+            case op::ISRU:
+                return my_isru(in);
+            case op::SIN:
+                return my_sin(in);
+            case op::COS:
+                return my_cos(in);
+            case op::LOG:
+                return my_log(in);
+            case op::EXP:
+                return my_exp(in);
+            case op::CONST:
+                break;
+        }
+        throw std::invalid_argument("A constant cannot be applied");
+    }
+
+private:
+    // Prints an operation
+    static std::string print(op o, const std::vector<std::string> &in)
+    {
+        switch (o) {
+            case op::SUM:
+                return print_my_sum(in);
+            case op::DIFF:
+                return print_my_diff(in);
+            case op::MUL:
+                return print_my_mul(in);
+            case op::DIV:
+                return print_my_div(in);
+            case op::PDIV:
+                return print_my_pdiv(in);
+            case op::SIG:
+                return print_my_sig(in);
+            case op::TANH:
+                return print_my_tanh(in);
+            case op::RELU:
+                return print_my_relu(in);
+            case op::ELU:
+                return print_my_elu(in);
+            case op::ISRU:
+                return print_my_isru(in);
+            case op::SIN:
+                return print_my_sin(in);
+            case op::COS:
+                return print_my_cos(in);
+            case op::LOG:
+                return print_my_log(in);
+            case op::EXP:
+                return print_my_exp(in);
+            case op::CONST:
+                break;
+        }
+        throw std::invalid_argument("A constant cannot be printed as an operation");
+    }
+
+    // Evaluates a point reusing the buffers regs and in
+    void eval(const std::vector<double> &point, std::vector<double> &regs, std::vector<double> &in,
+              std::vector<double> &out) const
+    {
+        if (point.size() != m_n) {
+            throw std::invalid_argument("Input size is incompatible, it was: " + std::to_string(point.size())
+                                        + " while I expected: " + std::to_string(m_n));
+        }
+        regs.resize(m_n + m_ops.size());
+        std::copy(point.begin(), point.end(), regs.begin());
+        for (auto k = 0u; k < get_n_nodes(); ++k) {
+            const auto b = m_offsets[k], e = m_offsets[k + 1u];
+            double &r = regs[m_n + k];
+            // The arithmetic kernels are computed on the registers, in the same order as in dcgp::kernel_set
+            switch (m_ops[k]) {
+                case op::CONST:
+                    r = m_constants[k];
+                    continue;
+                case op::SUM:
+                    r = regs[m_sources[b]];
+                    for (auto c = b + 1u; c < e; ++c) {
+                        r += regs[m_sources[c]];
+                    }
+                    continue;
+                case op::DIFF:
+                    r = regs[m_sources[b]];
+                    for (auto c = b + 1u; c < e; ++c) {
+                        r -= regs[m_sources[c]];
+                    }
+                    continue;
+                case op::MUL:
+                    r = regs[m_sources[b]];
+                    for (auto c = b + 1u; c < e; ++c) {
+                        r *= regs[m_sources[c]];
+                    }
+                    continue;
+                case op::DIV:
+                    r = regs[m_sources[b]];
+                    for (auto c = b + 1u; c < e; ++c) {
+                        r /= regs[m_sources[c]];
+                    }
+                    continue;
+                default:
+                    break;
+            }
+            in.clear();
+            for (auto c = b; c < e; ++c) {
+                in.push_back(regs[m_sources[c]]);
+            }
+            r = apply(m_ops[k], in);
+        }
+        out.resize(m_outputs.size());
+        for (decltype(m_outputs.size()) i = 0u; i < m_outputs.size(); ++i) {
+            out[i] = regs[m_outputs[i]];
+        }
+    }
+
+    // Checks the consistency of the data
+    void check() const
+    {
+        const auto K = m_ops.size();
+        if (m_offsets.size() != K + 1u || m_offsets[0] != 0u || m_offsets.back() != m_sources.size()
+            || m_constants.size() != K) {
+            throw std::invalid_argument("The sizes of the simplified expression data are inconsistent");
+        }
+        for (decltype(m_ops.size()) k = 0u; k < K; ++k) {
+            if (static_cast<unsigned>(m_ops[k]) > static_cast<unsigned>(op::EXP)) {
+                throw std::invalid_argument("Unknown operation for node " + std::to_string(k));
+            }
+            auto n_args = m_offsets[k + 1u] - m_offsets[k];
+            if (m_offsets[k + 1u] < m_offsets[k] || (m_ops[k] == op::CONST) != (n_args == 0u)
+                || (m_ops[k] == op::PDIV && n_args < 2u)) {
+                throw std::invalid_argument("Node " + std::to_string(k) + " has the wrong number of arguments");
+            }
+            for (auto c = m_offsets[k]; c < m_offsets[k + 1u]; ++c) {
+                if (m_sources[c] >= m_n + k) {
+                    throw std::invalid_argument("Node " + std::to_string(k) + " is fed by register "
+                                                + std::to_string(m_sources[c])
+                                                + ", which is not an input nor a previous node");
+                }
+            }
+        }
+        for (auto o : m_outputs) {
+            if (o >= m_n + K) {
+                throw std::invalid_argument("The output register " + std::to_string(o) + " does not exist");
+            }
+        }
+    }
+
+    friend class boost::serialization::access;
+    template <typename Archive>
+    void save(Archive &ar, const unsigned) const
+    {
+        std::vector<unsigned> ops(m_ops.size());
+        std::transform(m_ops.begin(), m_ops.end(), ops.begin(), [](op o) { return static_cast<unsigned>(o); });
+        ar << m_n;
+        ar << ops;
+        ar << m_constants;
+        ar << m_offsets;
+        ar << m_sources;
+        ar << m_outputs;
+    }
+    template <typename Archive>
+    void load(Archive &ar, const unsigned)
+    {
+        unsigned n;
+        std::vector<unsigned> ops, offsets, sources, outputs;
+        std::vector<double> constants;
+        ar >> n;
+        ar >> ops;
+        ar >> constants;
+        ar >> offsets;
+        ar >> sources;
+        ar >> outputs;
+        std::vector<op> ops_e(ops.size());
+        std::transform(ops.begin(), ops.end(), ops_e.begin(), [](unsigned o) {
+            if (o > static_cast<unsigned>(op::EXP)) {
+                throw std::invalid_argument("Unknown operation: " + std::to_string(o));
+            }
+            return static_cast<op>(o);
+        });
+        // We check the data before modifying the object
+        *this = simplified_expression(n, std::move(ops_e), std::move(constants), std::move(offsets),
+                                      std::move(sources), std::move(outputs));
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    unsigned m_n;
+    std::vector<op> m_ops;
+    std::vector<double> m_constants;
+    std::vector<unsigned> m_offsets;
+    std::vector<unsigned> m_sources;
+    std::vector<unsigned> m_outputs;
+};
+
+namespace detail
+{
+// Builds a simplified_expression node by node (in topological order), applying the simplification rules and
+// merging the nodes having the same operation and arguments. Nodes are identified by their register.
+class simplifier
+{
+    using op = simplified_expression::op;
+
+public:
+    explicit simplifier(unsigned n) : m_n(n) {}
+
+    // A constant node
+    unsigned constant(double c)
+    {
+        return add(op::CONST, c, {});
+    }
+
+    // A node applying o to args (simplified)
+    unsigned node(op o, std::vector<unsigned> args)
+    {
+        // These kernels discard all inputs except the first one
+        if (o == op::SIN || o == op::COS || o == op::LOG || o == op::EXP) {
+            args.resize(1u);
+        }
+        if (std::all_of(args.begin(), args.end(), [this](unsigned a) { return is_const(a); })) {
+            return fold(o, args);
+        }
+        switch (o) {
+            case op::MUL: {
+                auto c = merge_constants(args, 1., [](double a, double b) { return a * b; });
+                if (c == 0.) {
+                    return constant(0.);
+                }
+                if (args.size() == 1u) {
+                    return args[0];
+                }
+                std::sort(args.begin(), args.end());
+                break;
+            }
+            case op::SUM:
+            case op::SIG:
+            case op::TANH:
+            case op::RELU:
+            case op::ELU:
+            case op::ISRU: {
+                merge_constants(args, 0., [](double a, double b) { return a + b; });
+                if (o == op::SUM && args.size() == 1u) {
+                    return args[0];
+                }
+                std::sort(args.begin(), args.end());
+                break;
+            }
+            case op::DIFF:
+            case op::DIV:
+            case op::PDIV: {
+                // The first argument minus (divided by) the commutative others
+                const double neutral = (o == op::DIFF) ? 0. : 1.;
+                auto a = args[0];
+                std::vector<unsigned> rest(args.begin() + 1, args.end());
+                // x - x = 0, x / x = 1
+                auto it = std::find(rest.begin(), rest.end(), a);
+                if (it != rest.end()) {
+                    rest.erase(it);
+                    a = constant(neutral);
+                }
+                if (o == op::DIFF) {
+                    merge_constants(rest, neutral, [](double x, double y) { return x + y; });
+                } else {
+                    merge_constants(rest, neutral, [](double x, double y) { return x * y; });
+                    // 0 / x = 0 (but not for the protected division, where 0 / 0 = 1)
+                    if (o == op::DIV && is_const(a) && m_constants[a - m_n] == 0.) {
+                        return a;
+                    }
+                }
+                if (rest.empty()) {
+                    return a;
+                }
+                std::sort(rest.begin(), rest.end());
+                args.assign(1u, a);
+                args.insert(args.end(), rest.begin(), rest.end());
+                if (std::all_of(args.begin(), args.end(), [this](unsigned x) { return is_const(x); })) {
+                    return fold(o, args);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        return add(o, 0., std::move(args));
+    }
+
+    // The simplified_expression computing the nodes outputs, without the nodes they do not depend on
+    simplified_expression finish(const std::vector<unsigned> &outputs) const
+    {
+        const auto K = static_cast<unsigned>(m_ops.size());
+        std::vector<char> used(K, 0);
+        for (auto o : outputs) {
+            if (o >= m_n) {
+                used[o - m_n] = 1;
+            }
+        }
+        for (auto k = K; k-- > 0u;) {
+            if (used[k]) {
+                for (auto a : m_args[k]) {
+                    if (a >= m_n) {
+                        used[a - m_n] = 1;
+                    }
+                }
+            }
+        }
+        std::vector<unsigned> reg(m_n + K);
+        for (auto i = 0u; i < m_n; ++i) {
+            reg[i] = i;
+        }
+        std::vector<op> ops;
+        std::vector<double> constants;
+        std::vector<unsigned> offsets(1u, 0u), sources, outs;
+        for (auto k = 0u; k < K; ++k) {
+            if (!used[k]) continue;
+            reg[m_n + k] = m_n + static_cast<unsigned>(ops.size());
+            ops.push_back(m_ops[k]);
+            constants.push_back(m_constants[k]);
+            for (auto a : m_args[k]) {
+                sources.push_back(reg[a]);
+            }
+            offsets.push_back(static_cast<unsigned>(sources.size()));
+        }
+        for (auto o : outputs) {
+            outs.push_back(reg[o]);
+        }
+        return simplified_expression(m_n, std::move(ops), std::move(constants), std::move(offsets),
+                                     std::move(sources), std::move(outs));
+    }
+
+private:
+    bool is_const(unsigned a) const
+    {
+        return a >= m_n && m_ops[a - m_n] == op::CONST;
+    }
+
+    // Folds an operation on constant arguments
+    unsigned fold(op o, const std::vector<unsigned> &args)
+    {
+        std::vector<double> in;
+        for (auto a : args) {
+            in.push_back(m_constants[a - m_n]);
+        }
+        return constant(simplified_expression::apply(o, in));
+    }
+
+    // Merges the constant arguments into one (dropped if equal to neutral), returning its value
+    template <typename F>
+    double merge_constants(std::vector<unsigned> &args, double neutral, const F &f)
+    {
+        double c = neutral;
+        std::vector<unsigned> others;
+        for (auto a : args) {
+            if (is_const(a)) {
+                c = f(c, m_constants[a - m_n]);
+            } else {
+                others.push_back(a);
+            }
+        }
+        if (c != neutral) {
+            others.push_back(constant(c));
+        }
+        args = std::move(others);
+        return c;
+    }
+
+    // Adds a node, unless an identical one exists
+    unsigned add(op o, double c, std::vector<unsigned> args)
+    {
+        // Constants are identified by their bits, so that e.g. nans are merged too
+        std::uint64_t bits = 0u;
+        if (o == op::CONST) {
+            static_assert(sizeof(double) == sizeof(std::uint64_t), "Unexpected size of a double");
+            std::memcpy(&bits, &c, sizeof(double));
+        }
+        auto key = std::make_tuple(static_cast<unsigned>(o), bits, args);
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            return it->second;
+        }
+        auto retval = m_n + static_cast<unsigned>(m_ops.size());
+        m_ops.push_back(o);
+        m_constants.push_back((o == op::CONST) ? c : 0.);
+        m_args.push_back(std::move(args));
+        m_index.emplace(std::move(key), retval);
+        return retval;
+    }
+
+    unsigned m_n;
+    std::vector<op> m_ops;
+    std::vector<double> m_constants;
+    std::vector<std::vector<unsigned>> m_args;
+    std::map<std::tuple<unsigned, std::uint64_t, std::vector<unsigned>>, unsigned> m_index;
+};
+} // namespace detail
+
+} // end of namespace dcgp
+
+#endif // DCGP_SIMPLIFIED_EXPRESSION_H
@@ -0,0 +1,211 @@
+#ifndef DCGP_STEADY_STATE_H
+#define DCGP_STEADY_STATE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/spin_mutex.h>
+#include <tbb/task_arena.h>
+#include <tbb/tbb.h>
+#include <utility>
+#include <vector>
+
+namespace dcgp
+{
+
+/// Steady-state asynchronous evolution of dCGP expressions
+/**
+ * Evolves a population of dCGP expressions without generations. Each offspring evaluation is a TBB task: it
+ * picks a parent by tournament selection from the shared population, mutates its active genes, evaluates it and
+ * inserts it back replacing the worst individual (if not worse). On completion each task spawns a new one, so
+ * that a pool of pending evaluations is always available and idle workers steal them as soon as they are free.
+ * Contrary to a generational loop, no worker waits for the slowest evaluation, which keeps all cores busy when
+ * evaluation times are heterogeneous (e.g. with gduals of high order, or expressions of very different size).
+ *
+ * As the insertion order depends on the scheduling, results are not reproducible across runs when
+ * evaluations happen in parallel.
+ */
+class steady_state
+{
+public:
+    /// The outcome of an evolution: the final population
+    struct population {
+        /// Chromosomes of the final population, sorted from the best to the worst
+        std::vector<std::vector<unsigned>> m_chromosomes;
+        /// The corresponding fitness
+        std::vector<double> m_fitness;
+    };
+
+    /// Constructor
+    /**
+     * Constructs the steady-state algorithm.
+     *
+     * @param[in] n_evals number of offspring evaluations (the evaluation budget).
+     * @param[in] pop_size population size.
+     * @param[in] n_mutations number of active genes mutated to create an offspring.
+     * @param[in] seed seed for the random number generator.
+     *
+     * @throw std::invalid_argument if \p pop_size is smaller than 2 or \p n_mutations is zero.
+     */
+    steady_state(unsigned n_evals, unsigned pop_size, unsigned n_mutations = 1u,
+                 std::random_device::result_type seed = std::random_device{}())
+        : m_n_evals(n_evals), m_pop_size(pop_size), m_n_mutations(n_mutations), m_e(seed)
+    {
+        if (pop_size < 2u) {
+            throw std::invalid_argument("The population size must be at least 2, while " + std::to_string(pop_size)
+                                        + " was detected");
+        }
+        if (n_mutations == 0u) {
+            throw std::invalid_argument("The number of mutations must be at least 1");
+        }
+    }
+
+    /// Evolves the expression
+    /**
+     * Runs the steady-state evolution starting from a population made of \p ex and of random chromosomes.
+     *
+     * @param[in] ex the initial expression, its chromosome is part of the initial population.
+     * @param[in] fitness a callable returning the fitness (to be minimized) of an expression of type \p Expr.
+     * It is called concurrently on distinct expressions and must thus be thread-safe. It may itself use TBB
+     * (e.g. a parallel loss): each evaluation is run in an isolated region, so that a waiting thread does not
+     * start another evaluation on the same expression. NaNs are considered as the worst possible fitness.
+     * @param[in] n_tasks maximum number of evaluations pending at any time. 0 -> twice the concurrency
+     * of the current task arena. 1 -> serial evolution (reproducible).
+     *
+     * @return the final population.
+     */
+    template <typename Expr, typename F>
+    population evolve(const Expr &ex, const F &fitness, unsigned n_tasks = 0u)
+    {
+        if (n_tasks == 0u) {
+            n_tasks = 2u * static_cast<unsigned>(tbb::this_task_arena::max_concurrency());
+        }
+        auto safe_fitness = [&fitness](const Expr &e) {
+            double f = fitness(e);
+            return std::isnan(f) ? std::numeric_limits<double>::infinity() : f;
+        };
+        const auto N = m_pop_size;
+        population pop;
+        pop.m_chromosomes = std::vector<std::vector<unsigned>>(N, ex.get());
+        pop.m_fitness = std::vector<double>(N);
+        // The initial population: ex and random chromosomes within the bounds
+        const auto &lb = ex.get_lb();
+        const auto &ub = ex.get_ub();
+        for (auto i = 1u; i < N; ++i) {
+            for (decltype(lb.size()) j = 0u; j < lb.size(); ++j) {
+                pop.m_chromosomes[i][j] = std::uniform_int_distribution<unsigned>(lb[j], ub[j])(m_e);
+            }
+        }
+        // Each worker thread reuses its own copy of the expression. A thread waiting inside a fitness that
+        // uses TBB could otherwise steal another evaluation and modify its expression while it is being
+        // evaluated: the use of the expression is thus isolated.
+        tbb::enumerable_thread_specific<Expr> exs(ex);
+        tbb::parallel_for(0u, N, [&](unsigned i) {
+            tbb::this_task_arena::isolate([&]() {
+                auto &e = exs.local();
+                e.set(pop.m_chromosomes[i]);
+                pop.m_fitness[i] = safe_fitness(e);
+            });
+        });
+
+        // The mutex that protects the population and the random engine
+        tbb::spin_mutex mutex_pop;
+        std::atomic<unsigned> n_started(0u);
+        tbb::task_group tg;
+        std::function<void()> step = [&]() {
+            std::vector<unsigned> x;
+            std::mt19937::result_type seed;
+            {
+                tbb::spin_mutex::scoped_lock lock(mutex_pop);
+                x = pop.m_chromosomes[tournament(pop.m_fitness)];
+                seed = m_e();
+            }
+            double f;
+            tbb::this_task_arena::isolate([&]() {
+                auto &e = exs.local();
+                e.set(x);
+                e.seed(seed);
+                e.mutate_active(m_n_mutations);
+                f = safe_fitness(e);
+                x = e.get();
+            });
+            {
+                tbb::spin_mutex::scoped_lock lock(mutex_pop);
+                auto worst = static_cast<unsigned>(
+                    std::max_element(pop.m_fitness.begin(), pop.m_fitness.end()) - pop.m_fitness.begin());
+                // Replacing also on equal fitness allows neutral drift, which is beneficial in CGP
+                if (f <= pop.m_fitness[worst]) {
+                    pop.m_chromosomes[worst] = std::move(x);
+                    pop.m_fitness[worst] = f;
+                }
+            }
+            // The evaluation is over, we keep the pool of pending evaluations full
+            if (n_started.fetch_add(1u) < m_n_evals) {
+                tg.run(step);
+            }
+        };
+        for (auto i = 0u; i < n_tasks; ++i) {
+            if (n_started.fetch_add(1u) < m_n_evals) {
+                tg.run(step);
+            }
+        }
+        tg.wait();
+
+        // We sort the final population, best first
+        std::vector<unsigned> idx(N);
+        std::iota(idx.begin(), idx.end(), 0u);
+        std::stable_sort(idx.begin(), idx.end(),
+                         [&pop](unsigned a, unsigned b) { return pop.m_fitness[a] < pop.m_fitness[b]; });
+        population retval;
+        for (auto i : idx) {
+            retval.m_chromosomes.push_back(pop.m_chromosomes[i]);
+            retval.m_fitness.push_back(pop.m_fitness[i]);
+        }
+        return retval;
+    }
+
+    /// Gets the number of offspring evaluations
+    unsigned get_n_evals() const
+    {
+        return m_n_evals;
+    }
+
+    /// Gets the population size
+    unsigned get_pop_size() const
+    {
+        return m_pop_size;
+    }
+
+    /// Gets the number of mutations
+    unsigned get_n_mutations() const
+    {
+        return m_n_mutations;
+    }
+
+private:
+    // Binary tournament (to be called holding the population lock)
+    unsigned tournament(const std::vector<double> &fits)
+    {
+        auto N = static_cast<unsigned>(fits.size());
+        auto a = std::uniform_int_distribution<unsigned>(0u, N - 1u)(m_e);
+        auto b = std::uniform_int_distribution<unsigned>(0u, N - 2u)(m_e);
+        if (b >= a) ++b;
+        return fits[a] <= fits[b] ? a : b;
+    }
+
+    unsigned m_n_evals;
+    unsigned m_pop_size;
+    unsigned m_n_mutations;
+    std::mt19937 m_e;
+};
+
+} // end of namespace dcgp
+
+#endif // DCGP_STEADY_STATE_H
@@ -0,0 +1,284 @@
+#ifndef DCGP_SYMBOLIC_DAG_H
+#define DCGP_SYMBOLIC_DAG_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dcgp
+{
+
+/// The symbolic representation of a dCGP expression as a DAG
+/**
+ * The symbolic output of dcgp::expression (its call operator on strings) repeats the text of a node for each of its
+ * uses, so that its size can grow exponentially with the depth of the graph. This class, returned by
+ * dcgp::expression::symbolic(), stores instead the text of each active node once, in terms of the names of its
+ * arguments, and has thus a size linear in that of the graph. It can be printed in a let-bound form, each node being
+ * defined after its arguments:
+ *
+ * @code
+ * u2 = (x*y)
+ * u3 = sin(u2)
+ * u4 = (u2+u3)
+ * o0 = u4
+ * @endcode
+ *
+ * The full symbolic expressions of the outputs, identical to those of the call operator, are only built on request
+ * by dcgp::symbolic_dag::flatten().
+ *
+ * Values are referenced by registers: the first registers are the inputs, the following ones the nodes in
+ * topological order. The text of a node is made of fragments alternating with the registers of its arguments.
+ */
+class symbolic_dag
+{
+public:
+    /// A node of the DAG
+    struct node {
+        /// The name of the node
+        std::string name;
+        /// The text fragments of the node (one more than its arguments)
+        std::vector<std::string> parts;
+        /// The registers of the arguments, the j-th being written between parts[j] and parts[j + 1]
+        std::vector<unsigned> args;
+    };
+
+    /// Default constructor
+    /**
+     * Constructs an empty DAG with no inputs and no outputs.
+     */
+    symbolic_dag() = default;
+
+    /// Constructor
+    /**
+     * @param[in] inputs the symbols of the inputs.
+     * @param[in] nodes the nodes, in topological order.
+     * @param[in] outputs the register of each output.
+     *
+     * @throw std::invalid_argument if a node has not one more fragment than arguments, if it is not fed by previous
+     * registers only, if an output register does not exist or if a node name is also an input symbol.
+     */
+    symbolic_dag(std::vector<std::string> inputs, std::vector<node> nodes, std::vector<unsigned> outputs)
+        : m_inputs(std::move(inputs)), m_nodes(std::move(nodes)), m_outputs(std::move(outputs))
+    {
+        check();
+    }
+
+    /// Gets the number of inputs
+    unsigned get_n() const
+    {
+        return static_cast<unsigned>(m_inputs.size());
+    }
+
+    /// Gets the number of outputs
+    unsigned get_m() const
+    {
+        return static_cast<unsigned>(m_outputs.size());
+    }
+
+    /// Gets the number of nodes
+    unsigned get_n_nodes() const
+    {
+        return static_cast<unsigned>(m_nodes.size());
+    }
+
+    /// Gets the input symbols
+    const std::vector<std::string> &get_inputs() const
+    {
+        return m_inputs;
+    }
+
+    /// Gets the nodes
+    const std::vector<node> &get_nodes() const
+    {
+        return m_nodes;
+    }
+
+    /// Gets the output registers
+    const std::vector<unsigned> &get_outputs() const
+    {
+        return m_outputs;
+    }
+
+    /// Gets the name of a register
+    /**
+     * @param[in] reg a register.
+     *
+     * @return the input symbol or the node name of \p reg.
+     *
+     * @throw std::invalid_argument if \p reg does not exist.
+     */
+    const std::string &get_name(unsigned reg) const
+    {
+        if (reg >= get_n() + get_n_nodes()) {
+            throw std::invalid_argument("The register " + std::to_string(reg) + " does not exist");
+        }
+        return (reg < get_n()) ? m_inputs[reg] : m_nodes[reg - get_n()].name;
+    }
+
+    /// Gets the definition of a node
+    /**
+     * @param[in] k the index of the node.
+     *
+     * @return the text of the node \p k in terms of the names of its arguments.
+     *
+     * @throw std::invalid_argument if the node does not exist.
+     */
+    std::string get_definition(unsigned k) const
+    {
+        if (k >= get_n_nodes()) {
+            throw std::invalid_argument("The node " + std::to_string(k) + " does not exist");
+        }
+        std::string retval(m_nodes[k].parts[0]);
+        for (decltype(m_nodes[k].args.size()) j = 0u; j < m_nodes[k].args.size(); ++j) {
+            retval += get_name(m_nodes[k].args[j]);
+            retval += m_nodes[k].parts[j + 1u];
+        }
+        return retval;
+    }
+
+    /// The let-bound textual form
+    /**
+     * Writes one line per node, defining it in terms of the names of its arguments, followed by one line per output.
+     * The size of the result is linear in that of the DAG.
+     *
+     * @param[in] output_prefix the prefix of the outputs names (followed by their index).
+     *
+     * @return the let-bound form of the DAG.
+     */
+    std::string to_string(const std::string &output_prefix = "o") const
+    {
+        std::string retval;
+        for (auto k = 0u; k < get_n_nodes(); ++k) {
+            retval += m_nodes[k].name + " = " + get_definition(k) + "\n";
+        }
+        for (auto i = 0u; i < get_m(); ++i) {
+            retval += output_prefix + std::to_string(i) + " = " + get_name(m_outputs[i]) + "\n";
+        }
+        return retval;
+    }
+
+    /// Flattens the DAG
+    /**
+     * Builds the full symbolic expression of each output, substituting recursively the text of the nodes to their
+     * names. The result is that of the call operator of the expression on the input symbols, hence its size can
+     * grow exponentially with the depth of the DAG.
+     *
+     * @return the symbolic expression of each output.
+     */
+    std::vector<std::string> flatten() const
+    {
+        std::vector<std::string> regs(m_inputs);
+        regs.reserve(get_n() + get_n_nodes());
+        for (const auto &nd : m_nodes) {
+            std::string text(nd.parts[0]);
+            for (decltype(nd.args.size()) j = 0u; j < nd.args.size(); ++j) {
+                text += regs[nd.args[j]];
+                text += nd.parts[j + 1u];
+            }
+            regs.push_back(std::move(text));
+        }
+        std::vector<std::string> retval;
+        for (auto o : m_outputs) {
+            retval.push_back(regs[o]);
+        }
+        return retval;
+    }
+
+    /// The placeholder of an argument
+    /**
+     * A node is built by rendering its kernel with placeholders as inputs (see dcgp::symbolic_dag::make_node()).
+     *
+     * @param[in] j the index of the argument.
+     *
+     * @return the placeholder of the argument \p j.
+     */
+    static std::string placeholder(unsigned j)
+    {
+        return "\x1f" + std::to_string(j) + "\x1f";
+    }
+
+    /// Builds a node from a rendering
+    /**
+     * @param[in] name the name of the node.
+     * @param[in] text the text of the node, where the j-th argument is written as its placeholder.
+     * @param[in] args the register of each argument.
+     *
+     * @return the node, splitting \p text at the placeholders.
+     *
+     * @throw std::invalid_argument if a placeholder is malformed or does not refer to an argument.
+     */
+    static node make_node(std::string name, const std::string &text, const std::vector<unsigned> &args)
+    {
+        node retval{std::move(name), {}, {}};
+        std::string::size_type pos = 0u;
+        while (true) {
+            auto b = text.find('\x1f', pos);
+            retval.parts.push_back(text.substr(pos, b - pos));
+            if (b == std::string::npos) {
+                break;
+            }
+            auto e = text.find('\x1f', b + 1u);
+            if (e == std::string::npos || e == b + 1u
+                || !std::all_of(text.begin() + static_cast<std::ptrdiff_t>(b + 1u),
+                                text.begin() + static_cast<std::ptrdiff_t>(e),
+                                [](char c) { return c >= '0' && c <= '9'; })) {
+                throw std::invalid_argument("Malformed argument placeholder in the text of the node " + retval.name);
+            }
+            auto j = std::stoul(text.substr(b + 1u, e - b - 1u));
+            if (j >= args.size()) {
+                throw std::invalid_argument("The node " + retval.name + " refers to the argument " + std::to_string(j)
+                                            + ", but it has " + std::to_string(args.size()));
+            }
+            retval.args.push_back(args[j]);
+            pos = e + 1u;
+        }
+        return retval;
+    }
+
+    /// Streams the let-bound form of the DAG
+    friend std::ostream &operator<<(std::ostream &os, const symbolic_dag &d)
+    {
+        os << d.to_string();
+        return os;
+    }
+
+private:
+    // Checks the consistency of the data
+    void check() const
+    {
+        std::vector<std::string> sorted_inputs(m_inputs);
+        std::sort(sorted_inputs.begin(), sorted_inputs.end());
+        for (auto k = 0u; k < get_n_nodes(); ++k) {
+            const auto &nd = m_nodes[k];
+            if (nd.parts.size() != nd.args.size() + 1u) {
+                throw std::invalid_argument("The node " + nd.name + " must have one more fragment than arguments");
+            }
+            for (auto a : nd.args) {
+                if (a >= get_n() + k) {
+                    throw std::invalid_argument("The node " + nd.name + " is fed by register " + std::to_string(a)
+                                                + ", which is not an input nor a previous node");
+                }
+            }
+            if (std::binary_search(sorted_inputs.begin(), sorted_inputs.end(), nd.name)) {
+                throw std::invalid_argument("The node name " + nd.name + " is also an input symbol");
+            }
+        }
+        for (auto o : m_outputs) {
+            if (o >= get_n() + get_n_nodes()) {
+                throw std::invalid_argument("The output register " + std::to_string(o) + " does not exist");
+            }
+        }
+    }
+
+    std::vector<std::string> m_inputs;
+    std::vector<node> m_nodes;
+    std::vector<unsigned> m_outputs;
+};
+
+} // end of namespace dcgp
+
+#endif // DCGP_SYMBOLIC_DAG_H
@@ -12,4 +12,20 @@
 template <typename T> struct is_gdual : std::false_type {};
 template <typename T> struct is_gdual<audi::gdual<T>> : std::true_type {};
 
+namespace dcgp
+{
+template <unsigned N> class dual;
+} // namespace dcgp
+
+/// Type is a dual
+/**
+ * Checks whether T is a dcgp::dual type. Provides the member constant value which is
+ * equal to true, if T is the type dcgp::dual<N> for any N.
+ *
+ * \tparam T a type to check
+ */
+
+template <typename T> struct is_dual : std::false_type {};
+template <unsigned N> struct is_dual<dcgp::dual<N>> : std::true_type {};
+
 #endif // DCGP_TYPE_TRAITS_H
@@ -1,12 +1,14 @@
 #ifndef DCGP_WRAPPED_FUNCTIONS_H
 #define DCGP_WRAPPED_FUNCTIONS_H
 
+#include <algorithm>
 #include <audi/audi.hpp>
 #include <audi/functions.hpp>
 #include <cmath>
 #include <string>
 #include <vector>
 
+#include <dcgp/dual.hpp>
 #include <dcgp/type_traits.hpp>
 
 using namespace audi;
@@ -16,11 +18,13 @@ namespace dcgp
 
 // SFINAE dust (to hide under the carpet). Its used to enable the templated
 // version of the various functions that can construct a kernel object. Only for
-// double and a gdual type Complex could also be allowed.
+// double, a gdual and a dual type Complex could also be allowed.
 template <typename T>
-using f_enabler = typename std::enable_if<std::is_same<T, double>::value || is_gdual<T>::value, int>::type;
+using f_enabler =
+    typename std::enable_if<std::is_same<T, double>::value || is_gdual<T>::value || is_dual<T>::value, int>::type;
 
-// Allows to overload in templates std functions with audi functions
+// Allows to overload in templates std functions with audi functions (the dual functions
+// are instead found by argument dependent lookup, hence the unqualified calls)
 using namespace audi;
 
 /*--------------------------------------------------------------------------
@@ -104,6 +108,26 @@ inline T my_pdiv(const std::vector<T> &in)
     return 1.;
 }
 
+// protected division (dual overload):
+template <typename T, typename std::enable_if<is_dual<T>::value, int>::type = 0>
+inline T my_pdiv(const std::vector<T> &in)
+{
+    T retval(in[0]);
+    T tmpval(in[1]);
+
+    for (auto i = 2u; i < in.size(); ++i) {
+        tmpval *= in[i];
+    }
+
+    retval /= tmpval;
+
+    if (std::isfinite(retval.value())) {
+        return retval;
+    }
+
+    return T(1.);
+}
+
 // protected division (gdual overload):
 template <typename T, typename std::enable_if<is_gdual<T>::value, int>::type = 0>
 inline T my_pdiv(const std::vector<T> &in)
@@ -134,7 +158,7 @@ inline T my_sig(const std::vector<T> &in)
     for (auto i = 1u; i < in.size(); ++i) {
         retval += in[i];
     }
-    return 1. / (1. + audi::exp(-retval));
+    return 1. / (1. + exp(-retval));
 }
 
 inline std::string print_my_sig(const std::vector<std::string> &in)
@@ -154,7 +178,7 @@ inline T my_tanh(const std::vector<T> &in)
     for (auto i = 1u; i < in.size(); ++i) {
         retval += in[i];
     }
-    return audi::tanh(retval);
+    return tanh(retval);
 }
 
 inline std::string print_my_tanh(const std::vector<std::string> &in)
@@ -166,8 +190,9 @@ inline std::string print_my_tanh(const std::vector<std::string> &in)
     return "tanh(" + retval + ")";
 }
 
-// ReLu function (double overload):
-template <typename T, typename std::enable_if<std::is_same<T, double>::value, int>::type = 0>
+// ReLu function (double and dual overload):
+template <typename T,
+          typename std::enable_if<std::is_same<T, double>::value || is_dual<T>::value, int>::type = 0>
 inline T my_relu(const std::vector<T> &in)
 {
     T retval(in[0]);
@@ -199,15 +224,16 @@ inline std::string print_my_relu(const std::vector<std::string> &in)
     return "ReLu(" + retval + ")";
 }
 
-// Exponential linear unit (ELU) function (double overload):
-template <typename T, typename std::enable_if<std::is_same<T, double>::value, int>::type = 0>
+// Exponential linear unit (ELU) function (double and dual overload):
+template <typename T,
+          typename std::enable_if<std::is_same<T, double>::value || is_dual<T>::value, int>::type = 0>
 inline T my_elu(const std::vector<T> &in)
 {
     T retval(in[0]);
     for (auto i = 1u; i < in.size(); ++i) {
         retval += in[i];
     }
-    (retval < 0) ? retval = audi::exp(retval) - T(1.) : retval = retval;
+    (retval < 0) ? retval = exp(retval) - T(1.) : retval = retval;
     return retval;
 }
 
@@ -219,7 +245,7 @@ inline T my_elu(const std::vector<T> &in)
     for (auto i = 1u; i < in.size(); ++i) {
         retval += in[i];
     }
-    (retval.constant_cf() < T(0.).constant_cf()) ? retval = audi::exp(retval) - T(1.) : retval = retval;
+    (retval.constant_cf() < T(0.).constant_cf()) ? retval = exp(retval) - T(1.) : retval = retval;
     return retval;
 }
 
@@ -240,7 +266,7 @@ inline T my_isru(const std::vector<T> &in)
     for (auto i = 1u; i < in.size(); ++i) {
         retval += in[i];
     }
-    return retval / (audi::sqrt(1 + retval * retval));
+    return retval / (sqrt(1 + retval * retval));
 }
 
 inline std::string print_my_isru(const std::vector<std::string> &in)
@@ -302,7 +328,7 @@ inline std::string print_my_cos(const std::vector<std::string> &in)
 template <typename T, f_enabler<T> = 0>
 inline T my_log(const std::vector<T> &in)
 {
-    return audi::log(in[0]);
+    return log(in[0]);
 }
 
 inline std::string print_my_log(const std::vector<std::string> &in)
@@ -315,7 +341,7 @@ inline std::string print_my_log(const std::vector<std::string> &in)
 template <typename T, f_enabler<T> = 0>
 inline T my_exp(const std::vector<T> &in)
 {
-    return audi::exp(in[0]);
+    return exp(in[0]);
 }
 
 inline std::string print_my_exp(const std::vector<std::string> &in)
@@ -323,6 +349,196 @@ inline std::string print_my_exp(const std::vector<std::string> &in)
     return "exp(" + in[0] + ")";
 }
 
+/*--------------------------------------------------------------------------
+ *                          PARTIAL DERIVATIVES
+ * Each rule writes in grad (already sized as in) the derivatives of the
+ * kernel output out with respect to its inputs in. They are used in the
+ * reverse mode differentiation of the expressions, on doubles and (to
+ * obtain second derivatives, forward over reverse) on duals.
+ *------------------------------------------------------------------------**/
+
+template <typename T>
+using d_enabler = typename std::enable_if<std::is_same<T, double>::value || is_dual<T>::value, int>::type;
+
+// The value of a double or of a dual, used in the branches of the rules
+inline double d_value(double x)
+{
+    return x;
+}
+
+template <unsigned N>
+inline double d_value(const dual<N> &x)
+{
+    return x.value();
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_sum(const std::vector<T> &, const T &, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), T(1.));
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_diff(const std::vector<T> &, const T &, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), T(-1.));
+    grad[0] = T(1.);
+}
+
+// The products of all the other inputs are computed with a prefix and a suffix pass
+// so that null inputs are handled correctly
+template <typename T, d_enabler<T> = 0>
+inline void d_my_mul(const std::vector<T> &in, const T &, std::vector<T> &grad)
+{
+    T acc(1.);
+    for (auto i = 0u; i < in.size(); ++i) {
+        grad[i] = acc;
+        acc *= in[i];
+    }
+    acc = T(1.);
+    for (auto i = in.size(); i-- > 0u;) {
+        grad[i] *= acc;
+        acc *= in[i];
+    }
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_div(const std::vector<T> &in, const T &out, std::vector<T> &grad)
+{
+    T den(1.);
+    for (auto i = 1u; i < in.size(); ++i) {
+        den *= in[i];
+        grad[i] = -out / in[i];
+    }
+    grad[0] = T(1.) / den;
+}
+
+// Where the protected division returns the constant 1 its derivatives are null
+template <typename T, d_enabler<T> = 0>
+inline void d_my_pdiv(const std::vector<T> &in, const T &out, std::vector<T> &grad)
+{
+    T den(1.);
+    for (auto i = 1u; i < in.size(); ++i) {
+        den *= in[i];
+    }
+    if (!std::isfinite(d_value(in[0]) / d_value(den))) {
+        std::fill(grad.begin(), grad.end(), T(0.));
+        return;
+    }
+    for (auto i = 1u; i < in.size(); ++i) {
+        grad[i] = -out / in[i];
+    }
+    grad[0] = T(1.) / den;
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_sig(const std::vector<T> &, const T &out, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), out * (1. - out));
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_tanh(const std::vector<T> &, const T &out, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), 1. - out * out);
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_relu(const std::vector<T> &, const T &out, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), (d_value(out) > 0.) ? T(1.) : T(0.));
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_elu(const std::vector<T> &, const T &out, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), (d_value(out) > 0.) ? T(1.) : out + 1.);
+}
+
+// d/dx x / sqrt(1+x^2) = (1+x^2)^(-3/2), x being the sum of the inputs
+template <typename T, d_enabler<T> = 0>
+inline void d_my_isru(const std::vector<T> &in, const T &, std::vector<T> &grad)
+{
+    T x(in[0]);
+    for (auto i = 1u; i < in.size(); ++i) {
+        x += in[i];
+    }
+    T tmp = 1. + x * x;
+    std::fill(grad.begin(), grad.end(), 1. / (tmp * sqrt(tmp)));
+}
+
+// The unary functions discard all inputs except the first one
+template <typename T, d_enabler<T> = 0>
+inline void d_my_sin(const std::vector<T> &in, const T &, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), T(0.));
+    grad[0] = cos(in[0]);
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_cos(const std::vector<T> &in, const T &, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), T(0.));
+    grad[0] = -sin(in[0]);
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_log(const std::vector<T> &in, const T &, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), T(0.));
+    grad[0] = 1. / in[0];
+}
+
+template <typename T, d_enabler<T> = 0>
+inline void d_my_exp(const std::vector<T> &, const T &out, std::vector<T> &grad)
+{
+    std::fill(grad.begin(), grad.end(), T(0.));
+    grad[0] = out;
+}
+
+/*--------------------------------------------------------------------------
+ *                          IN-PLACE VARIANTS
+ * Each writes in out the kernel value in the point pointed to by in,
+ * accumulating with the in-place operators so that no temporary is created.
+ * They are used by the workspace evaluation of the expressions.
+ *------------------------------------------------------------------------**/
+
+template <typename T, f_enabler<T> = 0>
+inline void my_sum_in_place(const std::vector<const T *> &in, T &out)
+{
+    out = *in[0];
+    for (auto i = 1u; i < in.size(); ++i) {
+        out += *in[i];
+    }
+}
+
+template <typename T, f_enabler<T> = 0>
+inline void my_diff_in_place(const std::vector<const T *> &in, T &out)
+{
+    out = *in[0];
+    for (auto i = 1u; i < in.size(); ++i) {
+        out -= *in[i];
+    }
+}
+
+template <typename T, f_enabler<T> = 0>
+inline void my_mul_in_place(const std::vector<const T *> &in, T &out)
+{
+    out = *in[0];
+    for (auto i = 1u; i < in.size(); ++i) {
+        out *= *in[i];
+    }
+}
+
+template <typename T, f_enabler<T> = 0>
+inline void my_div_in_place(const std::vector<const T *> &in, T &out)
+{
+    out = *in[0];
+    for (auto i = 1u; i < in.size(); ++i) {
+        out /= *in[i];
+    }
+}
+
 } // namespace dcgp
 
 #endif // DCGP_WRAPPED_FUNCTIONS_H
@@ -5,6 +5,7 @@
 
 #include <dcgp/expression.hpp>
 #include <dcgp/kernel_set.hpp>
+#include <dcgp/simplified_expression.hpp>
 
 void perform_evaluations(unsigned int in, unsigned int out, unsigned int rows, unsigned int columns,
                          unsigned int levels_back, unsigned int arity, unsigned int N,
@@ -58,3 +59,48 @@ BOOST_AUTO_TEST_CASE(evaluation_speed)
     perform_evaluations(1, 1, 2, 100, 101, 8, N, kernel_set2());
     perform_evaluations(1, 1, 3, 100, 101, 9, N, kernel_set2());
 }
+
+void perform_simplified_evaluations(unsigned int in, unsigned int out, unsigned int rows, unsigned int columns,
+                                    unsigned int levels_back, unsigned int arity, unsigned int N,
+                                    std::vector<dcgp::kernel<double>> kernel_set)
+{
+    // Random numbers engine
+    std::default_random_engine re(123);
+    // Instatiate the expression and its simplification
+    dcgp::expression<double> ex(in, out, rows, columns, levels_back, arity, kernel_set, 123);
+    auto s = ex.simplify();
+    // We create the input data upfront and we do not time it.
+    std::vector<double> dumb(in);
+    std::vector<std::vector<double>> in_num(N, dumb);
+
+    for (auto j = 0u; j < N; ++j) {
+        for (auto i = 0u; i < in; ++i) {
+            in_num[j][i] = std::uniform_real_distribution<double>(-1, 1)(re);
+        }
+    }
+
+    std::cout << "Performing " << N << " evaluations, in:" << in << " out:" << out << " rows:" << rows
+              << " columns:" << columns << " active nodes:" << ex.get_active_nodes().size() - in
+              << " simplified nodes:" << s.get_n_nodes() << std::endl;
+    {
+        boost::timer::auto_cpu_timer t;
+        for (auto i = 0u; i < N; ++i) {
+            ex(in_num[i]);
+        }
+    }
+    {
+        boost::timer::auto_cpu_timer t;
+        s(in_num);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(simplified_evaluation_speed)
+{
+    unsigned int N = 100000;
+
+    dcgp::kernel_set<double> kernel_set1({"sum", "diff", "mul", "div"});
+    dcgp::stream(std::cout, "Function set ", kernel_set1(), "\n");
+    perform_simplified_evaluations(2, 4, 10, 10, 11, 5, N, kernel_set1());
+    perform_simplified_evaluations(2, 4, 20, 20, 21, 6, N, kernel_set1());
+    perform_simplified_evaluations(1, 1, 3, 100, 101, 9, N, kernel_set1());
+}
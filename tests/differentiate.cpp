@@ -1,9 +1,17 @@
+#include <algorithm>
 #include <audi/audi.hpp>
+#include <cmath>
+#include <random>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #define BOOST_TEST_MODULE dcgp_differentiation_test
 #include <boost/test/unit_test.hpp>
 
 #include <dcgp/expression.hpp>
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/expression_weighted.hpp>
+#include <dcgp/gdual_v_batch.hpp>
 #include <dcgp/kernel_set.hpp>
 
 using namespace dcgp;
@@ -57,3 +65,235 @@ BOOST_AUTO_TEST_CASE(differentiation_basic_set)
     BOOST_CHECK_EQUAL(jet2[0].get_derivative({3, 2, 1}), -3);
     BOOST_CHECK_EQUAL(jet2[0].get_derivative({2, 3, 1}), 4.5);
 }
+
+// Checks the reverse mode gradient of a double expression against the first order gduals of its twin
+template <typename E1, typename E2>
+void check_gradient(const E1 &ex, const E2 &ex_d, const std::vector<double> &point)
+{
+    auto n = ex.get_n();
+    std::vector<gdual_d> in;
+    for (auto j = 0u; j < n; ++j) {
+        in.emplace_back(point[j], "x" + std::to_string(j), 1);
+    }
+    auto jet = ex_d(in);
+    auto res = ex.gradient(point);
+    const auto &value = std::get<0>(res);
+    const auto &jacobian = std::get<1>(res);
+    BOOST_CHECK_EQUAL(value.size(), ex.get_m());
+    BOOST_CHECK_EQUAL(jacobian.size(), ex.get_m() * n);
+    for (auto i = 0u; i < ex.get_m(); ++i) {
+        // Sparse gduals treat 0 * nan as 0, doubles do not
+        if (!std::isfinite(jet[i].constant_cf()) || !std::isfinite(value[i])) continue;
+        BOOST_CHECK(std::abs(value[i] - jet[i].constant_cf()) <= 1e-12 * (1. + std::abs(jet[i].constant_cf())));
+        for (auto j = 0u; j < n; ++j) {
+            // A symbol the output does not depend on has a null derivative
+            auto d = jet[i].get_derivative(std::unordered_map<std::string, unsigned>{{"dx" + std::to_string(j), 1u}});
+            if (!std::isfinite(d)) continue;
+            BOOST_CHECK(std::abs(jacobian[i * n + j] - d) <= 1e-9 * (1. + std::abs(d)));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(reverse_mode_gradient)
+{
+    // pdiv is excluded as its gdual version differs (tested in wrapped_functions)
+    std::vector<std::string> names({"sum", "diff", "mul", "div", "sig", "tanh", "ReLu", "ELU", "ISRU", "sin", "cos",
+                                    "log", "exp"});
+    kernel_set<double> set(names);
+    kernel_set<gdual_d> set_d(names);
+    std::mt19937 gen(123u);
+    std::uniform_real_distribution<> uni(0.1, 2.);
+    std::normal_distribution<> norm(0., 1.);
+    for (auto i = 0u; i < 100u; ++i) {
+        unsigned seed = gen();
+        std::vector<double> point({uni(gen), uni(gen), uni(gen)});
+        // Plain expression
+        expression<double> ex(3u, 2u, 3u, 10u, 11u, {2u, 3u, 1u, 2u, 4u, 2u, 3u, 2u, 2u, 1u}, set(), seed);
+        expression<gdual_d> ex_d(3u, 2u, 3u, 10u, 11u, {2u, 3u, 1u, 2u, 4u, 2u, 3u, 2u, 2u, 1u}, set_d(), seed);
+        BOOST_CHECK(ex.get() == ex_d.get());
+        check_gradient(ex, ex_d, point);
+        // Weighted expression
+        expression_weighted<double> exw(3u, 2u, 3u, 10u, 11u, 2u, set(), seed);
+        expression_weighted<gdual_d> exw_d(3u, 2u, 3u, 10u, 11u, 2u, set_d(), seed);
+        std::vector<double> w(exw.get_weights().size());
+        std::generate(w.begin(), w.end(), [&]() { return norm(gen); });
+        exw.set_weights(w);
+        exw_d.set_weights(std::vector<gdual_d>(w.begin(), w.end()));
+        check_gradient(exw, exw_d, point);
+    }
+    // The dCGP-ANN input gradient is checked against central differences
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    for (auto i = 0u; i < 20u; ++i) {
+        unsigned seed = gen();
+        expression_ann ex(3u, 2u, 5u, 4u, 4u, {3u, 3u, 2u, 4u}, ann_set(), seed);
+        ex.randomise_weights(0., 1., seed);
+        ex.randomise_biases(0., 1., seed);
+        std::vector<double> point({norm(gen), norm(gen), norm(gen)});
+        auto res = ex.gradient(point);
+        BOOST_CHECK(std::get<0>(res) == ex(point));
+        for (auto j = 0u; j < 3u; ++j) {
+            auto p = point, m = point;
+            p[j] += 1e-6;
+            m[j] -= 1e-6;
+            auto fp = ex(p), fm = ex(m);
+            for (auto o = 0u; o < 2u; ++o) {
+                BOOST_CHECK_SMALL(std::get<1>(res)[o * 3u + j] - (fp[o] - fm[o]) / 2e-6, 1e-5);
+            }
+        }
+    }
+    // Errors
+    expression<double> ex(3u, 2u, 3u, 10u, 11u, 2u, set(), 0u);
+    BOOST_CHECK_THROW(ex.gradient({1., 2.}), std::invalid_argument);
+    expression<gdual_d> ex_d(3u, 2u, 3u, 10u, 11u, 2u, set_d(), 0u);
+    BOOST_CHECK_THROW(ex_d.gradient({gdual_d(1.), gdual_d(2.), gdual_d(3.)}), std::invalid_argument);
+}
+
+// Checks the batch Jacobians and Hessians of a double expression against the second order gduals of its twin
+template <typename E1, typename E2>
+void check_hessian(const E1 &ex, const E2 &ex_d, const std::vector<std::vector<double>> &points)
+{
+    auto n = ex.get_n(), m = ex.get_m();
+    auto jacobian = ex.jacobian(points);
+    auto hessian = ex.hessian(points);
+    BOOST_CHECK_EQUAL(jacobian.size(), points.size() * m * n);
+    BOOST_CHECK_EQUAL(hessian.size(), points.size() * m * n * n);
+    for (auto k = 0u; k < points.size(); ++k) {
+        std::vector<gdual_d> in;
+        for (auto j = 0u; j < n; ++j) {
+            in.emplace_back(points[k][j], "x" + std::to_string(j), 2);
+        }
+        auto jet = ex_d(in);
+        auto gradient = std::get<1>(ex.gradient(points[k]));
+        for (auto i = 0u; i < m; ++i) {
+            // Sparse gduals treat 0 * nan as 0, doubles do not
+            if (!std::isfinite(jet[i].constant_cf()) || !std::isfinite(ex(points[k])[i])) continue;
+            for (auto j = 0u; j < n; ++j) {
+                BOOST_CHECK(jacobian[(k * m + i) * n + j] == gradient[i * n + j]
+                            || !std::isfinite(gradient[i * n + j]));
+                for (auto l = 0u; l < n; ++l) {
+                    std::unordered_map<std::string, unsigned> d{{"dx" + std::to_string(j), 1u}};
+                    d["dx" + std::to_string(l)] += 1u;
+                    auto dd = jet[i].get_derivative(d);
+                    if (!std::isfinite(dd)) continue;
+                    BOOST_CHECK(std::abs(hessian[((k * m + i) * n + j) * n + l] - dd) <= 1e-9 * (1. + std::abs(dd)));
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(batch_jacobian_hessian)
+{
+    // pdiv is excluded as its gdual version differs
+    std::vector<std::string> names({"sum", "diff", "mul", "div", "sig", "tanh", "ReLu", "ELU", "ISRU", "sin", "cos",
+                                    "log", "exp"});
+    kernel_set<double> set(names);
+    kernel_set<gdual_d> set_d(names);
+    std::mt19937 gen(123u);
+    std::uniform_real_distribution<> uni(0.1, 2.);
+    std::normal_distribution<> norm(0., 1.);
+    std::vector<std::vector<double>> points(5u, std::vector<double>(3u));
+    for (auto i = 0u; i < 50u; ++i) {
+        unsigned seed = gen();
+        for (auto &p : points) {
+            std::generate(p.begin(), p.end(), [&]() { return uni(gen); });
+        }
+        // Plain expression
+        expression<double> ex(3u, 2u, 3u, 10u, 11u, {2u, 3u, 1u, 2u, 4u, 2u, 3u, 2u, 2u, 1u}, set(), seed);
+        expression<gdual_d> ex_d(3u, 2u, 3u, 10u, 11u, {2u, 3u, 1u, 2u, 4u, 2u, 3u, 2u, 2u, 1u}, set_d(), seed);
+        check_hessian(ex, ex_d, points);
+        // Weighted expression
+        expression_weighted<double> exw(3u, 2u, 3u, 10u, 11u, 2u, set(), seed);
+        expression_weighted<gdual_d> exw_d(3u, 2u, 3u, 10u, 11u, 2u, set_d(), seed);
+        std::vector<double> w(exw.get_weights().size());
+        std::generate(w.begin(), w.end(), [&]() { return norm(gen); });
+        exw.set_weights(w);
+        exw_d.set_weights(std::vector<gdual_d>(w.begin(), w.end()));
+        check_hessian(exw, exw_d, points);
+    }
+    // The dCGP-ANN Hessians are checked against central differences of the gradients, also in parallel
+    kernel_set<double> ann_set({"sig", "tanh", "ELU", "ISRU", "sum"});
+    expression_ann ex(3u, 2u, 5u, 4u, 4u, {3u, 3u, 2u, 4u}, ann_set(), 32u);
+    ex.randomise_weights(0., 1., 32u);
+    ex.randomise_biases(0., 1., 32u);
+    for (auto &p : points) {
+        std::generate(p.begin(), p.end(), [&]() { return norm(gen); });
+    }
+    auto hessian = ex.hessian(points);
+    BOOST_CHECK(ex.hessian(points, 2u) == hessian);
+    BOOST_CHECK(ex.jacobian(points, 3u) == ex.jacobian(points));
+    for (auto k = 0u; k < points.size(); ++k) {
+        for (auto l = 0u; l < 3u; ++l) {
+            auto p = points[k], m = points[k];
+            p[l] += 1e-6;
+            m[l] -= 1e-6;
+            auto gp = std::get<1>(ex.gradient(p)), gm = std::get<1>(ex.gradient(m));
+            for (auto ij = 0u; ij < 6u; ++ij) {
+                BOOST_CHECK_SMALL(hessian[(k * 6u + ij) * 3u + l] - (gp[ij] - gm[ij]) / 2e-6, 1e-5);
+            }
+        }
+    }
+    // Errors
+    expression<double> ex2(3u, 2u, 3u, 10u, 11u, 2u, set(), 0u);
+    BOOST_CHECK_THROW(ex2.jacobian({{1., 2.}}), std::invalid_argument);
+    BOOST_CHECK_THROW(ex2.hessian({{1., 2., 3.}, {1., 2.}}), std::invalid_argument);
+    BOOST_CHECK(ex2.hessian({}).empty());
+    kernel<double> my_kernel([](const std::vector<double> &in) { return in[0] * in[1]; },
+                             [](const std::vector<std::string> &in) { return in[0] + "*" + in[1]; },
+                             [](const std::vector<double> &in, const double &, std::vector<double> &grad) {
+                                 grad[0] = in[1];
+                                 grad[1] = in[0];
+                             },
+                             "my_mul");
+    expression<double> ex3(2u, 1u, 1u, 1u, 1u, 2u, {my_kernel}, 0u);
+    BOOST_CHECK_EQUAL(ex3.jacobian({{2., 3.}}).size(), 2u);
+    BOOST_CHECK_THROW(ex3.hessian({{2., 3.}}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(vectorized_batch)
+{
+    std::vector<std::string> names({"sum", "diff", "mul", "div", "sin", "cos", "exp", "log"});
+    kernel_set<gdual_d> set_d(names);
+    kernel_set<gdual_v> set_v(names);
+    std::mt19937 gen(123u);
+    std::uniform_real_distribution<> uni(0.5, 2.);
+    std::vector<std::vector<double>> grid(17u, std::vector<double>(3u));
+    for (auto &p : grid) {
+        std::generate(p.begin(), p.end(), [&]() { return uni(gen); });
+    }
+    // The third input is a constant
+    auto in = batch_inputs(grid, {"x", "y", ""}, 2u);
+    BOOST_CHECK_EQUAL(in.size(), 3u);
+    for (auto i = 0u; i < 20u; ++i) {
+        unsigned seed = gen();
+        expression<gdual_d> ex_d(3u, 2u, 2u, 10u, 11u, 2u, set_d(), seed);
+        expression<gdual_v> ex_v(3u, 2u, 2u, 10u, 11u, 2u, set_v(), seed);
+        // A single evaluation for the whole grid
+        auto out = ex_v(in);
+        for (auto o = 0u; o < 2u; ++o) {
+            auto values = batch_values(out[o], 17u);
+            auto dx = batch_derivative(out[o], {{"dx", 1u}}, 17u);
+            auto dxy = batch_derivative(out[o], {{"dx", 1u}, {"dy", 1u}}, 17u);
+            auto dyy = batch_derivative(out[o], {{"dy", 2u}}, 17u);
+            BOOST_CHECK_EQUAL(values.size(), 17u);
+            for (auto j = 0u; j < grid.size(); ++j) {
+                auto T = ex_d({gdual_d(grid[j][0], "x", 2u), gdual_d(grid[j][1], "y", 2u), gdual_d(grid[j][2])});
+                std::vector<double> expected(
+                    {T[o].constant_cf(), T[o].get_derivative(std::unordered_map<std::string, unsigned>{{"dx", 1u}}),
+                     T[o].get_derivative({{"dx", 1u}, {"dy", 1u}}), T[o].get_derivative({{"dy", 2u}})});
+                std::vector<double> got({values[j], dx[j], dxy[j], dyy[j]});
+                for (auto k = 0u; k < 4u; ++k) {
+                    if (!std::isfinite(expected[k])) continue;
+                    BOOST_CHECK_SMALL(got[k] - expected[k], 1e-12 * (1. + std::abs(expected[k])));
+                }
+            }
+        }
+    }
+    // Constants are broadcasted
+    BOOST_CHECK(batch_values(gdual_v(2.), 3u) == std::vector<double>(3u, 2.));
+    BOOST_CHECK(batch_derivative(in[0], {{"dy", 1u}}, 17u) == std::vector<double>(17u, 0.));
+    // Errors
+    BOOST_CHECK_THROW(batch_values(in[0], 16u), std::invalid_argument);
+    BOOST_CHECK_THROW(batch_inputs({}, {"x"}, 1u), std::invalid_argument);
+    BOOST_CHECK_THROW(batch_inputs(grid, {"x", "y"}, 1u), std::invalid_argument);
+}
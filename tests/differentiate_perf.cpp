@@ -1,10 +1,13 @@
 #define BOOST_TEST_MODULE dcgp_evaluation_perf
-#include <audi/gdual.hpp>
+#include <audi/audi.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/timer/timer.hpp>
+#include <chrono>
 #include <iostream>
 
+#include <dcgp/dual.hpp>
 #include <dcgp/expression.hpp>
+#include <dcgp/gdual_v_batch.hpp>
 #include <dcgp/kernel_set.hpp>
 
 using namespace audi;
@@ -62,3 +65,199 @@ BOOST_AUTO_TEST_CASE(evaluation_speed)
     perform_evaluations(1, 1, 2, 100, 101, 2, N, kernel_set2());
     perform_evaluations(1, 1, 3, 100, 101, 2, N, kernel_set2());
 }
+
+// Compares the evaluation of the first derivatives on a grid, point by point (gdual_d) and in a single
+// vectorized evaluation (gdual_v), as done in the fitness of the differential equations examples
+void perform_grid_evaluations(unsigned int in, unsigned int rows, unsigned int columns, unsigned int levels_back,
+                              unsigned int N, const std::vector<std::string> &kernels)
+{
+    std::default_random_engine re(123);
+    dcgp::expression<gdual_d> ex_d(in, 1, rows, columns, levels_back, 2, dcgp::kernel_set<gdual_d>(kernels)(), 123);
+    dcgp::expression<gdual_v> ex_v(in, 1, rows, columns, levels_back, 2, dcgp::kernel_set<gdual_v>(kernels)(), 123);
+    std::vector<std::vector<double>> grid(N, std::vector<double>(in));
+    std::vector<std::string> symbols;
+    for (auto i = 0u; i < in; ++i) {
+        symbols.push_back("x" + std::to_string(i));
+    }
+    for (auto &point : grid) {
+        for (auto &x : point) {
+            x = std::uniform_real_distribution<double>(0.1, 1.)(re);
+        }
+    }
+    std::cout << "Grid of " << N << " points, in:" << in << " rows:" << rows << " columns:" << columns << std::endl;
+    double check_d = 0., check_v = 0.;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &point : grid) {
+        std::vector<gdual_d> in_d;
+        for (auto i = 0u; i < in; ++i) {
+            in_d.emplace_back(point[i], symbols[i], 1);
+        }
+        auto T = ex_d(in_d);
+        for (auto i = 0u; i < in; ++i) {
+            check_d += T[0].get_derivative({{"d" + symbols[i], 1u}});
+        }
+    }
+    auto t_d = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    auto T = ex_v(dcgp::batch_inputs(grid, symbols, 1u));
+    for (auto i = 0u; i < in; ++i) {
+        for (auto d : dcgp::batch_derivative(T[0], {{"d" + symbols[i], 1u}}, N)) {
+            check_v += d;
+        }
+    }
+    auto t_v = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\tgdual_d: " << t_d << "s gdual_v: " << t_v << "s (x" << t_d / t_v << ") sums: " << check_d << " "
+              << check_v << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(grid_evaluation_speed)
+{
+    std::vector<std::string> kernels({"sum", "diff", "mul", "div"});
+    perform_grid_evaluations(1, 1, 15, 16, 10, kernels);
+    perform_grid_evaluations(1, 1, 15, 16, 1000, kernels);
+    perform_grid_evaluations(2, 1, 15, 16, 1000, kernels);
+    perform_grid_evaluations(6, 1, 100, 50, 1000, kernels);
+    perform_grid_evaluations(2, 1, 15, 16, 1000, {"sum", "diff", "mul", "div", "exp", "log", "sin", "cos"});
+}
+
+// Compares the evaluation through the call operator (allocating the nodes at each call) with the one reusing a
+// workspace and the in-place kernels
+void perform_workspace_evaluations(unsigned int in, unsigned int rows, unsigned int columns, unsigned int levels_back,
+                                   unsigned int order, unsigned int N, const std::vector<std::string> &kernels)
+{
+    std::default_random_engine re(123);
+    dcgp::expression<gdual_d> ex(in, 1, rows, columns, levels_back, 2, dcgp::kernel_set<gdual_d>(kernels)(), 123);
+    std::vector<std::vector<gdual_d>> points(N);
+    for (auto &point : points) {
+        for (auto i = 0u; i < in; ++i) {
+            point.emplace_back(std::uniform_real_distribution<double>(0.1, 1.)(re), "x" + std::to_string(i), order);
+        }
+    }
+    std::cout << "Order " << order << ", " << N << " evaluations, in:" << in << " rows:" << rows
+              << " columns:" << columns << std::endl;
+    double check = 0., check_ws = 0.;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &point : points) {
+        check += ex(point)[0].constant_cf();
+    }
+    auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    dcgp::expression<gdual_d>::workspace ws;
+    start = std::chrono::steady_clock::now();
+    for (const auto &point : points) {
+        check_ws += ex.evaluate(point, ws)[0].constant_cf();
+    }
+    auto t_ws = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\tcall operator: " << t << "s workspace: " << t_ws << "s (x" << t / t_ws << ") sums: " << check
+              << " " << check_ws << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(workspace_evaluation_speed)
+{
+    unsigned int N = 1000;
+    for (auto order = 1u; order <= 3u; ++order) {
+        perform_workspace_evaluations(2, 2, 10, 11, order, N, {"sum", "diff", "mul", "div"});
+        perform_workspace_evaluations(2, 1, 100, 101, order, N, {"sum", "diff", "mul", "div"});
+        perform_workspace_evaluations(2, 2, 10, 11, order, N, {"sum", "mul", "sin", "exp"});
+    }
+}
+
+// Compares the first derivatives computed with gduals of order one and with the dedicated dual type
+template <unsigned IN>
+void perform_dual_evaluations(unsigned int rows, unsigned int columns, unsigned int levels_back, unsigned int N,
+                              const std::vector<std::string> &kernels)
+{
+    std::default_random_engine re(123);
+    dcgp::expression<gdual_d> ex_d(IN, 1, rows, columns, levels_back, 2, dcgp::kernel_set<gdual_d>(kernels)(), 123);
+    dcgp::expression<dcgp::dual<IN>> ex(IN, 1, rows, columns, levels_back, 2,
+                                        dcgp::kernel_set<dcgp::dual<IN>>(kernels)(), 123);
+    std::vector<std::vector<gdual_d>> points_d(N);
+    std::vector<std::vector<dcgp::dual<IN>>> points(N);
+    for (auto j = 0u; j < N; ++j) {
+        for (auto i = 0u; i < IN; ++i) {
+            auto value = std::uniform_real_distribution<double>(0.1, 1.)(re);
+            points_d[j].emplace_back(value, "x" + std::to_string(i), 1);
+            points[j].emplace_back(value, i);
+        }
+    }
+    std::cout << N << " gradients, in:" << IN << " rows:" << rows << " columns:" << columns << std::endl;
+    double check_d = 0., check = 0.;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &point : points_d) {
+        auto T = ex_d(point);
+        for (auto i = 0u; i < IN; ++i) {
+            check_d += T[0].get_derivative({{"dx" + std::to_string(i), 1u}});
+        }
+    }
+    auto t_d = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (const auto &point : points) {
+        auto T = ex(point);
+        for (auto i = 0u; i < IN; ++i) {
+            check += T[0].get_derivative(i);
+        }
+    }
+    auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\tgdual_d: " << t_d << "s dual: " << t << "s (x" << t_d / t << ") sums: " << check_d << " "
+              << check << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(dual_evaluation_speed)
+{
+    unsigned int N = 1000;
+    perform_dual_evaluations<1>(1, 15, 16, N, {"sum", "diff", "mul", "div"});
+    perform_dual_evaluations<2>(2, 10, 11, N, {"sum", "diff", "mul", "div"});
+    perform_dual_evaluations<6>(1, 100, 101, N, {"sum", "diff", "mul", "div"});
+    perform_dual_evaluations<2>(2, 10, 11, N, {"sum", "mul", "sin", "exp"});
+}
+
+// Compares the Hessians on a batch of points computed with second order gduals and with the forward over reverse
+// sweeps of the double expressions
+void perform_hessian_evaluations(unsigned int in, unsigned int rows, unsigned int columns, unsigned int levels_back,
+                                 unsigned int N, const std::vector<std::string> &kernels)
+{
+    std::default_random_engine re(123);
+    dcgp::expression<gdual_d> ex_d(in, 1, rows, columns, levels_back, 2, dcgp::kernel_set<gdual_d>(kernels)(), 123);
+    dcgp::expression<double> ex(in, 1, rows, columns, levels_back, 2, dcgp::kernel_set<double>(kernels)(), 123);
+    std::vector<std::vector<double>> points(N, std::vector<double>(in));
+    for (auto &point : points) {
+        for (auto &x : point) {
+            x = std::uniform_real_distribution<double>(0.1, 1.)(re);
+        }
+    }
+    std::cout << N << " Hessians, in:" << in << " rows:" << rows << " columns:" << columns << std::endl;
+    double check_d = 0., check = 0.;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &point : points) {
+        std::vector<gdual_d> in_d;
+        for (auto i = 0u; i < in; ++i) {
+            in_d.emplace_back(point[i], "x" + std::to_string(i), 2);
+        }
+        auto T = ex_d(in_d);
+        for (auto i = 0u; i < in; ++i) {
+            check_d += T[0].get_derivative({{"dx" + std::to_string(i), 2u}});
+        }
+    }
+    auto t_d = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    auto H = ex.hessian(points);
+    for (auto k = 0u; k < N; ++k) {
+        for (auto i = 0u; i < in; ++i) {
+            check += H[(k * in + i) * in + i];
+        }
+    }
+    auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    ex.hessian(points, 4u);
+    auto t_p = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\tgdual_d: " << t_d << "s hessian: " << t << "s (x" << t_d / t << ") parallel: " << t_p
+              << "s sums: " << check_d << " " << check << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(hessian_evaluation_speed)
+{
+    unsigned int N = 1000;
+    perform_hessian_evaluations(1, 1, 15, 16, N, {"sum", "diff", "mul", "div"});
+    perform_hessian_evaluations(2, 2, 10, 11, N, {"sum", "diff", "mul", "div"});
+    perform_hessian_evaluations(3, 1, 100, 101, N, {"sum", "diff", "mul", "div"});
+    perform_hessian_evaluations(2, 2, 10, 11, N, {"sum", "mul", "sin", "exp"});
+}
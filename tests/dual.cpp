@@ -0,0 +1,134 @@
+#define BOOST_TEST_MODULE dcgp_dual_test
+#include <audi/audi.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dcgp/dual.hpp>
+#include <dcgp/expression.hpp>
+#include <dcgp/expression_weighted.hpp>
+#include <dcgp/kernel_set.hpp>
+
+using namespace dcgp;
+
+BOOST_AUTO_TEST_CASE(construction_and_arithmetic)
+{
+    dual<2> x(0.3, 0u), y(1.2, 1u), c(2.);
+    BOOST_CHECK_EQUAL(x.value(), 0.3);
+    BOOST_CHECK_EQUAL(x.get_derivative(0u), 1.);
+    BOOST_CHECK_EQUAL(x.get_derivative(1u), 0.);
+    BOOST_CHECK_EQUAL(c.get_derivative(0u), 0.);
+    BOOST_CHECK_EQUAL(dual<2>().value(), 0.);
+    BOOST_CHECK_THROW(dual<2>(0.3, 2u), std::invalid_argument);
+    BOOST_CHECK_THROW(x.get_derivative(2u), std::invalid_argument);
+    // f = (x * y + 2) / (x - y) at (0.3, 1.2)
+    auto f = (x * y + c) / (x - y);
+    double den = 0.3 - 1.2, num = 0.3 * 1.2 + 2.;
+    BOOST_CHECK_CLOSE(f.value(), num / den, 1e-12);
+    BOOST_CHECK_CLOSE(f.get_derivative(0u), (1.2 * den - num) / (den * den), 1e-12);
+    BOOST_CHECK_CLOSE(f.get_derivative(1u), (0.3 * den + num) / (den * den), 1e-12);
+    // Mixed with doubles and self assignments
+    auto g = 1. - 2. * x;
+    BOOST_CHECK_CLOSE(g.get_derivative(0u), -2., 1e-12);
+    g = x;
+    g *= g;
+    BOOST_CHECK_CLOSE(g.get_derivative(0u), 0.6, 1e-12);
+    g /= g;
+    BOOST_CHECK_CLOSE(g.value(), 1., 1e-12);
+    BOOST_CHECK_SMALL(g.get_derivative(0u), 1e-12);
+    BOOST_CHECK((-x).get_derivative(0u) == -1.);
+    BOOST_CHECK(x < y && y > x && x != y && x == dual<2>(0.3, 0u));
+    std::ostringstream ss;
+    ss << x;
+    BOOST_CHECK_EQUAL(ss.str(), "0.3 [1, 0]");
+}
+
+BOOST_AUTO_TEST_CASE(functions)
+{
+    // The derivatives against central differences
+    std::vector<double (*)(double)> fs(
+        {[](double a) { return std::exp(a); }, [](double a) { return std::log(a); },
+         [](double a) { return std::sin(a); }, [](double a) { return std::cos(a); },
+         [](double a) { return std::tanh(a); }, [](double a) { return std::sqrt(a); },
+         [](double a) { return std::abs(a); }});
+    std::vector<dual<1> (*)(const dual<1> &)> fs_d(
+        {[](const dual<1> &a) { return exp(a); }, [](const dual<1> &a) { return log(a); },
+         [](const dual<1> &a) { return sin(a); }, [](const dual<1> &a) { return cos(a); },
+         [](const dual<1> &a) { return tanh(a); }, [](const dual<1> &a) { return sqrt(a); },
+         [](const dual<1> &a) { return abs(a); }});
+    for (auto i = 0u; i < fs.size(); ++i) {
+        for (double x : {0.2, 0.7, 1.9}) {
+            auto f = fs_d[i](dual<1>(x, 0u));
+            BOOST_CHECK_CLOSE(f.value(), fs[i](x), 1e-12);
+            BOOST_CHECK_CLOSE(f.get_derivative(0u), (fs[i](x + 1e-6) - fs[i](x - 1e-6)) / 2e-6, 1e-6);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(expressions)
+{
+    // pdiv is excluded as its gdual version differs
+    std::vector<std::string> names({"sum", "diff", "mul", "div", "sig", "tanh", "ReLu", "ELU", "ISRU", "sin", "cos",
+                                    "log", "exp"});
+    kernel_set<dual<3>> set(names);
+    kernel_set<gdual_d> set_d(names);
+    std::mt19937 gen(123u);
+    std::uniform_real_distribution<> uni(0.1, 2.);
+    std::vector<std::string> symbols({"x", "y", "z"});
+    for (auto i = 0u; i < 100u; ++i) {
+        unsigned seed = gen();
+        expression<dual<3>> ex(3u, 2u, 3u, 10u, 11u, 2u, set(), seed);
+        expression<gdual_d> ex_d(3u, 2u, 3u, 10u, 11u, 2u, set_d(), seed);
+        std::vector<dual<3>> in;
+        std::vector<gdual_d> in_d;
+        for (auto j = 0u; j < 3u; ++j) {
+            auto x = uni(gen);
+            in.emplace_back(x, j);
+            in_d.emplace_back(x, symbols[j], 1);
+        }
+        auto out = ex(in);
+        auto out_d = ex_d(in_d);
+        // The workspace evaluation agrees with the call operator
+        expression<dual<3>>::workspace ws;
+        auto out_ws = ex.evaluate(in, ws);
+        for (auto k = 0u; k < 2u; ++k) {
+            BOOST_CHECK(out_ws[k] == out[k] || !std::isfinite(out[k].value()));
+            // Sparse gduals treat 0 * nan as 0, duals do not
+            if (!std::isfinite(out[k].value())) continue;
+            auto v = out_d[k].constant_cf();
+            BOOST_CHECK(std::abs(out[k].value() - v) <= 1e-12 * (1. + std::abs(v)));
+            for (auto j = 0u; j < 3u; ++j) {
+                auto d = out_d[k].get_derivative(std::unordered_map<std::string, unsigned>{{"d" + symbols[j], 1u}});
+                if (!std::isfinite(d)) continue;
+                BOOST_CHECK(std::abs(out[k].get_derivative(j) - d) <= 1e-9 * (1. + std::abs(d)));
+            }
+        }
+    }
+    // The symbolic representation and the losses
+    expression<dual<1>> ex(1u, 1u, 1u, 5u, 6u, 2u, kernel_set<dual<1>>({"sum", "mul", "pdiv"})(), 32u);
+    expression<double> ex_double(1u, 1u, 1u, 5u, 6u, 2u, kernel_set<double>({"sum", "mul", "pdiv"})(), 32u);
+    std::vector<std::string> x({"x"});
+    BOOST_CHECK_EQUAL(ex(x)[0], ex_double(x)[0]);
+    auto loss = ex.loss({{dual<1>(0.5, 0u)}}, {{dual<1>(1.)}}, "MSE");
+    auto out = ex({dual<1>(0.5, 0u)})[0];
+    BOOST_CHECK_CLOSE(loss.value(), (out.value() - 1.) * (out.value() - 1.), 1e-12);
+    BOOST_CHECK_CLOSE(loss.get_derivative(0u), 2. * (out.value() - 1.) * out.get_derivative(0u), 1e-12);
+    // Weighted expressions: the derivatives with respect to a weight
+    expression_weighted<dual<1>> ex_w(1u, 1u, 1u, 3u, 4u, 2u, kernel_set<dual<1>>({"sum", "mul"})(), 0u);
+    auto w = ex_w.get_weights();
+    w[0] = dual<1>(w[0].value(), 0u);
+    ex_w.set_weights(w);
+    auto dw = ex_w({dual<1>(0.7)})[0].get_derivative(0u);
+    auto p = ex_w.get_weights(), m = ex_w.get_weights();
+    p[0] = dual<1>(w[0].value() + 1e-6);
+    m[0] = dual<1>(w[0].value() - 1e-6);
+    auto ex_p = ex_w, ex_m = ex_w;
+    ex_p.set_weights(p);
+    ex_m.set_weights(m);
+    BOOST_CHECK_SMALL(dw - (ex_p({dual<1>(0.7)})[0].value() - ex_m({dual<1>(0.7)})[0].value()) / 2e-6, 1e-6);
+}
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <audi/audi.hpp>
+#include <cmath>
 #include <random>
 #include <string>
 #include <vector>
@@ -8,7 +9,10 @@
 #include <boost/test/unit_test.hpp>
 
 #include <dcgp/expression.hpp>
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/expression_weighted.hpp>
 #include <dcgp/kernel_set.hpp>
+#include <dcgp/s11n.hpp>
 
 #include "helpers.hpp"
 
@@ -333,3 +337,199 @@ BOOST_AUTO_TEST_CASE(loss)
         BOOST_CHECK_CLOSE(ex.loss(in, out, "CE", true), ex.loss(in, out, "CE", false), 1e-8);
     }
 }
+
+BOOST_AUTO_TEST_CASE(bounded_loss)
+{
+    kernel_set<double> basic_set({"sum", "diff", "mul", "div"});
+    expression<double> ex(2, 2, 2, 2, 3, 2, basic_set(), 32u);
+    // 2xy, 2x
+    ex.set({0, 1, 1, 0, 0, 0, 2, 0, 2, 2, 0, 2, 4, 3});
+    std::mt19937 mersenne_engine{32u};
+    std::uniform_real_distribution<double> dist{-1., 1.};
+    auto in = std::vector<std::vector<double>>(1000, {0., 0.});
+    auto out = std::vector<std::vector<double>>(1000, {0., 0.});
+    std::generate(in.begin(), in.end(), [&mersenne_engine, &dist]() {
+        return std::vector<double>{dist(mersenne_engine), dist(mersenne_engine)};
+    });
+    // Labels are non-negative so that the CE loss is too
+    std::uniform_real_distribution<double> dist_labels{0., 1.};
+    std::generate(out.begin(), out.end(), [&mersenne_engine, &dist_labels]() {
+        return std::vector<double>{dist_labels(mersenne_engine), dist_labels(mersenne_engine)};
+    });
+    // Exceptions
+    BOOST_CHECK_THROW(ex.bounded_loss(in, out, "MSX", 1.), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.bounded_loss(in, {{1., 1.}}, "MSE", 1.), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.bounded_loss({}, {}, "MSE", 1.), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.bounded_loss(in, out, "MSE", 1., 3u), std::invalid_argument);
+    for (auto loss_s : {"MSE", "CE"}) {
+        auto loss = ex.loss(in, out, loss_s, 0u);
+        // Above the loss, the loss is returned
+        BOOST_CHECK_EQUAL(ex.bounded_loss(in, out, loss_s, loss), loss);
+        BOOST_CHECK_EQUAL(ex.bounded_loss(in, out, loss_s, 2. * loss), loss);
+        BOOST_CHECK_CLOSE(ex.bounded_loss(in, out, loss_s, loss * (1. + 1e-10), 4u), loss, 1e-8);
+        // Below the loss, a lower bound of the loss larger than the threshold is returned
+        for (auto parallel : {0u, 1u, 4u, 10u}) {
+            for (auto threshold : {0., loss / 10., loss / 2.}) {
+                auto bl = ex.bounded_loss(in, out, loss_s, threshold, parallel);
+                BOOST_CHECK(bl > threshold);
+                BOOST_CHECK(bl <= loss * (1. + 1e-10));
+            }
+        }
+    }
+    // Early abort actually happens
+    BOOST_CHECK(ex.bounded_loss(in, out, "MSE", 0.) < ex.loss(in, out, "MSE") / 2.);
+    // NaNs
+    ex.set({3, 1, 1, 0, 0, 0, 2, 0, 2, 2, 0, 2, 4, 3});
+    in[100] = {0., 0.};
+    BOOST_CHECK(std::isnan(ex.bounded_loss(in, out, "MSE", 1.)));
+    BOOST_CHECK(std::isnan(ex.bounded_loss(in, out, "MSE", 1., 4u)));
+    // gduals
+    kernel_set<audi::gdual_d> gdual_set({"sum", "diff", "mul", "div"});
+    expression<audi::gdual_d> ex_gd(2, 2, 2, 2, 3, 2, gdual_set(), 32u);
+    ex_gd.set({0, 1, 1, 0, 0, 0, 2, 0, 2, 2, 0, 2, 4, 3});
+    std::vector<std::vector<audi::gdual_d>> gin, gout;
+    for (auto i = 0u; i < 100u; ++i) {
+        gin.push_back({audi::gdual_d(in[i][0], "x", 1), audi::gdual_d(in[i][1], "y", 1)});
+        gout.push_back({audi::gdual_d(out[i][0]), audi::gdual_d(out[i][1])});
+    }
+    auto gloss = ex_gd.loss(gin, gout, "MSE");
+    BOOST_CHECK_EQUAL(ex_gd.bounded_loss(gin, gout, "MSE", gloss), gloss);
+    BOOST_CHECK(ex_gd.bounded_loss(gin, gout, "MSE", audi::gdual_d(0.), 4u).constant_cf() > 0.);
+}
+
+BOOST_AUTO_TEST_CASE(serialization)
+{
+    // Random seed
+    std::random_device rd;
+    kernel_set<double> basic_set({"sum", "diff", "mul", "div", "sin", "exp"});
+    {
+        expression<double> ex(3, 2, 3, 10, 4, {2, 3, 1, 2, 2, 3, 4, 2, 2, 1}, basic_set(), rd());
+        ex.mutate_active(5);
+        std::stringstream ss;
+        {
+            boost::archive::binary_oarchive oarchive(ss);
+            oarchive << ex;
+        }
+        // We deserialize into an expression with a different structure
+        kernel_set<double> other_set({"sum"});
+        expression<double> ex2(1, 1, 1, 1, 1, 1, other_set(), rd());
+        {
+            boost::archive::binary_iarchive iarchive(ss);
+            iarchive >> ex2;
+        }
+        CHECK_EQUAL_V(ex.get(), ex2.get());
+        CHECK_EQUAL_V(ex.get_arity(), ex2.get_arity());
+        CHECK_EQUAL_V(ex.get_active_nodes(), ex2.get_active_nodes());
+        CHECK_EQUAL_V(ex.get_lb(), ex2.get_lb());
+        CHECK_EQUAL_V(ex.get_ub(), ex2.get_ub());
+        BOOST_CHECK_EQUAL(ex.get_f().size(), ex2.get_f().size());
+        CHECK_EQUAL_V(ex({0.1, 0.2, 0.3}), ex2({0.1, 0.2, 0.3}));
+        // The state of the random engine is preserved
+        ex.mutate_active(10);
+        ex2.mutate_active(10);
+        CHECK_EQUAL_V(ex.get(), ex2.get());
+    }
+    {
+        kernel_set<gdual_d> gdual_set({"sum", "diff", "mul", "div"});
+        expression_weighted<gdual_d> ex(2, 1, 2, 5, 6, 2, gdual_set(), rd());
+        ex.set_weight(3, 1, gdual_d(0.3, "w", 2));
+        std::stringstream ss;
+        {
+            boost::archive::text_oarchive oarchive(ss);
+            oarchive << ex;
+        }
+        expression_weighted<gdual_d> ex2(1, 1, 1, 1, 1, 1, gdual_set(), rd());
+        {
+            boost::archive::text_iarchive iarchive(ss);
+            iarchive >> ex2;
+        }
+        CHECK_EQUAL_V(ex.get(), ex2.get());
+        CHECK_EQUAL_V(ex.get_weights(), ex2.get_weights());
+        std::vector<gdual_d> in{gdual_d(0.1, "x", 2), gdual_d(-0.2, "y", 2)};
+        CHECK_EQUAL_V(ex(in), ex2(in));
+        BOOST_CHECK_EQUAL(ex(std::vector<std::string>{"x", "y"})[0], ex2(std::vector<std::string>{"x", "y"})[0]);
+    }
+    {
+        // Custom kernels cannot be deserialized as they are reconstructed by name
+        kernel<double> custom(my_sum<double>, print_my_sum, "custom_sum");
+        expression<double> ex(1, 1, 1, 1, 1, 1, {custom}, rd());
+        std::stringstream ss;
+        {
+            boost::archive::binary_oarchive oarchive(ss);
+            oarchive << ex;
+        }
+        // A failed deserialization leaves the expression untouched
+        kernel_set<double> basic_set({"sum", "diff", "mul", "div"});
+        expression<double> ex2(3, 2, 2, 3, 4, 2, basic_set(), rd());
+        const auto ex2_copy = ex2;
+        boost::archive::binary_iarchive iarchive(ss);
+        BOOST_CHECK_THROW(iarchive >> ex2, std::invalid_argument);
+        BOOST_CHECK_EQUAL(ex2.get_n(), 3u);
+        BOOST_CHECK_EQUAL(ex2.get_m(), 2u);
+        CHECK_EQUAL_V(ex2.get(), ex2_copy.get());
+        CHECK_EQUAL_V(ex2.get_lb(), ex2_copy.get_lb());
+        CHECK_EQUAL_V(ex2.get_ub(), ex2_copy.get_ub());
+        CHECK_EQUAL_V(ex2.get_active_nodes(), ex2_copy.get_active_nodes());
+        CHECK_EQUAL_V(ex2({0.1, 0.2, 0.3}), ex2_copy({0.1, 0.2, 0.3}));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(workspace_evaluation)
+{
+    std::mt19937 gen(123u);
+    std::uniform_real_distribution<> uni(-1., 1.);
+    std::vector<std::string> names({"sum", "diff", "mul", "div", "sin", "exp"});
+    kernel_set<double> set(names);
+    kernel_set<gdual_d> set_d(names);
+    BOOST_CHECK(set()[0].has_in_place());
+    BOOST_CHECK(!set()[4].has_in_place());
+    // The same workspaces are reused by all the evaluations (and expressions)
+    expression<double>::workspace ws;
+    expression<gdual_d>::workspace ws_d;
+    for (auto i = 0u; i < 100u; ++i) {
+        unsigned seed = gen();
+        expression<double> ex(3u, 2u, 3u, 10u, 11u, 3u, set(), seed);
+        expression_weighted<double> exw(3u, 2u, 3u, 10u, 11u, 3u, set(), seed);
+        expression<gdual_d> ex_d(3u, 2u, 3u, 10u, 11u, 3u, set_d(), seed);
+        std::vector<double> w(exw.get_weights().size());
+        std::generate(w.begin(), w.end(), [&]() { return uni(gen); });
+        exw.set_weights(w);
+        for (auto j = 0u; j < 5u; ++j) {
+            std::vector<double> point({uni(gen), uni(gen), uni(gen)});
+            std::vector<gdual_d> point_d({gdual_d(point[0], "x", 3u), gdual_d(point[1], "y", 3u), gdual_d(point[2])});
+            auto res = ex(point), res_w = exw(point);
+            auto res_d = ex_d(point_d);
+            auto out = ex.evaluate(point, ws);
+            // Also through the base class
+            const expression<double> &base = exw;
+            auto out_w = base.evaluate(point, ws);
+            const auto &out_d = ex_d.evaluate(point_d, ws_d);
+            for (auto o = 0u; o < 2u; ++o) {
+                BOOST_CHECK(out[o] == res[o] || !std::isfinite(res[o]));
+                BOOST_CHECK(out_w[o] == res_w[o] || !std::isfinite(res_w[o]));
+                if (std::isfinite(res_d[o].constant_cf())) {
+                    BOOST_CHECK(out_d[o] == res_d[o]);
+                }
+            }
+        }
+    }
+    // dCGP-ANN
+    expression_ann ex(3u, 2u, 5u, 4u, 4u, {3u, 3u, 2u, 4u}, kernel_set<double>({"sig", "tanh", "sum"})(), 32u);
+    ex.randomise_weights(0., 1., 32u);
+    ex.randomise_biases(0., 1., 32u);
+    BOOST_CHECK(ex.evaluate({0.1, 0.2, 0.3}, ws) == ex({0.1, 0.2, 0.3}));
+    // A kernel without in-place variant is called on the copied inputs
+    kernel<double> my_kernel([](const std::vector<double> &in) { return in[0] - 2. * in[1]; },
+                             [](const std::vector<std::string> &in) { return in[0]; }, "k");
+    BOOST_CHECK(!my_kernel.has_in_place());
+    double a = 1., b = 2., out = 0.;
+    my_kernel.in_place({&a, &b}, out);
+    BOOST_CHECK_EQUAL(out, -3.);
+    set()[2].in_place({&a, &b}, out);
+    BOOST_CHECK_EQUAL(out, 2.);
+    // Errors
+    expression<double> ex2(3u, 2u, 3u, 10u, 11u, 3u, set(), 0u);
+    BOOST_CHECK_THROW(ex2.evaluate({1., 2.}, ws), std::invalid_argument);
+    expression_weighted<double> exw2(3u, 2u, 3u, 10u, 11u, 3u, set(), 0u);
+    BOOST_CHECK_THROW(exw2.evaluate({1., 2.}, ws), std::invalid_argument);
+}
@@ -4,10 +4,13 @@
 #include <audi/back_compatibility.hpp>
 #include <audi/io.hpp>
 #include <boost/test/unit_test.hpp>
+#include <cmath>
 #include <stdexcept>
+#include <tbb/tbb.h>
 
 #include <dcgp/expression_ann.hpp>
 #include <dcgp/kernel_set.hpp>
+#include <dcgp/s11n.hpp>
 using namespace dcgp;
 
 void test_against_numerical_derivatives(unsigned n, unsigned m, unsigned r, unsigned c, unsigned lb,
@@ -260,6 +263,26 @@ BOOST_AUTO_TEST_CASE(sgd)
         print("Loss (", j, ") real: ", tmp_end, " proxy: ", loss, "\n");
     }
     BOOST_CHECK(tmp_end <= tmp_start);
+    // The data is left untouched, so that several expressions can train concurrently on it
+    const auto data_copy = data;
+    const auto label_copy = label;
+    std::vector<expression_ann> exs(4u, ex);
+    tbb::parallel_for(0u, 4u, [&](unsigned i) {
+        for (auto j = 0u; j < 5u; ++j) {
+            exs[i].sgd(data_copy, label_copy, 0.001, 32, "MSE");
+        }
+    });
+    BOOST_CHECK(data_copy == data);
+    BOOST_CHECK(label_copy == label);
+    // Without shuffling the batches are the consecutive points
+    auto ex2 = ex;
+    ex.sgd(data, label, 0.001, 32, "MSE", 0u, false);
+    for (auto i = 0u; i < data.size(); i += 32u) {
+        std::vector<std::vector<double>> bdata(data.begin() + i, data.begin() + std::min(i + 32u, 200u));
+        std::vector<std::vector<double>> blabel(label.begin() + i, label.begin() + std::min(i + 32u, 200u));
+        ex2.sgd(bdata, blabel, 0.001, 32, "MSE", 0u, false);
+    }
+    BOOST_CHECK(ex.get_weights() == ex2.get_weights());
 }
 
 BOOST_AUTO_TEST_CASE(d_loss)
@@ -302,6 +325,272 @@ BOOST_AUTO_TEST_CASE(d_loss)
     test_against_numerical_derivatives(5, 1, 6, 6, 2, {1, 1, 1, 1, 1, 1}, random_seed(gen), loss_t::CE);
 }
 
+// Checks the batch loss gradient against the cumulated single point gradients
+void test_batch_gradient(expression_ann &ex, unsigned batch_size, expression_ann::loss_type loss_e, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::normal_distribution<> norm{0., 1.};
+    std::uniform_real_distribution<> uni{0., 1.};
+    ex.randomise_weights(0, 1., seed);
+    ex.randomise_biases(0, 1., seed);
+    std::vector<std::vector<double>> points(batch_size, std::vector<double>(ex.get_n()));
+    std::vector<std::vector<double>> labels(batch_size, std::vector<double>(ex.get_m()));
+    for (auto i = 0u; i < batch_size; ++i) {
+        std::generate(points[i].begin(), points[i].end(), [&]() { return norm(gen); });
+        std::generate(labels[i].begin(), labels[i].end(), [&]() { return uni(gen); });
+    }
+    double value = 0.;
+    std::vector<double> gweights(ex.get_weights().size(), 0.);
+    std::vector<double> gbiases(ex.get_biases().size(), 0.);
+    for (auto i = 0u; i < batch_size; ++i) {
+        ex.d_loss(value, gweights, gbiases, points[i], labels[i], loss_e);
+    }
+    for (auto parallel : {0u, 2u}) {
+        auto batch = ex.d_loss(points, labels, loss_e, parallel);
+        BOOST_CHECK_CLOSE(std::get<0>(batch), value / batch_size, 1e-9);
+        for (auto i = 0u; i < gweights.size(); ++i) {
+            BOOST_CHECK_SMALL(std::get<1>(batch)[i] - gweights[i] / batch_size, 1e-11 * (1. + std::abs(gweights[i])));
+        }
+        for (auto i = 0u; i < gbiases.size(); ++i) {
+            BOOST_CHECK_SMALL(std::get<2>(batch)[i] - gbiases[i] / batch_size, 1e-11 * (1. + std::abs(gbiases[i])));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(layered)
+{
+    using loss_t = expression_ann::loss_type;
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    // A fully connected feed forward network (as created by dcgpy.encode_ffnn): 2 inputs, 4 - 3 hidden, 2 outputs
+    {
+        expression_ann ex(2u, 2u, 4u, 3u, 3u, {2u, 4u, 3u}, ann_set(), 32u);
+        std::vector<unsigned> x = ex.get();
+        std::vector<unsigned> layer_size{4u, 3u, 2u};
+        unsigned start_prev = 0u;
+        for (auto c = 0u; c < 3u; ++c) {
+            for (auto r = 0u; r < layer_size[c]; ++r) {
+                auto node_id = 2u + c * 4u + r;
+                auto g_idx = ex.get_gene_idx()[node_id];
+                x[g_idx] = c;
+                for (auto j = 0u; j < ex.get_arity(node_id); ++j) {
+                    x[g_idx + 1u + j] = start_prev + j;
+                }
+            }
+            start_prev = 2u + c * 4u;
+        }
+        x[x.size() - 2u] = start_prev;
+        x[x.size() - 1u] = start_prev + 1u;
+        ex.set(x);
+        BOOST_CHECK(ex.is_layered());
+        test_batch_gradient(ex, 10u, loss_t::MSE, 32u);
+        test_batch_gradient(ex, 10u, loss_t::CE, 33u);
+        // Connecting the output to the first hidden layer breaks the layers
+        x[x.size() - 1u] = 2u;
+        ex.set(x);
+        BOOST_CHECK(!ex.is_layered());
+        test_batch_gradient(ex, 10u, loss_t::MSE, 34u);
+        // As does skipping a layer
+        x[x.size() - 1u] = start_prev + 1u;
+        x[ex.get_gene_idx()[2u + 2u * 4u] + 1u] = 0u;
+        ex.set(x);
+        BOOST_CHECK(!ex.is_layered());
+        test_batch_gradient(ex, 10u, loss_t::MSE, 35u);
+    }
+    // With one level-back all dCGP-ANNs are layered
+    std::mt19937 gen(32u);
+    for (auto i = 0u; i < 20u; ++i) {
+        unsigned seed = gen();
+        expression_ann ex(3u, 2u, 10u, 4u, 1u, {3u, 10u, 5u, 7u}, ann_set(), seed);
+        BOOST_CHECK(ex.is_layered());
+        test_batch_gradient(ex, 8u, loss_t::MSE, seed);
+        test_batch_gradient(ex, 8u, loss_t::CE, seed);
+        // The general case must give the same results
+        expression_ann ex2(3u, 2u, 10u, 4u, 3u, {3u, 10u, 5u, 7u}, ann_set(), seed);
+        test_batch_gradient(ex2, 8u, loss_t::MSE, seed);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(minibatch)
+{
+    using loss_t = expression_ann::loss_type;
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    std::mt19937 gen(23u);
+    std::normal_distribution<> norm{0., 1.};
+    std::uniform_real_distribution<> uni{0., 1.};
+    for (auto i = 0u; i < 20u; ++i) {
+        unsigned seed = gen();
+        // Arbitrary (non layered) graphs, with repeated connections and nodes feeding several outputs
+        expression_ann ex(3u, 2u, 4u, 5u, 5u, {2u, 3u, 2u, 4u, 3u}, ann_set(), seed);
+        ex.randomise_weights(0., 1., seed);
+        ex.randomise_biases(0., 1., seed);
+        std::vector<std::vector<double>> points(13u, std::vector<double>(3u)), labels(13u, std::vector<double>(2u));
+        for (auto j = 0u; j < points.size(); ++j) {
+            std::generate(points[j].begin(), points[j].end(), [&]() { return norm(gen); });
+            std::generate(labels[j].begin(), labels[j].end(), [&]() { return uni(gen); });
+        }
+        for (auto loss_e : {loss_t::MSE, loss_t::CE}) {
+            double value = 0.;
+            std::vector<double> gweights(ex.get_weights().size(), 0.);
+            std::vector<double> gbiases(ex.get_biases().size(), 0.);
+            for (auto j = 0u; j < points.size(); ++j) {
+                ex.d_loss(value, gweights, gbiases, points[j], labels[j], loss_e);
+            }
+            // The serial minibatch is identical to the single point computations
+            auto batch = ex.d_loss(points, labels, loss_e, 0u);
+            if (ex.is_layered()) continue;
+            BOOST_CHECK_EQUAL(std::get<0>(batch), value / 13.);
+            for (auto j = 0u; j < gweights.size(); ++j) {
+                BOOST_CHECK_EQUAL(std::get<1>(batch)[j], gweights[j] / 13.);
+            }
+            for (auto j = 0u; j < gbiases.size(); ++j) {
+                BOOST_CHECK_EQUAL(std::get<2>(batch)[j], gbiases[j] / 13.);
+            }
+            // Splitting the batch in single points, the thread buffers are reduced to the same result
+            auto split = ex.d_loss(points, labels, loss_e, 13u);
+            BOOST_CHECK_CLOSE(std::get<0>(split), std::get<0>(batch), 1e-9);
+            for (auto j = 0u; j < gweights.size(); ++j) {
+                BOOST_CHECK_SMALL(std::get<1>(split)[j] - std::get<1>(batch)[j], 1e-12 * (1. + std::abs(gweights[j])));
+            }
+            for (auto j = 0u; j < gbiases.size(); ++j) {
+                BOOST_CHECK_SMALL(std::get<2>(split)[j] - std::get<2>(batch)[j], 1e-12 * (1. + std::abs(gbiases[j])));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(isru_zero_preactivation)
+{
+    // With the default null biases and null inputs all ISRU nodes have a null pre-activation, where the
+    // derivative is one
+    kernel_set<double> isru_set({"ISRU"});
+    expression_ann ex(2u, 2u, 4u, 3u, 3u, {2u, 4u, 3u}, isru_set(), 32u);
+    std::vector<unsigned> x = ex.get();
+    std::vector<unsigned> layer_size{4u, 3u, 2u};
+    unsigned start_prev = 0u;
+    for (auto c = 0u; c < 3u; ++c) {
+        for (auto r = 0u; r < layer_size[c]; ++r) {
+            auto g_idx = ex.get_gene_idx()[2u + c * 4u + r];
+            for (auto j = 0u; j < ex.get_arity(2u + c * 4u + r); ++j) {
+                x[g_idx + 1u + j] = start_prev + j;
+            }
+        }
+        start_prev = 2u + c * 4u;
+    }
+    x[x.size() - 2u] = start_prev;
+    x[x.size() - 1u] = start_prev + 1u;
+    std::vector<std::vector<double>> points(5u, std::vector<double>(2u, 0.)), labels;
+    for (auto i = 0u; i < points.size(); ++i) {
+        labels.push_back({0.1 * i, 0.5});
+    }
+    std::vector<double> out_bias_grad;
+    // The layered path first, then the minibatch one (the second output is connected to the first hidden layer)
+    for (auto layered : {true, false}) {
+        if (!layered) {
+            x[x.size() - 1u] = 2u;
+        }
+        ex.set(x);
+        BOOST_CHECK_EQUAL(ex.is_layered(), layered);
+        double value = 0.;
+        std::vector<double> gweights(ex.get_weights().size(), 0.);
+        std::vector<double> gbiases(ex.get_biases().size(), 0.);
+        for (auto i = 0u; i < points.size(); ++i) {
+            ex.d_loss(value, gweights, gbiases, points[i], labels[i], expression_ann::loss_type::MSE);
+        }
+        auto batch = ex.d_loss(points, labels, expression_ann::loss_type::MSE, 0u);
+        for (auto i = 0u; i < gweights.size(); ++i) {
+            BOOST_CHECK(std::isfinite(std::get<1>(batch)[i]));
+            BOOST_CHECK_SMALL(std::get<1>(batch)[i] - gweights[i] / 5., 1e-12);
+        }
+        for (auto i = 0u; i < gbiases.size(); ++i) {
+            BOOST_CHECK(std::isfinite(std::get<2>(batch)[i]));
+            BOOST_CHECK_SMALL(std::get<2>(batch)[i] - gbiases[i] / 5., 1e-12);
+        }
+        // The bias of the first output receives the loss derivative unchanged: -2 * mean(label) / m
+        BOOST_CHECK_CLOSE(std::get<2>(batch)[start_prev - 2u], -0.2, 1e-9);
+        out_bias_grad.push_back(std::get<2>(batch)[start_prev - 2u]);
+    }
+    BOOST_CHECK_CLOSE(out_bias_grad[0], out_bias_grad[1], 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(precision)
+{
+    using loss_t = expression_ann::loss_type;
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    {
+        expression_ann ex(3u, 2u, 4u, 5u, 5u, 2u, ann_set(), 32u);
+        BOOST_CHECK_EQUAL(ex.get_precision(), "double");
+        BOOST_CHECK_THROW(ex.set_precision("half"), std::invalid_argument);
+        BOOST_CHECK_EQUAL(ex.get_precision(), "double");
+        ex.set_precision("single");
+        BOOST_CHECK_EQUAL(ex.get_precision(), "single");
+        ex.set_precision("mixed");
+        BOOST_CHECK_EQUAL(ex.get_precision(), "mixed");
+    }
+    // Accuracy of the single and mixed precision gradients with respect to double precision on large batches, for
+    // arbitrary graphs (first level-back) and layered ones (second)
+    std::mt19937 gen(45u);
+    std::normal_distribution<> norm{0., 1.};
+    std::uniform_real_distribution<> uni{0., 1.};
+    for (auto i = 0u; i < 10u; ++i) {
+        unsigned seed = gen();
+        for (auto lb : {5u, 1u}) {
+            expression_ann ex(3u, 2u, 4u, 5u, lb, {2u, 3u, 2u, 4u, 3u}, ann_set(), seed);
+            ex.randomise_weights(0., 1., seed);
+            ex.randomise_biases(0., 1., seed);
+            std::vector<std::vector<double>> points(1000u, std::vector<double>(3u)),
+                labels(1000u, std::vector<double>(2u));
+            for (auto j = 0u; j < points.size(); ++j) {
+                std::generate(points[j].begin(), points[j].end(), [&]() { return norm(gen); });
+                std::generate(labels[j].begin(), labels[j].end(), [&]() { return uni(gen); });
+            }
+            for (auto loss_e : {loss_t::MSE, loss_t::CE}) {
+                ex.set_precision("double");
+                auto ref = ex.d_loss(points, labels, loss_e, 0u);
+                for (auto precision : {"single", "mixed"}) {
+                    ex.set_precision(precision);
+                    for (auto parallel : {0u, 4u}) {
+                        auto res = ex.d_loss(points, labels, loss_e, parallel);
+                        BOOST_CHECK_SMALL(std::get<0>(res) - std::get<0>(ref), 1e-5 * (1. + std::get<0>(ref)));
+                        for (auto j = 0u; j < std::get<1>(ref).size(); ++j) {
+                            BOOST_CHECK_SMALL(std::get<1>(res)[j] - std::get<1>(ref)[j],
+                                              1e-4 * (1. + std::abs(std::get<1>(ref)[j])));
+                        }
+                        for (auto j = 0u; j < std::get<2>(ref).size(); ++j) {
+                            BOOST_CHECK_SMALL(std::get<2>(res)[j] - std::get<2>(ref)[j],
+                                              1e-4 * (1. + std::abs(std::get<2>(ref)[j])));
+                        }
+                    }
+                }
+            }
+        }
+    }
+    // Training in single and mixed precision converges as in double precision, the weights being kept in double
+    // precision
+    std::vector<std::vector<double>> points, labels;
+    for (auto i = 0u; i < 200u; ++i) {
+        double x = -1. + 2. * i / 199.;
+        points.push_back({x});
+        labels.push_back({0.5 * x * x - 0.2 * x});
+    }
+    expression_ann ex(1u, 1u, 5u, 3u, 1u, {1u, 5u, 5u}, kernel_set<double>({"tanh", "sum"})(), 23u);
+    ex.set_output_f("sum");
+    ex.randomise_weights(0., 0.5, 23u);
+    ex.randomise_biases(0., 0.5, 23u);
+    const auto loss0 = ex.loss(points, labels, "MSE");
+    std::vector<double> final_loss;
+    for (auto precision : {"double", "single", "mixed"}) {
+        auto ex2 = ex;
+        ex2.set_precision(precision);
+        for (auto epoch = 0u; epoch < 50u; ++epoch) {
+            ex2.sgd(points, labels, 0.1, 10u, "MSE", 0u, false);
+        }
+        final_loss.push_back(ex2.loss(points, labels, "MSE"));
+        BOOST_CHECK(final_loss.back() < 0.5 * loss0);
+    }
+    BOOST_CHECK_CLOSE(final_loss[1], final_loss[0], 1.);
+    BOOST_CHECK_CLOSE(final_loss[2], final_loss[0], 1.);
+}
+
 BOOST_AUTO_TEST_CASE(n_active_weights)
 {
     // Random numbers stuff
@@ -322,4 +611,232 @@ BOOST_AUTO_TEST_CASE(n_active_weights)
         BOOST_CHECK(ex.n_active_weights(false) == 8u);
         BOOST_CHECK(ex.n_active_weights(true) == 7u);
     }
-}
\ No newline at end of file
+    {
+        // Only the active weights and biases are updated by sgd
+        expression_ann ex(2, 1, 4, 4, 5, 2, ann_set(), 32u);
+        ex.randomise_weights(0., 1., 32u);
+        ex.randomise_biases(0., 1., 32u);
+        std::mt19937 gen32(32u);
+        std::vector<std::vector<double>> points(8u, std::vector<double>(2u)), labels(8u, std::vector<double>(1u));
+        for (auto i = 0u; i < points.size(); ++i) {
+            points[i] = {norm(gen32), norm(gen32)};
+            labels[i] = {norm(gen32)};
+        }
+        auto weights = ex.get_weights();
+        auto biases = ex.get_biases();
+        ex.sgd(points, labels, 0.1, 4u, "MSE", 0u, false);
+        std::vector<bool> active_w(weights.size(), false), active_b(biases.size(), false);
+        for (auto node_id : ex.get_active_nodes()) {
+            if (node_id < 2u) continue;
+            active_b[node_id - 2u] = true;
+            for (auto i = 0u; i < 2u; ++i) {
+                active_w[(node_id - 2u) * 2u + i] = true;
+            }
+        }
+        BOOST_CHECK_EQUAL(std::count(active_w.begin(), active_w.end(), true), ex.n_active_weights());
+        for (auto i = 0u; i < weights.size(); ++i) {
+            BOOST_CHECK(active_w[i] || ex.get_weights()[i] == weights[i]);
+        }
+        for (auto i = 0u; i < biases.size(); ++i) {
+            BOOST_CHECK(active_b[i] || ex.get_biases()[i] == biases[i]);
+        }
+        BOOST_CHECK(ex.get_weights() != weights);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(optimizers)
+{
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    expression_ann ex(2u, 1u, 5u, 4u, 2u, 2u, ann_set(), 32u);
+    BOOST_CHECK_EQUAL(ex.get_optimizer(), "SGD");
+    BOOST_CHECK_THROW(ex.set_optimizer("ADAMW"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.set_optimizer("ADAM", 1.), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.set_optimizer("ADAM", 0.9, -0.1), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.set_optimizer("ADAM", 0.9, 0.999, 0.), std::invalid_argument);
+    std::mt19937 gen(32u);
+    std::normal_distribution<> norm{0., 1.};
+    std::vector<std::vector<double>> points(64u), labels(64u);
+    for (auto i = 0u; i < points.size(); ++i) {
+        points[i] = {norm(gen), norm(gen)};
+        labels[i] = {std::sin(points[i][0]) * points[i][1]};
+    }
+    ex.randomise_weights(0., 1., 32u);
+    ex.randomise_biases(0., 1., 32u);
+    const double lr = 0.01, b1 = 0.8, b2 = 0.9, eps = 1e-6;
+    for (std::string name : {"SGD", "MOMENTUM", "NESTEROV", "RMSPROP", "ADAM"}) {
+        auto ex2 = ex;
+        ex2.set_optimizer(name, b1, b2, eps);
+        BOOST_CHECK_EQUAL(ex2.get_optimizer(), name);
+        // Two full batch steps, compared to the update rules
+        std::vector<double> m1(ex.get_weights().size(), 0.), m2(ex.get_weights().size(), 0.);
+        auto w = ex2.get_weights();
+        for (auto t = 1u; t <= 2u; ++t) {
+            auto g = std::get<1>(ex2.d_loss(points, labels, expression_ann::loss_type::MSE, 0u));
+            ex2.sgd(points, labels, lr, 64u, "MSE", 0u, false);
+            for (auto i = 0u; i < w.size(); ++i) {
+                if (name == "SGD") {
+                    w[i] -= lr * g[i];
+                } else if (name == "MOMENTUM") {
+                    m1[i] = b1 * m1[i] + g[i];
+                    w[i] -= lr * m1[i];
+                } else if (name == "NESTEROV") {
+                    m1[i] = b1 * m1[i] + g[i];
+                    w[i] -= lr * (g[i] + b1 * m1[i]);
+                } else if (name == "RMSPROP") {
+                    m2[i] = b2 * m2[i] + (1. - b2) * g[i] * g[i];
+                    w[i] -= lr * g[i] / (std::sqrt(m2[i]) + eps);
+                } else {
+                    m1[i] = b1 * m1[i] + (1. - b1) * g[i];
+                    m2[i] = b2 * m2[i] + (1. - b2) * g[i] * g[i];
+                    w[i] -= lr * m1[i] / (1. - std::pow(b1, t)) / (std::sqrt(m2[i] / (1. - std::pow(b2, t))) + eps);
+                }
+                // Inactive weights are not updated
+                if (g[i] == 0.) {
+                    w[i] = ex2.get_weights()[i];
+                }
+                BOOST_CHECK_CLOSE(ex2.get_weights()[i], w[i], 1e-9);
+            }
+        }
+        // Training decreases the loss
+        auto loss0 = ex.loss(points, labels, "MSE");
+        for (auto epoch = 0u; epoch < 20u; ++epoch) {
+            ex2.sgd(points, labels, lr, 8u, "MSE", 0u, false);
+        }
+        BOOST_CHECK(ex2.loss(points, labels, "MSE") < loss0);
+    }
+    // The state of reconnected weights is reset, the other is kept
+    ex.set_optimizer("MOMENTUM", b1);
+    ex.sgd(points, labels, lr, 64u, "MSE", 0u, false);
+    auto x = ex.get();
+    auto node_id = ex.get_active_nodes().back();
+    auto g_idx = ex.get_gene_idx()[node_id];
+    x[g_idx + 1u] = (x[g_idx + 1u] == ex.get_lb()[g_idx + 1u]) ? ex.get_ub()[g_idx + 1u] : ex.get_lb()[g_idx + 1u];
+    ex.set(x);
+    auto w = ex.get_weights();
+    auto g = std::get<1>(ex.d_loss(points, labels, expression_ann::loss_type::MSE, 0u));
+    ex.sgd(points, labels, lr, 64u, "MSE", 0u, false);
+    auto w_idx = g_idx - (node_id - 2u);
+    BOOST_CHECK_CLOSE(ex.get_weights()[w_idx], w[w_idx] - lr * g[w_idx], 1e-9);
+    BOOST_CHECK(std::abs(ex.get_weights()[w_idx + 1u] - (w[w_idx + 1u] - lr * g[w_idx + 1u])) > 1e-12);
+    // Resetting the optimizer makes the next step a gradient step
+    ex.reset_optimizer();
+    w = ex.get_weights();
+    g = std::get<1>(ex.d_loss(points, labels, expression_ann::loss_type::MSE, 0u));
+    ex.sgd(points, labels, lr, 64u, "MSE", 0u, false);
+    for (auto i = 0u; i < w.size(); ++i) {
+        BOOST_CHECK_CLOSE(ex.get_weights()[i], w[i] - lr * g[i], 1e-9);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sgd_async)
+{
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    expression_ann ex(2u, 1u, 10u, 5u, 3u, 2u, ann_set(), 32u);
+    ex.randomise_weights(0., 1., 32u);
+    ex.randomise_biases(0., 1., 32u);
+    ex.set_output_f("sum");
+    std::mt19937 gen(32u);
+    std::normal_distribution<> norm{0., 1.};
+    std::vector<std::vector<double>> points(100u), labels(100u);
+    for (auto i = 0u; i < points.size(); ++i) {
+        points[i] = {norm(gen), norm(gen)};
+        labels[i] = {std::sin(points[i][0]) * points[i][1]};
+    }
+    BOOST_CHECK_THROW(ex.sgd_async(points, {{1.}}, 0.1, 10u, "MSE"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.sgd_async({}, {}, 0.1, 10u, "MSE"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.sgd_async(points, labels, 0., 10u, "MSE"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.sgd_async(points, labels, 0.1, 0u, "MSE"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.sgd_async(points, labels, 0.1, 10u, "MSX"), std::invalid_argument);
+    // With one shard it is the synchronous sgd
+    {
+        auto ex2 = ex;
+        auto points2 = points;
+        auto labels2 = labels;
+        auto l1 = ex.sgd_async(points, labels, 0.1, 7u, "MSE", 1u, false);
+        auto l2 = ex2.sgd(points2, labels2, 0.1, 7u, "MSE", 0u, false);
+        BOOST_CHECK_EQUAL(l1, l2);
+        BOOST_CHECK(ex.get_weights() == ex2.get_weights());
+        BOOST_CHECK(ex.get_biases() == ex2.get_biases());
+    }
+    // With one shard and a given seed it is reproducible, also when shuffling
+    {
+        auto ex2 = ex;
+        auto ex3 = ex;
+        auto l2 = ex2.sgd_async(points, labels, 0.1, 7u, "MSE", 1u, true, 23u);
+        auto l3 = ex3.sgd_async(points, labels, 0.1, 7u, "MSE", 1u, true, 23u);
+        BOOST_CHECK_EQUAL(l2, l3);
+        BOOST_CHECK(ex2.get_weights() == ex3.get_weights());
+        BOOST_CHECK(ex2.get_biases() == ex3.get_biases());
+    }
+    // Only the plain SGD update rule is supported
+    {
+        auto ex2 = ex;
+        ex2.set_optimizer("ADAM");
+        BOOST_CHECK_THROW(ex2.sgd_async(points, labels, 0.1, 10u, "MSE"), std::invalid_argument);
+        ex2.set_optimizer("SGD");
+        BOOST_CHECK_NO_THROW(ex2.sgd_async(points, labels, 0.1, 10u, "MSE"));
+    }
+    // With many shards it still trains
+    auto loss0 = ex.loss(points, labels, "MSE");
+    for (auto epoch = 0u; epoch < 20u; ++epoch) {
+        ex.sgd_async(points, labels, 0.01, 10u, "MSE", 4u);
+    }
+    BOOST_CHECK(ex.loss(points, labels, "MSE") < loss0);
+    // More shards than points
+    ex.sgd_async(points, labels, 0.05, 5u, "MSE", 1000u);
+}
+
+BOOST_AUTO_TEST_CASE(serialization)
+{
+    // Random seed
+    std::random_device rd;
+    // Kernel functions
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    expression_ann ex(3, 2, 10, 4, 2, {3, 10, 5, 10}, ann_set(), rd());
+    ex.randomise_weights(0., 1., rd());
+    ex.randomise_biases(0., 1., rd());
+    ex.set_output_f("sum");
+    std::stringstream ss;
+    {
+        boost::archive::binary_oarchive oarchive(ss);
+        oarchive << ex;
+    }
+    kernel_set<double> other_set({"tanh"});
+    expression_ann ex2(1, 1, 1, 1, 1, 1, other_set(), rd());
+    {
+        boost::archive::binary_iarchive iarchive(ss);
+        iarchive >> ex2;
+    }
+    BOOST_CHECK(ex.get() == ex2.get());
+    BOOST_CHECK(ex.get_weights() == ex2.get_weights());
+    BOOST_CHECK(ex.get_biases() == ex2.get_biases());
+    BOOST_CHECK(ex({0.1, 0.2, 0.3}) == ex2({0.1, 0.2, 0.3}));
+    BOOST_CHECK(ex(std::vector<std::string>{"x", "y", "z"}) == ex2(std::vector<std::string>{"x", "y", "z"}));
+    // The backward pass also needs the connection data structures to be rebuilt upon deserialization
+    std::vector<std::vector<double>> data{{0.1, 0.2, 0.3}, {-0.1, 0.4, 0.5}};
+    std::vector<std::vector<double>> labels{{0.1, 0.2}, {-0.1, 0.4}};
+    auto g1 = ex.d_loss(data, labels, expression_ann::loss_type::MSE, 0u);
+    auto g2 = ex2.d_loss(data, labels, expression_ann::loss_type::MSE, 0u);
+    BOOST_CHECK_EQUAL(std::get<0>(g1), std::get<0>(g2));
+    BOOST_CHECK(std::get<1>(g1) == std::get<1>(g2));
+    BOOST_CHECK(std::get<2>(g1) == std::get<2>(g2));
+    // The optimizer and its state are also serialized
+    ex.set_optimizer("ADAM", 0.8, 0.9);
+    ex.set_precision("mixed");
+    ex.sgd(data, labels, 0.1, 2u, "MSE", 0u, false);
+    std::stringstream ss2;
+    {
+        boost::archive::binary_oarchive oarchive(ss2);
+        oarchive << ex;
+    }
+    {
+        boost::archive::binary_iarchive iarchive(ss2);
+        iarchive >> ex2;
+    }
+    BOOST_CHECK_EQUAL(ex2.get_optimizer(), "ADAM");
+    BOOST_CHECK_EQUAL(ex2.get_precision(), "mixed");
+    ex.sgd(data, labels, 0.1, 2u, "MSE", 0u, false);
+    ex2.sgd(data, labels, 0.1, 2u, "MSE", 0u, false);
+    BOOST_CHECK(ex.get_weights() == ex2.get_weights());
+    BOOST_CHECK(ex.get_biases() == ex2.get_biases());
+}
@@ -5,6 +5,8 @@
 #include <audi/io.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/timer/timer.hpp>
+#include <chrono>
+#include <iostream>
 
 #include <dcgp/expression_ann.hpp>
 #include <dcgp/kernel_set.hpp>
@@ -76,3 +78,45 @@ BOOST_AUTO_TEST_CASE(evaluation_speed)
     perform_sgd(100, 10, 1, {100, 100, 100, 100, 100, 100, 100, 100, 100, 100}, N, 32u, kernel_set1(), 16u);
     perform_sgd(100, 10, 1, {100, 100, 100, 100, 100, 100, 100, 100, 100, 100}, N, 32u, kernel_set1(), 32u);
 }
+
+// Trains a sparse dCGP-ANN for some epochs printing the loss against the wall clock time
+void convergence(bool async, unsigned parallel)
+{
+    unsigned N = 4096u;
+    std::mt19937 gen(123u);
+    std::normal_distribution<> norm(0., 1.);
+    dcgp::kernel_set<double> kernel_set1({"sig", "tanh", "ReLu", "ISRU", "ELU", "sum"});
+    expression_ann ex(3u, 2u, 100u, 20u, 20u, 5u, kernel_set1(), 123u);
+    ex.randomise_weights(0., 0.1, 123u);
+    ex.randomise_biases(0., 0.1, 123u);
+    ex.set_output_f("sum");
+    std::vector<std::vector<double>> data(N, std::vector<double>(3u)), label(N, std::vector<double>(2u));
+    for (auto i = 0u; i < N; ++i) {
+        std::generate(data[i].begin(), data[i].end(), [&norm, &gen]() { return norm(gen); });
+        label[i][0] = 1. / 5. * std::cos(data[i][0] + data[i][1] + data[i][2]) - data[i][0] * data[i][1];
+        label[i][1] = data[i][0] * data[i][1] * data[i][2];
+    }
+    std::cout << (async ? "Asynchronous sgd, shards: " : "Synchronous sgd, parallel: ") << parallel
+              << " active weights: " << ex.n_active_weights() << std::endl;
+    double elapsed = 0.;
+    for (auto epoch = 0u; epoch < 5u; ++epoch) {
+        auto start = std::chrono::steady_clock::now();
+        if (async) {
+            ex.sgd_async(data, label, 0.01, 32u, "MSE", parallel, false);
+        } else {
+            ex.sgd(data, label, 0.01, 32u, "MSE", parallel, false);
+        }
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\tepoch: " << epoch << " time: " << elapsed << "s loss: " << ex.loss(data, label, "MSE")
+                  << std::endl;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(async_convergence_speed)
+{
+    // Loss against the wall clock time for the synchronous and the asynchronous (Hogwild) sgd
+    convergence(false, 0u);
+    convergence(false, 8u);
+    convergence(true, 1u);
+    convergence(true, 8u);
+}
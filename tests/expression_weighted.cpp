@@ -0,0 +1,157 @@
+#define BOOST_TEST_MODULE dcgp_expression_weighted_test
+#include <algorithm>
+#include <audi/audi.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <dcgp/expression_weighted.hpp>
+#include <dcgp/kernel_set.hpp>
+
+using namespace dcgp;
+
+BOOST_AUTO_TEST_CASE(d_loss)
+{
+    // pdiv is excluded as its gdual version differs
+    std::vector<std::string> names({"sum", "diff", "mul", "div", "sig", "tanh", "ReLu", "ELU", "ISRU", "sin", "cos",
+                                    "log", "exp"});
+    kernel_set<double> set(names);
+    kernel_set<gdual_d> set_d(names);
+    std::mt19937 gen(123u);
+    std::uniform_real_distribution<> uni(0.1, 2.);
+    std::normal_distribution<> norm(0., 1.);
+    for (auto i = 0u; i < 50u; ++i) {
+        unsigned seed = gen();
+        expression_weighted<double> ex(2u, 2u, 3u, 8u, 9u, 2u, set(), seed);
+        expression_weighted<gdual_d> ex_d(2u, 2u, 3u, 8u, 9u, 2u, set_d(), seed);
+        std::vector<double> w(ex.get_weights().size());
+        std::generate(w.begin(), w.end(), [&]() { return norm(gen); });
+        ex.set_weights(w);
+        // Each weight is a symbol of the gdual expression
+        std::vector<gdual_d> w_d;
+        for (auto k = 0u; k < w.size(); ++k) {
+            w_d.emplace_back(w[k], "w" + std::to_string(k), 1);
+        }
+        ex_d.set_weights(w_d);
+        std::vector<double> point({uni(gen), uni(gen)}), label({norm(gen), norm(gen)});
+        auto loss_d = ex_d.loss({gdual_d(point[0]), gdual_d(point[1])}, {gdual_d(label[0]), gdual_d(label[1])},
+                                expression<gdual_d>::loss_type::MSE);
+        double value = 0.;
+        std::vector<double> gweights(w.size(), 0.);
+        ex.d_loss(value, gweights, point, label, expression<double>::loss_type::MSE);
+        // Sparse gduals treat 0 * nan as 0, doubles do not
+        if (!std::isfinite(value)) continue;
+        BOOST_CHECK(std::abs(value - loss_d.constant_cf()) <= 1e-12 * (1. + std::abs(value)));
+        for (auto k = 0u; k < w.size(); ++k) {
+            auto d = loss_d.get_derivative(std::unordered_map<std::string, unsigned>{{"dw" + std::to_string(k), 1u}});
+            if (!std::isfinite(d)) continue;
+            BOOST_CHECK(std::abs(gweights[k] - d) <= 1e-9 * (1. + std::abs(d)));
+        }
+    }
+    // Batches (and cross entropy) against central differences
+    expression_weighted<double> ex(3u, 3u, 3u, 8u, 9u, 2u, kernel_set<double>({"sum", "mul", "sin", "pdiv", "exp"})(),
+                                   32u);
+    std::vector<double> w(ex.get_weights().size());
+    std::generate(w.begin(), w.end(), [&]() { return norm(gen); });
+    ex.set_weights(w);
+    std::vector<std::vector<double>> points(60u, std::vector<double>(3u)), labels(60u, std::vector<double>(3u, 0.));
+    for (auto j = 0u; j < points.size(); ++j) {
+        std::generate(points[j].begin(), points[j].end(), [&]() { return uni(gen); });
+        labels[j][j % 3u] = 1.;
+    }
+    for (std::string loss_s : {"MSE", "CE"}) {
+        auto loss_e = (loss_s == "MSE") ? expression<double>::loss_type::MSE : expression<double>::loss_type::CE;
+        auto res = ex.d_loss(points, labels, loss_e);
+        BOOST_CHECK_CLOSE(std::get<0>(res), ex.loss(points, labels, loss_s), 1e-9);
+        for (auto k = 0u; k < w.size(); ++k) {
+            auto p = w, m = w;
+            p[k] += 1e-6;
+            m[k] -= 1e-6;
+            auto ex_p = ex, ex_m = ex;
+            ex_p.set_weights(p);
+            ex_m.set_weights(m);
+            auto fd = (ex_p.loss(points, labels, loss_s) - ex_m.loss(points, labels, loss_s)) / 2e-6;
+            BOOST_CHECK_SMALL(std::get<1>(res)[k] - fd, 1e-5 * (1. + std::abs(fd)));
+        }
+        // Parallel and serial computations agree
+        auto res_p = ex.d_loss(points, labels, loss_e, 4u);
+        BOOST_CHECK_CLOSE(std::get<0>(res_p), std::get<0>(res), 1e-9);
+        for (auto k = 0u; k < w.size(); ++k) {
+            BOOST_CHECK_SMALL(std::get<1>(res_p)[k] - std::get<1>(res)[k], 1e-12 * (1. + std::abs(std::get<1>(res)[k])));
+        }
+    }
+    // Errors
+    double value = 0.;
+    std::vector<double> gweights(w.size(), 0.);
+    BOOST_CHECK_THROW(ex.d_loss(value, gweights, {1., 2.}, {1., 2., 3.}, expression<double>::loss_type::MSE),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(ex.d_loss(value, gweights, {1., 2., 3.}, {1., 2.}, expression<double>::loss_type::MSE),
+                      std::invalid_argument);
+    gweights.pop_back();
+    BOOST_CHECK_THROW(ex.d_loss(value, gweights, {1., 2., 3.}, {1., 2., 3.}, expression<double>::loss_type::MSE),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(ex.d_loss(points, {}, expression<double>::loss_type::MSE), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.d_loss(points, labels, expression<double>::loss_type::MSE, 7u), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.d_loss({{1., 2.}}, {{1., 2., 3.}}, expression<double>::loss_type::MSE),
+                      std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(sgd)
+{
+    std::mt19937 gen(32u);
+    std::uniform_real_distribution<> uni(-1., 1.);
+    std::normal_distribution<> norm(0., 1.);
+    kernel_set<double> set({"sum", "diff", "mul", "sin", "cos"});
+    // The data are generated by an expression, whose weights are then perturbed and learned back
+    expression_weighted<double> target(2u, 1u, 3u, 6u, 7u, 2u, set(), 123u);
+    std::vector<double> w(target.get_weights().size());
+    std::generate(w.begin(), w.end(), [&]() { return norm(gen); });
+    target.set_weights(w);
+    std::vector<std::vector<double>> points(200u, std::vector<double>(2u)), labels;
+    for (auto &p : points) {
+        std::generate(p.begin(), p.end(), [&]() { return uni(gen); });
+        labels.push_back(target(p));
+    }
+    auto ex = target;
+    std::transform(w.begin(), w.end(), w.begin(), [&](double a) { return a + 0.2 * norm(gen); });
+    ex.set_weights(w);
+    auto start = ex.loss(points, labels, "MSE");
+    for (auto i = 0u; i < 200u; ++i) {
+        ex.sgd(points, labels, 0.05, 20u, "MSE");
+    }
+    BOOST_CHECK(ex.loss(points, labels, "MSE") < 0.01 * start);
+    // Without shuffling, and in parallel
+    ex.set_weights(w);
+    for (auto i = 0u; i < 200u; ++i) {
+        ex.sgd(points, labels, 0.05, 20u, "MSE", 2u, false);
+    }
+    BOOST_CHECK(ex.loss(points, labels, "MSE") < 0.01 * start);
+    // The inactive weights are untouched
+    for (auto k = 0u; k < w.size(); ++k) {
+        bool active = false;
+        for (auto node_id : ex.get_active_nodes()) {
+            if (node_id < ex.get_n()) continue;
+            auto w_idx = ex.get_gene_idx()[node_id] - (node_id - ex.get_n());
+            active = active || (k >= w_idx && k < w_idx + ex.get_arity(node_id));
+        }
+        if (!active) {
+            BOOST_CHECK_EQUAL(ex.get_weights()[k], w[k]);
+        }
+    }
+    // Errors
+    BOOST_CHECK_THROW(ex.sgd(points, {}, 0.1, 10u, "MSE"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.sgd({}, {}, 0.1, 10u, "MSE"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.sgd(points, labels, -0.1, 10u, "MSE"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.sgd(points, labels, 0.1, 0u, "MSE"), std::invalid_argument);
+    BOOST_CHECK_THROW(ex.sgd(points, labels, 0.1, 10u, "MAE"), std::invalid_argument);
+    // Kernels without derivatives cannot be trained
+    kernel<double> my_kernel([](const std::vector<double> &in) { return in[0]; },
+                             [](const std::vector<std::string> &in) { return in[0]; }, "id");
+    expression_weighted<double> ex2(2u, 1u, 1u, 1u, 1u, 2u, {my_kernel}, 0u);
+    BOOST_CHECK_THROW(ex2.sgd(points, labels, 0.1, 10u, "MSE"), std::invalid_argument);
+}
@@ -0,0 +1,101 @@
+#define BOOST_TEST_MODULE dcgp_frozen_ann_test
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <tbb/tbb.h>
+#include <vector>
+
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/frozen_ann.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/s11n.hpp>
+
+using namespace dcgp;
+
+BOOST_AUTO_TEST_CASE(construction)
+{
+    using act = frozen_ann::activation;
+    // Default constructed
+    frozen_ann empty;
+    BOOST_CHECK_EQUAL(empty.get_n(), 0u);
+    BOOST_CHECK_EQUAL(empty.get_m(), 0u);
+    BOOST_CHECK_EQUAL(empty.get_n_nodes(), 0u);
+    // A hand made network: o = tanh(2 x + 3 y + 0.5), x
+    frozen_ann f(2u, {act::TANH}, {0u, 2u}, {0u, 1u}, {2., 3.}, {0.5}, {2u, 0u});
+    BOOST_CHECK_EQUAL(f.get_n(), 2u);
+    BOOST_CHECK_EQUAL(f.get_m(), 2u);
+    BOOST_CHECK_EQUAL(f.get_n_nodes(), 1u);
+    auto out = f({0.1, -0.2});
+    BOOST_CHECK_EQUAL(out[0], std::tanh(0.1 * 2. + 0.5 + -0.2 * 3.));
+    BOOST_CHECK_EQUAL(out[1], 0.1);
+    BOOST_CHECK_THROW(f(std::vector<double>{0.1}), std::invalid_argument);
+    BOOST_CHECK_THROW(f(std::vector<std::vector<double>>{{0.1, 0.2}, {0.1}}), std::invalid_argument);
+    // Inconsistent data
+    BOOST_CHECK_THROW(frozen_ann(2u, {act::TANH}, {0u, 2u}, {0u, 1u}, {2.}, {0.5}, {2u}), std::invalid_argument);
+    BOOST_CHECK_THROW(frozen_ann(2u, {act::TANH}, {0u, 2u}, {0u, 1u}, {2., 3.}, {}, {2u}), std::invalid_argument);
+    BOOST_CHECK_THROW(frozen_ann(2u, {act::TANH}, {0u, 0u}, {}, {}, {0.5}, {2u}), std::invalid_argument);
+    // Not topologically sorted
+    BOOST_CHECK_THROW(frozen_ann(2u, {act::TANH}, {0u, 2u}, {0u, 2u}, {2., 3.}, {0.5}, {2u}), std::invalid_argument);
+    // Output register out of range
+    BOOST_CHECK_THROW(frozen_ann(2u, {act::TANH}, {0u, 2u}, {0u, 1u}, {2., 3.}, {0.5}, {3u}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(freeze)
+{
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    std::mt19937 gen(32u);
+    std::normal_distribution<> norm(0., 1.);
+    for (auto i = 0u; i < 20u; ++i) {
+        unsigned seed = gen();
+        expression_ann ex(3u, 2u, 5u, 6u, 4u, {2u, 3u, 2u, 4u, 3u, 2u}, ann_set(), seed);
+        ex.randomise_weights(0., 1., seed);
+        ex.randomise_biases(0., 1., seed);
+        auto f = ex.freeze();
+        BOOST_CHECK_EQUAL(f.get_n(), 3u);
+        BOOST_CHECK_EQUAL(f.get_m(), 2u);
+        // Only the active nodes are kept
+        BOOST_CHECK_EQUAL(f.get_n_nodes(), std::count_if(ex.get_active_nodes().begin(), ex.get_active_nodes().end(),
+                                                         [](unsigned id) { return id >= 3u; }));
+        BOOST_CHECK_EQUAL(f.get_weights().size(), ex.n_active_weights());
+        // The frozen network computes the same outputs, point by point and on batches spanning several chunks
+        std::vector<std::vector<double>> points(150u, std::vector<double>(3u));
+        for (auto &p : points) {
+            std::generate(p.begin(), p.end(), [&]() { return norm(gen); });
+        }
+        auto batch = f(points);
+        BOOST_CHECK_EQUAL(batch.size(), points.size());
+        for (auto j = 0u; j < points.size(); ++j) {
+            auto expected = ex(points[j]);
+            BOOST_CHECK(f(points[j]) == expected);
+            BOOST_CHECK(batch[j] == expected);
+        }
+        // It does not depend on the expression anymore
+        auto ex2 = ex;
+        ex2.randomise_weights(0., 1., seed + 1u);
+        BOOST_CHECK(f(points[0]) == ex(points[0]));
+        // Serialization
+        std::stringstream ss;
+        {
+            boost::archive::binary_oarchive oarchive(ss);
+            oarchive << f;
+        }
+        frozen_ann f2;
+        {
+            boost::archive::binary_iarchive iarchive(ss);
+            iarchive >> f2;
+        }
+        BOOST_CHECK(f2(points) == batch);
+        // Concurrent use
+        std::vector<std::vector<std::vector<double>>> results(8u);
+        tbb::parallel_for(0u, 8u, [&](unsigned k) { results[k] = f(points); });
+        for (const auto &r : results) {
+            BOOST_CHECK(r == batch);
+        }
+    }
+    // Empty batch
+    expression_ann ex(3u, 2u, 5u, 6u, 4u, 2u, ann_set(), 32u);
+    BOOST_CHECK(ex.freeze()(std::vector<std::vector<double>>{}).size() == 0u);
+}
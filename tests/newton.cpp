@@ -0,0 +1,132 @@
+#define BOOST_TEST_MODULE dcgp_newton_test
+#include <algorithm>
+#include <audi/audi.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dcgp/expression.hpp>
+#include <dcgp/expression_weighted.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/newton.hpp>
+
+using namespace dcgp;
+
+// Evaluates the gdual expression on a point of doubles
+template <typename Expression>
+std::vector<double> eval(const Expression &ex, const std::vector<double> &point)
+{
+    auto out = ex(std::vector<gdual_d>(point.begin(), point.end()));
+    std::vector<double> retval;
+    for (const auto &o : out) {
+        retval.push_back(o.constant_cf());
+    }
+    return retval;
+}
+
+BOOST_AUTO_TEST_CASE(constants)
+{
+    std::mt19937 gen(123u);
+    std::uniform_real_distribution<> uni(-1., 1.);
+    kernel_set<gdual_d> set({"sum", "diff", "mul"});
+    // The inputs are x, c1, y, c2: the data are generated at known constants, then perturbed and fitted back
+    std::vector<double> true_c({0.7, -1.3});
+    for (auto i = 0u; i < 20u; ++i) {
+        expression<gdual_d> ex(4u, 1u, 1u, 8u, 9u, 2u, set(), gen());
+        std::vector<std::vector<double>> points(100u, std::vector<double>(2u)), labels;
+        for (auto &p : points) {
+            std::generate(p.begin(), p.end(), [&]() { return uni(gen); });
+            labels.push_back(eval(ex, {p[0], true_c[0], p[1], true_c[1]}));
+        }
+        std::vector<double> c({true_c[0] + 0.1 * uni(gen), true_c[1] + 0.1 * uni(gen)});
+        auto loss = newton_constants(ex, c, {1u, 3u}, points, labels, "MSE");
+        BOOST_CHECK_SMALL(loss, 1e-12);
+        // The returned loss is the one of the optimized constants
+        double check = 0.;
+        for (auto j = 0u; j < points.size(); ++j) {
+            auto o = eval(ex, {points[j][0], c[0], points[j][1], c[1]});
+            check += (o[0] - labels[j][0]) * (o[0] - labels[j][0]);
+        }
+        BOOST_CHECK_SMALL(check / static_cast<double>(points.size()) - loss, 1e-12);
+    }
+    // Cross entropy never increases
+    expression<gdual_d> ex(3u, 3u, 2u, 6u, 7u, 2u, kernel_set<gdual_d>({"sum", "mul", "sin"})(), 32u);
+    std::vector<std::vector<double>> points(60u, std::vector<double>(2u)), labels(60u, std::vector<double>(3u, 0.));
+    for (auto j = 0u; j < points.size(); ++j) {
+        std::generate(points[j].begin(), points[j].end(), [&]() { return uni(gen); });
+        labels[j][j % 3u] = 1.;
+    }
+    std::vector<double> c({0.5});
+    std::vector<std::vector<gdual_d>> gpoints, glabels;
+    for (auto j = 0u; j < points.size(); ++j) {
+        gpoints.push_back({gdual_d(c[0]), gdual_d(points[j][0]), gdual_d(points[j][1])});
+        glabels.emplace_back(labels[j].begin(), labels[j].end());
+    }
+    auto start = ex.loss(gpoints, glabels, "CE").constant_cf();
+    auto loss = newton_constants(ex, c, {0u}, points, labels, "CE", 10u);
+    BOOST_CHECK(loss <= start);
+    // Errors
+    BOOST_CHECK_THROW(newton_constants(ex, c, {}, points, labels), std::invalid_argument);
+    BOOST_CHECK_THROW(newton_constants(ex, c, {3u}, points, labels), std::invalid_argument);
+    BOOST_CHECK_THROW(newton_constants(ex, c, {0u, 1u}, points, labels), std::invalid_argument);
+    c.push_back(0.5);
+    BOOST_CHECK_THROW(newton_constants(ex, c, {0u, 0u}, points, labels), std::invalid_argument);
+    c.pop_back();
+    BOOST_CHECK_THROW(newton_constants(ex, c, {0u}, points, labels, "MAE"), std::invalid_argument);
+    BOOST_CHECK_THROW(newton_constants(ex, c, {0u}, points, {}), std::invalid_argument);
+    BOOST_CHECK_THROW(newton_constants(ex, c, {0u}, {}, {}), std::invalid_argument);
+    BOOST_CHECK_THROW(newton_constants(ex, c, {0u}, {{0.1, 0.2, 0.3}}, {{1., 0., 0.}}), std::invalid_argument);
+    BOOST_CHECK_THROW(newton_constants(ex, c, {0u}, {{0.1, 0.2}}, {{1., 0.}}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(weights)
+{
+    std::mt19937 gen(32u);
+    std::uniform_real_distribution<> uni(-1., 1.);
+    std::normal_distribution<> norm(0., 1.);
+    kernel_set<gdual_d> set({"sum", "diff", "mul", "sin", "cos"});
+    for (auto i = 0u; i < 10u; ++i) {
+        expression_weighted<gdual_d> ex(2u, 1u, 3u, 6u, 7u, 2u, set(), gen());
+        std::vector<gdual_d> w;
+        for (auto k = 0u; k < ex.get_weights().size(); ++k) {
+            w.emplace_back(norm(gen));
+        }
+        ex.set_weights(w);
+        std::vector<std::vector<double>> points(100u, std::vector<double>(2u)), labels;
+        for (auto &p : points) {
+            std::generate(p.begin(), p.end(), [&]() { return uni(gen); });
+            labels.push_back(eval(ex, p));
+        }
+        // Three weights are perturbed and fitted back, the others are untouched
+        std::vector<unsigned> idx({0u, 2u, 5u});
+        auto perturbed = w;
+        for (auto k : idx) {
+            perturbed[k] = gdual_d(w[k].constant_cf() + 0.05 * uni(gen));
+        }
+        ex.set_weights(perturbed);
+        auto loss = newton_weights(ex, idx, points, labels, "MSE");
+        BOOST_CHECK_SMALL(loss, 1e-12);
+        for (auto k = 0u; k < w.size(); ++k) {
+            if (std::find(idx.begin(), idx.end(), k) == idx.end()) {
+                BOOST_CHECK_EQUAL(ex.get_weights()[k].constant_cf(), w[k].constant_cf());
+            }
+        }
+        // The expression holds the optimized weights
+        double check = 0.;
+        for (auto j = 0u; j < points.size(); ++j) {
+            auto o = eval(ex, points[j]);
+            check += (o[0] - labels[j][0]) * (o[0] - labels[j][0]);
+        }
+        BOOST_CHECK_SMALL(check / static_cast<double>(points.size()) - loss, 1e-12);
+        // Errors
+        BOOST_CHECK_THROW(newton_weights(ex, {}, points, labels), std::invalid_argument);
+        BOOST_CHECK_THROW(newton_weights(ex, {1u, 1u}, points, labels), std::invalid_argument);
+        BOOST_CHECK_THROW(newton_weights(ex, {static_cast<unsigned>(w.size())}, points, labels),
+                          std::invalid_argument);
+        BOOST_CHECK_THROW(newton_weights(ex, idx, points, labels, "MAE"), std::invalid_argument);
+        BOOST_CHECK_THROW(newton_weights(ex, idx, {{0.1}}, {{0.1}}), std::invalid_argument);
+    }
+}
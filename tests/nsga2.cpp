@@ -0,0 +1,183 @@
+#define BOOST_TEST_MODULE dcgp_nsga2_test
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <dcgp/expression.hpp>
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/nsga2.hpp>
+
+using namespace dcgp;
+
+// Reference O(M N^2) implementation of the non-dominated sorting
+std::vector<unsigned> naive_ranks(const std::vector<std::vector<double>> &fits)
+{
+    std::vector<unsigned> rank(fits.size(), 0u);
+    std::vector<bool> assigned(fits.size(), false);
+    unsigned n_assigned = 0u, r = 0u;
+    while (n_assigned < fits.size()) {
+        std::vector<unsigned> current;
+        for (auto i = 0u; i < fits.size(); ++i) {
+            if (assigned[i]) continue;
+            bool dominated = false;
+            for (auto j = 0u; j < fits.size(); ++j) {
+                if (!assigned[j] && pareto_dominance(fits[j], fits[i])) {
+                    dominated = true;
+                    break;
+                }
+            }
+            if (!dominated) current.push_back(i);
+        }
+        for (auto i : current) {
+            assigned[i] = true;
+            rank[i] = r;
+        }
+        n_assigned += static_cast<unsigned>(current.size());
+        ++r;
+    }
+    return rank;
+}
+
+BOOST_AUTO_TEST_CASE(non_dominated_sorting)
+{
+    // Trivial cases
+    BOOST_CHECK(non_dominated_sort({}).size() == 0u);
+    BOOST_CHECK_THROW(non_dominated_sort({{1., 2.}, {1.}}), std::invalid_argument);
+    BOOST_CHECK_THROW(non_dominated_sort({{}, {}}), std::invalid_argument);
+    {
+        auto fronts = non_dominated_sort({{1., 1.}, {0., 2.}, {2., 2.}, {1., 1.}, {3., 3.}});
+        BOOST_CHECK(fronts.size() == 3u);
+        BOOST_CHECK((fronts[0] == std::vector<unsigned>{1u, 0u, 3u}));
+        BOOST_CHECK((fronts[1] == std::vector<unsigned>{2u}));
+        BOOST_CHECK((fronts[2] == std::vector<unsigned>{4u}));
+    }
+    // Random cases against the naive implementation (discrete values produce many ties)
+    std::mt19937 gen(123u);
+    for (auto n_obj : {1u, 2u, 3u, 5u}) {
+        for (auto N : {1u, 2u, 10u, 100u}) {
+            std::vector<std::vector<double>> fits(N, std::vector<double>(n_obj));
+            for (auto &f : fits) {
+                for (auto &v : f) {
+                    v = std::uniform_int_distribution<int>(0, 5)(gen);
+                }
+            }
+            auto fronts = non_dominated_sort(fits);
+            auto rank = naive_ranks(fits);
+            unsigned count = 0u;
+            for (auto k = 0u; k < fronts.size(); ++k) {
+                for (auto i : fronts[k]) {
+                    BOOST_CHECK_EQUAL(rank[i], k);
+                    ++count;
+                }
+            }
+            BOOST_CHECK_EQUAL(count, N);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(crowding)
+{
+    std::vector<std::vector<double>> fits{{0., 4.}, {1., 2.}, {3., 1.}, {4., 0.}, {10., 10.}};
+    auto cd = crowding_distance(fits, {0u, 1u, 2u, 3u});
+    BOOST_CHECK(std::isinf(cd[0]));
+    BOOST_CHECK(std::isinf(cd[3]));
+    BOOST_CHECK_CLOSE(cd[1], 3. / 4. + 3. / 4., 1e-12);
+    BOOST_CHECK_CLOSE(cd[2], 3. / 4. + 2. / 4., 1e-12);
+    cd = crowding_distance(fits, {4u, 1u});
+    BOOST_CHECK(std::isinf(cd[0]) && std::isinf(cd[1]));
+    // An objective with an infinite range is skipped
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<std::vector<double>> inf_fits{{0., inf}, {1., 2.}, {2., 1.}, {4., 0.}};
+    cd = crowding_distance(inf_fits, {0u, 1u, 2u, 3u});
+    BOOST_CHECK_CLOSE(cd[1], 2. / 4., 1e-12);
+    BOOST_CHECK_CLOSE(cd[2], 3. / 4., 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(evolution)
+{
+    BOOST_CHECK_THROW(nsga2(10u, 1u), std::invalid_argument);
+    BOOST_CHECK_THROW(nsga2(10u, 10u, 0u), std::invalid_argument);
+    // Loss vs. number of active nodes on the Koza quintic
+    std::vector<std::vector<double>> points, labels;
+    for (auto i = 0u; i < 20u; ++i) {
+        double x = -1. + 2. * i / 19.;
+        points.push_back({x});
+        labels.push_back({x * x * x * x * x - 2. * x * x * x + x});
+    }
+    kernel_set<double> basic_set({"sum", "diff", "mul", "div"});
+    expression<double> ex(1u, 1u, 1u, 15u, 16u, 2u, basic_set(), 32u);
+    auto objectives = [&points, &labels](const expression<double> &e) {
+        return std::vector<double>{e.loss(points, labels, "MSE"), static_cast<double>(e.get_active_nodes().size())};
+    };
+    const auto ex0 = ex;
+    nsga2 algo(50u, 20u, 2u, 23u);
+    auto front = algo.evolve(ex0, objectives);
+    BOOST_CHECK(front.m_chromosomes.size() > 0u);
+    BOOST_CHECK_EQUAL(front.m_chromosomes.size(), front.m_fitness.size());
+    for (auto i = 0u; i < front.m_chromosomes.size(); ++i) {
+        // The returned objectives are those of the returned chromosomes
+        ex.set(front.m_chromosomes[i]);
+        BOOST_CHECK(objectives(ex) == front.m_fitness[i]);
+        // No point on the front dominates another
+        for (auto j = 0u; j < front.m_fitness.size(); ++j) {
+            BOOST_CHECK(!pareto_dominance(front.m_fitness[j], front.m_fitness[i]));
+        }
+    }
+    // The front is sorted by loss
+    BOOST_CHECK(std::is_sorted(front.m_fitness.begin(), front.m_fitness.end()));
+    // The algorithm is deterministic for a given seed
+    nsga2 algo2(50u, 20u, 2u, 23u);
+    BOOST_CHECK(algo2.evolve(ex0, objectives).m_chromosomes == front.m_chromosomes);
+
+    // Loss vs. number of active weights for an ANN
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu"});
+    expression_ann ann(1u, 1u, 3u, 3u, 4u, 2u, ann_set(), 32u);
+    ann.randomise_weights(0., 1., 32u);
+    auto ann_objectives = [&points, &labels](const expression_ann &e) {
+        return std::vector<double>{e.loss(points, labels, "MSE"), static_cast<double>(e.n_active_weights())};
+    };
+    auto ann_front = nsga2(10u, 10u, 1u, 32u).evolve(ann, ann_objectives);
+    BOOST_CHECK(ann_front.m_chromosomes.size() > 0u);
+    for (auto i = 0u; i < ann_front.m_chromosomes.size(); ++i) {
+        ann.set(ann_front.m_chromosomes[i]);
+        BOOST_CHECK(ann_objectives(ann) == ann_front.m_fitness[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(non_finite_objectives)
+{
+    std::vector<std::vector<double>> points, labels;
+    for (auto i = 0u; i < 20u; ++i) {
+        double x = -1. + 2. * i / 19.;
+        points.push_back({x});
+        labels.push_back({x * x * x - x});
+    }
+    kernel_set<double> basic_set({"sum", "diff", "mul", "div"});
+    expression<double> ex(1u, 1u, 1u, 15u, 16u, 2u, basic_set(), 32u);
+    // A NaN loss for about half of the expressions, an infinite one for some others
+    auto objectives = [&points, &labels](const expression<double> &e) {
+        auto n_active = e.get_active_nodes().size();
+        double loss = e.loss(points, labels, "MSE");
+        if (n_active % 2u) {
+            loss = std::numeric_limits<double>::quiet_NaN();
+        } else if (n_active % 3u == 0u) {
+            loss = std::numeric_limits<double>::infinity();
+        }
+        return std::vector<double>{loss, static_cast<double>(n_active)};
+    };
+    auto front = nsga2(30u, 20u, 2u, 23u).evolve(ex, objectives);
+    BOOST_CHECK(front.m_chromosomes.size() > 0u);
+    for (auto i = 0u; i < front.m_fitness.size(); ++i) {
+        // NaNs are returned as infinite objectives and never dominate finite ones
+        BOOST_CHECK(!std::isnan(front.m_fitness[i][0]));
+        for (auto j = 0u; j < front.m_fitness.size(); ++j) {
+            BOOST_CHECK(!pareto_dominance(front.m_fitness[j], front.m_fitness[i]));
+        }
+    }
+    BOOST_CHECK(std::is_sorted(front.m_fitness.begin(), front.m_fitness.end()));
+}
@@ -0,0 +1,114 @@
+#define BOOST_TEST_MODULE dcgp_quantized_ann_test
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/frozen_ann.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/quantized_ann.hpp>
+#include <dcgp/s11n.hpp>
+
+using namespace dcgp;
+
+BOOST_AUTO_TEST_CASE(construction)
+{
+    using act = frozen_ann::activation;
+    // Default constructed
+    quantized_ann empty;
+    BOOST_CHECK_EQUAL(empty.get_n(), 0u);
+    BOOST_CHECK_EQUAL(empty.get_m(), 0u);
+    BOOST_CHECK_EQUAL(empty.get_n_nodes(), 0u);
+    // A hand made network: o = relu(2 x - 3 y + 0.5), x
+    frozen_ann f(2u, {act::RELU}, {0u, 2u}, {0u, 1u}, {2., -3.}, {0.5}, {2u, 0u});
+    BOOST_CHECK_THROW(quantized_ann(f, {}), std::invalid_argument);
+    BOOST_CHECK_THROW(quantized_ann(f, {{0.1, 0.2}, {0.1}}), std::invalid_argument);
+    std::vector<std::vector<double>> points;
+    for (auto i = 0u; i <= 10u; ++i) {
+        for (auto j = 0u; j <= 10u; ++j) {
+            points.push_back({-1. + 0.2 * i, -1. + 0.2 * j});
+        }
+    }
+    quantized_ann q(f, points);
+    BOOST_CHECK_EQUAL(q.get_n(), 2u);
+    BOOST_CHECK_EQUAL(q.get_m(), 2u);
+    BOOST_CHECK_EQUAL(q.get_n_nodes(), 1u);
+    // The inputs map to [-127, 127], as do the weights (times the input scales) of each node
+    BOOST_CHECK_CLOSE(q.get_scales()[0], 1. / 127., 1e-12);
+    BOOST_CHECK_EQUAL(*std::max_element(q.get_weights().begin(), q.get_weights().end(), [](int a, int b) {
+        return std::abs(a) < std::abs(b);
+    }), -127);
+    // The quantization error is of the order of the scales
+    for (const auto &p : points) {
+        auto exact = f(p);
+        auto approx = q(p);
+        BOOST_CHECK_SMALL(approx[0] - exact[0], 3. * q.get_scales()[2]);
+        BOOST_CHECK_SMALL(approx[1] - exact[1], q.get_scales()[0]);
+        BOOST_CHECK(approx[0] >= 0.);
+    }
+    BOOST_CHECK_THROW(q(std::vector<double>{0.1}), std::invalid_argument);
+    BOOST_CHECK_THROW(q(std::vector<std::vector<double>>{{0.1, 0.2}, {0.1}}), std::invalid_argument);
+    // Out of the calibration range values saturate
+    BOOST_CHECK_CLOSE(q({10., 0.})[1], 1., 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(accuracy)
+{
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    std::mt19937 gen(32u);
+    std::uniform_real_distribution<> uni(-1., 1.);
+    double total_error = 0., total_range = 0.;
+    for (auto i = 0u; i < 20u; ++i) {
+        unsigned seed = gen();
+        expression_ann ex(3u, 2u, 5u, 4u, 4u, {3u, 3u, 2u, 4u}, ann_set(), seed);
+        ex.randomise_weights(0., 1., seed);
+        ex.randomise_biases(0., 1., seed);
+        auto f = ex.freeze();
+        std::vector<std::vector<double>> calibration(500u, std::vector<double>(3u)),
+            points(300u, std::vector<double>(3u));
+        for (auto &p : calibration) {
+            std::generate(p.begin(), p.end(), [&]() { return uni(gen); });
+        }
+        for (auto &p : points) {
+            std::generate(p.begin(), p.end(), [&]() { return uni(gen); });
+        }
+        quantized_ann q(f, calibration);
+        BOOST_CHECK_EQUAL(q.get_n_nodes(), f.get_n_nodes());
+        BOOST_CHECK_EQUAL(q.get_weights().size(), f.get_weights().size());
+        auto exact = f(points);
+        auto approx = q(points);
+        BOOST_CHECK_EQUAL(approx.size(), points.size());
+        for (auto o = 0u; o < 2u; ++o) {
+            double range = 0., error = 0.;
+            for (auto j = 0u; j < points.size(); ++j) {
+                range = std::max(range, std::abs(exact[j][o]));
+                error += std::abs(approx[j][o] - exact[j][o]);
+                // Batches and single points give identical results
+                BOOST_CHECK(q(points[j]) == approx[j]);
+            }
+            error /= static_cast<double>(points.size());
+            // The mean error is a few percents of the output range at most
+            BOOST_CHECK(error <= 0.05 * range + 1e-12);
+            total_error += error;
+            total_range += range;
+        }
+        // Serialization
+        std::stringstream ss;
+        {
+            boost::archive::binary_oarchive oarchive(ss);
+            oarchive << q;
+        }
+        quantized_ann q2;
+        {
+            boost::archive::binary_iarchive iarchive(ss);
+            iarchive >> q2;
+        }
+        BOOST_CHECK(q2(points) == approx);
+    }
+    // On average, the error is below one percent of the output range
+    BOOST_CHECK(total_error < 0.01 * total_range);
+}
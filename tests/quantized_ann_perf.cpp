@@ -0,0 +1,68 @@
+#define BOOST_TEST_MODULE dcgp_quantized_ann_perf
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/frozen_ann.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/quantized_ann.hpp>
+
+using namespace dcgp;
+
+// Compares the throughput and the accuracy of the frozen and the quantized dCGP-ANN
+void perform_inference(unsigned rows, unsigned columns, unsigned levels_back, unsigned arity, unsigned N,
+                       const std::vector<std::string> &kernels)
+{
+    unsigned in = 10u;
+    std::mt19937 gen(123u);
+    std::normal_distribution<> norm(0., 1.);
+    expression_ann ex(in, 1u, rows, columns, levels_back, arity, kernel_set<double>(kernels)(), 123u);
+    ex.randomise_weights(0., 1. / std::sqrt(arity), 123u);
+    ex.randomise_biases(0., 0.1, 123u);
+    std::vector<std::vector<double>> data(N, std::vector<double>(in));
+    for (auto &item : data) {
+        std::generate(item.begin(), item.end(), [&norm, &gen]() { return norm(gen); });
+    }
+    auto f = ex.freeze();
+    // Calibration on one tenth of the data
+    quantized_ann q(f, std::vector<std::vector<double>>(data.begin(), data.begin() + N / 10u));
+
+    std::cout << "Inference: rows:" << rows << " columns:" << columns << " arity:" << arity
+              << " active nodes:" << f.get_n_nodes() << " kernels:";
+    for (const auto &k : kernels) {
+        std::cout << " " << k;
+    }
+    std::cout << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    auto exact = f(data);
+    auto t_frozen = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    auto approx = q(data);
+    auto t_quantized = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double range = 0., error = 0., max_error = 0.;
+    for (auto i = 0u; i < N; ++i) {
+        range = std::max(range, std::abs(exact[i][0]));
+        error += std::abs(approx[i][0] - exact[i][0]);
+        max_error = std::max(max_error, std::abs(approx[i][0] - exact[i][0]));
+    }
+    std::cout << "\tfrozen: " << N / t_frozen << " points/s quantized: " << N / t_quantized
+              << " points/s (x" << t_frozen / t_quantized << ")" << std::endl;
+    std::cout << "\tmean error: " << error / N << " max error: " << max_error << " output range: " << range
+              << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(inference_speed)
+{
+    unsigned N = 100000u;
+    // Integer arithmetic only
+    perform_inference(50u, 3u, 1u, 10u, N, {"ReLu", "sum"});
+    perform_inference(20u, 10u, 3u, 10u, N, {"ReLu", "sum"});
+    // Lookup tables
+    perform_inference(50u, 3u, 1u, 10u, N, {"sig", "tanh", "ISRU", "ELU"});
+    perform_inference(20u, 10u, 3u, 10u, N, {"sig", "tanh", "ReLu", "ISRU", "ELU", "sum"});
+}
@@ -0,0 +1,151 @@
+#define BOOST_TEST_MODULE dcgp_racing_test
+#include <algorithm>
+#include <audi/audi.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <dcgp/expression.hpp>
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/racing.hpp>
+
+using namespace dcgp;
+
+// Koza quintic data, shuffled
+void make_data(unsigned N, std::vector<std::vector<double>> &points, std::vector<std::vector<double>> &labels)
+{
+    std::mt19937 gen(123u);
+    points.clear();
+    labels.clear();
+    for (auto i = 0u; i < N; ++i) {
+        double x = std::uniform_real_distribution<double>(-1., 1.)(gen);
+        points.push_back({x});
+        labels.push_back({x * x * x * x * x - 2. * x * x * x + x});
+    }
+}
+
+BOOST_AUTO_TEST_CASE(racing_single)
+{
+    std::vector<std::vector<double>> points, labels;
+    make_data(1000u, points, labels);
+    kernel_set<double> basic_set({"sum", "diff", "mul", "div"});
+    expression<double> ex(1u, 1u, 1u, 15u, 16u, 2u, basic_set(), 32u);
+    // Exceptions
+    BOOST_CHECK_THROW(racing_loss(ex, points, labels, "MSX", 1.), std::invalid_argument);
+    BOOST_CHECK_THROW(racing_loss(ex, points, {{1.}}, "MSE", 1.), std::invalid_argument);
+    BOOST_CHECK_THROW(racing_loss(ex, {}, {}, "MSE", 1.), std::invalid_argument);
+    BOOST_CHECK_THROW(racing_loss(ex, points, labels, "MSE", 1., 0u), std::invalid_argument);
+
+    const auto parent = ex.loss(points, labels, "MSE");
+    for (auto i = 0u; i < 100u; ++i) {
+        auto child = ex;
+        child.seed(i);
+        child.mutate_active(3u);
+        auto exact = child.loss(points, labels, "MSE");
+        auto raced = racing_loss(child, points, labels, "MSE", parent, 10u);
+        if (std::isnan(exact)) {
+            BOOST_CHECK(std::isnan(raced));
+            continue;
+        }
+        if (exact <= parent) {
+            // Winners are always evaluated exactly
+            BOOST_CHECK_EQUAL(raced, exact);
+        } else {
+            // Losers are always detected, with a lower bound of their loss
+            BOOST_CHECK(raced > parent);
+            BOOST_CHECK(raced <= exact);
+        }
+        // Without an incumbent the full loss is computed
+        BOOST_CHECK_EQUAL(racing_loss(child, points, labels, "MSE", std::numeric_limits<double>::infinity()), exact);
+    }
+    // gduals
+    kernel_set<audi::gdual_d> gdual_set({"sum", "diff", "mul", "div"});
+    expression<audi::gdual_d> ex_gd(1u, 1u, 1u, 15u, 16u, 2u, gdual_set(), 32u);
+    std::vector<std::vector<audi::gdual_d>> gpoints, glabels;
+    for (auto i = 0u; i < 100u; ++i) {
+        gpoints.push_back({audi::gdual_d(points[i][0], "x", 1)});
+        glabels.push_back({audi::gdual_d(labels[i][0])});
+    }
+    auto gexact = ex_gd.loss(gpoints, glabels, "MSE");
+    auto graced = racing_loss(ex_gd, gpoints, glabels, "MSE", audi::gdual_d(1e300));
+    BOOST_CHECK_EQUAL(graced.constant_cf(), gexact.constant_cf());
+    graced = racing_loss(ex_gd, gpoints, glabels, "MSE", audi::gdual_d(0.), 10u);
+    BOOST_CHECK(graced.constant_cf() <= gexact.constant_cf());
+}
+
+BOOST_AUTO_TEST_CASE(racing_population)
+{
+    std::vector<std::vector<double>> points, labels;
+    make_data(1000u, points, labels);
+    kernel_set<double> basic_set({"sum", "diff", "mul", "div"});
+    expression<double> ex(1u, 1u, 1u, 15u, 16u, 2u, basic_set(), 32u);
+    std::vector<expression<double>> exs(50u, ex);
+    for (auto i = 0u; i < exs.size(); ++i) {
+        exs[i].seed(i);
+        exs[i].mutate_active(3u);
+    }
+    const auto parent = ex.loss(points, labels, "MSE");
+    BOOST_CHECK_THROW(racing_loss(exs, points, labels, "MSE", parent, 10u, 0u), std::invalid_argument);
+    std::vector<unsigned> n_eval;
+    auto raced = racing_loss(exs, points, labels, "MSE", parent, 10u, 1u, &n_eval);
+    BOOST_CHECK_EQUAL(raced.size(), exs.size());
+    BOOST_CHECK_EQUAL(n_eval.size(), exs.size());
+    for (auto i = 0u; i < exs.size(); ++i) {
+        auto exact = exs[i].loss(points, labels, "MSE");
+        if (std::isnan(exact)) {
+            BOOST_CHECK(std::isnan(raced[i]));
+            continue;
+        }
+        BOOST_CHECK_EQUAL(racing_loss(exs[i], points, labels, "MSE", parent, 10u), raced[i]);
+        if (exact <= parent) {
+            BOOST_CHECK_EQUAL(raced[i], exact);
+            BOOST_CHECK_EQUAL(n_eval[i], points.size());
+        } else {
+            BOOST_CHECK(raced[i] > parent);
+            BOOST_CHECK(raced[i] <= exact);
+        }
+    }
+    // Racing saves evaluations
+    auto total = std::accumulate(n_eval.begin(), n_eval.end(), 0u);
+    BOOST_CHECK(total < exs.size() * points.size());
+    // Successive halving saves even more, the best candidate is still evaluated on the whole data
+    std::vector<unsigned> n_eval_halving;
+    auto halved = racing_loss(exs, points, labels, "MSE", std::numeric_limits<double>::infinity(), 10u, 2u,
+                              &n_eval_halving);
+    BOOST_CHECK(std::accumulate(n_eval_halving.begin(), n_eval_halving.end(), 0u) < exs.size() * points.size());
+    BOOST_CHECK(std::count(n_eval_halving.begin(), n_eval_halving.end(), points.size()) >= 1u);
+    // With an infinite incumbent only NaNs are dropped by the race, the others by the halving get an infinite loss
+    for (auto i = 0u; i < exs.size(); ++i) {
+        if (n_eval_halving[i] < points.size()) {
+            BOOST_CHECK(std::isnan(halved[i]) || (std::isinf(halved[i]) && halved[i] > 0.));
+        }
+    }
+    BOOST_CHECK(std::any_of(halved.begin(), halved.end(), [](double l) { return std::isinf(l); }));
+    // A candidate dropped by the halving cannot look better than the incumbent
+    std::vector<unsigned> n_eval_both;
+    auto both = racing_loss(exs, points, labels, "MSE", parent, 10u, 2u, &n_eval_both);
+    for (auto i = 0u; i < exs.size(); ++i) {
+        if (n_eval_both[i] < points.size()) {
+            BOOST_CHECK(!(both[i] <= parent));
+        } else {
+            BOOST_CHECK_EQUAL(both[i], exs[i].loss(points, labels, "MSE"));
+        }
+    }
+
+    // Artificial neural networks
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu"});
+    expression_ann ann(1u, 1u, 3u, 3u, 4u, 2u, ann_set(), 32u);
+    std::vector<expression_ann> anns(5u, ann);
+    for (auto i = 0u; i < anns.size(); ++i) {
+        anns[i].randomise_weights(0., 1., i);
+    }
+    auto ann_raced = racing_loss(anns, points, labels, "MSE", std::numeric_limits<double>::infinity());
+    for (auto i = 0u; i < anns.size(); ++i) {
+        BOOST_CHECK_EQUAL(ann_raced[i], anns[i].loss(points, labels, "MSE"));
+    }
+}
@@ -0,0 +1,186 @@
+#define BOOST_TEST_MODULE dcgp_simplified_expression_test
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dcgp/expression.hpp>
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/expression_weighted.hpp>
+#include <dcgp/kernel.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/s11n.hpp>
+#include <dcgp/simplified_expression.hpp>
+
+using namespace dcgp;
+
+// Checks that the simplified expression computes the same outputs as the expression where these are finite
+template <typename Expr>
+void check_equivalent(const Expr &ex, const simplified_expression &s, std::mt19937 &gen)
+{
+    std::uniform_real_distribution<> uni(-1., 1.);
+    BOOST_CHECK_EQUAL(s.get_n(), ex.get_n());
+    BOOST_CHECK_EQUAL(s.get_m(), ex.get_m());
+    std::vector<std::vector<double>> points(20u, std::vector<double>(ex.get_n()));
+    for (auto &p : points) {
+        std::generate(p.begin(), p.end(), [&]() { return uni(gen); });
+    }
+    auto batch = s(points);
+    for (auto j = 0u; j < points.size(); ++j) {
+        auto expected = ex(points[j]);
+        auto out = s(points[j]);
+        BOOST_CHECK(batch[j] == out);
+        for (auto i = 0u; i < expected.size(); ++i) {
+            if (!std::isfinite(expected[i])) continue;
+            BOOST_CHECK(std::abs(out[i] - expected[i]) <= 1e-9 * (1. + std::abs(expected[i])));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(construction)
+{
+    using op = simplified_expression::op;
+    // Default constructed
+    simplified_expression empty;
+    BOOST_CHECK_EQUAL(empty.get_n(), 0u);
+    BOOST_CHECK_EQUAL(empty.get_m(), 0u);
+    BOOST_CHECK_EQUAL(empty.get_n_nodes(), 0u);
+    // A hand made expression: o = sin(x * 2), y
+    simplified_expression s(2u, {op::CONST, op::MUL, op::SIN}, {2., 0., 0.}, {0u, 0u, 2u, 3u}, {0u, 2u, 3u}, {4u, 1u});
+    BOOST_CHECK_EQUAL(s.get_n_nodes(), 3u);
+    auto out = s({0.1, -0.2});
+    BOOST_CHECK_EQUAL(out[0], std::sin(0.1 * 2.));
+    BOOST_CHECK_EQUAL(out[1], -0.2);
+    BOOST_CHECK_EQUAL(s(std::vector<std::string>{"x", "y"})[0], "sin((x*2))");
+    BOOST_CHECK_THROW(s(std::vector<double>{0.1}), std::invalid_argument);
+    BOOST_CHECK_THROW(s(std::vector<std::string>{"x"}), std::invalid_argument);
+    // Inconsistent data
+    BOOST_CHECK_THROW(simplified_expression(2u, {op::MUL}, {}, {0u, 2u}, {0u, 1u}, {2u}), std::invalid_argument);
+    BOOST_CHECK_THROW(simplified_expression(2u, {op::MUL}, {0.}, {0u, 2u}, {0u}, {2u}), std::invalid_argument);
+    // Wrong number of arguments
+    BOOST_CHECK_THROW(simplified_expression(2u, {op::CONST}, {0.}, {0u, 1u}, {0u}, {2u}), std::invalid_argument);
+    BOOST_CHECK_THROW(simplified_expression(2u, {op::PDIV}, {0.}, {0u, 1u}, {0u}, {2u}), std::invalid_argument);
+    // Not topologically sorted
+    BOOST_CHECK_THROW(simplified_expression(2u, {op::SUM}, {0.}, {0u, 2u}, {0u, 2u}, {2u}), std::invalid_argument);
+    // Output register out of range
+    BOOST_CHECK_THROW(simplified_expression(2u, {op::SUM}, {0.}, {0u, 2u}, {0u, 1u}, {3u}), std::invalid_argument);
+    // Kernel names
+    BOOST_CHECK(simplified_expression::from_name("ReLu") == op::RELU);
+    BOOST_CHECK_THROW(simplified_expression::from_name("gaussian"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(rules)
+{
+    using op = simplified_expression::op;
+    kernel_set<double> set({"sum", "diff", "mul", "div", "pdiv", "sin"});
+    // Builds a two inputs expression of arity 2 whose nodes are given as (kernel, input 0, input 1). The levels back
+    // exceed the columns so that the outputs can be inputs.
+    auto make = [&set](const std::vector<std::vector<unsigned>> &nodes, std::vector<unsigned> outputs) {
+        expression<double> ex(2u, static_cast<unsigned>(outputs.size()), 1u, static_cast<unsigned>(nodes.size()),
+                              static_cast<unsigned>(nodes.size()) + 1u, 2u, set(), 0u);
+        std::vector<unsigned> x;
+        for (const auto &n : nodes) {
+            x.insert(x.end(), n.begin(), n.end());
+        }
+        x.insert(x.end(), outputs.begin(), outputs.end());
+        ex.set(x);
+        return ex;
+    };
+    // x - x = 0
+    auto s = make({{1u, 0u, 0u}}, {2u}).simplify();
+    BOOST_CHECK_EQUAL(s.get_n_nodes(), 1u);
+    BOOST_CHECK(s.get_ops()[0] == op::CONST && s.get_constants()[0] == 0.);
+    // x / x = 1, also protected
+    s = make({{3u, 1u, 1u}, {4u, 0u, 0u}}, {2u, 3u}).simplify();
+    BOOST_CHECK_EQUAL(s.get_n_nodes(), 1u);
+    BOOST_CHECK(s(std::vector<double>{0., 0.3}) == std::vector<double>({1., 1.}));
+    // (x - x) * y = 0, (x - x) / y = 0 and sin(x - x) = 0
+    s = make({{1u, 0u, 0u}, {2u, 2u, 1u}, {3u, 2u, 1u}, {5u, 2u, 2u}}, {3u, 4u, 5u}).simplify();
+    BOOST_CHECK_EQUAL(s.get_n_nodes(), 1u);
+    BOOST_CHECK(s.get_outputs() == std::vector<unsigned>({2u, 2u, 2u}));
+    // (x / x) * y = y
+    s = make({{3u, 0u, 0u}, {2u, 2u, 1u}}, {3u}).simplify();
+    BOOST_CHECK_EQUAL(s.get_n_nodes(), 0u);
+    BOOST_CHECK(s.get_outputs() == std::vector<unsigned>({1u}));
+    // x * y and y * x are merged, as are the two sums using them
+    s = make({{2u, 0u, 1u}, {2u, 1u, 0u}, {0u, 2u, 0u}, {0u, 0u, 3u}, {1u, 4u, 5u}}, {4u, 5u, 6u}).simplify();
+    BOOST_CHECK_EQUAL(s.get_n_nodes(), 3u);
+    BOOST_CHECK(s.get_outputs()[0] == s.get_outputs()[1]);
+    BOOST_CHECK(s.get_ops()[2] == op::CONST && s.get_outputs()[2] == 4u);
+    // The unused nodes are dropped
+    s = make({{2u, 0u, 1u}, {5u, 0u, 1u}}, {1u}).simplify();
+    BOOST_CHECK_EQUAL(s.get_n_nodes(), 0u);
+    // The protected division is not simplified when dividing zero
+    s = make({{1u, 0u, 0u}, {4u, 2u, 1u}}, {3u}).simplify();
+    BOOST_CHECK_EQUAL(s({0.2, 0.})[0], 1.);
+    BOOST_CHECK_EQUAL(s({0.2, 0.5})[0], 0.);
+    // Weights are folded in the kernels
+    kernel_set<double> wset({"sum", "mul"});
+    expression_weighted<double> ex_w(1u, 1u, 1u, 1u, 1u, 2u, wset(), 0u);
+    ex_w.set({1u, 0u, 0u, 1u});
+    ex_w.set_weights({2., 3.});
+    s = ex_w.simplify();
+    BOOST_CHECK_EQUAL(s.get_n_nodes(), 2u);
+    BOOST_CHECK_EQUAL(s(std::vector<double>{0.5})[0], 0.5 * 2. * 0.5 * 3.);
+    // Unknown kernels
+    kernel_set<double> custom({"sum"});
+    custom.push_back(kernel<double>([](const std::vector<double> &in) { return in[0]; },
+                                    [](const std::vector<std::string> &in) { return in[0]; }, "first"));
+    expression<double> ex_c(1u, 1u, 1u, 1u, 1u, 2u, custom(), 0u);
+    ex_c.set({1u, 0u, 0u, 1u});
+    BOOST_CHECK_THROW(ex_c.simplify(), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(random_expressions)
+{
+    // The protected division is excluded as it hides the non finite values the identities do not preserve
+    kernel_set<double> set({"sum", "diff", "mul", "div", "sig", "tanh", "ReLu", "ELU", "ISRU", "sin", "cos"});
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    std::mt19937 gen(123u);
+    std::normal_distribution<> norm(0., 1.);
+    for (auto i = 0u; i < 100u; ++i) {
+        unsigned seed = gen();
+        expression<double> ex(3u, 2u, 3u, 10u, 11u, 2u, set(), seed);
+        auto s = ex.simplify();
+        check_equivalent(ex, s, gen);
+        // Without weights, only constants are added
+        auto n_ops = std::count_if(s.get_ops().begin(), s.get_ops().end(),
+                                   [](simplified_expression::op o) { return o != simplified_expression::op::CONST; });
+        BOOST_CHECK(n_ops <= std::count_if(ex.get_active_nodes().begin(), ex.get_active_nodes().end(),
+                                           [](unsigned id) { return id >= 3u; }));
+        expression_weighted<double> ex_w(3u, 2u, 3u, 10u, 11u, 2u, set(), seed);
+        auto w = ex_w.get_weights();
+        std::generate(w.begin(), w.end(), [&]() { return norm(gen); });
+        ex_w.set_weights(w);
+        check_equivalent(ex_w, ex_w.simplify(), gen);
+        expression_ann ex_a(3u, 2u, 5u, 6u, 4u, 2u, ann_set(), seed);
+        ex_a.randomise_weights(0., 1., seed);
+        ex_a.randomise_biases(0., 1., seed);
+        check_equivalent(ex_a, ex_a.simplify(), gen);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(s11n)
+{
+    kernel_set<double> set({"sum", "diff", "mul", "div", "pdiv", "sin", "cos", "log", "exp"});
+    expression_weighted<double> ex(2u, 2u, 3u, 10u, 11u, 2u, set(), 32u);
+    auto s = ex.simplify();
+    std::stringstream ss;
+    {
+        boost::archive::binary_oarchive oarchive(ss);
+        oarchive << s;
+    }
+    simplified_expression s2;
+    {
+        boost::archive::binary_iarchive iarchive(ss);
+        iarchive >> s2;
+    }
+    std::vector<std::string> in({"x", "y"});
+    BOOST_CHECK(s2(in) == s(in));
+    BOOST_CHECK(s2.get_outputs() == s.get_outputs());
+    BOOST_CHECK(s2.get_sources() == s.get_sources());
+}
@@ -0,0 +1,106 @@
+#define BOOST_TEST_MODULE dcgp_steady_state_test
+#include <algorithm>
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <tbb/tbb.h>
+#include <vector>
+
+#include <dcgp/expression.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/steady_state.hpp>
+
+using namespace dcgp;
+
+BOOST_AUTO_TEST_CASE(evolution)
+{
+    BOOST_CHECK_THROW(steady_state(10u, 1u), std::invalid_argument);
+    BOOST_CHECK_THROW(steady_state(10u, 10u, 0u), std::invalid_argument);
+    // Koza quintic
+    std::vector<std::vector<double>> points, labels;
+    for (auto i = 0u; i < 20u; ++i) {
+        double x = -1. + 2. * i / 19.;
+        points.push_back({x});
+        labels.push_back({x * x * x * x * x - 2. * x * x * x + x});
+    }
+    kernel_set<double> basic_set({"sum", "diff", "mul", "div"});
+    const expression<double> ex(1u, 1u, 1u, 15u, 16u, 2u, basic_set(), 32u);
+    std::atomic<unsigned> n_calls(0u);
+    auto fitness = [&](const expression<double> &e) {
+        ++n_calls;
+        return e.loss(points, labels, "MSE");
+    };
+    {
+        // No budget, we get back the sorted initial population
+        auto pop = steady_state(0u, 10u, 2u, 23u).evolve(ex, fitness);
+        BOOST_CHECK_EQUAL(n_calls, 10u);
+        BOOST_CHECK_EQUAL(pop.m_chromosomes.size(), 10u);
+        BOOST_CHECK(std::is_sorted(pop.m_fitness.begin(), pop.m_fitness.end()));
+    }
+    for (auto n_tasks : {0u, 1u, 3u}) {
+        n_calls = 0u;
+        auto initial = steady_state(0u, 10u, 2u, 23u).evolve(ex, fitness);
+        n_calls = 0u;
+        auto pop = steady_state(500u, 10u, 2u, 23u).evolve(ex, fitness, n_tasks);
+        // Exactly the budget (plus the initial population) has been evaluated
+        BOOST_CHECK_EQUAL(n_calls, 510u);
+        BOOST_CHECK_EQUAL(pop.m_chromosomes.size(), 10u);
+        BOOST_CHECK(std::is_sorted(pop.m_fitness.begin(), pop.m_fitness.end()));
+        // Replace-worst never makes the best individual worse
+        BOOST_CHECK(pop.m_fitness[0] <= initial.m_fitness[0]);
+        // The returned fitness is that of the returned chromosomes
+        auto e = ex;
+        for (auto i = 0u; i < pop.m_chromosomes.size(); ++i) {
+            e.set(pop.m_chromosomes[i]);
+            BOOST_CHECK_EQUAL(e.loss(points, labels, "MSE"), pop.m_fitness[i]);
+        }
+    }
+    // A serial evolution is reproducible
+    auto pop1 = steady_state(200u, 10u, 2u, 23u).evolve(ex, fitness, 1u);
+    auto pop2 = steady_state(200u, 10u, 2u, 23u).evolve(ex, fitness, 1u);
+    BOOST_CHECK(pop1.m_chromosomes == pop2.m_chromosomes);
+    // NaNs are considered the worst fitness
+    auto nan_fitness = [](const expression<double> &e) {
+        return e.get_active_nodes().size() % 2u ? std::numeric_limits<double>::quiet_NaN() : 1.;
+    };
+    auto pop3 = steady_state(100u, 10u, 2u, 23u).evolve(ex, nan_fitness);
+    BOOST_CHECK(std::all_of(pop3.m_fitness.begin(), pop3.m_fitness.end(), [](double f) { return !std::isnan(f); }));
+}
+
+BOOST_AUTO_TEST_CASE(nested_parallelism)
+{
+    std::vector<std::vector<double>> points, labels;
+    for (auto i = 0u; i < 200u; ++i) {
+        double x = -1. + 2. * i / 199.;
+        points.push_back({x});
+        labels.push_back({x * x * x - x});
+    }
+    kernel_set<double> basic_set({"sum", "diff", "mul", "div"});
+    const expression<double> ex(1u, 1u, 1u, 15u, 16u, 2u, basic_set(), 32u);
+    // The fitness runs its own parallel loop: a thread waiting in it must not start another
+    // evaluation on the expression being evaluated
+    std::atomic<unsigned> n_corrupted(0u);
+    auto fitness = [&](const expression<double> &e) {
+        auto x = e.get();
+        std::vector<double> err(points.size());
+        tbb::parallel_for(std::size_t(0u), points.size(), [&](std::size_t i) {
+            auto out = e(points[i]);
+            err[i] = (out[0] - labels[i][0]) * (out[0] - labels[i][0]);
+        });
+        if (e.get() != x) {
+            ++n_corrupted;
+        }
+        return std::accumulate(err.begin(), err.end(), 0.) / static_cast<double>(err.size());
+    };
+    auto pop = steady_state(300u, 10u, 2u, 23u).evolve(ex, fitness, 8u);
+    BOOST_CHECK_EQUAL(n_corrupted, 0u);
+    // The returned fitness is that of the returned chromosomes
+    auto e = ex;
+    for (auto i = 0u; i < pop.m_chromosomes.size(); ++i) {
+        e.set(pop.m_chromosomes[i]);
+        BOOST_CHECK_EQUAL(fitness(e), pop.m_fitness[i]);
+    }
+}
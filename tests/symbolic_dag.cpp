@@ -0,0 +1,111 @@
+#define BOOST_TEST_MODULE dcgp_symbolic_dag_test
+#include <algorithm>
+#include <audi/audi.hpp>
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dcgp/expression.hpp>
+#include <dcgp/expression_ann.hpp>
+#include <dcgp/expression_weighted.hpp>
+#include <dcgp/kernel_set.hpp>
+#include <dcgp/symbolic_dag.hpp>
+
+using namespace dcgp;
+
+BOOST_AUTO_TEST_CASE(construction)
+{
+    // Default constructed
+    symbolic_dag empty;
+    BOOST_CHECK_EQUAL(empty.get_n(), 0u);
+    BOOST_CHECK_EQUAL(empty.get_m(), 0u);
+    BOOST_CHECK_EQUAL(empty.get_n_nodes(), 0u);
+    BOOST_CHECK_EQUAL(empty.to_string(), "");
+    // A hand made DAG: u2 = (x*y), u3 = sin(u2), u4 = (u2+u3)
+    auto u2 = symbolic_dag::make_node("u2", "(" + symbolic_dag::placeholder(0u) + "*" + symbolic_dag::placeholder(1u)
+                                                + ")", {0u, 1u});
+    auto u3 = symbolic_dag::make_node("u3", "sin(" + symbolic_dag::placeholder(0u) + ")", {2u});
+    auto u4 = symbolic_dag::make_node("u4", "(" + symbolic_dag::placeholder(1u) + "+" + symbolic_dag::placeholder(0u)
+                                                + ")", {3u, 2u});
+    BOOST_CHECK(u4.args == std::vector<unsigned>({2u, 3u}));
+    BOOST_CHECK(u4.parts == std::vector<std::string>({"(", "+", ")"}));
+    symbolic_dag d({"x", "y"}, {u2, u3, u4}, {4u, 0u});
+    BOOST_CHECK_EQUAL(d.get_n_nodes(), 3u);
+    BOOST_CHECK_EQUAL(d.get_name(1u), "y");
+    BOOST_CHECK_EQUAL(d.get_name(3u), "u3");
+    BOOST_CHECK_EQUAL(d.get_definition(2u), "(u2+u3)");
+    BOOST_CHECK_EQUAL(d.to_string(), "u2 = (x*y)\nu3 = sin(u2)\nu4 = (u2+u3)\no0 = u4\no1 = x\n");
+    std::ostringstream ss;
+    ss << d;
+    BOOST_CHECK_EQUAL(ss.str(), d.to_string());
+    BOOST_CHECK(d.flatten() == std::vector<std::string>({"((x*y)+sin((x*y)))", "x"}));
+    BOOST_CHECK_THROW(d.get_name(5u), std::invalid_argument);
+    BOOST_CHECK_THROW(d.get_definition(3u), std::invalid_argument);
+    // Malformed placeholders
+    BOOST_CHECK_THROW(symbolic_dag::make_node("u2", "sin(\x1f" "0)", {0u}), std::invalid_argument);
+    BOOST_CHECK_THROW(symbolic_dag::make_node("u2", "sin(\x1f" "a\x1f)", {0u}), std::invalid_argument);
+    BOOST_CHECK_THROW(symbolic_dag::make_node("u2", "sin(" + symbolic_dag::placeholder(1u) + ")", {0u}),
+                      std::invalid_argument);
+    // Inconsistent data
+    BOOST_CHECK_THROW(symbolic_dag({"x", "y"}, {u3}, {2u}), std::invalid_argument);
+    BOOST_CHECK_THROW(symbolic_dag({"x", "y"}, {u2}, {3u}), std::invalid_argument);
+    BOOST_CHECK_THROW(symbolic_dag({"x", "u2"}, {u2}, {2u}), std::invalid_argument);
+    symbolic_dag::node bad{"u2", {"("}, {0u}};
+    BOOST_CHECK_THROW(symbolic_dag({"x", "y"}, {bad}, {2u}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(expressions)
+{
+    // The flattened DAG is the symbolic output of the call operator
+    kernel_set<double> set({"sum", "diff", "mul", "div", "pdiv", "sig", "sin", "log", "exp"});
+    kernel_set<gdual_d> set_d({"sum", "diff", "mul", "div", "pdiv", "sig", "sin", "log", "exp"});
+    kernel_set<double> ann_set({"sig", "tanh", "ReLu", "ELU", "ISRU", "sum"});
+    std::vector<std::string> in({"x", "y", "z"});
+    for (auto seed = 0u; seed < 50u; ++seed) {
+        expression<double> ex(3u, 2u, 3u, 10u, 11u, 2u, set(), seed);
+        auto d = ex.symbolic(in);
+        BOOST_CHECK(d.flatten() == ex(in));
+        // Each active node is written once
+        BOOST_CHECK_EQUAL(d.get_n_nodes(), std::count_if(ex.get_active_nodes().begin(), ex.get_active_nodes().end(),
+                                                         [](unsigned id) { return id >= 3u; }));
+        expression<gdual_d> ex_d(3u, 2u, 3u, 10u, 11u, 2u, set_d(), seed);
+        BOOST_CHECK(ex_d.symbolic(in).flatten() == ex_d(in));
+        expression_weighted<double> ex_w(3u, 2u, 3u, 10u, 11u, 2u, set(), seed);
+        BOOST_CHECK(ex_w.symbolic(in).flatten() == ex_w(in));
+        expression_ann ex_a(3u, 2u, 5u, 6u, 4u, 2u, ann_set(), seed);
+        auto d_a = ex_a.symbolic(in, "n");
+        BOOST_CHECK(d_a.flatten() == ex_a(in));
+        // The weights and biases symbols are in the definitions
+        for (auto k = 0u; k < d_a.get_n_nodes(); ++k) {
+            auto id = d_a.get_nodes()[k].name.substr(1u);
+            BOOST_CHECK(d_a.get_definition(k).find("w" + id + "_0*") != std::string::npos);
+            BOOST_CHECK(d_a.get_definition(k).find("b" + id + "+") != std::string::npos);
+        }
+    }
+    expression<double> ex(3u, 2u, 3u, 10u, 11u, 2u, set(), 0u);
+    BOOST_CHECK_THROW(ex.symbolic({"x", "y"}), std::invalid_argument);
+    // A node name is an input symbol
+    auto name = ex.symbolic(in).get_nodes()[0].name;
+    BOOST_CHECK_THROW(ex.symbolic({"x", "y", name}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(deep_reuse)
+{
+    // A chain where each node uses the previous one twice: the flattened output doubles at each node while the DAG
+    // grows linearly
+    kernel_set<double> set({"mul"});
+    const unsigned c = 60u;
+    expression<double> ex(1u, 1u, 1u, c, c + 1u, 2u, set(), 0u);
+    std::vector<unsigned> x;
+    for (auto k = 0u; k < c; ++k) {
+        x.insert(x.end(), {0u, k, k});
+    }
+    x.push_back(c);
+    ex.set(x);
+    auto d = ex.symbolic({"x"});
+    BOOST_CHECK_EQUAL(d.get_n_nodes(), c);
+    BOOST_CHECK(d.to_string().size() < 30u * c);
+    BOOST_CHECK_EQUAL(d.get_definition(c - 1u), "(u" + std::to_string(c - 1u) + "*u" + std::to_string(c - 1u) + ")");
+}
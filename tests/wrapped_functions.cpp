@@ -1,7 +1,10 @@
 #define BOOST_TEST_MODULE dcgp_wrapped_functions_test
 #include <boost/test/unit_test.hpp>
 #include <cmath>
+#include <dcgp/kernel_set.hpp>
 #include <dcgp/wrapped_functions.hpp>
+#include <random>
+#include <vector>
 
 using namespace dcgp;
 
@@ -43,3 +46,45 @@ BOOST_AUTO_TEST_CASE(pdiv)
         BOOST_CHECK(std::isfinite(my_pdiv(v)));
     }
 }
+
+BOOST_AUTO_TEST_CASE(derivatives)
+{
+    // The partial derivatives of all the double kernels are checked against central differences
+    kernel_set<double> set({"sum", "diff", "mul", "div", "pdiv", "sig", "tanh", "ReLu", "ELU", "ISRU", "sin", "cos",
+                            "log", "exp"});
+    std::mt19937 gen(123u);
+    std::uniform_real_distribution<> uni(0.2, 2.);
+    std::bernoulli_distribution sign(0.5);
+    std::vector<double> grad;
+    for (const auto &k : set()) {
+        BOOST_CHECK(k.has_derivative());
+        for (auto arity = 2u; arity <= 4u; ++arity) {
+            for (auto trial = 0u; trial < 10u; ++trial) {
+                std::vector<double> in(arity);
+                for (auto &v : in) {
+                    v = uni(gen) * ((sign(gen) && k.get_name() != "log") ? -1. : 1.);
+                }
+                auto out = k(in);
+                k.d(in, out, grad);
+                BOOST_CHECK_EQUAL(grad.size(), arity);
+                for (auto j = 0u; j < arity; ++j) {
+                    auto p = in, m = in;
+                    p[j] += 1e-6;
+                    m[j] -= 1e-6;
+                    BOOST_CHECK_SMALL(grad[j] - (k(p) - k(m)) / 2e-6, 1e-5 * (1. + std::abs(grad[j])));
+                }
+            }
+        }
+    }
+    // Where the protected division is not finite its derivatives vanish
+    std::vector<double> in({0.4, 0.});
+    grad.resize(2u);
+    d_my_pdiv(in, my_pdiv(in), grad);
+    BOOST_CHECK_EQUAL(grad[0], 0.);
+    BOOST_CHECK_EQUAL(grad[1], 0.);
+    // The gdual kernels do not provide derivatives
+    kernel_set<gdual_d> set_d({"sum"});
+    BOOST_CHECK(!set_d()[0].has_derivative());
+    std::vector<gdual_d> grad_d;
+    BOOST_CHECK_THROW(set_d()[0].d({gdual_d(1.)}, gdual_d(1.), grad_d), std::invalid_argument);
+}